@@ -96,6 +96,50 @@ enum UCS_S_PACKED ucg_group_member_distance {
     UCG_GROUP_MEMBER_DISTANCE_LAST
 };
 
+/* Predefined reduction operators, see @ref ucg_group_params_t */
+typedef enum ucg_reduce_op {
+    UCG_REDUCE_OP_SUM = 0,
+    UCG_REDUCE_OP_PROD,
+    UCG_REDUCE_OP_MIN,
+    UCG_REDUCE_OP_MAX,
+    UCG_REDUCE_OP_BAND,
+    UCG_REDUCE_OP_BOR,
+    UCG_REDUCE_OP_BXOR,
+    UCG_REDUCE_OP_LAST
+} ucg_reduce_op_t;
+
+/* Predefined reduction data-types, see @ref ucg_group_params_t */
+typedef enum ucg_reduce_dt {
+    UCG_REDUCE_DT_INT8 = 0,
+    UCG_REDUCE_DT_INT16,
+    UCG_REDUCE_DT_INT32,
+    UCG_REDUCE_DT_INT64,
+    UCG_REDUCE_DT_UINT8,
+    UCG_REDUCE_DT_UINT16,
+    UCG_REDUCE_DT_UINT32,
+    UCG_REDUCE_DT_UINT64,
+    UCG_REDUCE_DT_FLOAT,
+    UCG_REDUCE_DT_DOUBLE,
+    UCG_REDUCE_DT_LAST
+} ucg_reduce_dt_t;
+
+/*
+ * Reduction kernel: computes dst[i] = src[i] (op) dst[i] for "count" elements,
+ * same as MPI_Reduce_local(src, dst), or the other way around if "reversed".
+ * It's resolved once per collective operation, see @ref ucg_group_params_t.
+ */
+typedef void (*ucg_reduce_kernel_f)(void *arg, void *dst, const void *src,
+                                    size_t count);
+
+typedef struct ucg_reduce_kernel {
+    ucg_reduce_kernel_f func;           /* the reduction itself */
+    ucg_reduce_kernel_f func_reversed;  /* dst[i] = dst[i] (op) src[i], or NULL */
+    void               *arg;            /* passed as the first argument of func */
+    size_t              dt_len;         /* size of an element, in bytes */
+    int                 is_commutative; /* (a op b) == (b op a) */
+    const void         *identity;       /* element x, for which (x op a) == a, or NULL */
+} ucg_reduce_kernel_t;
+
 enum UCS_S_PACKED ucg_group_hierarchy_level {
     UCG_GROUP_HIERARCHY_LEVEL_NODE = 0,
     UCG_GROUP_HIERARCHY_LEVEL_SOCKET,
@@ -106,7 +150,14 @@ typedef struct ucg_group_params {
     ucg_group_member_index_t member_count; /* number of group members */
     uint32_t cid;                          /* Assign value to group_id */
 
-    char **topo_map; /* Global topology map, topo_map[i][j] means Distance between rank i and rank j. */
+    /*
+     * Global topology map, topo_map[i][j] means Distance between rank i and rank j.
+     * Optional - and only read during @ref ucg_group_create: the group keeps a
+     * compact copy of the topology (shared with other groups of the same
+     * layout), which planners get with ucg_group_topo(). The distance and node
+     * index arrays below are copied, and remain available to the planners.
+     */
+    char **topo_map;
 
     /*
      * This array contains information about the process placement of different
@@ -149,6 +200,30 @@ typedef struct ucg_group_params {
     /* Callback function for MPI_OP */
     int (*op_is_commute_f)(void *mpi_op);
 
+    /*
+     * Number of collectives which may be in progress on this group at the same
+     * time - further ones are started once an earlier one completes. Rounded up
+     * to a power of 2 (at most 128), and 0 selects the planner's default.
+     * Must be the same on all the members of the group.
+     */
+    unsigned max_concurrent_colls;
+
+    /*
+     * Callback function identifying predefined reductions (optional). Returns
+     * non-zero, and sets the operator and data-type, for those the planner can
+     * compute with its own (vectorized) kernels instead of calling mpi_reduce_f.
+     */
+    int (*reduce_type_f)(void *mpi_op, void *mpi_dtype,
+                         ucg_reduce_op_t *op_p, ucg_reduce_dt_t *dt_p);
+
+    /*
+     * Callback function resolving other reductions (optional), called once when
+     * a collective operation is created rather than per incoming message. Fills
+     * the kernel and returns UCS_OK, or returns an error to use mpi_reduce_f.
+     */
+    ucs_status_t (*reduce_resolve_f)(void *mpi_op, void *mpi_dtype,
+                                     ucg_reduce_kernel_t *kernel);
+
 } ucg_group_params_t;
 
 typedef struct ucg_collective {
@@ -179,6 +254,14 @@ typedef struct ucg_collective {
 
 } ucg_collective_params_t;
 
+/* A collective operation expected to be used, to be planned in advance */
+typedef struct ucg_collective_warmup {
+    ucg_collective_type_t     type;     /* the type (and root) of the collective */
+    size_t                    msg_size; /* typical message size, in bytes (a multiple of dt_len) */
+    size_t                    dt_len;   /* external datatype length */
+    void                     *op_ext;   /* external reduce operation handle, or NULL */
+} ucg_collective_warmup_t;
+
 
 /**
  * @ingroup UCG_GROUP
@@ -205,6 +288,69 @@ ucs_status_t ucg_group_create(ucg_worker_h worker,
                               ucg_group_h *group_p);
 
 
+/**
+ * @ingroup UCG_GROUP
+ * @brief Create a group object, and connect its members in the background.
+ *
+ * This routine is similar to @ref ucg_group_create, but it also starts
+ * connecting to the group members the first collective operations would use
+ * (all at once, rather than one at a time). The group can be used immediately,
+ * and collectives created before the request completes wait for the connections
+ * they need. The request is completed by @ref ucg_group_progress.
+ *
+ * @param [in] worker      Worker to create a group on top of.
+ * @param [in] params      User defined @ref ucg_group_params_t configurations for the
+ *                         @ref ucg_group_h "UCG group".
+ * @param [out] group_p    A pointer to the group object allocated by the
+ *                         UCG library
+ * @param [in]  req        Request handle allocated by the user. There should
+ *                         be at least UCG request size bytes of available
+ *                         space before the @a req. The size of UCG request
+ *                         can be obtained by @ref ucg_context_query function.
+ *
+ * @return UCS_OK           - The group was created and connected immediately.
+ * @return UCS_INPROGRESS   - The group was created, but is still connecting.
+ *                            @ref ucg_request_check_status() should be used to
+ *                            monitor @a req status.
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_group_create_nb(ucg_worker_h worker,
+                                 const ucg_group_params_t *params,
+                                 ucg_group_h *group_p, void *req);
+
+
+/**
+ * @ingroup UCG_GROUP
+ * @brief Plan collective operations in advance, and connect their peers.
+ *
+ * This routine creates the plans for the given collective operations - as
+ * @ref ucg_collective_create would when first called for them (with a message
+ * of the same size class) - and connects all the group members they require.
+ * This moves these costs out of the first collective calls, e.g. to before the
+ * application's main loop. Variable-length collectives are not supported.
+ *
+ * @note The plans are cached, so they may still be evicted if the plan cache
+ *       exceeds its memory budget.
+ *
+ * @param [in]  group       Group object to prepare.
+ * @param [in]  colls       Collective operations expected to be used.
+ * @param [in]  coll_cnt    Number of entries in @a colls.
+ * @param [in]  req         Request handle allocated by the user, or NULL to
+ *                          wait for all the connections to be established.
+ *                          Otherwise, the connections are established in the
+ *                          background by @ref ucg_group_progress, and the
+ *                          request completes once all of them are.
+ *
+ * @return UCS_OK           - The plans were created and connected.
+ * @return UCS_INPROGRESS   - The plans were created, but are still connecting.
+ *                            @ref ucg_request_check_status() should be used to
+ *                            monitor @a req status.
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_group_warmup(ucg_group_h group, const ucg_collective_warmup_t *colls,
+                              unsigned coll_cnt, void *req);
+
+
 /**
  * @ingroup UCG_GROUP
  * @brief Destroy a group object.
@@ -243,6 +389,67 @@ unsigned ucg_group_progress(ucg_group_h group);
 unsigned ucg_worker_progress(ucg_worker_h worker);
 
 
+/**
+ * @ingroup UCG_GROUP
+ * @brief Obtain an event file descriptor for the interfaces of a Worker.
+ *
+ * The descriptor becomes readable on network events of any of the interfaces
+ * the groups of this worker communicate over, once armed by
+ * @ref ucg_worker_arm. It requires the context to be created with
+ * UCP_FEATURE_WAKEUP. Since more interfaces may be used as groups connect to
+ * new members, the descriptor is kept up-to-date by the arm call.
+ *
+ * @param [in]  worker      Worker of the groups to wait for.
+ * @param [out] fd          File descriptor to poll on.
+ *
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_worker_get_efd(ucg_worker_h worker, int *fd);
+
+
+/**
+ * @ingroup UCG_GROUP
+ * @brief Arm the Worker's interfaces for event notification.
+ *
+ * @param [in]  worker      Worker of the groups to wait for.
+ *
+ * @return UCS_OK           - The event file descriptor may now be polled on.
+ * @return UCS_ERR_BUSY     - There are unprocessed events, so
+ *                            @ref ucg_worker_progress should be called first.
+ * @return Other error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_worker_arm(ucg_worker_h worker);
+
+
+/**
+ * @ingroup UCG_GROUP
+ * @brief Obtain an event file descriptor for the interfaces of a Group.
+ *
+ * Similar to @ref ucg_worker_get_efd, but only for the interfaces used by
+ * this group. It is armed by @ref ucg_group_arm.
+ *
+ * @param [in]  group       Group object to wait for.
+ * @param [out] fd          File descriptor to poll on.
+ *
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_group_get_efd(ucg_group_h group, int *fd);
+
+
+/**
+ * @ingroup UCG_GROUP
+ * @brief Arm the Group's interfaces for event notification.
+ *
+ * @param [in]  group       Group object to wait for.
+ *
+ * @return UCS_OK           - The event file descriptor may now be polled on.
+ * @return UCS_ERR_BUSY     - There are unprocessed events, so
+ *                            @ref ucg_group_progress should be called first.
+ * @return Other error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_group_arm(ucg_group_h group);
+
+
 /**
  * @ingroup UCG_GROUP
  * @brief Exposes the parameters used to create the Group object.
@@ -308,6 +515,38 @@ ucs_status_ptr_t ucg_collective_start_nb(ucg_coll_h coll);
 ucs_status_t ucg_collective_start_nbr(ucg_coll_h coll, void *req);
 
 
+/**
+ * @ingroup UCG_GROUP
+ * @brief Starts a collective operation on a different pair of buffers.
+ *
+ * Persistent collectives are typically issued many times with identical
+ * parameters except for the buffers. This call re-targets a previously
+ * created operation at @a sbuf and @a rbuf (keeping its plan, endpoints and
+ * the rest of its parameters) and starts it, avoiding the cost of creating a
+ * new operation. The buffers must be of the same size and layout as those
+ * originally passed to @ref ucg_collective_create, and the operation must not
+ * be in progress. Passing the original buffers is equivalent to
+ * @ref ucg_collective_start_nbr.
+ *
+ * @param [in]  coll        Collective operation handle.
+ * @param [in]  sbuf        Send buffer (MPI_IN_PLACE only if so at creation).
+ * @param [in]  rbuf        Receive buffer.
+ * @param [in]  req         Request handle allocated by the user, as described
+ *                          for @ref ucg_collective_start_nbr.
+ *
+ * @return UCS_OK           - The collective operation was completed immediately.
+ * @return UCS_INPROGRESS   - The collective was not completed and is in progress.
+ * @return UCS_ERR_UNSUPPORTED - The operation can not be re-targeted, e.g. if
+ *                            its planner does not support it.
+ * @return UCS_ERR_BUSY     - The operation is in progress, or other handles to
+ *                            it (returned by @ref ucg_collective_create for
+ *                            identical parameters) still use its buffers.
+ * @return Error code as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_collective_start_with_buffers(ucg_coll_h coll, const void *sbuf,
+                                               void *rbuf, void *req);
+
+
 /**
  * @ingroup UCG_GROUP
  * @brief Destroys a collective operation handle.
@@ -338,6 +577,24 @@ void ucg_collective_destroy(ucg_coll_h coll);
  */
 ucs_status_t ucg_request_check_status(void *request);
 
+
+/**
+ * @ingroup UCG_GROUP
+ * @brief Wait for a non-blocking request to complete.
+ *
+ * This routine progresses the group until the request completes. Once nothing
+ * has progressed for a while (UCX_UCG_WAIT_SPIN_TIME), it sleeps until the
+ * next network event rather than keep polling, which leaves the CPU to other
+ * processes, e.g. when oversubscribed or not bound to cores. Without wakeup
+ * support (see @ref ucg_group_get_efd) it yields the CPU instead.
+ *
+ * @param [in]  group       Group object the request belongs to.
+ * @param [in]  request     Non-blocking request to wait for.
+ *
+ * @return Completion status of the request, as defined by @ref ucs_status_t
+ */
+ucs_status_t ucg_request_wait(ucg_group_h group, void *request);
+
 void ucg_request_cancel(ucg_worker_h worker, void *request);
 
 void ucg_request_free(void *request);
@@ -13,6 +13,7 @@
 #include <uct/api/uct.h>
 #include <ucs/config/parser.h>
 #include <ucs/datastruct/mpool.h>
+#include <ucs/datastruct/khash.h>
 #include <ucs/datastruct/list_types.h>
 #include <ucs/datastruct/queue_types.h>
 
@@ -97,10 +98,19 @@ typedef struct ucg_plan_config {
     enum ucg_plan_ft_mode ft;
 } ucg_plan_config_t;
 
+typedef struct ucg_op ucg_op_t;
+
+/* Operations of a plan, looked up by their (entire) collective parameters */
+KHASH_TYPE(ucg_plan_op, const ucg_collective_params_t*, ucg_op_t*);
+
 typedef struct ucg_base_plan {
     /* Plan lookup - caching mechanism */
     ucg_collective_type_t    type;
-    ucs_list_link_t          op_head;   /**< List of requests following this plan */
+    ucs_list_link_t          op_head;   /**< List of requests following this plan, most recently used first */
+    khash_t(ucg_plan_op)     op_hash;   /**< Lookup of the operations in op_head */
+    unsigned                 op_cnt;    /**< Number of operations in op_head */
+    unsigned                 op_live;   /**< Operations not discarded yet - cached or not */
+    size_t                   op_footprint; /**< Memory used by those operations */
 
     /* Plan progress */
     ucg_plan_component_t    *planner;
@@ -117,8 +127,9 @@ typedef struct ucg_base_plan {
 
 enum ucg_request_common_flags {
     UCG_REQUEST_COMMON_FLAG_COMPLETED = UCS_BIT(0),
+    UCG_REQUEST_COMMON_FLAG_EMBEDDED  = UCS_BIT(1), /**< the pending_comp of an operation */
 
-    UCG_REQUEST_COMMON_FLAG_MASK = UCS_MASK(1)
+    UCG_REQUEST_COMMON_FLAG_MASK = UCS_MASK(2)
 };
 
 typedef struct ucg_request {
@@ -126,22 +137,36 @@ typedef struct ucg_request {
     volatile ucs_status_t    status;     /**< Operation status */
 } ucg_request_t;
 
-typedef struct ucg_op {
+enum ucg_op_flags {
+    UCG_OP_FLAG_IN_FLIGHT = UCS_BIT(0), /**< started, and not completed yet */
+    UCG_OP_FLAG_QUEUED    = UCS_BIT(1), /**< on the pending queue of the group */
+    UCG_OP_FLAG_REQ_HELD  = UCS_BIT(2), /**< pending_comp was given to the user, and
+                                             not released by @ref ucg_request_free */
+};
+
+struct ucg_op {
     /* Collective-specific request content */
     union {
         ucs_list_link_t      list;        /**< cache list member */
         struct {
             ucs_queue_elem_t queue;       /**< pending queue member */
-            ucg_request_t  **pending_req; /**< original invocation request */
+            ucg_request_t   *pending_req; /**< request to complete once started */
         };
     };
 
+    ucg_request_t            pending_comp; /**< request for a queued call without one,
+                                                valid until released or started again */
+
     ucg_plan_t              *plan;        /**< The group this belongs to */
+    volatile uint32_t        flags;       /**< @ref enum ucg_op_flags */
+    uint32_t                 handles;     /**< handles the user may still use, see
+                                               @ref ucg_plan_op_is_idle */
+    size_t                   footprint;   /**< memory used, counted in the plan */
     ucg_collective_params_t  params;      /**< original parameters for it */
 
     /* Component-specific request content */
     char                     priv[0];
-} ucg_op_t;
+};
 
 struct ucg_plan_component {
     /* test for support and other attribures of this component */
@@ -168,16 +193,23 @@ struct ucg_plan_component {
                                        ucg_group_h group,
                                        ucg_collective_params_t *coll_params,
                                        ucg_plan_t **plan_p);
+    /* destroy a plan, along with all its operations */
+    void                   (*destroy_plan)(ucg_plan_t *plan);
     /* Prepare an operation to follow the given plan */
     ucs_status_t           (*prepare) (ucg_plan_t *plan,
                                        const ucg_collective_params_t *coll_params,
                                        ucg_op_t **op);
-    /* Trigger an operation to start, generate a request handle for updates */
+    /* Trigger an operation to start, generate a request handle for updates
+     * (UCS_ERR_NO_RESOURCE means it can't start yet, and is retried later) */
     ucs_status_t           (*trigger) (ucg_op_t *op,
                                        ucg_coll_id_t coll_id,
                                        ucg_request_t **request);
     /* Discard an operation previously prepared */
     void                   (*discard) (ucg_op_t *op);
+    /* Point a prepared operation at other buffers (optional, may be NULL) */
+    ucs_status_t           (*rebind)  (ucg_op_t *op,
+                                       const void *sbuf,
+                                       void *rbuf);
 
     /* print a plan object, for debugging purposes */
     void                   (*print)   (ucg_plan_t *plan,
@@ -212,8 +244,12 @@ struct ucg_plan_component {
  * @param _planc         Planning component structure to initialize.
  * @param _name          Planning component name.
  * @param _query         Function to query planning resources.
+ * @param _plan          Function to plan a collective operation.
+ * @param _destroy_plan  Function to release a plan and all its operations.
  * @param _prepare       Function to prepare an operation according to a plan.
  * @param _trigger       Function to start a prepared collective operation.
+ * @param _discard       Function to release a prepared operation.
+ * @param _rebind        Function to re-target an operation to other buffers.
  * @param _destroy       Function to release a plan and all related objects.
  * @param _priv          Custom private data.
  * @param _cfg_prefix    Prefix for configuration environment variables.
@@ -221,8 +257,9 @@ struct ucg_plan_component {
  * @param _cfg_struct    Planning component configuration structure.
  */
 #define UCG_PLAN_COMPONENT_DEFINE(_planc, _name, _sz, _query, _create, _destroy,\
-                                  _progress, _plan, _prepare, _trigger, _discard,\
-                                  _print, _cfg_prefix, _cfg_table, _cfg_struct)\
+                                  _progress, _plan, _destroy_plan, _prepare,   \
+                                  _trigger, _discard, _rebind, _print,         \
+                                  _cfg_prefix, _cfg_table, _cfg_struct)        \
                                                                                \
     ucg_plan_component_t _planc = {                                            \
         .group_context_size = (_sz),                                           \
@@ -231,9 +268,11 @@ struct ucg_plan_component {
         .destroy            = (_destroy),                                      \
         .progress           = (_progress),                                     \
         .plan               = (_plan),                                         \
+        .destroy_plan       = (_destroy_plan),                                 \
         .prepare            = (_prepare),                                      \
         .trigger            = (_trigger),                                      \
         .discard            = (_discard),                                      \
+        .rebind             = (_rebind),                                       \
         .print              = (_print),                                        \
         .cfg_prefix         = (_cfg_prefix),                                   \
         .plan_config_table  = (_cfg_table),                                    \
@@ -251,6 +290,27 @@ ucs_status_t ucg_plan_single(ucg_plan_component_t *planc,
                              ucg_plan_desc_t **resources_p,
                              unsigned *nums_p);
 
+/* Helper functions for the per-plan cache of operations */
+void ucg_plan_op_cache_init(ucg_plan_t *plan);
+ucg_op_t *ucg_plan_op_cache_get(ucg_plan_t *plan, const ucg_collective_params_t *params);
+void ucg_plan_op_cache_add(ucg_plan_t *plan, ucg_op_t *op, unsigned cache_size);
+void ucg_plan_op_cache_remove(ucg_plan_t *plan, ucg_op_t *op);
+void ucg_plan_op_cache_cleanup(ucg_plan_t *plan);
+void ucg_plan_op_discard(ucg_plan_t *plan, ucg_op_t *op);
+
+/*
+ * Whether a cached operation may be discarded: it's not running, and the user
+ * has no handle to it - handles are returned by @ref ucg_collective_create, and
+ * given back by @ref ucg_collective_destroy or (unless persistent) by starting -
+ * nor to its own request.
+ */
+static inline int ucg_plan_op_is_idle(const ucg_op_t *op)
+{
+    return !(op->flags & (UCG_OP_FLAG_IN_FLIGHT | UCG_OP_FLAG_QUEUED |
+                          UCG_OP_FLAG_REQ_HELD)) &&
+           (op->handles == 0);
+}
+
 /* Helper function for connecting to other group members - by their index */
 typedef ucs_status_t (*ucg_plan_reg_handler_cb)(uct_iface_h iface, void *arg);
 ucs_status_t ucg_plan_connect(ucg_group_h group, ucg_group_member_index_t index,
@@ -258,6 +318,45 @@ ucs_status_t ucg_plan_connect(ucg_group_h group, ucg_group_member_index_t index,
                               uct_md_h* md_p, const uct_md_attr_t** md_attr_p, 
                               ucp_ep_h *ucp_ep_p);
 
+/*
+ * Non-blocking variant of the above, so that many members can be wired up at
+ * once: start connecting (*ucp_ep_p is NULL for a "debugging" connection),
+ * then progress all the endpoints together until they're ready (returns
+ * UCS_INPROGRESS until then), and only then query their transport details.
+ */
+ucs_status_t ucg_plan_connect_nb(ucg_group_h group, ucg_group_member_index_t index,
+                                 ucp_ep_h *ucp_ep_p);
+ucs_status_t ucg_plan_connect_all_nb(ucg_group_h group, ucp_ep_h *ucp_eps,
+                                     unsigned ep_cnt);
+ucs_status_t ucg_plan_connect_finish(ucg_group_h group, ucp_ep_h ucp_ep,
+                                     uct_ep_h *ep_p, const uct_iface_attr_t **ep_attr_p,
+                                     uct_md_h* md_p, const uct_md_attr_t** md_attr_p);
+
+/* The component of the memory domain above, e.g. for unpacking remote keys */
+uct_component_h ucg_plan_connect_component(ucp_ep_h ucp_ep);
+
+/*
+ * The lanes of a (connected) endpoint, which may carry active messages with
+ * a high bandwidth - e.g. one per HCA - for striping large messages across.
+ * The first is always the lane returned by @ref ucg_plan_connect_finish .
+ */
+typedef struct ucg_plan_lane {
+    uct_ep_h                ep;
+    const uct_iface_attr_t *ep_attr;
+    uct_md_h                md;
+    const uct_md_attr_t    *md_attr;
+} ucg_plan_lane_t;
+
+ucs_status_t ucg_plan_connect_lanes(ucg_group_h group, ucp_ep_h ucp_ep,
+                                    ucg_plan_lane_t *lanes, unsigned max_lanes,
+                                    unsigned *lane_cnt_p);
+
+/*
+ * Release an endpoint obtained by one of the above. Endpoints are shared by
+ * all the plans on the worker, so it's only closed once no plan uses it.
+ */
+void ucg_plan_disconnect(ucg_group_h group, ucp_ep_h ucp_ep);
+
 /* Helper function for selecting other planners - to be used as fall-back */
 ucs_status_t ucg_plan_select(ucg_group_h group, const char* planner_name,
                              const ucg_collective_params_t *params,
@@ -0,0 +1,137 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include "ucg_ep_table.h"
+
+#include <string.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+
+static inline khint32_t ucg_ep_table_key_hash(ucg_ep_table_key_t key)
+{
+    /* FNV-1a, over the entire address */
+    const uint8_t *byte = (const uint8_t*)key.addr;
+    khint32_t hash      = 2166136261u;
+    size_t i;
+
+    for (i = 0; i < key.addr_len; i++) {
+        hash = (hash ^ byte[i]) * 16777619u;
+    }
+    return hash;
+}
+
+#define ucg_ep_table_key_equal(_key1, _key2) \
+    (((_key1).addr_len == (_key2).addr_len) && \
+     !memcmp((_key1).addr, (_key2).addr, (_key1).addr_len))
+
+KHASH_IMPL(ucg_ep_by_addr, ucg_ep_table_key_t, ucg_ep_table_entry_t*, 1,
+           ucg_ep_table_key_hash, ucg_ep_table_key_equal);
+
+KHASH_IMPL(ucg_ep_by_ep, uint64_t, ucg_ep_table_entry_t*, 1,
+           kh_int64_hash_func, kh_int64_hash_equal);
+
+void ucg_ep_table_init(ucg_ep_table_t *table)
+{
+    kh_init_inplace(ucg_ep_by_addr, &table->by_addr);
+    kh_init_inplace(ucg_ep_by_ep, &table->by_ep);
+}
+
+void ucg_ep_table_cleanup(ucg_ep_table_t *table)
+{
+    ucg_ep_table_entry_t *entry;
+
+    kh_foreach_value(&table->by_ep, entry, {
+        ucs_debug("endpoint %p is still used %u times", entry->ep, entry->refcount);
+        ucs_free(entry);
+    });
+
+    kh_destroy_inplace(ucg_ep_by_addr, &table->by_addr);
+    kh_destroy_inplace(ucg_ep_by_ep, &table->by_ep);
+}
+
+ucp_ep_h ucg_ep_table_get(ucg_ep_table_t *table, const ucp_address_t *addr,
+                          size_t addr_len)
+{
+    ucg_ep_table_key_t key = {
+        .addr     = addr,
+        .addr_len = addr_len
+    };
+
+    khiter_t iter = kh_get(ucg_ep_by_addr, &table->by_addr, key);
+    if (iter == kh_end(&table->by_addr)) {
+        return NULL;
+    }
+
+    ucg_ep_table_entry_t *entry = kh_val(&table->by_addr, iter);
+    entry->refcount++;
+    return entry->ep;
+}
+
+ucs_status_t ucg_ep_table_add(ucg_ep_table_t *table, const ucp_address_t *addr,
+                              size_t addr_len, ucp_ep_h ep)
+{
+    int ret;
+    khiter_t iter;
+    ucg_ep_table_entry_t *entry = ucs_malloc(sizeof(*entry) + addr_len,
+                                             "ucg endpoint table entry");
+    if (entry == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    entry->ep       = ep;
+    entry->refcount = 1;
+    entry->addr_len = addr_len;
+    memcpy(entry->addr, addr, addr_len);
+
+    /* the key refers to the copy, since the callers' address is released */
+    ucg_ep_table_key_t key = {
+        .addr     = entry->addr,
+        .addr_len = addr_len
+    };
+
+    iter = kh_put(ucg_ep_by_addr, &table->by_addr, key, &ret);
+    if (ret < 0) {
+        goto err_free;
+    }
+    ucs_assert(ret != 0); /* only missing addresses are connected */
+    kh_val(&table->by_addr, iter) = entry;
+
+    iter = kh_put(ucg_ep_by_ep, &table->by_ep, (uintptr_t)ep, &ret);
+    if (ret < 0) {
+        kh_del(ucg_ep_by_addr, &table->by_addr,
+               kh_get(ucg_ep_by_addr, &table->by_addr, key));
+        goto err_free;
+    }
+    kh_val(&table->by_ep, iter) = entry;
+    return UCS_OK;
+
+err_free:
+    ucs_free(entry);
+    return UCS_ERR_NO_MEMORY;
+}
+
+int ucg_ep_table_put(ucg_ep_table_t *table, ucp_ep_h ep)
+{
+    khiter_t iter = kh_get(ucg_ep_by_ep, &table->by_ep, (uintptr_t)ep);
+    if (iter == kh_end(&table->by_ep)) {
+        return 1; /* not shared - the caller owns it */
+    }
+
+    ucg_ep_table_entry_t *entry = kh_val(&table->by_ep, iter);
+    ucs_assert(entry->refcount > 0);
+    if (--entry->refcount > 0) {
+        return 0;
+    }
+
+    ucg_ep_table_key_t key = {
+        .addr     = entry->addr,
+        .addr_len = entry->addr_len
+    };
+    kh_del(ucg_ep_by_ep, &table->by_ep, iter);
+    kh_del(ucg_ep_by_addr, &table->by_addr,
+           kh_get(ucg_ep_by_addr, &table->by_addr, key));
+    ucs_free(entry);
+    return 1;
+}
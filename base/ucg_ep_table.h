@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_EP_TABLE_H_
+#define UCG_EP_TABLE_H_
+
+#include <ucp/api/ucp.h>
+#include <ucs/datastruct/khash.h>
+
+/* Remote worker address, as returned by the address resolution callback */
+typedef struct ucg_ep_table_key {
+    const void *addr;
+    size_t      addr_len;
+} ucg_ep_table_key_t;
+
+/*
+ * An endpoint shared by all the plans (of all the groups) on the worker which
+ * reach the same remote worker. It's closed once no plan uses it.
+ */
+typedef struct ucg_ep_table_entry {
+    ucp_ep_h ep;
+    unsigned refcount;       /* number of plan phases using this endpoint */
+    size_t   addr_len;
+    uint8_t  addr[0];        /* copy of the remote address, used as the key */
+} ucg_ep_table_entry_t;
+
+KHASH_TYPE(ucg_ep_by_addr, ucg_ep_table_key_t, ucg_ep_table_entry_t*);
+KHASH_TYPE(ucg_ep_by_ep, uint64_t, ucg_ep_table_entry_t*);
+
+typedef struct ucg_ep_table {
+    khash_t(ucg_ep_by_addr) by_addr; /* lookup on connection */
+    khash_t(ucg_ep_by_ep)   by_ep;   /* lookup on release */
+} ucg_ep_table_t;
+
+void ucg_ep_table_init(ucg_ep_table_t *table);
+
+/* Release the table itself - the endpoints are closed along with the worker */
+void ucg_ep_table_cleanup(ucg_ep_table_t *table);
+
+/* Borrow the endpoint to this remote address, or return NULL if there's none */
+ucp_ep_h ucg_ep_table_get(ucg_ep_table_t *table, const ucp_address_t *addr,
+                          size_t addr_len);
+
+/* Add a newly created endpoint, borrowed once */
+ucs_status_t ucg_ep_table_add(ucg_ep_table_t *table, const ucp_address_t *addr,
+                              size_t addr_len, ucp_ep_h ep);
+
+/* Return a borrowed endpoint: returns 1 if it's no longer used (and removed) */
+int ucg_ep_table_put(ucg_ep_table_t *table, ucp_ep_h ep);
+
+#endif /* UCG_EP_TABLE_H_ */
@@ -6,6 +6,7 @@
 #include "ucg_group.h"
 #include "../builtin/plan/builtin_plan.h"
 
+#include <ucg/api/ucg_mpi.h>
 #include <ucp/core/ucp_ep.inl>
 #include <ucp/core/ucp_worker.h>
 #include <ucs/datastruct/queue.h>
@@ -14,6 +15,12 @@
 #include <ucs/debug/memtrack.h>
 #include <ucp/core/ucp_ep.inl>
 #include <ucp/core/ucp_proxy_ep.h> /* for @ref ucp_proxy_ep_test */
+#include <ucs/time/time.h>
+#include <sys/epoll.h>
+#include <unistd.h>
+#include <sched.h>
+#include <errno.h>
+#include <limits.h>
 
 #if ENABLE_STATS
 /**
@@ -27,6 +34,10 @@ enum {
     UCG_GROUP_STAT_OPS_USED,
     UCG_GROUP_STAT_OPS_IMMEDIATE,
 
+    UCG_GROUP_STAT_PLAN_CACHE_HITS,
+    UCG_GROUP_STAT_PLAN_CACHE_MISSES,
+    UCG_GROUP_STAT_PLAN_CACHE_EVICTIONS,
+
     UCG_GROUP_STAT_LAST
 };
 
@@ -38,11 +49,54 @@ static ucs_stats_class_t ucg_group_stats_class = {
         [UCG_GROUP_STAT_PLANS_USED]    = "plans_reused",
         [UCG_GROUP_STAT_OPS_CREATED]   = "ops_created",
         [UCG_GROUP_STAT_OPS_USED]      = "ops_started",
-        [UCG_GROUP_STAT_OPS_IMMEDIATE] = "ops_immediate"
+        [UCG_GROUP_STAT_OPS_IMMEDIATE] = "ops_immediate",
+        [UCG_GROUP_STAT_PLAN_CACHE_HITS]      = "plan_cache_hits",
+        [UCG_GROUP_STAT_PLAN_CACHE_MISSES]    = "plan_cache_misses",
+        [UCG_GROUP_STAT_PLAN_CACHE_EVICTIONS] = "plan_cache_evictions"
     }
 };
 #endif
 
+static inline khint32_t ucg_group_plan_key_hash(ucg_group_plan_key_t key)
+{
+    return kh_int64_hash_func(key.root ^ ((uint64_t)key.dt_len << 24) ^
+                              ((uint64_t)key.modifiers << 8) ^
+                              ((uint64_t)key.size_level << 4) ^ key.op_flags);
+}
+
+#define ucg_group_plan_key_equal(_key1, _key2) \
+    (!memcmp(&(_key1), &(_key2), sizeof(ucg_group_plan_key_t)))
+
+KHASH_IMPL(ucg_group_plan, ucg_group_plan_key_t, ucg_group_plan_entry_t*, 1,
+           ucg_group_plan_key_hash, ucg_group_plan_key_equal);
+
+static ucs_config_field_t ucg_groups_config_table[] = {
+    {"PLAN_CACHE_MEM", "16m", "Memory budget of the per-group plan cache, including the "
+     "cached operations, beyond which the least recently used plans are destroyed",
+     ucs_offsetof(ucg_groups_config_t, plan_cache_mem), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"OP_CACHE_SIZE", "1000", "Number of operations each plan keeps for reuse, beyond "
+     "which the least recently used idle ones are discarded",
+     ucs_offsetof(ucg_groups_config_t, op_cache_size), UCS_CONFIG_TYPE_UINT},
+
+    {"WAIT_SPIN_TIME", "50us", "How long ucg_request_wait() polls without any progress "
+     "before it sleeps until the next network event (requires the UCP wakeup feature)",
+     ucs_offsetof(ucg_groups_config_t, wait_spin_time), UCS_CONFIG_TYPE_TIME},
+
+    {NULL}
+};
+
+UCS_CONFIG_REGISTER_TABLE(ucg_groups_config_table, "UCG groups", "UCG_",
+                          ucg_groups_config_t)
+
+static inline const ucg_groups_config_t *ucg_group_config(ucg_group_h group)
+{
+    return &UCG_WORKER_TO_GROUPS_CTX(group->worker)->config;
+}
+
+/* longest sleep in @ref ucg_request_wait before checking the request again */
+#define UCG_GROUP_WAIT_TIMEOUT_MS 100
+
 #define UCG_GROUP_PROGRESS_ADD(iface, ctx) {         \
     unsigned idx = 0;                                \
     if (ucs_unlikely(idx == UCG_GROUP_MAX_IFACES)) { \
@@ -59,6 +113,66 @@ static ucs_stats_class_t ucg_group_stats_class = {
     }                                                \
 }
 
+static void ucg_group_wireup_complete(ucg_group_h group, ucs_status_t status)
+{
+    unsigned idx;
+    ucs_debug("group %hu wireup completed: %s", group->group_id,
+              ucs_status_string(status));
+
+    for (idx = 0; idx < group->wireup_req_cnt; idx++) {
+        ucg_request_t *req = group->wireup_reqs[idx];
+        req->status = status;
+        req->flags |= UCG_REQUEST_COMMON_FLAG_COMPLETED;
+    }
+
+    ucs_free(group->wireup_reqs);
+    group->wireup_reqs    = NULL;
+    group->wireup_req_cnt = 0;
+}
+
+static ucs_status_t ucg_group_wireup_check(ucg_group_h group)
+{
+    ucs_status_t ret = UCS_OK;
+    ucg_group_plan_entry_t *entry;
+    ucs_list_for_each(entry, &group->plan_lru, lru) {
+        ucg_builtin_plan_t *plan = ucs_derived_of(entry->plan, ucg_builtin_plan_t);
+        ucs_status_t status      = ucg_builtin_plan_connect_progress(plan);
+        if (UCS_STATUS_IS_ERR(status)) {
+            return status;
+        } else if (status == UCS_INPROGRESS) {
+            ret = UCS_INPROGRESS;
+        }
+    }
+
+    return ret;
+}
+
+static void ucg_group_wireup_progress(ucg_group_h group)
+{
+    ucs_status_t status = ucg_group_wireup_check(group);
+    if (status != UCS_INPROGRESS) {
+        ucg_group_wireup_complete(group, status);
+    }
+}
+
+static ucs_status_t ucg_group_wireup_add_req(ucg_group_h group, void *request)
+{
+    ucg_request_t **reqs = ucs_realloc(group->wireup_reqs,
+                                       (group->wireup_req_cnt + 1) * sizeof(*reqs),
+                                       "ucg group wireup requests");
+    if (reqs == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    ucg_request_t *req = (ucg_request_t*)request - 1;
+    req->flags         = 0;
+    req->status        = UCS_INPROGRESS;
+
+    reqs[group->wireup_req_cnt++] = req;
+    group->wireup_reqs            = reqs;
+    return UCS_OK;
+}
+
 unsigned ucg_worker_progress(ucg_worker_h worker)
 {
     unsigned idx;
@@ -70,6 +184,8 @@ unsigned ucg_worker_progress(ucg_worker_h worker)
     return ret;
 }
 
+static ucs_status_t ucg_collective_dispatch(ucg_group_h group);
+
 unsigned ucg_group_progress(ucg_group_h group)
 {
     unsigned idx;
@@ -85,38 +201,182 @@ unsigned ucg_group_progress(ucg_group_h group)
         ret += uct_iface_progress(group->ifaces[idx]);
     }
 
+    if (ucs_unlikely(group->wireup_req_cnt != 0)) {
+        ucg_group_wireup_progress(group);
+    }
+
+    /* operations which found the window full may start once a slot is free */
+    if (ucs_unlikely(!ucs_queue_is_empty(&group->pending))) {
+        (void) ucg_collective_dispatch(group);
+    }
+
     return ret;
 }
 
-unsigned ucg_base_am_id;
-size_t ucg_ctx_worker_offset;
+static void ucg_group_events_cleanup(ucg_group_events_t *events)
+{
+    if (events->epfd >= 0) {
+        close(events->epfd);
+        events->epfd = -1;
+    }
+}
 
-void ucg_init_group_cache(struct ucg_group *new_group)
+static ucs_status_t ucg_group_events_update(ucg_group_events_t *events,
+                                            uct_iface_h *ifaces, unsigned iface_cnt)
 {
-    unsigned idx, rank, algo_idx;
-    for (algo_idx = 0; algo_idx <  UCG_GROUP_MSG_SIZE_LEVEL; algo_idx++) {
-        for (rank = 0; rank < UCG_GROUP_MAX_ROOT_PARAM; rank++) {
-            for (idx = 0; idx < UCG_GROUP_MAX_COLL_TYPE_BUCKETS; idx++) {
-                new_group->cache[algo_idx][rank][idx] = NULL;
+    int fd;
+    ucs_status_t status;
+    struct epoll_event event = {0};
+
+    if (events->epfd < 0) {
+        events->epfd = epoll_create(1);
+        if (events->epfd < 0) {
+            ucs_error("epoll_create() failed: %m");
+            return UCS_ERR_IO_ERROR;
+        }
+    }
+
+    /* interfaces are only ever added (as new members are connected) */
+    for (; events->iface_cnt < iface_cnt; events->iface_cnt++) {
+        /* not supported unless the context was created with UCP_FEATURE_WAKEUP */
+        status = uct_iface_event_fd(ifaces[events->iface_cnt], &fd);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        event.events  = EPOLLIN;
+        event.data.fd = fd;
+        if (epoll_ctl(events->epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+            ucs_error("epoll_ctl(ADD, fd=%d) failed: %m", fd);
+            return UCS_ERR_IO_ERROR;
+        }
+    }
+
+    return UCS_OK;
+}
+
+static ucs_status_t ucg_group_events_arm(ucg_group_events_t *events,
+                                         uct_iface_h *ifaces, unsigned iface_cnt)
+{
+    unsigned idx;
+    ucs_status_t status = ucg_group_events_update(events, ifaces, iface_cnt);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    for (idx = 0; idx < iface_cnt; idx++) {
+        /* UCS_ERR_BUSY means there are events to progress before sleeping */
+        status = uct_iface_event_arm(ifaces[idx], UCT_EVENT_SEND_COMP |
+                                                  UCT_EVENT_RECV |
+                                                  UCT_EVENT_RECV_SIG);
+        if (status != UCS_OK) {
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
+ucs_status_t ucg_worker_get_efd(ucg_worker_h worker, int *fd)
+{
+    ucg_groups_t *gctx  = UCG_WORKER_TO_GROUPS_CTX(worker);
+    ucs_status_t status = ucg_group_events_update(&gctx->events, gctx->ifaces,
+                                                  gctx->iface_cnt);
+    *fd = gctx->events.epfd;
+    return status;
+}
+
+ucs_status_t ucg_worker_arm(ucg_worker_h worker)
+{
+    ucg_groups_t *gctx = UCG_WORKER_TO_GROUPS_CTX(worker);
+    return ucg_group_events_arm(&gctx->events, gctx->ifaces, gctx->iface_cnt);
+}
+
+ucs_status_t ucg_group_get_efd(ucg_group_h group, int *fd)
+{
+    ucs_status_t status = ucg_group_events_update(&group->events, group->ifaces,
+                                                  group->iface_cnt);
+    *fd = group->events.epfd;
+    return status;
+}
+
+ucs_status_t ucg_group_arm(ucg_group_h group)
+{
+    return ucg_group_events_arm(&group->events, group->ifaces, group->iface_cnt);
+}
+
+ucs_status_t ucg_request_wait(ucg_group_h group, void *request)
+{
+    struct epoll_event event;
+    ucs_status_t status;
+    int can_sleep = 1;
+
+    ucs_time_t spin_time = ucs_time_from_sec(ucg_group_config(group)->wait_spin_time);
+    ucs_time_t spin_end  = ucs_get_time() + spin_time;
+
+    while ((status = ucg_request_check_status(request)) == UCS_INPROGRESS) {
+        /* only sleep once nothing happened for the whole spin time */
+        if (ucg_group_progress(group)) {
+            spin_end = ucs_get_time() + spin_time;
+            continue;
+        } else if (ucs_get_time() < spin_end) {
+            continue;
+        }
+
+        if (!can_sleep) {
+            /* without wakeup support, at least let co-located processes run */
+            sched_yield();
+            continue;
+        }
+
+        /* nothing happened for a while - sleep until the next event */
+        UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(group->worker);
+        status = ucg_group_arm(group);
+        UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(group->worker);
+        if (status == UCS_OK) {
+            /* the timeout only guards against events no interface reports */
+            if ((epoll_wait(group->events.epfd, &event, 1, UCG_GROUP_WAIT_TIMEOUT_MS) < 0) &&
+                (errno != EINTR)) {
+                ucs_error("epoll_wait() failed: %m");
+                return UCS_ERR_IO_ERROR;
             }
+        } else if (status != UCS_ERR_BUSY) {
+            ucs_debug("group %hu can't wait for events: %s", group->group_id,
+                      ucs_status_string(status));
+            can_sleep = 0;
         }
+
+        spin_end = ucs_get_time() + spin_time;
     }
+
+    return status;
+}
+
+unsigned ucg_base_am_id;
+size_t ucg_ctx_worker_offset;
+
+void ucg_init_group_cache(struct ucg_group *new_group)
+{
+    kh_init_inplace(ucg_group_plan, &new_group->plan_cache);
+    ucs_list_head_init(&new_group->plan_lru);
+    new_group->plan_footprint = 0;
+    new_group->op_footprint   = 0;
 }
 
-void ucg_init_group_root_used(struct ucg_group *new_group)
+static void ucg_group_cache_cleanup(ucg_group_h group)
 {
-    unsigned rank;
-    /* Initalization of root_used */
-    for (rank = 0; rank < UCG_GROUP_MAX_ROOT_PARAM; rank++) {
-        new_group->root_used[rank] = (unsigned) -1;
+    /* the plans themselves are released by the planners */
+    ucg_group_plan_entry_t *entry = NULL;
+    ucg_group_plan_entry_t *tmp = NULL;
+    ucs_list_for_each_safe(entry, tmp, &group->plan_lru, lru) {
+        ucs_free(entry);
     }
+    kh_destroy_inplace(ucg_group_plan, &group->plan_cache);
 }
 
 ucs_status_t ucg_init_group(ucg_worker_h worker,
                             const ucg_group_params_t *params,
                             ucg_groups_t *ctx,
-                            size_t distance_size,
-                            size_t nodenumber_size,
                             struct ucg_group *new_group)
 {
     /* fill in the group fields */
@@ -125,33 +385,41 @@ ucs_status_t ucg_init_group(ucg_worker_h worker,
     new_group->worker                 = worker;
     new_group->next_id                = 0;
     new_group->iface_cnt              = 0;
+    new_group->events.epfd            = -1;
+    new_group->events.iface_cnt       = 0;
+    new_group->wireup_reqs            = NULL;
+    new_group->wireup_req_cnt         = 0;
 
     ucs_queue_head_init(&new_group->pending);
     memcpy((ucg_group_params_t*)&new_group->params, params, sizeof(*params));
-    new_group->params.distance = (typeof(params->distance))((char*)(new_group
-            + 1) + ctx->total_planner_sizes);
-    memcpy(new_group->params.distance, params->distance, distance_size);
-    new_group->params.node_index = (typeof(params->node_index))((char*)(new_group
-            + 1) + ctx->total_planner_sizes + distance_size);
-    memcpy(new_group->params.node_index, params->node_index, nodenumber_size);
     memset(new_group + 1, 0, ctx->total_planner_sizes);
 
-    ucg_init_group_cache(new_group);
-    ucg_init_group_root_used(new_group);
-    new_group->params.topo_map = NULL;
-    if (params->topo_map) {
-        new_group->params.topo_map = UCS_ALLOC_CHECK(sizeof(char*) * params->member_count, "topo map");
-        unsigned i;
-        for (i = 0; i < params->member_count; i++) {
-            unsigned topo_size = sizeof(char) * params->member_count;
-            new_group->params.topo_map[i] = UCS_ALLOC_CHECK(topo_size, "topo map");
-            memcpy(new_group->params.topo_map[i], params->topo_map[i], topo_size);
-        }
+    /* the topology map is only read here - the group keeps a compact copy */
+    ucs_status_t status = ucg_topo_get(&ctx->topo_head, params, &new_group->topo);
+    if (status != UCS_OK) {
+        return status;
     }
+    new_group->params.topo_map = NULL;
+
+    /* other planners may still look at the (linear) placement arrays */
+    new_group->params.distance   = (typeof(params->distance))((char*)(new_group + 1) +
+                                                              ctx->total_planner_sizes);
+    new_group->params.node_index = (typeof(params->node_index))(new_group->params.distance +
+                                                                params->member_count);
+    memcpy(new_group->params.distance, params->distance,
+           sizeof(*params->distance) * params->member_count);
+    memcpy(new_group->params.node_index, params->node_index,
+           sizeof(*params->node_index) * params->member_count);
 
+    ucg_init_group_cache(new_group);
     return UCS_OK;
 }
 
+const ucg_topo_t *ucg_group_topo(ucg_group_h group)
+{
+    return group->topo;
+}
+
 void ucg_group_clean_planners(ucg_groups_t *ctx,
                               unsigned planner_idx,
                               struct ucg_group *new_group)
@@ -194,19 +462,20 @@ ucs_status_t ucg_group_create(ucg_worker_h worker,
     UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
 
     /* allocate a new group */
-    size_t distance_size              = sizeof(*params->distance) * params->member_count;
-    size_t nodenumber_size            = sizeof(*params->node_index) * params->member_count;
+    size_t placement_size             = params->member_count *
+            (sizeof(*params->distance) + sizeof(*params->node_index));
     struct ucg_group *new_group       = ucs_malloc(sizeof(struct ucg_group) +
-            ctx->total_planner_sizes + distance_size + nodenumber_size, "communicator group");
+            ctx->total_planner_sizes + placement_size, "communicator group");
     if (new_group == NULL) {
         status = UCS_ERR_NO_MEMORY;
         goto cleanup_none;
     }
 
     unsigned idx = 0;
-    status = ucg_init_group(worker, params, ctx, distance_size, nodenumber_size, new_group);
+    status = ucg_init_group(worker, params, ctx, new_group);
     if (status != UCS_OK) {
-        goto cleanup_planners;
+        ucs_free(new_group);
+        goto cleanup_none;
     }
 
     status = ucg_group_planner_create(ctx, worker, new_group, &idx);
@@ -227,6 +496,7 @@ ucs_status_t ucg_group_create(ucg_worker_h worker,
     return UCS_OK;
 
 cleanup_planners:
+    ucg_topo_put(new_group->topo);
     ucg_group_clean_planners(ctx, idx, new_group);
 
 cleanup_none:
@@ -268,7 +538,14 @@ void ucg_group_destroy(ucg_group_h group)
     UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
 #endif
 
+    if (group->wireup_req_cnt != 0) {
+        ucg_group_wireup_complete(group, UCS_ERR_CANCELED);
+    }
+
     ucg_group_planner_destroy(group);
+    ucg_group_cache_cleanup(group);
+    ucg_group_events_cleanup(&group->events);
+    ucg_topo_put(group->topo);
     UCS_STATS_NODE_FREE(group->stats);
     ucs_list_del(&group->list);
     ucs_free(group);
@@ -292,7 +569,21 @@ ucs_status_t ucg_request_check_status(void *request)
 
 void ucg_request_cancel(ucg_worker_h worker, void *request) { }
 
-void ucg_request_free(void *request) { }
+void ucg_request_free(void *request)
+{
+    ucg_request_t *req = (ucg_request_t*)request - 1;
+    if (!(req->flags & UCG_REQUEST_COMMON_FLAG_EMBEDDED)) {
+        return;
+    }
+
+    /* the operation may be discarded once the user is done with its request */
+    ucg_op_t *op        = ucs_container_of(req, ucg_op_t, pending_comp);
+    ucg_worker_h worker = op->plan->group->worker;
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(worker);
+    req->flags &= ~UCG_REQUEST_COMMON_FLAG_EMBEDDED;
+    op->flags  &= ~UCG_OP_FLAG_REQ_HELD;
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(worker);
+}
 
 ucs_status_t ucg_plan_select(ucg_group_h group, const char* planner_name,
                              const ucg_collective_params_t *params,
@@ -303,52 +594,143 @@ ucs_status_t ucg_plan_select(ucg_group_h group, const char* planner_name,
                                      planner_name, &group->params, params, planc_p);
 }
 
-void ucg_get_cache_plan(unsigned int message_size_level, unsigned int coll_root,
-                        ucg_group_h group, ucg_collective_params_t *params, ucg_plan_t **cache_plan, unsigned root)
+static void ucg_group_plan_key_init(ucg_group_h group,
+                                    const ucg_collective_params_t *params,
+                                    unsigned message_size_level,
+                                    ucg_group_plan_key_t *key)
 {
-    ucg_plan_t *plan = group->cache[message_size_level][coll_root][params->plan_cache_index];
-    if (plan == NULL) {
-        *cache_plan = NULL;
-        return;
+    memset(key, 0, sizeof(*key));
+    key->root       = UCG_ROOT_RANK(params);
+    key->dt_len     = params->send.dt_len;
+    key->modifiers  = params->type.modifiers;
+    key->size_level = message_size_level;
+    if (params->send.op_ext && !group->params.op_is_commute_f(params->send.op_ext)) {
+        key->op_flags |= UCG_GROUP_PLAN_KEY_FLAG_NON_COMMUTATIVE;
+        if (params->send.count > 1) {
+            key->op_flags |= UCG_GROUP_PLAN_KEY_FLAG_MULTI_COUNT;
+        }
     }
+}
 
-    if (params->send.op_ext && !group->params.op_is_commute_f(params->send.op_ext) && !plan->support_non_commutative) {
+static int ucg_group_cache_is_evictable(ucg_plan_t *plan);
+static void ucg_group_cache_evict(ucg_group_h group, ucg_group_plan_entry_t *entry);
+
+void ucg_get_cache_plan(ucg_group_h group, const ucg_group_plan_key_t *key,
+                        ucg_plan_t **cache_plan)
+{
+    khiter_t iter = kh_get(ucg_group_plan, &group->plan_cache, *key);
+    if (iter == kh_end(&group->plan_cache)) {
+        UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLAN_CACHE_MISSES, 1);
         *cache_plan = NULL;
         return;
     }
 
-    if (params->send.op_ext && !group->params.op_is_commute_f(params->send.op_ext) && params->send.count > 1) {
+    /* a plan which can no longer be used is planned again, once it's idle */
+    ucg_group_plan_entry_t *entry = kh_val(&group->plan_cache, iter);
+    if (ucs_unlikely(!ucg_builtin_plan_is_usable(ucs_derived_of(entry->plan,
+                                                                ucg_builtin_plan_t))) &&
+        ucg_group_cache_is_evictable(entry->plan)) {
+        ucg_group_cache_evict(group, entry);
+        UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLAN_CACHE_MISSES, 1);
         *cache_plan = NULL;
         return;
     }
 
-    ucg_builtin_config_t *config = (ucg_builtin_config_t *)plan->planner->plan_config;
-    if (params->send.dt_len > config->large_datatype_threshold && !plan->support_large_datatype) {
-        *cache_plan = NULL;
-        return;
+    /* move to the head of the LRU list */
+    ucs_list_del(&entry->lru);
+    ucs_list_add_head(&group->plan_lru, &entry->lru);
+
+    UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLAN_CACHE_HITS, 1);
+    ucs_debug("select plan from cache: %p", entry->plan);
+    *cache_plan = entry->plan;
+}
+
+static void ucg_group_cache_evict(ucg_group_h group, ucg_group_plan_entry_t *entry)
+{
+    khiter_t iter = kh_get(ucg_group_plan, &group->plan_cache, entry->key);
+    ucs_assert(iter != kh_end(&group->plan_cache));
+    kh_del(ucg_group_plan, &group->plan_cache, iter);
+    ucs_list_del(&entry->lru);
+    group->plan_footprint -= entry->footprint;
+    group->op_footprint   -= entry->plan->op_footprint;
+
+    ucs_debug("evict plan %p from cache of group %hu", entry->plan, group->group_id);
+    ucg_destroy_plan(entry->plan);
+    ucs_free(entry);
+    UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLAN_CACHE_EVICTIONS, 1);
+}
+
+/*
+ * A plan may only be destroyed along with all of its operations, so none of
+ * them may be queued (and thus out of the cache), running or held by the user.
+ */
+static int ucg_group_cache_is_evictable(ucg_plan_t *plan)
+{
+    ucg_op_t *op;
+
+    if (plan->op_live != plan->op_cnt) {
+        return 0;
     }
 
-    if (plan != NULL && root != plan->type.root) {
-        *cache_plan = NULL;
-        return;
+    ucs_list_for_each(op, &plan->op_head, list) {
+        if (!ucg_plan_op_is_idle(op)) {
+            return 0;
+        }
     }
 
-    ucs_debug("select plan from cache: %p", plan);
-    *cache_plan = plan;
+    return 1;
 }
 
-void ucg_update_group_cache(ucg_group_h group,
-                            unsigned int message_size_level,
-                            unsigned int coll_root,
-                            ucg_collective_params_t *params,
-                            ucg_plan_t *plan)
+static void ucg_group_cache_trim(ucg_group_h group, size_t budget)
 {
-    if (group->cache[message_size_level][coll_root][params->plan_cache_index] != NULL) {
-        ucg_builtin_plan_t *builtin_plan = ucs_derived_of(group->cache[message_size_level][coll_root][params->plan_cache_index], ucg_builtin_plan_t);
-        (void)ucg_builtin_destroy_plan(builtin_plan, group);
-        group->cache[message_size_level][coll_root][params->plan_cache_index] = NULL;
+    ucg_group_plan_entry_t *entry;
+    ucs_list_link_t *link;
+
+    /* evict from the tail, but always keep the most recently used plan - the
+     * operations of a plan are counted as a part of it */
+    link = group->plan_lru.prev;
+    while (((group->plan_footprint + group->op_footprint) > budget) &&
+           (link != group->plan_lru.next)) {
+        entry = ucs_container_of(link, ucg_group_plan_entry_t, lru);
+        link  = link->prev;
+        if (ucg_group_cache_is_evictable(entry->plan)) {
+            ucg_group_cache_evict(group, entry);
+        }
+    }
+}
+
+ucs_status_t ucg_update_group_cache(ucg_group_h group,
+                                    const ucg_group_plan_key_t *key,
+                                    ucg_plan_t *plan)
+{
+    ucg_group_plan_entry_t *entry = ucs_malloc(sizeof(*entry), "ucg plan cache entry");
+    if (entry == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    int ret;
+    khiter_t iter = kh_put(ucg_group_plan, &group->plan_cache, *key, &ret);
+    if (ret < 0) {
+        ucs_free(entry);
+        return UCS_ERR_NO_MEMORY;
     }
-    group->cache[message_size_level][coll_root][params->plan_cache_index] = plan;
+    ucs_assert(ret != 0); /* only missing keys are planned */
+
+    entry->key       = *key;
+    entry->plan      = plan;
+    entry->footprint = ucg_builtin_plan_footprint(ucs_derived_of(plan, ucg_builtin_plan_t));
+    kh_val(&group->plan_cache, iter) = entry;
+    ucs_list_add_head(&group->plan_lru, &entry->lru);
+    group->plan_footprint += entry->footprint;
+
+    /* enforce the budget, but always keep the plan which was just added */
+    ucg_group_cache_trim(group, ucg_group_config(group)->plan_cache_mem);
+    return UCS_OK;
+}
+
+static inline unsigned ucg_group_op_cache_size(ucg_plan_t *plan)
+{
+    return ucg_group_config(plan->group)->op_cache_size;
 }
 
 void ucg_log_coll_params(ucg_collective_params_t *params)
@@ -364,14 +746,176 @@ void ucg_log_coll_params(ucg_collective_params_t *params)
               params->comp_cb, params->recv.op_ext);
 }
 
-void ucg_collective_create_choose_algorithm(unsigned msg_size, unsigned *message_size_level)
+void ucg_collective_create_choose_algorithm(const ucg_collective_params_t *params,
+                                            size_t msg_size, unsigned *message_size_level)
 {
-    /* choose algorithm due to message size */
-    if (msg_size < UCG_GROUP_MED_MSG_SIZE) {
-        *message_size_level = 0;
-    } else {
-        *message_size_level = 1;
+    /* each message size class of a collective is planned separately */
+    *message_size_level = ucg_builtin_msg_size_class(params->type.modifiers, msg_size);
+}
+
+static ucs_status_t ucg_group_plan_create(ucg_group_h group,
+                                          ucg_collective_params_t *params,
+                                          const ucg_group_plan_key_t *key,
+                                          ucg_plan_t **plan_p)
+{
+    /* select which plan to use for this collective operation */
+    ucg_plan_component_t *planc = NULL;
+    ucs_status_t status = ucg_plan_select(group, NULL, params, &planc);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* create the actual plan for the collective operation */
+    ucg_plan_t *plan = NULL;
+    UCS_PROFILE_CODE("ucg_plan") {
+        ucs_trace_req("ucg_collective_create PLAN: planc=%s type=%x root=%lu",
+                      &planc->name[0], params->type.modifiers, (uint64_t)params->type.root);
+        status = ucg_plan(planc, &params->type, params->send.count * params->send.dt_len, group, params, &plan);
+    }
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    plan->planner           = planc;
+    plan->group             = group;
+    plan->type              = params->type;
+    plan->group_id          = group->group_id;
+    plan->am_mp             = &group->worker->am_mp;
+    ucg_plan_op_cache_init(plan);
+    status = ucg_update_group_cache(group, key, plan);
+    if (status != UCS_OK) {
+        ucg_destroy_plan(plan);
+        return status;
+    }
+    UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLANS_CREATED, 1);
+
+    *plan_p = plan;
+    return UCS_OK;
+}
+
+static ucs_status_t ucg_group_warmup_plan(ucg_group_h group,
+                                          const ucg_collective_warmup_t *coll)
+{
+    if (coll->type.root >= group->params.member_count) {
+        ucs_error("Invalid root[%ld] for communication group size[%ld]",
+                  (uint64_t)coll->type.root, group->params.member_count);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    /* per-member counts are only known once the collective is created */
+    if (coll->type.modifiers & UCG_GROUP_COLLECTIVE_MODIFIER_VARIABLE_LENGTH) {
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    /* the size has to be one a collective could actually be created with */
+    size_t count = (coll->dt_len != 0) ? (coll->msg_size / coll->dt_len) : 0;
+    if ((count > INT_MAX) || ((count * coll->dt_len) != coll->msg_size)) {
+        ucs_error("Invalid message size[%zu] for datatype length[%zu]",
+                  coll->msg_size, coll->dt_len);
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    ucg_collective_params_t params = {
+        .type = coll->type,
+        .send = {
+            .count  = (int)count,
+            .dt_len = coll->dt_len,
+            .op_ext = coll->op_ext
+        }
+    };
+    params.recv = params.send;
+
+    unsigned message_size_level;
+    ucg_group_plan_key_t key;
+    size_t msg_size = (size_t)params.send.count * params.send.dt_len;
+    ucg_collective_create_choose_algorithm(&params, msg_size, &message_size_level);
+    ucg_group_plan_key_init(group, &params, message_size_level, &key);
+
+    ucg_plan_t *plan = NULL;
+    ucg_get_cache_plan(group, &key, &plan);
+    if (plan != NULL) {
+        return UCS_OK;
+    }
+
+    return ucg_group_plan_create(group, &params, &key, &plan);
+}
+
+ucs_status_t ucg_group_warmup(ucg_group_h group, const ucg_collective_warmup_t *colls,
+                              unsigned coll_cnt, void *request)
+{
+    unsigned idx;
+    ucs_status_t status = UCS_OK;
+    if ((group == NULL) || ((colls == NULL) && (coll_cnt > 0))) {
+        return UCS_ERR_INVALID_PARAM;
     }
+
+    UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(group->worker);
+
+    /* create all the plans first, so that all their endpoints connect at once */
+    for (idx = 0; idx < coll_cnt; idx++) {
+        status = ucg_group_warmup_plan(group, &colls[idx]);
+        if (status != UCS_OK) {
+            goto out;
+        }
+    }
+
+    status = ucg_group_wireup_check(group);
+    if (status != UCS_INPROGRESS) {
+        goto out;
+    }
+
+    if (request != NULL) {
+        status = ucg_group_wireup_add_req(group, request);
+        if (status == UCS_OK) {
+            status = UCS_INPROGRESS;
+        }
+        goto out;
+    }
+
+    /* wait without holding the worker, so other threads may use it meanwhile */
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(group->worker);
+    do {
+        UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(group->worker);
+        status = ucg_group_wireup_check(group);
+        UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(group->worker);
+    } while (status == UCS_INPROGRESS);
+    return status;
+
+out:
+    UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(group->worker);
+    return status;
+}
+
+ucs_status_t ucg_group_create_nb(ucg_worker_h worker,
+                                 const ucg_group_params_t *params,
+                                 ucg_group_h *group_p, void *request)
+{
+    if (request == NULL) {
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    ucg_group_h group;
+    ucs_status_t status = ucg_group_create(worker, params, &group);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* the barrier connects the peers most collectives will use anyway */
+    ucg_collective_warmup_t barrier = {
+        .type = {
+            .modifiers = ucg_predefined_modifiers[UCG_PRIMITIVE_BARRIER],
+            .root      = 0
+        }
+    };
+
+    status = ucg_group_warmup(group, &barrier, 1, request);
+    if (UCS_STATUS_IS_ERR(status)) {
+        ucg_group_destroy(group);
+        return status;
+    }
+
+    *group_p = group;
+    return status;
 }
 
 UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
@@ -390,10 +934,9 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
 
     /* find the plan of current root whether has been established */
     ucg_group_member_index_t root = UCG_ROOT_RANK(params);
-    unsigned msg_size = params->send.count * params->send.dt_len;
-    unsigned coll_root;
+    size_t msg_size = (size_t)params->send.count * params->send.dt_len;
     unsigned message_size_level;
-    unsigned is_coll_root_found = 1;
+    ucg_group_plan_key_t key;
 
     if (root >= group->params.member_count) {
         status = UCS_ERR_INVALID_PARAM;
@@ -401,58 +944,28 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_create,
         goto out;
     }
 
-    /* root cache has been not found */
-    if (root != group->root_used[root % UCG_GROUP_MAX_ROOT_PARAM]) {
-        group->root_used[root % UCG_GROUP_MAX_ROOT_PARAM] = root;
-        is_coll_root_found = 0;
-    }
-    coll_root = root % UCG_GROUP_MAX_ROOT_PARAM;
-
-    ucg_collective_create_choose_algorithm(msg_size, &message_size_level);
+    ucg_collective_create_choose_algorithm(params, msg_size, &message_size_level);
+    ucg_group_plan_key_init(group, params, message_size_level, &key);
 
     ucg_plan_t *plan = NULL;
-    if (is_coll_root_found) {
-        ucg_get_cache_plan(message_size_level, coll_root, group, params, &plan, root);
-    }
+    ucg_get_cache_plan(group, &key, &plan);
 
     if (ucs_likely(plan != NULL)) {
-        ucs_list_for_each(op, &plan->op_head, list) {
-            if (!memcmp(&op->params, params, sizeof(*params))) {
-                status = UCS_OK;
-                goto op_found;
-            }
+        op = ucg_plan_op_cache_get(plan, params);
+        if (op != NULL) {
+            status = UCS_OK;
+            goto op_found;
         }
 
         UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLANS_USED, 1);
         goto plan_found;
     }
 
-    /* select which plan to use for this collective operation */
-    ucg_plan_component_t *planc = NULL;
-    status = ucg_plan_select(group, NULL, params, &planc);
+    status = ucg_group_plan_create(group, params, &key, &plan);
     if (status != UCS_OK) {
         goto out;
     }
 
-    /* create the actual plan for the collective operation */
-    UCS_PROFILE_CODE("ucg_plan") {
-        ucs_trace_req("ucg_collective_create PLAN: planc=%s type=%x root=%lu",
-                      &planc->name[0], params->type.modifiers, (uint64_t)params->type.root);
-        status = ucg_plan(planc, &params->type, params->send.count * params->send.dt_len, group, params, &plan);
-    }
-    if (status != UCS_OK) {
-        goto out;
-    }
-
-    plan->planner           = planc;
-    plan->group             = group;
-    plan->type              = params->type;
-    plan->group_id          = group->group_id;
-    plan->am_mp             = &group->worker->am_mp;
-    ucg_update_group_cache(group, message_size_level, coll_root, params, plan);
-    ucs_list_head_init(&plan->op_head);
-    UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_PLANS_CREATED, 1);
-
 plan_found:
     UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_OPS_CREATED, 1);
     UCS_PROFILE_CODE("ucg_prepare") {
@@ -462,11 +975,24 @@ plan_found:
         goto out;
     }
 
-    ucs_list_add_head(&plan->op_head, &op->list);
     memcpy(&op->params, params, sizeof(*params));
-    op->plan = plan;
+    op->plan           = plan;
+    op->flags          = 0;
+    op->handles        = 1;
+    op->footprint      = ucg_builtin_op_footprint(op);
+    plan->op_live++;
+    plan->op_footprint += op->footprint;
+    group->op_footprint += op->footprint;
+    ucg_plan_op_cache_add(plan, op, ucg_group_op_cache_size(plan));
+
+    /* the new operation counts against the budget of the plan cache */
+    ucg_group_cache_trim(group, ucg_group_config(group)->plan_cache_mem);
+    *coll = op;
+    ucg_log_coll_params(params);
+    goto out;
 
 op_found:
+    op->handles++;
     *coll = op;
     ucg_log_coll_params(params);
 
@@ -478,7 +1004,8 @@ out:
 static UCS_F_ALWAYS_INLINE ucs_status_t ucg_collective_trigger(ucg_group_h group, ucg_op_t *op, ucg_request_t **req)
 {
     /* Barrier effect - all new collectives are pending */
-    if (ucs_unlikely(op->params.type.modifiers & UCG_GROUP_COLLECTIVE_MODIFIER_BARRIER)) {
+    int is_barrier = op->params.type.modifiers & UCG_GROUP_COLLECTIVE_MODIFIER_BARRIER;
+    if (ucs_unlikely(is_barrier)) {
         ucs_assert(group->is_barrier_outstanding == 0);
         group->is_barrier_outstanding = 1;
     }
@@ -486,43 +1013,96 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_collective_trigger(ucg_group_h group
     /* Start the first step of the collective operation */
     ucs_status_t ret;
     UCS_PROFILE_CODE("ucg_trigger") {
-        ret = ucg_trigger(op, group->next_id++, req);
+        ret = ucg_trigger(op, group->next_id, req);
+    }
+
+    if (ucs_unlikely(ret == UCS_ERR_NO_RESOURCE)) {
+        /* all the slots are taken - the same id is used once one is released */
+        if (is_barrier) {
+            group->is_barrier_outstanding = 0;
+        }
+        return ret;
     }
 
+    group->next_id++;
     if (ret != UCS_INPROGRESS) {
+        /* nothing is going to release a barrier which is already complete */
+        if (is_barrier) {
+            group->is_barrier_outstanding = 0;
+        }
         UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_OPS_IMMEDIATE, 1);
     }
 
     return ret;
 }
 
-ucs_status_t ucg_collective_release_barrier(ucg_group_h group)
+static void ucg_collective_enqueue(ucg_group_h group, ucg_op_t *op,
+                                   ucg_request_t **req)
 {
-    if (group->is_barrier_outstanding == 0) {
-        // current operation is not barrier.
-        return UCS_OK;
-    }
-    group->is_barrier_outstanding = 0;
-    if (ucs_queue_is_empty(&group->pending)) {
-        return UCS_OK;
+    ucg_plan_op_cache_remove(op->plan, op);
+
+    /* the caller has to get a request now, so the operation provides one -
+     * and is kept until it's released, since the user may still check it */
+    if (*req == NULL) {
+        op->pending_comp.flags = UCG_REQUEST_COMMON_FLAG_EMBEDDED;
+        op->flags             |= UCG_OP_FLAG_REQ_HELD;
+        *req                   = &op->pending_comp + 1;
     }
 
-    ucs_status_t ret;
-    do {
+    op->pending_req = *req;
+    op->flags      |= UCG_OP_FLAG_QUEUED;
+    ucs_queue_push(&group->pending, &op->queue);
+}
+
+static ucs_status_t ucg_collective_dispatch(ucg_group_h group)
+{
+    ucs_status_t ret = UCS_OK;
+
+    /* Start the queued operations in order, so that all members agree on ids */
+    while ((!ucs_queue_is_empty(&group->pending)) &&
+           (!group->is_barrier_outstanding)) {
         /* Move the operation from the pending queue back to the original one */
-        ucg_op_t *op = (ucg_op_t*)ucs_queue_pull_non_empty(&group->pending);
-        ucg_request_t **req = op->pending_req;
-        ucs_list_add_head(&op->plan->op_head, &op->list);
+        ucg_op_t *op       = (ucg_op_t*)ucs_queue_pull_non_empty(&group->pending);
+        ucg_request_t *req = op->pending_req;
+        op->flags         &= ~UCG_OP_FLAG_QUEUED;
+        ucg_plan_op_cache_add(op->plan, op, ucg_group_op_cache_size(op->plan));
 
         /* Start this next pending operation */
-        ret = ucg_collective_trigger(group, op, req);
-    } while ((!ucs_queue_is_empty(&group->pending)) &&
-             (!group->is_barrier_outstanding) &&
-             (ret == UCS_OK));
+        ret = ucg_collective_trigger(group, op, &req);
+        if (req == &op->pending_comp + 1) {
+            /* starting resets the request, but it's still the operation's own */
+            op->pending_comp.flags |= UCG_REQUEST_COMMON_FLAG_EMBEDDED;
+        }
+
+        if (ret == UCS_ERR_NO_RESOURCE) {
+            ucg_plan_op_cache_remove(op->plan, op);
+            op->pending_req = req;
+            op->flags      |= UCG_OP_FLAG_QUEUED;
+            ucs_queue_push_head(&group->pending, &op->queue);
+            return UCS_INPROGRESS;
+        }
+
+        /* the caller was told it's in progress, so report the outcome there */
+        if (ret != UCS_INPROGRESS) {
+            (req - 1)->status = ret;
+            (req - 1)->flags |= UCG_REQUEST_COMMON_FLAG_COMPLETED;
+        }
+    }
 
     return ret;
 }
 
+ucs_status_t ucg_collective_release_barrier(ucg_group_h group)
+{
+    if (group->is_barrier_outstanding == 0) {
+        // current operation is not barrier.
+        return UCS_OK;
+    }
+
+    group->is_barrier_outstanding = 0;
+    return ucg_collective_dispatch(group);
+}
+
 static UCS_F_ALWAYS_INLINE ucs_status_t ucg_collective_start(ucg_coll_h coll, ucg_request_t **req)
 {
     if (coll == NULL || req == NULL) {
@@ -537,13 +1117,23 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_collective_start(ucg_coll_h coll, uc
 
     ucs_trace_req("ucg_collective_start: op=%p req=%p", coll, *req);
 
-    if (ucs_unlikely(group->is_barrier_outstanding)) {
-        ucs_list_del(&op->list);
-        ucs_queue_push(&group->pending, &op->queue);
-        op->pending_req = req;
+    /* a non-persistent handle is given back to the cache once started */
+    if (!(op->params.type.modifiers & UCG_GROUP_COLLECTIVE_MODIFIER_PERSISTENT) &&
+        (op->handles > 0)) {
+        op->handles--;
+    }
+
+    /* Operations waiting for a barrier or a free slot are started in order */
+    if (ucs_unlikely(group->is_barrier_outstanding ||
+                     !ucs_queue_is_empty(&group->pending))) {
+        ucg_collective_enqueue(group, op, req);
         ret = UCS_INPROGRESS;
     } else {
         ret = ucg_collective_trigger(group, op, req);
+        if (ucs_unlikely(ret == UCS_ERR_NO_RESOURCE)) {
+            ucg_collective_enqueue(group, op, req);
+            ret = UCS_INPROGRESS;
+        }
     }
 
     UCS_STATS_UPDATE_COUNTER(group->stats, UCG_GROUP_STAT_OPS_USED, 1);
@@ -567,13 +1157,72 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_start_nbr,
     return ucg_collective_start(coll, (ucg_request_t**)&request);
 }
 
+UCS_PROFILE_FUNC(ucs_status_t, ucg_collective_start_with_buffers,
+                 (coll, sbuf, rbuf, request), ucg_coll_h coll, const void *sbuf,
+                 void *rbuf, void *request)
+{
+    ucs_status_t status;
+    ucg_op_t *op = (ucg_op_t*)coll;
+    if (coll == NULL) {
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    /* a queued operation reuses some of its fields for the queue itself */
+    if (op->flags & (UCG_OP_FLAG_IN_FLIGHT | UCG_OP_FLAG_QUEUED)) {
+        return UCS_ERR_BUSY;
+    }
+
+    if ((op->params.send.buf != sbuf) || (op->params.recv.buf != rbuf)) {
+        ucg_plan_t *plan  = op->plan;
+        ucg_group_h group = plan->group;
+        if (plan->planner->rebind == NULL) {
+            return UCS_ERR_UNSUPPORTED;
+        }
+
+        /* other handles to this operation still expect the original buffers */
+        if (op->handles > 1) {
+            return UCS_ERR_BUSY;
+        }
+
+        UCP_WORKER_THREAD_CS_ENTER_CONDITIONAL(group->worker);
+        status = ucg_rebind(op, sbuf, rbuf);
+        if (status == UCS_OK) {
+            /* the parameters are the cache key, so re-insert the operation */
+            ucg_plan_op_cache_remove(plan, op);
+            op->params.send.buf = (void*)sbuf;
+            op->params.recv.buf = rbuf;
+            ucg_plan_op_cache_add(plan, op, ucg_group_op_cache_size(plan));
+        }
+        UCP_WORKER_THREAD_CS_EXIT_CONDITIONAL(group->worker);
+
+        if (status != UCS_OK) {
+            ucs_debug("ucg_collective_start_with_buffers %p: rebind failed: %s",
+                      coll, ucs_status_string(status));
+            return status;
+        }
+    }
+
+    ucs_debug("ucg_collective_start_with_buffers %p", coll);
+    return ucg_collective_start(coll, (ucg_request_t**)&request);
+}
+
 void ucg_collective_destroy(ucg_coll_h coll)
 {
     if (coll == NULL) {
         return;
     }
     ucs_info("ucg_collective_destroy %p", coll);
-    ucg_discard((ucg_op_t*)coll);
+    ucg_op_t *op = (ucg_op_t*)coll;
+
+    /* the cache keeps the operation while other handles or a run still use it */
+    if ((op->handles == 0) || (--op->handles > 0) ||
+        (op->flags & (UCG_OP_FLAG_IN_FLIGHT | UCG_OP_FLAG_QUEUED |
+                      UCG_OP_FLAG_REQ_HELD))) {
+        return;
+    }
+
+    ucg_plan_op_cache_remove(op->plan, op);
+    ucg_plan_op_discard(op->plan, op);
 }
 
 ucs_status_t ucg_worker_groups_init(void *groups_ctx)
@@ -599,8 +1248,20 @@ ucs_status_t ucg_worker_groups_init(void *groups_ctx)
 
     gctx->next_id             = 0;
     gctx->iface_cnt           = 0;
+    gctx->events.epfd         = -1;
+    gctx->events.iface_cnt    = 0;
     gctx->total_planner_sizes = group_ctx_offset;
+
+    status = ucs_config_parser_fill_opts(&gctx->config, ucg_groups_config_table,
+                                         NULL, "UCG_", 0);
+    if (status != UCS_OK) {
+        ucg_plan_release_list(gctx->planners, gctx->num_planners);
+        return status;
+    }
+
     ucs_list_head_init(&gctx->groups_head);
+    ucs_list_head_init(&gctx->topo_head);
+    ucg_ep_table_init(&gctx->ep_table);
     return UCS_OK;
 }
 
@@ -616,6 +1277,9 @@ void ucg_worker_groups_cleanup(void *groups_ctx)
         }
     }
 
+    ucg_ep_table_cleanup(&gctx->ep_table);
+    ucg_group_events_cleanup(&gctx->events);
+    ucs_config_parser_release_opts(&gctx->config, ucg_groups_config_table);
     ucg_plan_release_list(gctx->planners, gctx->num_planners);
 }
 
@@ -652,9 +1316,8 @@ ucs_status_t ucg_init(const ucp_params_t *params,
     return status;
 }
 
-ucs_status_t ucg_plan_connect(ucg_group_h group, ucg_group_member_index_t index,
-                              uct_ep_h *ep_p, const uct_iface_attr_t **ep_attr_p, uct_md_h* md_p,
-                              const uct_md_attr_t** md_attr_p, ucp_ep_h *ucp_ep_p)
+ucs_status_t ucg_plan_connect_nb(ucg_group_h group, ucg_group_member_index_t index,
+                                 ucp_ep_h *ucp_ep_p)
 {
     /* fill-in UCP connection parameters */
     size_t remote_addr_len;
@@ -668,12 +1331,19 @@ ucs_status_t ucg_plan_connect(ucg_group_h group, ucg_group_member_index_t index,
 
     /* special case: connecting to a zero-length address means it's "debugging" */
     if (ucs_unlikely(remote_addr_len == 0)) {
-        *ep_p = NULL;
+        *ucp_ep_p = NULL;
         return UCS_OK;
     }
 
+    /* other plans (possibly of other groups) may already reach this member */
+    ucg_groups_t *gctx = UCG_WORKER_TO_GROUPS_CTX(group->worker);
+    ucp_ep_h ucp_ep    = ucg_ep_table_get(&gctx->ep_table, remote_addr, remote_addr_len);
+    if (ucp_ep != NULL) {
+        *ucp_ep_p = ucp_ep;
+        goto connect_cleanup;
+    }
+
     /* create an endpoint for communication with the remote member */
-    ucp_ep_h ucp_ep = NULL;
     ucp_ep_params_t ep_params = {
         .field_mask = UCP_EP_PARAM_FIELD_REMOTE_ADDRESS,
         .address = remote_addr
@@ -689,24 +1359,120 @@ ucs_status_t ucg_plan_connect(ucg_group_h group, ucg_group_member_index_t index,
         goto connect_cleanup;
     }
 
-    while ((ucp_ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED) == 0) {
-        ucp_worker_progress(group->worker);
+    status = ucg_ep_table_add(&gctx->ep_table, remote_addr, remote_addr_len, ucp_ep);
+    if (status != UCS_OK) {
+        ucp_ep_destroy(ucp_ep);
+        goto connect_cleanup;
     }
 
-    do {
-        *ep_p = ucp_ep_get_am_uct_ep(ucp_ep);
-        if (ucp_proxy_ep_test(*ep_p)) {
-            ucp_proxy_ep_t *proxy_ep = ucs_derived_of(*ep_p, ucp_proxy_ep_t);
-            *ep_p = proxy_ep->uct_ep;
+    *ucp_ep_p = ucp_ep;
+
+connect_cleanup:
+    group->params.release_address_f(remote_addr);
+    return status;
+}
+
+void ucg_plan_disconnect(ucg_group_h group, ucp_ep_h ucp_ep)
+{
+    ucg_groups_t *gctx = UCG_WORKER_TO_GROUPS_CTX(group->worker);
+    if ((ucp_ep == NULL) || !ucg_ep_table_put(&gctx->ep_table, ucp_ep)) {
+        return;
+    }
+
+    ucp_ep_ext_gen_t *ep_ext = NULL;
+    ucp_ep_ext_gen_t *tmp = NULL;
+    ucs_list_for_each_safe(ep_ext, tmp, &group->worker->all_eps, ep_list) {
+        ucp_ep_h tmp_ep = (ucp_ep_h)ucs_strided_elem_get(ep_ext, 1, 0);
+        if (tmp_ep == ucp_ep) {
+            ucp_ep_disconnected(tmp_ep, 1);
+            ucs_list_del(&ep_ext->ep_list);
+            break;
         }
+    }
+}
+
+static uct_ep_h ucg_plan_connect_lane_ep(ucp_ep_h ucp_ep, ucp_lane_index_t lane)
+{
+    uct_ep_h ep = ucp_ep->uct_eps[lane];
+    if (ucp_proxy_ep_test(ep)) {
+        ucp_proxy_ep_t *proxy_ep = ucs_derived_of(ep, ucp_proxy_ep_t);
+        ep = proxy_ep->uct_ep;
+    }
+
+    ucs_assert(ep->iface != NULL);
+    return ep;
+}
+
+static uct_ep_h ucg_plan_connect_am_ep(ucp_ep_h ucp_ep)
+{
+    return ucg_plan_connect_lane_ep(ucp_ep, ucp_ep_get_am_lane(ucp_ep));
+}
+
+/* A lane is a stub until the wireup of its transport is complete */
+static int ucg_plan_connect_is_stub(uct_ep_h ep)
+{
+    return ep->iface->ops.ep_am_short ==
+           (typeof(ep->iface->ops.ep_am_short))ucs_empty_function_return_no_resource;
+}
+
+static int ucg_plan_connect_is_ready(ucp_ep_h ucp_ep)
+{
+    ucp_lane_index_t lane;
+    unsigned i;
 
-        ucs_assert((*ep_p)->iface != NULL);
-        if ((*ep_p)->iface->ops.ep_am_short !=
-            (typeof((*ep_p)->iface->ops.ep_am_short))ucs_empty_function_return_no_resource) {
+    if (ucp_ep == NULL) {
+        return 1; /* "debugging" connection */
+    }
+
+    if ((ucp_ep->flags & UCP_EP_FLAG_REMOTE_CONNECTED) == 0) {
+        return 0;
+    }
+
+    if (ucg_plan_connect_is_stub(ucg_plan_connect_am_ep(ucp_ep))) {
+        return 0;
+    }
+
+    /* messages may be striped across the other AM lanes, see below */
+    for (i = 0; i < UCP_MAX_LANES; i++) {
+        lane = ucp_ep_config(ucp_ep)->key.am_bw_lanes[i];
+        if (lane == UCP_NULL_LANE) {
             break;
         }
-        ucp_worker_progress(group->worker);
-    } while (1);
+
+        if (ucg_plan_connect_is_stub(ucg_plan_connect_lane_ep(ucp_ep, lane))) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+ucs_status_t ucg_plan_connect_all_nb(ucg_group_h group, ucp_ep_h *ucp_eps,
+                                     unsigned ep_cnt)
+{
+    unsigned ep_idx;
+    for (ep_idx = 0; ep_idx < ep_cnt; ep_idx++) {
+        if (!ucg_plan_connect_is_ready(ucp_eps[ep_idx])) {
+            /* all the endpoints are progressed by the same worker */
+            ucp_worker_progress(group->worker);
+            return UCS_INPROGRESS;
+        }
+    }
+
+    return UCS_OK;
+}
+
+ucs_status_t ucg_plan_connect_finish(ucg_group_h group, ucp_ep_h ucp_ep,
+                                     uct_ep_h *ep_p, const uct_iface_attr_t **ep_attr_p,
+                                     uct_md_h* md_p, const uct_md_attr_t** md_attr_p)
+{
+    if (ucs_unlikely(ucp_ep == NULL)) {
+        *ep_p = NULL;
+        return UCS_OK;
+    }
+
+    ucs_assert(ucg_plan_connect_is_ready(ucp_ep));
+    *ep_p = ucg_plan_connect_am_ep(ucp_ep);
 
     /* Register interfaces to be progressed in future calls */
     ucg_groups_t *gctx = UCG_WORKER_TO_GROUPS_CTX(group->worker);
@@ -716,11 +1482,73 @@ ucs_status_t ucg_plan_connect(ucg_group_h group, ucg_group_member_index_t index,
     *ep_attr_p = ucp_ep_get_am_iface_attr(ucp_ep);
     *md_p      = ucp_ep_get_am_uct_md(ucp_ep);
     *md_attr_p = ucp_ep_get_am_uct_md_attr(ucp_ep);
-    *ucp_ep_p = ucp_ep;
+    return UCS_OK;
+}
 
-connect_cleanup:
-    group->params.release_address_f(remote_addr);
-    return status;
+uct_component_h ucg_plan_connect_component(ucp_ep_h ucp_ep)
+{
+    ucp_context_h context   = ucp_ep->worker->context;
+    ucp_md_index_t md_index = ucp_ep_md_index(ucp_ep, ucp_ep_get_am_lane(ucp_ep));
+
+    return context->tl_cmpts[context->tl_mds[md_index].cmpt_index].cmpt;
+}
+
+ucs_status_t ucg_plan_connect_lanes(ucg_group_h group, ucp_ep_h ucp_ep,
+                                    ucg_plan_lane_t *lanes, unsigned max_lanes,
+                                    unsigned *lane_cnt_p)
+{
+    ucp_ep_config_key_t *key  = &ucp_ep_config(ucp_ep)->key;
+    ucp_lane_index_t am_lane  = ucp_ep_get_am_lane(ucp_ep);
+    ucg_groups_t *gctx        = UCG_WORKER_TO_GROUPS_CTX(group->worker);
+    unsigned lane_cnt         = 0;
+    ucp_lane_index_t lane;
+    unsigned i;
+    uct_ep_h ep;
+
+    /* the AM lane comes first, followed by the other high-bandwidth AM lanes */
+    for (i = 0; (i <= UCP_MAX_LANES) && (lane_cnt < max_lanes); i++) {
+        lane = (i == 0) ? am_lane : key->am_bw_lanes[i - 1];
+        if (lane == UCP_NULL_LANE) {
+            break;
+        }
+
+        if ((i > 0) && (lane == am_lane)) {
+            continue;
+        }
+
+        ep = ucg_plan_connect_lane_ep(ucp_ep, lane);
+        ucs_assert(!ucg_plan_connect_is_stub(ep));
+
+        /* incoming fragments may arrive on any of them */
+        UCG_GROUP_PROGRESS_ADD(ep->iface, group);
+        UCG_GROUP_PROGRESS_ADD(ep->iface, gctx);
+
+        lanes[lane_cnt].ep      = ep;
+        lanes[lane_cnt].ep_attr = ucp_worker_iface_get_attr(ucp_ep->worker,
+                ucp_ep_get_rsc_index(ucp_ep, lane));
+        lanes[lane_cnt].md      = ucp_ep_md(ucp_ep, lane);
+        lanes[lane_cnt].md_attr = ucp_ep_md_attr(ucp_ep, lane);
+        lane_cnt++;
+    }
+
+    *lane_cnt_p = lane_cnt;
+    return UCS_OK;
+}
+
+ucs_status_t ucg_plan_connect(ucg_group_h group, ucg_group_member_index_t index,
+                              uct_ep_h *ep_p, const uct_iface_attr_t **ep_attr_p, uct_md_h* md_p,
+                              const uct_md_attr_t** md_attr_p, ucp_ep_h *ucp_ep_p)
+{
+    ucp_ep_h ucp_ep;
+    ucs_status_t status = ucg_plan_connect_nb(group, index, &ucp_ep);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    while (ucg_plan_connect_all_nb(group, &ucp_ep, 1) == UCS_INPROGRESS);
+
+    *ucp_ep_p = ucp_ep;
+    return ucg_plan_connect_finish(group, ucp_ep, ep_p, ep_attr_p, md_p, md_attr_p);
 }
 
 
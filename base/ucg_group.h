@@ -7,24 +7,15 @@
 #define UCG_GROUP_H_
 
 #include "ucg_plan.h"
+#include "ucg_topo.h"
+#include "ucg_ep_table.h"
 #include "../api/ucg.h"
 
 #include <ucs/stats/stats.h>
+#include <ucs/datastruct/khash.h>
 
 #define UCG_GROUP_MAX_IFACES 8
 
-/* level number of categoried message size, 0 for short message size, 1 for mid-long message size */
-#define UCG_GROUP_MSG_SIZE_LEVEL 2
-
-/* threshold message size to switch algorithm */
-#define UCG_GROUP_MED_MSG_SIZE 16384
-
-/* max number of actual root rank used */
-#define UCG_GROUP_MAX_ROOT_PARAM 96
-
-/* max number of collective type in the plan cache. */
-#define UCG_GROUP_MAX_COLL_TYPE_BUCKETS 16
-
 extern size_t ucg_ctx_worker_offset;
 #define UCG_WORKER_TO_GROUPS_CTX(worker) \
     ((ucg_groups_t*)((char*)(worker) + ucg_ctx_worker_offset))
@@ -35,20 +26,68 @@ extern size_t ucg_ctx_worker_offset;
 #define UCG_ROOT_RANK(params) \
     ((params)->type.root)
 
+/* flags describing the reduction operation, as part of the plan cache key */
+enum ucg_group_plan_key_flags {
+    UCG_GROUP_PLAN_KEY_FLAG_NON_COMMUTATIVE = UCS_BIT(0), /* op is not commutative */
+    UCG_GROUP_PLAN_KEY_FLAG_MULTI_COUNT     = UCS_BIT(1)  /* more than one element */
+};
+
+/*
+ * Everything the planner bases its decision on - two collectives with equal
+ * keys may share the same plan. The layout has no implicit padding, since the
+ * key is hashed and compared as a whole.
+ */
+typedef struct ucg_group_plan_key {
+    ucg_group_member_index_t root;       /* root rank (zero if not rooted) */
+    size_t                   dt_len;     /* datatype length */
+    uint16_t                 modifiers;  /* @ref enum ucg_collective_modifiers */
+    uint8_t                  size_level; /* @ref enum ucg_builtin_msg_size_class */
+    uint8_t                  op_flags;   /* @ref enum ucg_group_plan_key_flags */
+    uint32_t                 reserved;   /* always zero */
+} ucg_group_plan_key_t;
+
+typedef struct ucg_group_plan_entry {
+    ucg_group_plan_key_t     key;        /* the key this plan is stored under */
+    ucg_plan_t              *plan;       /* the cached plan itself */
+    ucs_list_link_t          lru;        /* member of the group's LRU list */
+    size_t                   footprint;  /* memory charged to the cache */
+} ucg_group_plan_entry_t;
+
+KHASH_TYPE(ucg_group_plan, ucg_group_plan_key_t, ucg_group_plan_entry_t*);
+
 /*
  * To enable the "Groups" feature in UCX - it's registered as part of the UCX
  * context - and allocated a context slot in each UCP Worker at a certain offset.
  */
+/* Event file descriptors of a set of interfaces, for blocking waits */
+typedef struct ucg_group_events {
+    int                   epfd;         /* epoll set of the interfaces, or -1 */
+    unsigned              iface_cnt;    /* interfaces already in the set */
+} ucg_group_events_t;
+
+/* Configuration of the groups themselves, regardless of the planners */
+typedef struct ucg_groups_config {
+    size_t                plan_cache_mem; /* memory budget of the plan cache of a group */
+    unsigned              op_cache_size;  /* operations cached by each plan */
+    double                wait_spin_time; /* polling before sleeping, in seconds */
+} ucg_groups_config_t;
+
 typedef struct ucg_groups {
     ucs_list_link_t       groups_head;
     ucg_group_id_t        next_id;
 
     unsigned              iface_cnt;
     uct_iface_h           ifaces[UCG_GROUP_MAX_IFACES];
+    ucg_group_events_t    events;       /* wakeup on any of the above */
+
+    ucs_list_link_t       topo_head;    /* topologies shared by the groups */
+    ucg_ep_table_t        ep_table;     /* endpoints shared by the groups */
 
     size_t                total_planner_sizes;
     unsigned              num_planners;
     ucg_plan_desc_t      *planners;
+
+    ucg_groups_config_t   config;
 } ucg_groups_t;
 
 struct ucg_group {
@@ -63,25 +102,30 @@ struct ucg_group {
     ucg_group_id_t     group_id;     /* group identifier (order of creation) */
     ucs_queue_head_t   pending;      /* requests currently pending execution */
     ucg_group_params_t params;       /* parameters, for future connections */
+    ucg_topo_t        *topo;         /* member placement, possibly shared */
     ucs_list_link_t    list;         /* worker's group list */
 
     UCS_STATS_NODE_DECLARE(stats);
 
     unsigned           iface_cnt;
     uct_iface_h        ifaces[UCG_GROUP_MAX_IFACES];
+    ucg_group_events_t events;       /* wakeup on any of the above */
 
     /* per-group cache of previous plans/operations, arranged as follows:
-     * for each collective type (e.g. Allreduce) there is a plan with a list of
+     * each plan is looked up by @ref ucg_group_plan_key_t, and holds a list of
      * operations. To re-use a past operation it must be available and match the
-     * requested collective parameters.
-     */
-    ucg_plan_t        *cache[UCG_GROUP_MSG_SIZE_LEVEL][UCG_GROUP_MAX_ROOT_PARAM][UCG_GROUP_MAX_COLL_TYPE_BUCKETS];
-
-    /*
-     * for root collective operations(e.g. Bcast), the parameter of root should be
-     * the criterion to decide whether plan has been found.
+     * requested collective parameters. Once the plans exceed the memory budget
+     * the least recently used ones are destroyed.
      */
-    unsigned           root_used[UCG_GROUP_MAX_ROOT_PARAM];
+    khash_t(ucg_group_plan) plan_cache;
+    ucs_list_link_t    plan_lru;     /* most recently used plan first */
+    size_t             plan_footprint; /* memory used by all cached plans (excluding their operations) */
+    size_t             op_footprint; /* memory used by the operations of those plans */
+
+    /* requests completed once the endpoints of all the cached plans are
+     * connected, e.g. by @ref ucg_group_create_nb or @ref ucg_group_warmup */
+    ucg_request_t    **wireup_reqs;
+    unsigned           wireup_req_cnt;
 
     /* Below this point - the private per-planner data is allocated/stored */
 };
@@ -4,6 +4,7 @@
  */
 
 #include "ucg_plan.h"
+#include "ucg_group.h"
 
 #include <ucg/api/ucg_mpi.h>
 #include <ucs/config/parser.h>
@@ -17,6 +18,29 @@
 
 UCS_LIST_HEAD(ucg_plan_components_list);
 
+/*
+ * Operations are matched on their entire parameters (as before, by memcmp),
+ * so the fingerprint simply folds the parameter structure word by word.
+ */
+static inline khint32_t ucg_plan_op_params_hash(const ucg_collective_params_t *params)
+{
+    const uint64_t *word = (const uint64_t*)params;
+    uint64_t hash        = 0;
+    unsigned idx;
+
+    UCS_STATIC_ASSERT((sizeof(*params) % sizeof(*word)) == 0);
+    for (idx = 0; idx < (sizeof(*params) / sizeof(*word)); idx++) {
+        hash = (hash * 31) ^ word[idx];
+    }
+    return kh_int64_hash_func(hash);
+}
+
+#define ucg_plan_op_params_equal(_params1, _params2) \
+    (!memcmp((_params1), (_params2), sizeof(ucg_collective_params_t)))
+
+KHASH_IMPL(ucg_plan_op, const ucg_collective_params_t*, ucg_op_t*, 1,
+           ucg_plan_op_params_hash, ucg_plan_op_params_equal);
+
 /**
  * Keeps information about allocated configuration structure, to be used when
  * releasing the options.
@@ -160,6 +184,88 @@ void ucg_plan_release_list(ucg_plan_desc_t *resources, unsigned resource_cnt)
     ucg_plan_free((void **)&resources);
 }
 
+void ucg_plan_op_cache_init(ucg_plan_t *plan)
+{
+    ucs_list_head_init(&plan->op_head);
+    kh_init_inplace(ucg_plan_op, &plan->op_hash);
+    plan->op_cnt       = 0;
+    plan->op_live      = 0;
+    plan->op_footprint = 0;
+}
+
+ucg_op_t *ucg_plan_op_cache_get(ucg_plan_t *plan, const ucg_collective_params_t *params)
+{
+    khiter_t iter = kh_get(ucg_plan_op, &plan->op_hash, params);
+    if (iter == kh_end(&plan->op_hash)) {
+        return NULL;
+    }
+
+    /* move to the head of the list, so the least recently used is the tail */
+    ucg_op_t *op = kh_val(&plan->op_hash, iter);
+    ucs_list_del(&op->list);
+    ucs_list_add_head(&plan->op_head, &op->list);
+    return op;
+}
+
+void ucg_plan_op_cache_remove(ucg_plan_t *plan, ucg_op_t *op)
+{
+    khiter_t iter = kh_get(ucg_plan_op, &plan->op_hash, &op->params);
+    if ((iter != kh_end(&plan->op_hash)) && (kh_val(&plan->op_hash, iter) == op)) {
+        kh_del(ucg_plan_op, &plan->op_hash, iter);
+    }
+
+    ucs_list_del(&op->list);
+    plan->op_cnt--;
+}
+
+void ucg_plan_op_cache_add(ucg_plan_t *plan, ucg_op_t *op, unsigned cache_size)
+{
+    int ret;
+    khiter_t iter = kh_put(ucg_plan_op, &plan->op_hash, &op->params, &ret);
+    if (ret > 0) {
+        kh_val(&plan->op_hash, iter) = op;
+    } else {
+        /* an identical operation is already cached, or no memory for the hash
+         * - either way this one is only tracked for release with the plan */
+        ucs_debug("operation %p is not added to the lookup of plan %p", op, plan);
+    }
+
+    ucs_list_add_head(&plan->op_head, &op->list);
+    plan->op_cnt++;
+
+    /* discard the least recently used operations beyond the cache size, but
+     * not the one just added - nor those which are running or held by the user
+     * (these are discarded later, once they are idle and in excess) */
+    ucs_list_link_t *link = plan->op_head.prev;
+    while ((plan->op_cnt > cache_size) && (link != plan->op_head.next)) {
+        ucg_op_t *lru_op = ucs_container_of(link, ucg_op_t, list);
+        link             = link->prev;
+        if (!ucg_plan_op_is_idle(lru_op)) {
+            continue;
+        }
+
+        ucg_plan_op_cache_remove(plan, lru_op);
+        ucs_debug("discard operation %p of plan %p from cache", lru_op, plan);
+        ucg_plan_op_discard(plan, lru_op);
+    }
+}
+
+void ucg_plan_op_discard(ucg_plan_t *plan, ucg_op_t *op)
+{
+    ucs_assert(plan->op_live > 0);
+    plan->op_live--;
+    plan->op_footprint -= op->footprint;
+    plan->group->op_footprint -= op->footprint;
+    ucg_discard(op);
+}
+
+void ucg_plan_op_cache_cleanup(ucg_plan_t *plan)
+{
+    /* the operations themselves are discarded by the planner */
+    kh_destroy_inplace(ucg_plan_op, &plan->op_hash);
+    plan->op_cnt = 0;
+}
+
 ucs_status_t ucg_plan_single(ucg_plan_component_t *planc,
                              ucg_plan_desc_t **resources_p,
                              unsigned *nums_p)
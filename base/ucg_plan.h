@@ -24,6 +24,7 @@ ucs_status_t ucg_plan_select_component(ucg_plan_desc_t *planners,
 #define ucg_prepare(plan, params, op) ((plan)->planner->prepare(plan, params, op))
 #define ucg_trigger(op, cid, req)     ((op)->plan->planner->trigger(op, cid, req))
 #define ucg_discard(op)               ((op)->plan->planner->discard(op))
-#define ucg_destroy(plan)             ((plan)->planner->destroy(plan))
+#define ucg_rebind(op, sbuf, rbuf)    ((op)->plan->planner->rebind(op, sbuf, rbuf))
+#define ucg_destroy_plan(plan)        ((plan)->planner->destroy_plan(plan))
 
 #endif /* UCG_PLAN_H_ */
\ No newline at end of file
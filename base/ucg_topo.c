@@ -0,0 +1,269 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include "ucg_topo.h"
+
+#include <string.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+
+static ucs_status_t ucg_topo_find_myself(const ucg_group_params_t *params,
+                                         ucg_group_member_index_t *my_index)
+{
+    ucg_group_member_index_t member_idx;
+    for (member_idx = 0; member_idx < params->member_count; member_idx++) {
+        ucs_assert(params->distance[member_idx] < UCG_GROUP_MEMBER_DISTANCE_LAST);
+        if (params->distance[member_idx] == UCG_GROUP_MEMBER_DISTANCE_SELF) {
+            *my_index = member_idx;
+            return UCS_OK;
+        }
+    }
+
+    ucs_error("No member with distance==UCG_GROUP_MEMBER_DISTANCE_SELF found");
+    return UCS_ERR_INVALID_PARAM;
+}
+
+static ucs_status_t ucg_topo_fill_hosts(ucg_topo_t *topo,
+                                        const ucg_group_params_t *params)
+{
+    ucg_group_member_index_t member_idx;
+    uint32_t *node_leaders;
+
+    topo->node_cnt = 0;
+    for (member_idx = 0; member_idx < params->member_count; member_idx++) {
+        topo->members[member_idx].node_index = params->node_index[member_idx];
+        topo->node_cnt = ucs_max(topo->node_cnt, params->node_index[member_idx] + 1);
+    }
+
+    node_leaders = ucs_malloc(topo->node_cnt * sizeof(*node_leaders), "ucg topo node leaders");
+    if (node_leaders == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+    memset(node_leaders, 0xff, topo->node_cnt * sizeof(*node_leaders));
+
+    /* the first member seen on each node leads it */
+    for (member_idx = 0; member_idx < params->member_count; member_idx++) {
+        uint32_t *leader = &node_leaders[params->node_index[member_idx]];
+        if (*leader == UCG_TOPO_ID_UNKNOWN) {
+            *leader = member_idx;
+        }
+        topo->members[member_idx].host_id = *leader;
+    }
+
+    ucs_free(node_leaders);
+    return UCS_OK;
+}
+
+static void ucg_topo_map_domains(const ucg_group_params_t *params,
+                                 ucg_group_member_index_t member_idx,
+                                 uint32_t host_id, uint32_t *socket_id,
+                                 uint32_t *l3_id)
+{
+    const char *row = params->topo_map[member_idx];
+    ucg_group_member_index_t peer_idx;
+
+    *socket_id = UCG_TOPO_ID_UNKNOWN;
+    *l3_id     = UCG_TOPO_ID_UNKNOWN;
+
+    /* leaders never precede the node's leader, and the member itself ends the scan */
+    for (peer_idx = host_id; peer_idx <= member_idx; peer_idx++) {
+        if ((*socket_id == UCG_TOPO_ID_UNKNOWN) &&
+            (row[peer_idx] <= (char)UCG_GROUP_MEMBER_DISTANCE_SOCKET)) {
+            *socket_id = peer_idx;
+        }
+        if (row[peer_idx] <= (char)UCG_GROUP_MEMBER_DISTANCE_L3CACHE) {
+            *l3_id = peer_idx;
+            break;
+        }
+    }
+}
+
+static void ucg_topo_fill_domains_from_map(ucg_topo_t *topo,
+                                           const ucg_group_params_t *params)
+{
+    ucg_group_member_index_t member_idx;
+    for (member_idx = 0; member_idx < params->member_count; member_idx++) {
+        ucg_topo_member_t *member = &topo->members[member_idx];
+        ucg_topo_map_domains(params, member_idx, member->host_id,
+                             &member->socket_id, &member->l3_id);
+    }
+    topo->is_complete = 1;
+}
+
+/* Domain of a member, if within the given distance of the local member */
+static inline uint32_t ucg_topo_distance_domain(const ucg_group_params_t *params,
+                                                ucg_group_member_index_t member_idx,
+                                                enum ucg_group_member_distance domain,
+                                                uint32_t *leader)
+{
+    if (params->distance[member_idx] > domain) {
+        return UCG_TOPO_ID_UNKNOWN;
+    }
+
+    if (*leader == UCG_TOPO_ID_UNKNOWN) {
+        *leader = member_idx;
+    }
+    return *leader;
+}
+
+static void ucg_topo_fill_domains_from_distance(ucg_topo_t *topo,
+                                                const ucg_group_params_t *params)
+{
+    uint32_t socket_leader = UCG_TOPO_ID_UNKNOWN;
+    uint32_t l3_leader     = UCG_TOPO_ID_UNKNOWN;
+    ucg_group_member_index_t member_idx;
+
+    /* only the domains of the local member are known */
+    for (member_idx = 0; member_idx < params->member_count; member_idx++) {
+        ucg_topo_member_t *member = &topo->members[member_idx];
+        member->socket_id = ucg_topo_distance_domain(params, member_idx,
+                                                     UCG_GROUP_MEMBER_DISTANCE_SOCKET,
+                                                     &socket_leader);
+        member->l3_id     = ucg_topo_distance_domain(params, member_idx,
+                                                     UCG_GROUP_MEMBER_DISTANCE_L3CACHE,
+                                                     &l3_leader);
+    }
+    topo->is_complete = 0;
+}
+
+/*
+ * Fingerprint of the inputs a topology is built from, so that a matching one
+ * is found without building (or allocating) another first. The topology map
+ * itself is not folded in, being O(N^2) - it's compared on a match instead.
+ */
+static uint64_t ucg_topo_params_hash(const ucg_group_params_t *params,
+                                     ucg_group_member_index_t my_index)
+{
+    uint64_t hash = (params->member_count * 31 + my_index) * 2 +
+                    (params->topo_map != NULL);
+    ucg_group_member_index_t member_idx;
+
+    for (member_idx = 0; member_idx < params->member_count; member_idx++) {
+        hash = (hash * 31) ^ params->node_index[member_idx];
+        if (params->topo_map == NULL) {
+            /* only whether it shares the socket or the L3 cache matters */
+            hash = (hash * 31) ^
+                   (params->distance[member_idx] <= UCG_GROUP_MEMBER_DISTANCE_SOCKET) ^
+                   ((params->distance[member_idx] <= UCG_GROUP_MEMBER_DISTANCE_L3CACHE) << 1);
+        }
+    }
+    return hash;
+}
+
+/* Whether the topology would be built from these parameters, in O(N) */
+static int ucg_topo_is_match(const ucg_topo_t *topo, uint64_t hash,
+                             const ucg_group_params_t *params,
+                             ucg_group_member_index_t my_index)
+{
+    uint32_t socket_leader = UCG_TOPO_ID_UNKNOWN;
+    uint32_t l3_leader     = UCG_TOPO_ID_UNKNOWN;
+    ucg_group_member_index_t member_idx;
+    uint32_t socket_id, l3_id;
+
+    if ((topo->hash         != hash) ||
+        (topo->member_count != params->member_count) ||
+        (topo->my_index     != my_index) ||
+        (topo->is_complete  != (params->topo_map != NULL))) {
+        return 0;
+    }
+
+    /* the node leaders follow from the node indexes, so these are compared */
+    for (member_idx = 0; member_idx < params->member_count; member_idx++) {
+        const ucg_topo_member_t *member = &topo->members[member_idx];
+        if (member->node_index != params->node_index[member_idx]) {
+            return 0;
+        }
+
+        if (params->topo_map != NULL) {
+            ucg_topo_map_domains(params, member_idx, member->host_id,
+                                 &socket_id, &l3_id);
+        } else {
+            socket_id = ucg_topo_distance_domain(params, member_idx,
+                                                 UCG_GROUP_MEMBER_DISTANCE_SOCKET,
+                                                 &socket_leader);
+            l3_id     = ucg_topo_distance_domain(params, member_idx,
+                                                 UCG_GROUP_MEMBER_DISTANCE_L3CACHE,
+                                                 &l3_leader);
+        }
+
+        if ((member->socket_id != socket_id) || (member->l3_id != l3_id)) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+ucs_status_t ucg_topo_get(ucs_list_link_t *topo_head,
+                          const ucg_group_params_t *params,
+                          ucg_topo_t **topo_p)
+{
+    ucg_group_member_index_t my_index;
+    ucs_status_t status;
+    ucg_topo_t *topo;
+    uint64_t hash;
+
+    if ((params->distance == NULL) || (params->node_index == NULL)) {
+        ucs_error("Group topology requires both distance and node index arrays");
+        return UCS_ERR_INVALID_PARAM;
+    }
+
+    if (params->member_count >= UCG_TOPO_ID_UNKNOWN) {
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    status = ucg_topo_find_myself(params, &my_index);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* groups with the same layout (e.g. duplicates) share a single copy */
+    hash = ucg_topo_params_hash(params, my_index);
+    ucs_list_for_each(topo, topo_head, list) {
+        if (ucg_topo_is_match(topo, hash, params, my_index)) {
+            topo->refcount++;
+            *topo_p = topo;
+            return UCS_OK;
+        }
+    }
+
+    topo = ucs_calloc(1, sizeof(*topo) + params->member_count * sizeof(ucg_topo_member_t),
+                      "ucg topology");
+    if (topo == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+    topo->member_count = params->member_count;
+    topo->my_index     = my_index;
+    topo->hash         = hash;
+
+    status = ucg_topo_fill_hosts(topo, params);
+    if (status != UCS_OK) {
+        goto err_free;
+    }
+
+    if (params->topo_map != NULL) {
+        ucg_topo_fill_domains_from_map(topo, params);
+    } else {
+        ucg_topo_fill_domains_from_distance(topo, params);
+    }
+
+    topo->refcount = 1;
+    ucs_list_add_tail(topo_head, &topo->list);
+    *topo_p = topo;
+    return UCS_OK;
+
+err_free:
+    ucs_free(topo);
+    return status;
+}
+
+void ucg_topo_put(ucg_topo_t *topo)
+{
+    ucs_assert(topo->refcount > 0);
+    if (--topo->refcount == 0) {
+        ucs_list_del(&topo->list);
+        ucs_free(topo);
+    }
+}
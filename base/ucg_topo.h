@@ -0,0 +1,112 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_TOPO_H_
+#define UCG_TOPO_H_
+
+#include "../api/ucg.h"
+
+#include <ucs/datastruct/list.h>
+#include <ucs/sys/compiler_def.h>
+
+/* a socket/L3 cache identifier which is not known to the local member */
+#define UCG_TOPO_ID_UNKNOWN ((uint32_t)-1)
+
+/*
+ * Placement of a single group member. Each locality domain is identified by
+ * its "leader" - the lowest member index within it - so that domains can be
+ * compared without any (per-pair) distance information.
+ */
+typedef struct ucg_topo_member {
+    uint16_t node_index;      /* node number, as passed by the user */
+    uint32_t host_id;         /* leader of the members on the same node */
+    uint32_t socket_id;       /* leader of the members on the same socket */
+    uint32_t l3_id;           /* leader of the members sharing the L3 cache */
+} ucg_topo_member_t;
+
+/*
+ * Compact topology of a group: O(N) per distinct group layout, and shared
+ * (reference-counted) by all the groups with the same layout, e.g. duplicates
+ * of the same communicator. Distances are computed on demand.
+ *
+ * If only the local member's distances were given (no topology map), the
+ * socket/L3 identifiers are known only for the members close to it.
+ */
+typedef struct ucg_topo {
+    ucs_list_link_t          list;         /* member of the worker's list */
+    unsigned                 refcount;     /* number of groups using it */
+    uint64_t                 hash;         /* of the parameters it was built from */
+    int                      is_complete;  /* socket/L3 known for all members */
+    ucg_group_member_index_t member_count;
+    ucg_group_member_index_t my_index;     /* index of the local member */
+    unsigned                 node_cnt;     /* highest node index + 1 */
+    ucg_topo_member_t        members[0];
+} ucg_topo_t;
+
+/* Find a matching topology for these group parameters, or create a new one */
+ucs_status_t ucg_topo_get(ucs_list_link_t *topo_head,
+                          const ucg_group_params_t *params,
+                          ucg_topo_t **topo_p);
+
+/* Release a topology obtained by @ref ucg_topo_get */
+void ucg_topo_put(ucg_topo_t *topo);
+
+/* Topology of the group, for its planners */
+const ucg_topo_t *ucg_group_topo(ucg_group_h group);
+
+static UCS_F_ALWAYS_INLINE enum ucg_group_member_distance
+ucg_topo_distance(const ucg_topo_t *topo, ucg_group_member_index_t a,
+                  ucg_group_member_index_t b)
+{
+    const ucg_topo_member_t *ma = &topo->members[a];
+    const ucg_topo_member_t *mb = &topo->members[b];
+
+    if (a == b) {
+        return UCG_GROUP_MEMBER_DISTANCE_SELF;
+    } else if (ma->host_id != mb->host_id) {
+        return UCG_GROUP_MEMBER_DISTANCE_NET;
+    } else if ((ma->socket_id != mb->socket_id) ||
+               (ma->socket_id == UCG_TOPO_ID_UNKNOWN)) {
+        return UCG_GROUP_MEMBER_DISTANCE_HOST;
+    } else if ((ma->l3_id != mb->l3_id) ||
+               (ma->l3_id == UCG_TOPO_ID_UNKNOWN)) {
+        return UCG_GROUP_MEMBER_DISTANCE_SOCKET;
+    }
+    return UCG_GROUP_MEMBER_DISTANCE_L3CACHE;
+}
+
+/* Distance of a member from the local member */
+static UCS_F_ALWAYS_INLINE enum ucg_group_member_distance
+ucg_topo_my_distance(const ucg_topo_t *topo, ucg_group_member_index_t index)
+{
+    return ucg_topo_distance(topo, topo->my_index, index);
+}
+
+static UCS_F_ALWAYS_INLINE unsigned
+ucg_topo_node_index(const ucg_topo_t *topo, ucg_group_member_index_t index)
+{
+    return topo->members[index].node_index;
+}
+
+/* Leader of the domain of the given distance the member belongs to */
+static UCS_F_ALWAYS_INLINE ucg_group_member_index_t
+ucg_topo_domain_leader(const ucg_topo_t *topo, ucg_group_member_index_t index,
+                       enum ucg_group_member_distance domain_distance)
+{
+    switch (domain_distance) {
+        case UCG_GROUP_MEMBER_DISTANCE_SELF:
+            return index;
+        case UCG_GROUP_MEMBER_DISTANCE_L3CACHE:
+            return topo->members[index].l3_id;
+        case UCG_GROUP_MEMBER_DISTANCE_SOCKET:
+            return topo->members[index].socket_id;
+        case UCG_GROUP_MEMBER_DISTANCE_HOST:
+            return topo->members[index].host_id;
+        default:
+            return 0;
+    }
+}
+
+#endif /* UCG_TOPO_H_ */
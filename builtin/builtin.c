@@ -4,6 +4,8 @@
  */
 
 #include <string.h>
+#include <stdio.h>
+#include <sys/prctl.h>
 #include <ucs/debug/memtrack.h>
 #include <ucg/api/ucg_plan_component.h>
 #include <ucs/profile/profile.h>
@@ -13,19 +15,43 @@
 #include <ucg/api/ucg_mpi.h>
 #include <ucg/base/ucg_group.h>
 
-#define CACHE_SIZE 1000
-#define RECURSIVE_FACTOR 2
 #define DEFAULT_INTER_KVALUE 8
 #define DEFAULT_INTRA_KVALUE 2
+#define UCG_BUILTIN_CONNECT_MIN 16
 
 #define UCG_BUILTIN_SUPPORT_MASK (UCG_GROUP_COLLECTIVE_MODIFIER_AGGREGATE |\
                                   UCG_GROUP_COLLECTIVE_MODIFIER_BROADCAST)
 
+ucs_config_field_t ucg_builtin_msg_size_config_table[] = {
+    {"MEDIUM", "16k", "Smallest message size of the medium class",
+     ucs_offsetof(ucg_builtin_msg_size_config_t, medium), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"LARGE", "1m", "Smallest message size of the large class",
+     ucs_offsetof(ucg_builtin_msg_size_config_t, large), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"HUGE", "32m", "Smallest message size of the huge class",
+     ucs_offsetof(ucg_builtin_msg_size_config_t, huge), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {NULL}
+};
+
 static ucs_config_field_t ucg_builtin_config_table[] = {
 
     {"BMTREE_", "", NULL, ucs_offsetof(ucg_builtin_config_t, bmtree),
      UCS_CONFIG_TYPE_TABLE(ucg_builtin_binomial_tree_config_table)},
 
+    {"RECURSIVE_", "", NULL, ucs_offsetof(ucg_builtin_config_t, recursive),
+     UCS_CONFIG_TYPE_TABLE(ucg_builtin_recursive_config_table)},
+
+    {"ALLREDUCE_SIZE_", "", NULL, ucs_offsetof(ucg_builtin_config_t, allreduce_size),
+     UCS_CONFIG_TYPE_TABLE(ucg_builtin_msg_size_config_table)},
+
+    {"BCAST_SIZE_", "", NULL, ucs_offsetof(ucg_builtin_config_t, bcast_size),
+     UCS_CONFIG_TYPE_TABLE(ucg_builtin_msg_size_config_table)},
+
+    {"COLL_SIZE_", "", NULL, ucs_offsetof(ucg_builtin_config_t, coll_size),
+     UCS_CONFIG_TYPE_TABLE(ucg_builtin_msg_size_config_table)},
+
     {"BCAST_ALGORITHM", "0", "Bcast algorithm",
      ucs_offsetof(ucg_builtin_config_t, bcast_algorithm), UCS_CONFIG_TYPE_DOUBLE},
 
@@ -35,6 +61,9 @@ static ucs_config_field_t ucg_builtin_config_table[] = {
     {"BARRIER_ALGORITHM", "0", "Barrier algorithm",
      ucs_offsetof(ucg_builtin_config_t, barrier_algorithm), UCS_CONFIG_TYPE_DOUBLE},
 
+    {"REDUCE_ALGORITHM", "0", "Reduce algorithm",
+     ucs_offsetof(ucg_builtin_config_t, reduce_algorithm), UCS_CONFIG_TYPE_DOUBLE},
+
     {"MAX_MSG_LIST_SIZE", "40", "Largest loop count of msg process function",
      ucs_offsetof(ucg_builtin_config_t, max_msg_list_size), UCS_CONFIG_TYPE_UINT},
 
@@ -51,9 +80,72 @@ static ucs_config_field_t ucg_builtin_config_table[] = {
     {"BCOPY_MAX_TX_SIZE", "32768", "Largest send operation to use buffer copy",
      ucs_offsetof(ucg_builtin_config_t, bcopy_max_tx), UCS_CONFIG_TYPE_MEMUNITS},
 
+    {"PIPELINE_SEGMENT", "8k", "Segment size of the pipelined algorithms (trees and ring), where "
+     "every segment is passed on as soon as it arrives. Capped by the largest buffer-copy send",
+     ucs_offsetof(ucg_builtin_config_t, pipeline_segment), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"RNDV_THRESH", "inf", "Broadcast messages from this size on are not sent, but read by every "
+     "receiver directly from its sender's buffer - if the transport supports RDMA read",
+     ucs_offsetof(ucg_builtin_config_t, rndv_thresh), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"SHM_CMA_THRESH", "64k", "Broadcast messages from this size on are read by every receiver "
+     "on the same node as its sender directly from the sender's memory, using a single copy "
+     "(Cross-Memory Attach), regardless of the transport",
+     ucs_offsetof(ucg_builtin_config_t, cma_thresh), UCS_CONFIG_TYPE_MEMUNITS},
+
+    {"CMA_PTRACER_ANY", "n", "Allow any process to read the memory of this one (see "
+     "PR_SET_PTRACER), once the first group is created, so that Cross-Memory Attach works "
+     "with a Yama ptrace_scope of 1. Otherwise, it is only used with a ptrace_scope of 0. "
+     "Must be the same on all the processes",
+     ucs_offsetof(ucg_builtin_config_t, cma_ptracer_any), UCS_CONFIG_TYPE_BOOL},
+
+    {"SHM_COLL", "y", "Pass the data of barriers and allreduce operations of up to 256 bytes "
+     "through shared memory among the processes on the same node, so that only one process "
+     "per node takes part in the exchange between the nodes. Must be the same on all the "
+     "processes",
+     ucs_offsetof(ucg_builtin_config_t, shm_coll), UCS_CONFIG_TYPE_BOOL},
+
+    {"NODE_RING", "n", "Reduce-scatter large allreduce operations among the processes on the "
+     "same node, and have each one exchange its slice with the other nodes, rather than pass "
+     "the whole vector around a ring of the group. Requires Cross-Memory Attach (see "
+     "BUILTIN_CMA_PTRACER_ANY) on every node. Must be the same on all the processes",
+     ucs_offsetof(ucg_builtin_config_t, node_ring), UCS_CONFIG_TYPE_BOOL},
+
     {"LARGE_DATATYPE_THRESHOLD", "32", "Large datatype threshold",
      ucs_offsetof(ucg_builtin_config_t, large_datatype_threshold), UCS_CONFIG_TYPE_UINT},
 
+    {"MAX_CONCURRENT_COLLS", "16", "Number of collectives which may be in progress on a group "
+     "at the same time, unless set in the group parameters. Rounded up to a power of 2, "
+     "at most 128. Further collectives are queued until an earlier one completes",
+     ucs_offsetof(ucg_builtin_config_t, max_concurrent_colls), UCS_CONFIG_TYPE_UINT},
+
+    {"MEM_REG_CACHE", "y", "Keep the registration of user buffers sent with zero-copy "
+     "after the collective is done, so that other collectives on the same memory reuse it",
+     ucs_offsetof(ucg_builtin_config_t, mem_reg_cache), UCS_CONFIG_TYPE_BOOL},
+
+    {"MAX_RAILS", "1", "Largest number of lanes to each peer (e.g. one per HCA), which the "
+     "fragments of large messages are striped across. Must be the same on all the processes",
+     ucs_offsetof(ucg_builtin_config_t, max_rails), UCS_CONFIG_TYPE_UINT},
+
+    {"RAIL_BW_WEIGHTED", "y", "Stripe fragments across the rails in proportion to their "
+     "bandwidth, rather than round-robin",
+     ucs_offsetof(ucg_builtin_config_t, rail_bw_weighted), UCS_CONFIG_TYPE_BOOL},
+
+    {"SCRATCH_HUGETLB", "n", "Map large temporary buffers of collectives (e.g. for "
+     "waypoints) from huge pages, if available",
+     ucs_offsetof(ucg_builtin_config_t, scratch_hugetlb), UCS_CONFIG_TYPE_BOOL},
+
+    {"SCRATCH_MAX_CACHED", "64m", "Memory kept by the per-group arena of temporary "
+     "buffers once they are returned, beyond which they are released instead",
+     ucs_offsetof(ucg_builtin_config_t, scratch_max_cached), UCS_CONFIG_TYPE_MEMUNITS},
+
+#if ENABLE_DEBUG_DATA
+    {"FAULT_NO_RESOURCE", "0", "Test the resending of fragmented messages: fail every "
+     "N-th fragment sent with UCS_ERR_NO_RESOURCE, and check the resend resumes from it "
+     "(0 to disable)",
+     ucs_offsetof(ucg_builtin_config_t, fault_no_resource), UCS_CONFIG_TYPE_UINT},
+#endif
+
     {NULL}
 };
 
@@ -67,6 +159,8 @@ struct ucg_builtin_algorithm ucg_algo = {
     .topo_level   = UCG_GROUP_HIERARCHY_LEVEL_NODE,
     .ring         = 0,
     .pipeline     = 0,
+    .halving      = 0,
+    .kary         = 0,
     .feature_flag = UCG_ALGORITHM_SUPPORT_COMMON_FEATURE,
 };
 
@@ -75,18 +169,35 @@ struct ucg_builtin_group_ctx {
 
     ucg_group_h               group;
     const ucg_group_params_t *group_params;
+    const ucg_topo_t         *topo;
     ucg_group_id_t            group_id;
     uint16_t                  am_id;
     ucs_list_link_t           plan_head;    /* for resource release */
     ucg_builtin_config_t     *config;
 
-    ucg_builtin_comp_slot_t   slots[UCG_BUILTIN_MAX_CONCURRENT_OPS];
+    /* endpoints of the plan being created, connected once it's complete */
+    ucg_builtin_plan_connect_t *connect;
+    ucp_ep_h                 *connect_eps;
+    unsigned                  connect_cnt;
+    unsigned                  connect_max;
+
+    ucg_builtin_comp_slot_t  *slots;        /* window of outstanding collectives */
+    unsigned                  slot_mask;    /* window size, minus one */
+    ucg_builtin_scratch_t     scratch;      /* temporary buffers of operations */
+    ucs_list_link_t           rcaches;      /* registration caches, one per MD */
+    ucg_builtin_shm_t         shm;          /* node-local segment, once planned */
 };
 
+/* The slots of a group, as seen by the AM-handler */
+typedef struct ucg_builtin_ctx_slots {
+    ucg_builtin_comp_slot_t *slots;
+    unsigned                 mask;
+} ucg_builtin_ctx_slots_t;
+
 typedef struct ucg_builtin_ctx {
     unsigned slots_total;
     unsigned slots_used;
-    ucg_builtin_comp_slot_t *slots[];
+    ucg_builtin_ctx_slots_t slots[];
 } ucg_builtin_ctx_t;
 
 /*
@@ -124,9 +235,9 @@ enum ucg_builtin_plan_topology_type ucg_builtin_choose_type(enum ucg_collective_
 
     if (flags & UCG_GROUP_COLLECTIVE_MODIFIER_AGGREGATE) {
         if (ucg_algo.recursive) {
-            return UCG_PLAN_RECURSIVE;
+            return ucg_algo.halving ? UCG_PLAN_RECURSIVE_HALVING : UCG_PLAN_RECURSIVE;
         } else if (ucg_algo.ring) {
-            return UCG_PLAN_RING;
+            return ucg_algo.topo ? UCG_PLAN_NODE_RING : UCG_PLAN_RING;
         } else {
             return UCG_PLAN_TREE_FANIN_FANOUT;
         }
@@ -153,8 +264,8 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
 {
     ucg_builtin_header_t* header  = data;
     ucg_builtin_ctx_t **ctx       = UCG_WORKER_TO_COMPONENT_CTX(ucg_builtin_component, arg);
-    ucg_builtin_comp_slot_t *slot = &(*ctx)->slots[header->group_id]
-        [header->coll_id % UCG_BUILTIN_MAX_CONCURRENT_OPS];
+    ucg_builtin_ctx_slots_t *group_slots = &(*ctx)->slots[header->group_id];
+    ucg_builtin_comp_slot_t *slot = &group_slots->slots[header->coll_id & group_slots->mask];
     ucs_assert(header->group_id < (*ctx)->slots_total);
     ucs_assert(length >= sizeof(header));
 
@@ -185,19 +296,6 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_am_handler,
             goto am_handler_store;
         }
 
-        size_t real_length = length - sizeof(ucg_builtin_header_t);
-        char *header_tmp = (char *)header;
-        char *recv_buffer_tmp = (char *)slot->req.step->recv_buffer;
-
-        if (slot->req.step->phase->is_swap) {
-            char *temp_buffer = (char*)UCS_ALLOC_CHECK(real_length, "temp buffer");
-            memcpy(temp_buffer, header_tmp + sizeof(ucg_builtin_header_t), real_length);
-            memcpy(header_tmp + sizeof(ucg_builtin_header_t), recv_buffer_tmp + header->remote_offset, real_length);
-            memcpy(recv_buffer_tmp + header->remote_offset, temp_buffer, real_length);
-            free(temp_buffer);
-            temp_buffer = NULL;
-        }
-
         /* The packet arrived "on time" - process it */
         UCS_PROFILE_CODE("ucg_builtin_am_handler_cb") {
             (void) slot->cb(&slot->req, header->remote_offset,
@@ -245,12 +343,122 @@ void ucg_builtin_msg_dump(ucp_worker_h worker, uct_am_trace_type_t type,
 }
 
 
+static void ucg_builtin_check_msg_size_config(const char *coll_name,
+                                              ucg_builtin_msg_size_config_t *sizes)
+{
+    if ((sizes->medium > sizes->large) || (sizes->large > sizes->huge)) {
+        ucs_warn("%s message size classes must be ascending (%zu, %zu, %zu), "
+                 "merging the out-of-order classes", coll_name,
+                 sizes->medium, sizes->large, sizes->huge);
+        sizes->large = ucs_max(sizes->large, sizes->medium);
+        sizes->huge  = ucs_max(sizes->huge, sizes->large);
+    }
+}
+
+enum ucg_builtin_msg_size_class ucg_builtin_msg_size_class(enum ucg_collective_modifiers modifiers,
+                                                           size_t msg_size)
+{
+    const ucg_builtin_config_t *config = ucg_builtin_component.plan_config;
+    const ucg_builtin_msg_size_config_t *sizes;
+
+    if (modifiers == ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE]) {
+        if (config->shm_coll && (msg_size <= UCG_BUILTIN_SHM_MAX_DATA)) {
+            return UCG_BUILTIN_MSG_SIZE_TINY;
+        }
+        sizes = &config->allreduce_size;
+    } else if (modifiers == ucg_predefined_modifiers[UCG_PRIMITIVE_BCAST]) {
+        sizes = &config->bcast_size;
+    } else {
+        sizes = &config->coll_size;
+    }
+
+    if (msg_size < sizes->medium) {
+        return UCG_BUILTIN_MSG_SIZE_SMALL;
+    } else if (msg_size < sizes->large) {
+        return UCG_BUILTIN_MSG_SIZE_MEDIUM;
+    } else if (msg_size < sizes->huge) {
+        return UCG_BUILTIN_MSG_SIZE_LARGE;
+    }
+    return UCG_BUILTIN_MSG_SIZE_HUGE;
+}
+
+static inline int ucg_builtin_allreduce_is_small(const size_t msg_size)
+{
+    return ucg_builtin_msg_size_class(ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE],
+                                      msg_size) <= UCG_BUILTIN_MSG_SIZE_SMALL;
+}
+
+/* Whether any process may read the memory of this one, see BUILTIN_CMA_PTRACER_ANY */
+static int ucg_builtin_cma_ptracer_any = -1;
+
+static int ucg_builtin_ptrace_scope(void)
+{
+    static int ptrace_scope = -1;
+    FILE *file;
+
+    if (ptrace_scope >= 0) {
+        return ptrace_scope;
+    }
+
+    ptrace_scope = 0;
+    file         = fopen("/proc/sys/kernel/yama/ptrace_scope", "r");
+    if (file != NULL) {
+        if (fscanf(file, "%d", &ptrace_scope) != 1) {
+            ptrace_scope = 0;
+        }
+        fclose(file);
+    }
+    return ptrace_scope;
+}
+
+/*
+ * Yama restricts reading the memory of other processes (of the same user) to
+ * their ancestors, unless they allow it explicitly - which this process does
+ * only if so configured, and only once.
+ */
+static void ucg_builtin_cma_set_ptracer(const ucg_builtin_config_t *config)
+{
+    if (!config->cma_ptracer_any || (ucg_builtin_cma_ptracer_any >= 0) ||
+        (ucg_builtin_ptrace_scope() != 1)) {
+        return;
+    }
+
+    ucg_builtin_cma_ptracer_any = (prctl(PR_SET_PTRACER, PR_SET_PTRACER_ANY, 0, 0, 0) == 0);
+    if (ucg_builtin_cma_ptracer_any) {
+        ucs_info("any process may read the memory of this one (PR_SET_PTRACER_ANY), "
+                 "for Cross-Memory Attach");
+    } else {
+        ucs_warn("failed to allow other processes to read the memory of this one: %m");
+    }
+}
+
+/*
+ * Whether this process may read the memory of other processes (of the same user)
+ * with process_vm_readv() - which requires them to allow it, with a ptrace_scope
+ * of 1 (see @ref ucg_builtin_cma_set_ptracer).
+ */
+static int ucg_builtin_cma_is_supported(void)
+{
+    int ptrace_scope = ucg_builtin_ptrace_scope();
+    int is_supported = (ptrace_scope == 0) ||
+                       ((ptrace_scope == 1) && (ucg_builtin_cma_ptracer_any == 1));
+
+    if (!is_supported) {
+        ucs_debug("CMA is not supported (ptrace_scope %d), the memory of node-local "
+                  "peers is not read directly", ptrace_scope);
+    }
+    return is_supported;
+}
+
 static ucs_status_t ucg_builtin_init_plan_config(ucg_plan_component_t *plan_component)
 {
     ucg_builtin_config_t *config = (ucg_builtin_config_t*)plan_component->plan_config;
-    config->cache_size = CACHE_SIZE;
-    config->pipelining = 0;
-    config->recursive.factor = RECURSIVE_FACTOR;
+
+    /* Recursive k-ing requires a factor bigger than 1, or 0 to choose it */
+    if (config->recursive.factor == 1) {
+        ucs_warn("Recursive algorithm requires a factor bigger than one, choose it from the group size instead");
+        config->recursive.factor = 0;
+    }
 
     /* K-nomial tree algorithm require all K vaule is bigger than 1 */
     if (config->bmtree.degree_inter_fanout <= 1 || config->bmtree.degree_inter_fanin <= 1 ||
@@ -262,6 +470,11 @@ static ucs_status_t ucg_builtin_init_plan_config(ucg_plan_component_t *plan_comp
         config->bmtree.degree_intra_fanin  = DEFAULT_INTRA_KVALUE;
     }
 
+    ucg_builtin_check_msg_size_config("allreduce", &config->allreduce_size);
+    ucg_builtin_check_msg_size_config("bcast", &config->bcast_size);
+    ucg_builtin_check_msg_size_config("collective", &config->coll_size);
+    ucg_builtin_cma_set_ptracer(config);
+
     ucs_info("plan %s bcast %u allreduce %u barrier %u "
              "inter_fanout %u inter_fanin %u intra_fanout %u intra_fanin %u",
              plan_component->name, (unsigned)config->bcast_algorithm, (unsigned)config->allreduce_algorithm,
@@ -271,6 +484,24 @@ static ucs_status_t ucg_builtin_init_plan_config(ucg_plan_component_t *plan_comp
     return UCS_OK;
 }
 
+static unsigned ucg_builtin_slot_count(const ucg_builtin_config_t *config,
+                                       const ucg_group_params_t *group_params)
+{
+    unsigned slot_cnt = group_params->max_concurrent_colls ?
+                        group_params->max_concurrent_colls :
+                        config->max_concurrent_colls;
+
+    if (slot_cnt == 0) {
+        slot_cnt = UCG_BUILTIN_MAX_CONCURRENT_OPS_DEFAULT;
+    } else if (slot_cnt > UCG_BUILTIN_MAX_CONCURRENT_OPS_LIMIT) {
+        ucs_warn("%u concurrent collectives requested, but at most %u are supported",
+                 slot_cnt, (unsigned)UCG_BUILTIN_MAX_CONCURRENT_OPS_LIMIT);
+        slot_cnt = UCG_BUILTIN_MAX_CONCURRENT_OPS_LIMIT;
+    }
+
+    return ucs_roundup_pow2(slot_cnt);
+}
+
 static ucs_status_t ucg_builtin_create(ucg_plan_component_t *plan_component,
                                        ucg_worker_h worker,
                                        ucg_group_h group,
@@ -285,7 +516,7 @@ static ucs_status_t ucg_builtin_create(ucg_plan_component_t *plan_component,
     if ((ucs_unlikely(*bctx == NULL)) ||
         (ucs_likely((*bctx)->slots_total <= group_id))) {
         void *temp = *bctx;
-        size_t bctx_size = sizeof(**bctx) + ((group_id + 1) * sizeof(void*));
+        size_t bctx_size = sizeof(**bctx) + ((group_id + 1) * sizeof(ucg_builtin_ctx_slots_t));
         *bctx = ucs_realloc(temp, bctx_size, "builtin_context");
         if (ucs_unlikely(*bctx == NULL)) {
             *bctx = temp;
@@ -303,36 +534,69 @@ static ucs_status_t ucg_builtin_create(ucg_plan_component_t *plan_component,
     /* Fill in the information in the per-group context */
     ucg_builtin_group_ctx_t *gctx =
             UCG_GROUP_TO_COMPONENT_CTX(ucg_builtin_component, group);
-    ucg_builtin_mpi_reduce_cb     = group_params->mpi_reduce_f;
+    ucg_builtin_reduce_select();
     gctx->group                   = group;
     gctx->group_id                = group_id;
     gctx->group_params            = group_params;
+    gctx->topo                    = ucg_group_topo(group);
     gctx->config                  = plan_component->plan_config;
     gctx->am_id                   = base_am_id;
     ucs_list_head_init(&gctx->send_head);
     ucs_list_head_init(&gctx->plan_head);
 
-    int i;
-    for (i = 0; i < UCG_BUILTIN_MAX_CONCURRENT_OPS; i++) {
+    ucs_status_t status = ucg_builtin_init_plan_config(plan_component);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    unsigned slot_cnt = ucg_builtin_slot_count(gctx->config, group_params);
+    gctx->slot_mask   = slot_cnt - 1;
+    gctx->slots       = ucs_malloc(slot_cnt * sizeof(*gctx->slots), "builtin slots");
+    if (gctx->slots == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    unsigned i;
+    for (i = 0; i < slot_cnt; i++) {
         ucs_list_head_init(&gctx->slots[i].msg_head);
-        gctx->slots[i].mp       = group_am_mp;
-        gctx->slots[i].cb       = NULL;
-        gctx->slots[i].coll_id  = i;
-        gctx->slots[i].step_idx = 0;
+        gctx->slots[i].mp          = group_am_mp;
+        gctx->slots[i].cb          = NULL;
+        gctx->slots[i].coll_id     = i;
+        gctx->slots[i].step_idx    = 0;
     }
 
-    /* Link the two contexts */
-    (*bctx)->slots[group_id] = gctx->slots;
+    ucg_builtin_scratch_init(&gctx->scratch, gctx->config->scratch_hugetlb,
+                             gctx->config->scratch_max_cached);
+    ucg_builtin_rcache_init(&gctx->rcaches);
+    ucg_builtin_shm_init(&gctx->shm, slot_cnt);
 
-    return ucg_builtin_init_plan_config(plan_component);
+    /* Link the two contexts */
+    (*bctx)->slots[group_id].slots = gctx->slots;
+    (*bctx)->slots[group_id].mask  = gctx->slot_mask;
+    return UCS_OK;
 }
 
 static void ucg_builtin_clean_phases(ucg_builtin_plan_t *plan)
 {
     int i;
+    ucg_builtin_free((void **)&plan->connect);
+    ucg_builtin_free((void **)&plan->connect_eps);
+    plan->connect_cnt = 0;
+
     for (i = 0; i < plan->phs_cnt; i++) {
-        ucg_builtin_free((void **)&plan->phss[i].recv_cache_buffer);
+        if (plan->phss[i].recv_cache_buffer != NULL) {
+            ucg_builtin_scratch_put(plan->scratch, plan->phss[i].recv_cache_buffer);
+            plan->phss[i].recv_cache_buffer = NULL;
+            plan->phss[i].recv_cache_len    = 0;
+        }
         ucg_builtin_free((void **)&plan->phss[i].ucp_eps);
+        /* clones share the rail endpoints of their original phase */
+        if (plan->phss[i].clone_of == NULL) {
+            ucg_builtin_free((void **)&plan->phss[i].rail_eps);
+        } else {
+            plan->phss[i].rail_eps = NULL;
+        }
+        plan->phss[i].rail_cnt = 0;
     }
 
 #if ENABLE_DEBUG_DATA
@@ -340,27 +604,13 @@ static void ucg_builtin_clean_phases(ucg_builtin_plan_t *plan)
 #endif
 }
 
-ucs_status_t ucg_builtin_remove_ep(ucp_ep_h *ep, ucg_group_h group)
-{
-    ucp_ep_ext_gen_t *ep_ext = NULL;
-    ucp_ep_ext_gen_t *tmp = NULL;
-    ucs_list_for_each_safe(ep_ext, tmp, &group->worker->all_eps, ep_list) {
-        ucp_ep_h tmp_ep = (ucp_ep_h)ucs_strided_elem_get(ep_ext, 1, 0);
-        if (tmp_ep == *ep) {
-            ucp_ep_disconnected(tmp_ep, 1);
-            ucs_list_del(&ep_ext->ep_list);
-            break;
-        }
-    }
-    return UCS_OK;
-}
-
 ucs_status_t ucg_builtin_destroy_plan(ucg_builtin_plan_t *plan, ucg_group_h group)
 {
+    /* the endpoints are shared, so other plans may still keep them open */
     for (unsigned i = 0; i < plan->phs_cnt; i++) {
         if (plan->phss[i].ucp_eps != NULL) {
-            for (unsigned j = 0; j < plan->phss[i].ep_cnt; j++) {
-                ucg_builtin_remove_ep(&plan->phss[i].ucp_eps[j], group);
+            for (unsigned j = 0; j < plan->phss[i].ucp_ep_cnt; j++) {
+                ucg_plan_disconnect(group, plan->phss[i].ucp_eps[j]);
                 plan->phss[i].ucp_eps[j] = NULL;
             }
         }
@@ -371,6 +621,7 @@ ucs_status_t ucg_builtin_destroy_plan(ucg_builtin_plan_t *plan, ucg_group_h grou
         ucg_op_t *op = ucs_list_extract_head(&plan->super.op_head, ucg_op_t, list);
         ucg_builtin_op_discard(op);
     }
+    ucg_plan_op_cache_cleanup(&plan->super);
 
     ucs_list_del(&plan->list);
     ucs_mpool_cleanup(&plan->op_mp, 1);
@@ -379,6 +630,67 @@ ucs_status_t ucg_builtin_destroy_plan(ucg_builtin_plan_t *plan, ucg_group_h grou
     return UCS_OK;
 }
 
+static void ucg_builtin_plan_destroy(ucg_plan_t *plan)
+{
+    (void)ucg_builtin_destroy_plan(ucs_derived_of(plan, ucg_builtin_plan_t),
+                                   plan->group);
+}
+
+int ucg_builtin_plan_is_usable(const ucg_builtin_plan_t *plan)
+{
+    unsigned phs_idx;
+
+    if (ucs_likely(plan->shm->status == UCS_OK)) {
+        return 1;
+    }
+
+    for (phs_idx = 0; phs_idx < plan->phs_cnt; phs_idx++) {
+        switch (plan->phss[phs_idx].method) {
+            case UCG_PLAN_METHOD_SHM_FANIN:
+            case UCG_PLAN_METHOD_SHM_FANOUT:
+            case UCG_PLAN_METHOD_SHM_REDUCE_SCATTER:
+            case UCG_PLAN_METHOD_SHM_ALLGATHER:
+                return 0;
+            default:
+                break;
+        }
+    }
+
+    return 1;
+}
+
+size_t ucg_builtin_plan_footprint(const ucg_builtin_plan_t *plan)
+{
+    /* the phases and both endpoint arrays dominate the size of a plan */
+    return sizeof(*plan) + plan->phs_cnt * sizeof(ucg_builtin_plan_phase_t) +
+           plan->ep_cnt * (sizeof(uct_ep_h) + sizeof(ucp_ep_h));
+}
+
+size_t ucg_builtin_op_footprint(const ucg_op_t *op)
+{
+    const ucg_builtin_op_t *builtin_op = (const ucg_builtin_op_t*)op;
+    const ucg_builtin_plan_t *plan     = ucs_derived_of(op->plan, ucg_builtin_plan_t);
+    const ucg_builtin_op_step_t *step  = &builtin_op->steps[0];
+    size_t footprint                   = sizeof(*builtin_op) + plan->phs_cnt *
+                                         sizeof(ucg_builtin_op_step_t);
+
+    /* besides the element of the pool - count the scratch buffers it holds */
+    if (builtin_op->reduce_scratch != NULL) {
+        footprint += ucg_builtin_scratch_footprint(builtin_op->reduce_scratch);
+    }
+
+    do {
+        if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER) {
+            footprint += ucg_builtin_scratch_footprint(step->send_buffer);
+        }
+        if (step->fragment_pending != NULL) {
+            footprint += ucg_builtin_scratch_footprint((void*)step->fragment_pending);
+        }
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+
+    return footprint;
+}
+
 void ucg_builtin_release_comp_desc(ucg_builtin_comp_desc_t *desc)
 {
     if (desc->super.flags == UCT_CB_PARAM_FLAG_DESC) {
@@ -394,7 +706,7 @@ static void ucg_builtin_destroy(ucg_group_h group)
             UCG_GROUP_TO_COMPONENT_CTX(ucg_builtin_component, group);
 
     unsigned i;
-    for (i = 0; i < UCG_BUILTIN_MAX_CONCURRENT_OPS; i++) {
+    for (i = 0; i <= gctx->slot_mask; i++) {
         if (gctx->slots[i].cb != NULL) {
             ucs_warn("Collective operation #%u has been left incomplete (Group #%u)",
                      gctx->slots[i].coll_id, gctx->group_id);
@@ -410,21 +722,19 @@ static void ucg_builtin_destroy(ucg_group_h group)
         }
     }
 
-    if (group->params.topo_map) {
-        for (i = 0; i < group->params.member_count; i++) {
-            ucg_builtin_free((void **)&group->params.topo_map[i]);
-        }
-        ucg_builtin_free((void **)&group->params.topo_map);
-    }
-
     while (!ucs_list_is_empty(&gctx->plan_head)) {
         ucg_builtin_plan_t *plan = ucs_list_head(&gctx->plan_head,
                                                  ucg_builtin_plan_t, list);
         ucs_status_t status = ucg_builtin_destroy_plan(plan, group);
         if (ucs_unlikely(status != UCS_OK)) {
-            return;
+            break;
         }
     }
+
+    ucg_builtin_shm_cleanup(&gctx->shm);
+    ucg_builtin_rcache_cleanup(&gctx->rcaches);
+    ucg_builtin_scratch_cleanup(&gctx->scratch);
+    ucg_builtin_free((void **)&gctx->slots);
 }
 
 static unsigned ucg_builtin_progress(ucg_group_h group)
@@ -448,7 +758,9 @@ static unsigned ucg_builtin_progress(ucg_group_h group)
         ucg_builtin_request_t *req = ucs_list_extract_head(&temp_head,
                                                            ucg_builtin_request_t, send_list);
         ucs_status_t status = ucg_builtin_step_execute(req, NULL);
-        if (status != UCS_INPROGRESS) {
+        /* polling shared memory raises no event, so the caller must not sleep */
+        if ((status != UCS_INPROGRESS) ||
+            (req->step->flags & UCG_BUILTIN_OP_STEP_FLAG_SHM)) {
             ret++;
         }
     }
@@ -464,7 +776,7 @@ ucs_mpool_ops_t ucg_builtin_plan_mpool_ops = {
 
 void ucg_builtin_plan_decision_in_unsupport_allreduce_case_check_msg_size(const size_t msg_size)
 {
-    if (msg_size < UCG_GROUP_MED_MSG_SIZE) {
+    if (ucg_builtin_allreduce_is_small(msg_size)) {
         /* Node-aware Recursive */
         ucg_builtin_allreduce_algo_switch(UCG_ALGORITHM_ALLREDUCE_NODE_AWARE_RECURSIVE_AND_BMTREE, &ucg_algo);
     } else {
@@ -545,7 +857,7 @@ void ucg_builtin_plan_decision_in_noncommutative_largedata_case_ring(const size_
 
 void ucg_builtin_plan_decision_in_noncommutative_largedata_case(const size_t msg_size, enum ucg_builtin_allreduce_algorithm *allreduce_algo_decision)
 {
-    if (msg_size < UCG_GROUP_MED_MSG_SIZE) {
+    if (ucg_builtin_allreduce_is_small(msg_size)) {
         ucg_builtin_plan_decision_in_noncommutative_largedata_case_recusive(msg_size, allreduce_algo_decision);
     } else {
         ucg_builtin_plan_decision_in_noncommutative_largedata_case_ring(msg_size, allreduce_algo_decision);
@@ -574,10 +886,15 @@ void ucg_builtin_allreduce_decision_fixed(const size_t msg_size,
         *allreduce_algo_decision = UCG_ALGORITHM_ALLREDUCE_NODE_AWARE_RECURSIVE_AND_BMTREE;
         ucg_builtin_allreduce_algo_switch(*allreduce_algo_decision, &ucg_algo);
     } else {
-        if (msg_size < UCG_GROUP_MED_MSG_SIZE) {
+        if (ucg_builtin_allreduce_is_small(msg_size)) {
             /* Node-aware Kinomial tree (DEFAULT) */
             *allreduce_algo_decision = UCG_ALGORITHM_ALLREDUCE_NODE_AWARE_KMTREE;
             ucg_builtin_allreduce_algo_switch(*allreduce_algo_decision, &ucg_algo);
+        } else if (ucg_builtin_msg_size_class(ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE],
+                                              msg_size) == UCG_BUILTIN_MSG_SIZE_MEDIUM) {
+            /* Recursive halving/doubling: fewer steps than Ring, less data than Recursive */
+            *allreduce_algo_decision = UCG_ALGORITHM_ALLREDUCE_RABENSEIFNER;
+            ucg_builtin_allreduce_algo_switch(*allreduce_algo_decision, &ucg_algo);
         } else {
             /* Ring */
             *allreduce_algo_decision = UCG_ALGORITHM_ALLREDUCE_RING;
@@ -644,6 +961,8 @@ ucs_status_t ucg_builtin_init_algo(struct ucg_builtin_algorithm *algo)
     algo->bruck        = 1,
     algo->topo_level   = UCG_GROUP_HIERARCHY_LEVEL_NODE,
     algo->pipeline     = 0;
+    algo->halving      = 0;
+    algo->kary         = 0;
     algo->feature_flag = UCG_ALGORITHM_SUPPORT_COMMON_FEATURE;
     return UCS_OK;
 }
@@ -669,6 +988,15 @@ ucs_status_t ucg_builtin_bcast_algo_switch(const enum ucg_builtin_bcast_algorith
         case UCG_ALGORITHM_BCAST_NODE_AWARE_KMTREE:
             ucg_builtin_fillin_algo(algo, 1, 1, 1, 0, 1, 0);
             break;
+        case UCG_ALGORITHM_BCAST_PIPELINED_BMTREE:
+            ucg_builtin_fillin_algo(algo, 1, 0, 0, 0, 0, 0);
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_RANK_FEATURE;
+            algo->pipeline = 1;
+            break;
+        case UCG_ALGORITHM_BCAST_PIPELINED_NODE_AWARE_KMTREE:
+            ucg_builtin_fillin_algo(algo, 1, 1, 1, 0, 1, 0);
+            algo->pipeline = 1;
+            break;
         default:
             ucg_builtin_bcast_algo_switch(UCG_ALGORITHM_BCAST_NODE_AWARE_KMTREE, algo);
             break;
@@ -767,6 +1095,26 @@ ucs_status_t ucg_builtin_allreduce_algo_switch(const enum ucg_builtin_allreduce_
             ucg_builtin_fillin_algo(algo, 1, 1, 1, 0, 1, 0);
             algo->topo_level = UCG_GROUP_HIERARCHY_LEVEL_SOCKET;
             break;
+        case UCG_ALGORITHM_ALLREDUCE_PIPELINED_RING:
+            ucg_builtin_fillin_algo(algo, 0, 0, 0, 0, 0, 1);
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_RANK_FEATURE;
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_ALLREDUCE_RARE_FEATURE;
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_BIND_TO_NONE;
+            algo->pipeline = 1;
+            break;
+        case UCG_ALGORITHM_ALLREDUCE_NODE_AWARE_RING:
+            ucg_builtin_fillin_algo(algo, 0, 0, 0, 0, 1, 1);
+            algo->topo_level = UCG_GROUP_HIERARCHY_LEVEL_NODE;
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_DISCONTINOUS_RANK;
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_LARGE_DATATYPE;
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_BIND_TO_NONE;
+            break;
+        case UCG_ALGORITHM_ALLREDUCE_RABENSEIFNER:
+            ucg_builtin_fillin_algo(algo, 0, 0, 0, 1, 0, 0);
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_RANK_FEATURE;
+            algo->feature_flag |= UCG_ALGORITHM_SUPPORT_BIND_TO_NONE;
+            algo->halving = 1;
+            break;
         default:
             ucg_builtin_allreduce_algo_switch(UCG_ALGORITHM_ALLREDUCE_NODE_AWARE_KMTREE, algo);
             break;
@@ -774,6 +1122,28 @@ ucs_status_t ucg_builtin_allreduce_algo_switch(const enum ucg_builtin_allreduce_
     return UCS_OK;
 }
 
+ucs_status_t ucg_builtin_reduce_algo_switch(const enum ucg_builtin_reduce_algorithm reduce_algo_decision,
+                                            struct ucg_builtin_algorithm *algo)
+{
+    algo->topo_level = UCG_GROUP_HIERARCHY_LEVEL_NODE;
+    algo->feature_flag |= UCG_ALGORITHM_SUPPORT_BIND_TO_NONE;
+    algo->feature_flag |= UCG_ALGORITHM_SUPPORT_RANK_FEATURE;
+    algo->bruck = 1;
+    switch (reduce_algo_decision) {
+        case UCG_ALGORITHM_REDUCE_BMTREE:
+            ucg_builtin_fillin_algo(algo, 1, 0, 0, 0, 0, 0);
+            break;
+        case UCG_ALGORITHM_REDUCE_PIPELINED_BMTREE:
+            ucg_builtin_fillin_algo(algo, 1, 0, 0, 0, 0, 0);
+            algo->pipeline = 1;
+            break;
+        default:
+            ucg_builtin_reduce_algo_switch(UCG_ALGORITHM_REDUCE_BMTREE, algo);
+            break;
+    }
+    return UCS_OK;
+}
+
 void ucg_builtin_check_algorithm_param_size(ucg_builtin_config_t *config)
 {
     if (((int)config->allreduce_algorithm >= UCG_ALGORITHM_ALLREDUCE_LAST) || ((int)config->allreduce_algorithm < UCG_ALGORITHM_ALLREDUCE_AUTO_DECISION)) {
@@ -785,6 +1155,9 @@ void ucg_builtin_check_algorithm_param_size(ucg_builtin_config_t *config)
     if (((int)config->barrier_algorithm >= UCG_ALGORITHM_BARRIER_LAST) || ((int)config->barrier_algorithm < UCG_ALGORITHM_BARRIER_AUTO_DECISION)) {
         ucs_warn("Param UCX_BUILTIN_BARRIER_ALGORITHM=%d is invalid parameter, switch to default algorithm.", (int)config->barrier_algorithm);
     }
+    if (((int)config->reduce_algorithm >= UCG_ALGORITHM_REDUCE_LAST) || ((int)config->reduce_algorithm < UCG_ALGORITHM_REDUCE_AUTO_DECISION)) {
+        ucs_warn("Param UCX_BUILTIN_REDUCE_ALGORITHM=%d is invalid parameter, switch to default algorithm.", (int)config->reduce_algorithm);
+    }
 }
 
 void ucg_builtin_check_algorithm_param_type(ucg_builtin_config_t *config)
@@ -798,6 +1171,9 @@ void ucg_builtin_check_algorithm_param_type(ucg_builtin_config_t *config)
     if ((config->barrier_algorithm - (int)config->barrier_algorithm) != 0) {
         ucs_warn("Param UCX_BUILTIN_BARRIER_ALGORITHM=%lf is not unsigned integer, switch to unsigned integer '%d'.", config->barrier_algorithm, (int)config->barrier_algorithm);
     }
+    if ((config->reduce_algorithm - (int)config->reduce_algorithm) != 0) {
+        ucs_warn("Param UCX_BUILTIN_REDUCE_ALGORITHM=%lf is not unsigned integer, switch to unsigned integer '%d'.", config->reduce_algorithm, (int)config->reduce_algorithm);
+    }
 }
 
 enum choose_ops_mask ucg_builtin_plan_choose_ops(ucg_plan_component_t *plan_component, enum ucg_collective_modifiers ops_type_choose)
@@ -811,9 +1187,11 @@ enum choose_ops_mask ucg_builtin_plan_choose_ops(ucg_plan_component_t *plan_comp
             config->allreduce_algorithm;
     enum ucg_builtin_barrier_algorithm barrier_algo_decision = (enum ucg_builtin_barrier_algorithm)
             config->barrier_algorithm;
+    enum ucg_builtin_reduce_algorithm reduce_algo_decision = (enum ucg_builtin_reduce_algorithm)
+            config->reduce_algorithm;
     enum choose_ops_mask result = OPS_AUTO_DECISION;
 
-    if (!(bcast_algo_decision | allreduce_algo_decision | barrier_algo_decision)) {
+    if (!(bcast_algo_decision | allreduce_algo_decision | barrier_algo_decision | reduce_algo_decision)) {
         return OPS_AUTO_DECISION;
     }
 
@@ -838,6 +1216,13 @@ enum choose_ops_mask ucg_builtin_plan_choose_ops(ucg_plan_component_t *plan_comp
         result = OPS_BARRIER;
     }
 
+    if (ops_type_choose == ucg_predefined_modifiers[UCG_PRIMITIVE_REDUCE]) {
+        if (reduce_algo_decision >= UCG_ALGORITHM_REDUCE_LAST || reduce_algo_decision <= UCG_ALGORITHM_REDUCE_AUTO_DECISION) {
+            return OPS_AUTO_DECISION;
+        }
+        result = OPS_REDUCE;
+    }
+
     return result;
 }
 
@@ -866,60 +1251,53 @@ void ucg_builtin_check_continuous_number_by_sort(ucg_group_member_index_t *array
     }
 }
 
-static void ucg_builtin_prepare_rank_same_unit(const ucg_group_params_t *group_params,
+static void ucg_builtin_prepare_rank_same_unit(const ucg_topo_t *topo,
                                                enum ucg_group_member_distance domain_distance,
                                                ucg_group_member_index_t *rank_same_unit)
 {
     unsigned idx, member_idx;
     enum ucg_group_member_distance next_distance;
-    for (idx = 0, member_idx = 0; member_idx < group_params->member_count; member_idx++) {
-        next_distance = group_params->distance[member_idx];
+    for (idx = 0, member_idx = 0; member_idx < topo->member_count; member_idx++) {
+        next_distance = ucg_topo_my_distance(topo, member_idx);
         if (ucs_likely(next_distance <= domain_distance)) {
             rank_same_unit[idx++] = member_idx;
         }
     }
 }
 
-ucs_status_t ucg_builtin_check_continuous_number_no_topo_map(const ucg_group_params_t *group_params,
-                                                             enum ucg_group_member_distance domain_distance,
-                                                             unsigned *discont_flag)
+static ucs_status_t ucg_builtin_check_continuous_number_partial(const ucg_topo_t *topo,
+                                                                enum ucg_group_member_distance domain_distance,
+                                                                unsigned *discont_flag)
 {
-    unsigned ppx = ucg_builtin_calculate_ppx(group_params, domain_distance);
+    unsigned ppx = ucg_builtin_calculate_ppx(topo, domain_distance);
 
     /* store rank number in same unit */
     size_t alloc_size = ppx * sizeof(ucg_group_member_index_t);
     ucg_group_member_index_t *rank_same_unit = (ucg_group_member_index_t*)UCS_ALLOC_CHECK(alloc_size, "rank number");
     memset(rank_same_unit, 0, alloc_size);
-    ucg_builtin_prepare_rank_same_unit(group_params, domain_distance, rank_same_unit);
+    ucg_builtin_prepare_rank_same_unit(topo, domain_distance, rank_same_unit);
 
     ucg_builtin_check_continuous_number_by_sort(rank_same_unit, ppx, discont_flag);
     ucg_builtin_free((void **)&rank_same_unit);
     return UCS_OK;
 }
 
-ucs_status_t ucg_builtin_check_continuous_number(const ucg_group_params_t *group_params,
+ucs_status_t ucg_builtin_check_continuous_number(const ucg_topo_t *topo,
                                                  enum ucg_group_member_distance domain_distance,
                                                  unsigned *discont_flag)
 {
-    if (group_params->topo_map == NULL) {
-        return ucg_builtin_check_continuous_number_no_topo_map(group_params, domain_distance, discont_flag);
+    if (!topo->is_complete) {
+        return ucg_builtin_check_continuous_number_partial(topo, domain_distance, discont_flag);
     }
 
-    char domain_distance_ch = (char)domain_distance;
-    /* Check the topo distance in each line and find all ranks in the same node
-       Make sure the ranks in the same node is continuous. */
-    for (unsigned i = 0; i < group_params->member_count; i++) {
-        int last_same_unit_rank = -1;
-        for (unsigned j = 0; j < group_params->member_count; j++) {
-            if (group_params->topo_map[i][j] > domain_distance_ch) {
-                continue;
-            }
-
-            if (last_same_unit_rank != -1 && j - last_same_unit_rank != 1) {
-                *discont_flag = 1;
-                return UCS_OK;
-            }
-            last_same_unit_rank = j;
+    /* Make sure the ranks in every unit are continuous: whenever the unit
+       changes between neighbors, the next rank must be the first of its unit. */
+    ucg_group_member_index_t member_idx;
+    for (member_idx = 1; member_idx < topo->member_count; member_idx++) {
+        if ((ucg_topo_distance(topo, member_idx - 1, member_idx) > domain_distance) &&
+            (ucg_topo_domain_leader(topo, member_idx, domain_distance) != member_idx)) {
+            *discont_flag = 1;
+            return UCS_OK;
         }
     }
     *discont_flag = 0;
@@ -963,6 +1341,7 @@ void ucg_builtin_non_commutative_operation(const ucg_group_params_t *group_param
 */
 ucs_status_t ucg_builtin_change_unsupport_algo(struct ucg_builtin_algorithm *algo,
                                                const ucg_group_params_t *group_params,
+                                               const ucg_topo_t *topo,
                                                const size_t msg_size,
                                                const ucg_collective_params_t *coll_params,
                                                const enum ucg_collective_modifiers ops_type_choose,
@@ -979,7 +1358,7 @@ ucs_status_t ucg_builtin_change_unsupport_algo(struct ucg_builtin_algorithm *alg
 
     /* Special Case 2 : unbalance ppn */
     unsigned is_ppn_unbalance = 0;
-    status = ucg_builtin_check_ppn(group_params, &is_ppn_unbalance);
+    status = ucg_builtin_check_ppn(topo, &is_ppn_unbalance);
     if (status != UCS_OK) {
         return status;
     }
@@ -996,7 +1375,7 @@ ucs_status_t ucg_builtin_change_unsupport_algo(struct ucg_builtin_algorithm *alg
     if (status != UCS_OK) {
         return status;
     }
-    status = ucg_builtin_check_continuous_number(group_params, domain_distance, &is_discontinuous_rank);
+    status = ucg_builtin_check_continuous_number(topo, domain_distance, &is_discontinuous_rank);
     if (status != UCS_OK) {
         return status;
     }
@@ -1023,14 +1402,16 @@ ucs_status_t ucg_builtin_change_unsupport_algo(struct ucg_builtin_algorithm *alg
 
 void ucg_builtin_log_algo()
 {
-    ucs_info("bmtree %u kmtree %u kmtree_intra %u recur %u bruck %u topo %u level %u ring %u pipe %u",
+    ucs_info("bmtree %u kmtree %u kmtree_intra %u recur %u bruck %u topo %u level %u ring %u pipe %u halving %u kary %u",
              ucg_algo.bmtree, ucg_algo.kmtree, ucg_algo.kmtree_intra, ucg_algo.recursive, ucg_algo.bruck,
-             ucg_algo.topo, (unsigned)ucg_algo.topo_level, ucg_algo.ring, ucg_algo.pipeline);
+             ucg_algo.topo, (unsigned)ucg_algo.topo_level, ucg_algo.ring, ucg_algo.pipeline,
+             ucg_algo.halving, ucg_algo.kary);
 }
 
 ucs_status_t ucg_builtin_algorithm_decision(const ucg_collective_type_t *coll_type,
                                             const size_t msg_size,
                                             const ucg_group_params_t *group_params,
+                                            const ucg_topo_t *topo,
                                             const ucg_collective_params_t *coll_params,
                                             ucg_plan_component_t *plan_component)
 {
@@ -1057,7 +1438,7 @@ ucs_status_t ucg_builtin_algorithm_decision(const ucg_collective_type_t *coll_ty
 
     /* unblanced ppn or not */
     unsigned is_ppn_unbalance = 0;
-    status = ucg_builtin_check_ppn(group_params, &is_ppn_unbalance);
+    status = ucg_builtin_check_ppn(topo, &is_ppn_unbalance);
     if (status != UCS_OK) {
         ucs_error("Error in check ppn");
         return status;
@@ -1089,17 +1470,184 @@ ucs_status_t ucg_builtin_algorithm_decision(const ucg_collective_type_t *coll_ty
             allreduce_algo_decision = UCG_ALGORITHM_ALLREDUCE_AUTO_DECISION;
             break;
 
+        case OPS_REDUCE:
+            ucg_builtin_reduce_algo_switch((enum ucg_builtin_reduce_algorithm)config->reduce_algorithm,
+                                           &ucg_algo);
+            bcast_algo_decision = UCG_ALGORITHM_BCAST_AUTO_DECISION;
+            allreduce_algo_decision = UCG_ALGORITHM_ALLREDUCE_AUTO_DECISION;
+            barrier_algo_decision = UCG_ALGORITHM_BARRIER_AUTO_DECISION;
+            break;
+
         default:
             break;
     }
 
     /* One API to deal with all special case */
-    status = ucg_builtin_change_unsupport_algo(&ucg_algo, group_params, msg_size, coll_params, ops_type_choose, ops_choose, config);
+    status = ucg_builtin_change_unsupport_algo(&ucg_algo, group_params, topo, msg_size, coll_params, ops_type_choose, ops_choose, config);
     ucg_builtin_log_algo();
 
     return UCS_OK;
 }
 
+/*
+ * Barriers and tiny allreduce operations are passed through shared memory within
+ * each node, unless an algorithm was requested. All the members must agree on it,
+ * so it only depends on the collective and on the layout of the group.
+ */
+static int ucg_builtin_node_shm_is_selected(ucg_plan_component_t *plan_component,
+                                            const ucg_collective_type_t *coll_type,
+                                            const size_t msg_size,
+                                            const ucg_group_params_t *group_params,
+                                            const ucg_topo_t *topo,
+                                            const ucg_collective_params_t *coll_params)
+{
+    ucg_builtin_config_t *config = (ucg_builtin_config_t*)plan_component->plan_config;
+    enum ucg_collective_modifiers modifiers = coll_type->modifiers;
+    ucg_group_member_index_t idx, leader_cnt;
+
+    if (!config->shm_coll ||
+        (ucg_builtin_plan_choose_ops(plan_component, modifiers) != OPS_AUTO_DECISION)) {
+        return 0;
+    }
+
+    if (modifiers == ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE]) {
+        if ((msg_size > UCG_BUILTIN_SHM_MAX_DATA) || (coll_params->send.op_ext &&
+            !group_params->op_is_commute_f(coll_params->send.op_ext))) {
+            return 0;
+        }
+    } else if (modifiers != ucg_predefined_modifiers[UCG_PRIMITIVE_BARRIER]) {
+        return 0;
+    }
+
+    /* worthwhile only if some node has several members */
+    leader_cnt = 0;
+    for (idx = 0; idx < topo->member_count; idx++) {
+        leader_cnt += (topo->members[idx].host_id == idx);
+    }
+    return leader_cnt < topo->member_count;
+}
+
+static int ucg_builtin_topo_is_single_host(const ucg_topo_t *topo)
+{
+    ucg_group_member_index_t idx;
+    for (idx = 1; idx < topo->member_count; idx++) {
+        if (topo->members[idx].host_id != topo->members[0].host_id) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Large allreduce operations are better off with a ring per slice of the vector
+ * between the nodes (see @ref ucg_builtin_node_ring_create), than with a ring of
+ * the whole group - so it replaces the latter if enabled (BUILTIN_NODE_RING) and
+ * no other algorithm was requested. It takes commutative operations and the same
+ * number of members on every node. All the members must agree on it, so it only
+ * depends on the collective, the group and the configuration - not on whether
+ * this process may read the memory of the others, which the configuration has to
+ * guarantee (and is checked once it's chosen).
+ */
+static enum ucg_builtin_plan_topology_type
+ucg_builtin_node_ring_choose_type(ucg_plan_component_t *plan_component,
+                                  enum ucg_builtin_plan_topology_type plan_topo_type,
+                                  const ucg_collective_type_t *coll_type,
+                                  const size_t msg_size,
+                                  const ucg_group_params_t *group_params,
+                                  const ucg_topo_t *topo,
+                                  const ucg_collective_params_t *coll_params)
+{
+    ucg_builtin_config_t *config = (ucg_builtin_config_t*)plan_component->plan_config;
+    enum ucg_collective_modifiers modifiers = coll_type->modifiers;
+    ucg_group_member_index_t idx, local_cnt;
+    unsigned is_ppn_unbalance = 0;
+
+    if (modifiers != ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE]) {
+        return (plan_topo_type == UCG_PLAN_NODE_RING) ? UCG_PLAN_RING : plan_topo_type;
+    }
+
+    /* unless requested, only large messages on several members per node are worth it */
+    local_cnt = 0;
+    for (idx = 0; idx < topo->member_count; idx++) {
+        local_cnt += (topo->members[idx].host_id == topo->members[topo->my_index].host_id);
+    }
+
+    if ((plan_topo_type != UCG_PLAN_NODE_RING) &&
+        (!config->node_ring || (local_cnt < 2) ||
+         (ucg_builtin_plan_choose_ops(plan_component, modifiers) != OPS_AUTO_DECISION) ||
+         (ucg_builtin_msg_size_class(modifiers, msg_size) < UCG_BUILTIN_MSG_SIZE_LARGE) ||
+         (coll_params->send.dt_len > config->large_datatype_threshold))) {
+        return plan_topo_type;
+    }
+
+    if ((coll_params->send.op_ext && !group_params->op_is_commute_f(coll_params->send.op_ext)) ||
+        (ucg_builtin_check_ppn(topo, &is_ppn_unbalance) != UCS_OK) ||
+        is_ppn_unbalance) {
+        if (plan_topo_type == UCG_PLAN_NODE_RING) {
+            ucs_debug("node-aware ring is not supported by this group, select Ring.");
+        }
+        return UCG_PLAN_RING;
+    }
+
+    return UCG_PLAN_NODE_RING;
+}
+
+/*
+ * Recursive halving reduces every block in a different order, so it does not
+ * take non-commutative operations - plain recursive doubling does instead.
+ */
+static enum ucg_builtin_plan_topology_type
+ucg_builtin_recursive_halving_choose_type(const ucg_collective_type_t *coll_type,
+                                          const ucg_group_params_t *group_params,
+                                          const ucg_collective_params_t *coll_params)
+{
+    if ((coll_type->modifiers != ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE]) ||
+        (coll_params->send.op_ext && !group_params->op_is_commute_f(coll_params->send.op_ext))) {
+        ucs_debug("recursive halving is not supported by this collective, select Recursive.");
+        return UCG_PLAN_RECURSIVE;
+    }
+
+    return UCG_PLAN_RECURSIVE_HALVING;
+}
+
+/*
+ * Recursive k-ing (a factor above 2) folds the data of the members in a different
+ * order, so it only takes barriers and small allreduce of commutative operations -
+ * larger messages gain nothing from sending k-1 of them at once.
+ */
+static unsigned ucg_builtin_recursive_is_kary(const ucg_collective_type_t *coll_type,
+                                              const size_t msg_size,
+                                              const ucg_group_params_t *group_params,
+                                              const ucg_collective_params_t *coll_params)
+{
+    if (coll_type->modifiers == ucg_predefined_modifiers[UCG_PRIMITIVE_BARRIER]) {
+        return 1;
+    }
+
+    return (coll_type->modifiers == ucg_predefined_modifiers[UCG_PRIMITIVE_ALLREDUCE]) &&
+           ucg_builtin_allreduce_is_small(msg_size) &&
+           !(coll_params->send.op_ext && !group_params->op_is_commute_f(coll_params->send.op_ext));
+}
+
+/* Pipelined plans use the same segments on every phase, so each waypoint can pass them on */
+static void ucg_builtin_plan_set_segment(ucg_builtin_plan_t *plan, size_t segment_length)
+{
+    unsigned phs_idx;
+    for (phs_idx = 0; phs_idx < plan->phs_cnt; phs_idx++) {
+        plan->phss[phs_idx].segment_length = segment_length;
+    }
+}
+
+/* Drop the endpoint references taken for a plan which failed to be created */
+static void ucg_builtin_connect_release(ucg_group_h group, ucp_ep_h *connect_eps,
+                                        unsigned connect_cnt)
+{
+    unsigned idx;
+    for (idx = 0; idx < connect_cnt; idx++) {
+        ucg_plan_disconnect(group, connect_eps[idx]);
+    }
+}
+
 static ucs_status_t ucg_builtin_plan(ucg_plan_component_t *plan_component,
                                      const ucg_collective_type_t *coll_type,
                                      const size_t msg_size,
@@ -1114,13 +1662,45 @@ static ucs_status_t ucg_builtin_plan(ucg_plan_component_t *plan_component,
 
     status = ucg_builtin_init_algo(&ucg_algo);
 
-    status = ucg_builtin_algorithm_decision(coll_type, msg_size, builtin_ctx->group_params, coll_params, plan_component);
+    status = ucg_builtin_algorithm_decision(coll_type, msg_size, builtin_ctx->group_params,
+                                            builtin_ctx->topo, coll_params, plan_component);
 
     if (status != UCS_OK) {
         return status;
     }
 
+    /*
+     * Once the shared-memory segment failed, the group does without it - but
+     * only if it's all on this node: other nodes would keep using their own
+     * segments (and the plans built around them), so the plans fail instead.
+     */
+    int is_shm_usable = (builtin_ctx->shm.status == UCS_OK) ||
+                        !ucg_builtin_topo_is_single_host(builtin_ctx->topo);
+
     enum ucg_builtin_plan_topology_type plan_topo_type = ucg_builtin_choose_type(coll_type->modifiers);
+    if (is_shm_usable &&
+        ucg_builtin_node_shm_is_selected(plan_component, coll_type, msg_size,
+                                         builtin_ctx->group_params, builtin_ctx->topo,
+                                         coll_params)) {
+        plan_topo_type = UCG_PLAN_NODE_SHM;
+    } else if ((plan_topo_type == UCG_PLAN_RING) || (plan_topo_type == UCG_PLAN_NODE_RING)) {
+        plan_topo_type = ucg_builtin_node_ring_choose_type(plan_component, plan_topo_type,
+                                                           coll_type, msg_size,
+                                                           builtin_ctx->group_params,
+                                                           builtin_ctx->topo, coll_params);
+        if ((plan_topo_type == UCG_PLAN_NODE_RING) && !is_shm_usable) {
+            plan_topo_type = UCG_PLAN_RING;
+        }
+    } else if (plan_topo_type == UCG_PLAN_RECURSIVE_HALVING) {
+        plan_topo_type = ucg_builtin_recursive_halving_choose_type(coll_type,
+                                                                   builtin_ctx->group_params,
+                                                                   coll_params);
+    }
+
+    if (plan_topo_type == UCG_PLAN_RECURSIVE) {
+        ucg_algo.kary = ucg_builtin_recursive_is_kary(coll_type, msg_size,
+                                                      builtin_ctx->group_params, coll_params);
+    }
 
     ucs_debug("plan topo type: %d", plan_topo_type);
 
@@ -1131,34 +1711,97 @@ static ucs_status_t ucg_builtin_plan(ucg_plan_component_t *plan_component,
                                                   builtin_ctx->group_params, coll_type, &plan);
             break;
 
+        case UCG_PLAN_RECURSIVE_HALVING:
+            status = ucg_builtin_recursive_halving_create(builtin_ctx, plan_topo_type,
+                                                          plan_component->plan_config,
+                                                          builtin_ctx->group_params, coll_type, &plan);
+            break;
+
         case UCG_PLAN_RING:
             status = ucg_builtin_ring_create(builtin_ctx, plan_topo_type, plan_component->plan_config,
                                              builtin_ctx->group_params, coll_type, &plan);
             break;
 
+        case UCG_PLAN_NODE_SHM:
+            status = ucg_builtin_shm_connect(&builtin_ctx->shm, builtin_ctx->group_params,
+                                             builtin_ctx->topo);
+            if (status == UCS_OK) {
+                status = ucg_builtin_node_shm_create(builtin_ctx, plan_topo_type,
+                                                     plan_component->plan_config,
+                                                     builtin_ctx->group_params, coll_type, &plan);
+            }
+            break;
+
+        case UCG_PLAN_NODE_RING:
+            if (!ucg_builtin_cma_is_supported()) {
+                ucs_error("the node-aware ring reads the memory of the other processes on "
+                          "the node, which is not permitted - set UCX_BUILTIN_CMA_PTRACER_ANY=y, "
+                          "or select another allreduce algorithm");
+                status = UCS_ERR_UNSUPPORTED;
+                break;
+            }
+
+            status = ucg_builtin_shm_connect(&builtin_ctx->shm, builtin_ctx->group_params,
+                                             builtin_ctx->topo);
+            if (status == UCS_OK) {
+                status = ucg_builtin_node_ring_create(builtin_ctx, plan_topo_type,
+                                                      plan_component->plan_config,
+                                                      builtin_ctx->group_params, coll_type, &plan);
+            }
+            break;
+
         default:
             status = ucg_builtin_binomial_tree_create(builtin_ctx, plan_topo_type, plan_component->plan_config,
                                                       builtin_ctx->group_params, coll_type, &plan);
             break;
     }
 
+    /* the endpoints are wired up together, by the time the plan is first used */
+    ucg_builtin_plan_connect_t *connect = builtin_ctx->connect;
+    ucp_ep_h *connect_eps               = builtin_ctx->connect_eps;
+    unsigned connect_cnt                = builtin_ctx->connect_cnt;
+    builtin_ctx->connect                = NULL;
+    builtin_ctx->connect_eps            = NULL;
+    builtin_ctx->connect_cnt            = 0;
+    builtin_ctx->connect_max            = 0;
+
     if (status != UCS_OK) {
+        ucg_builtin_connect_release(group, connect_eps, connect_cnt);
+        ucg_builtin_free((void **)&connect);
+        ucg_builtin_free((void **)&connect_eps);
         ucg_builtin_free((void **)&plan);
         return status;
     }
 
+    plan->connect     = connect;
+    plan->connect_eps = connect_eps;
+    plan->connect_cnt = connect_cnt;
+    if (connect_cnt == 0) {
+        ucg_builtin_plan_clone_phases(plan);
+    }
+
+    if (ucg_algo.pipeline) {
+        ucg_builtin_plan_set_segment(plan, ((ucg_builtin_config_t*)
+                                     plan_component->plan_config)->pipeline_segment);
+    }
+
     /* Create a memory-pool for operations for this plan */
     size_t op_size = sizeof(ucg_builtin_op_t) + plan->phs_cnt * sizeof(ucg_builtin_op_step_t);
     status = ucs_mpool_init(&plan->op_mp, 0, op_size, 0, UCS_SYS_CACHE_LINE_SIZE,
                             1, UINT_MAX, &ucg_builtin_plan_mpool_ops, "ucg_builtin_plan_mp");
     if (status != UCS_OK) {
+        ucg_builtin_connect_release(group, plan->connect_eps, plan->connect_cnt);
+        ucg_builtin_clean_phases(plan);
         ucg_builtin_free((void **)&plan);
         return status;
     }
 
     ucs_list_add_head(&builtin_ctx->plan_head, &plan->list);
     plan->resend    = &builtin_ctx->send_head;
+    plan->scratch   = &builtin_ctx->scratch;
+    plan->shm       = &builtin_ctx->shm;
     plan->slots     = &builtin_ctx->slots[0];
+    plan->slot_mask = builtin_ctx->slot_mask;
     plan->am_id     = builtin_ctx->am_id;
     *plan_p         = (ucg_plan_t*)plan;
     return UCS_OK;
@@ -1208,11 +1851,47 @@ void  ucg_builtin_set_phase_thresh_max_bcopy_zcopy(ucg_builtin_group_ctx_t *ctx,
     }
 }
 
+/*
+ * Both ends of an edge have to agree on the rendezvous threshold, but a phase
+ * may have peers on other nodes which its own peers know nothing of - so the
+ * threshold only depends on the configuration, and on whether the group is on
+ * a single node (then CMA takes the place of RDMA read). Each receiver reads
+ * using CMA if its sender is on the same node (see @ref ucg_builtin_comp_rndv_cb),
+ * and RDMA otherwise.
+ */
+void  ucg_builtin_set_phase_thresh_rndv(ucg_builtin_group_ctx_t *ctx,
+                                       ucg_builtin_plan_phase_t *phase)
+{
+    /* Only the phases of a broadcast tree know how to read (and acknowledge) */
+    int is_bcast_method = (phase->method == UCG_PLAN_METHOD_SEND_TERMINAL) ||
+                          (phase->method == UCG_PLAN_METHOD_RECV_TERMINAL) ||
+                          (phase->method == UCG_PLAN_METHOD_BCAST_WAYPOINT);
+    int is_cma          = is_bcast_method &&
+                          (ctx->config->cma_thresh != UCS_CONFIG_MEMUNITS_INF) &&
+                          ucg_builtin_cma_is_supported();
+    const ucg_topo_t *topo = ctx->topo;
+
+    /* All the peers on this node - nothing to register */
+    phase->rndv_cma     = is_cma && !phase->has_remote_peer;
+    phase->rndv_host_id = is_cma ? topo->members[topo->my_index].host_id :
+                                   UCG_BUILTIN_RNDV_NO_CMA;
+
+    if (!is_bcast_method) {
+        phase->rndv_thresh = UCS_CONFIG_MEMUNITS_INF;
+    } else if (is_cma && ucg_builtin_topo_is_single_host(topo)) {
+        phase->rndv_thresh = ctx->config->cma_thresh;
+    } else {
+        /* see @ref ucg_builtin_connect_check_rndv */
+        phase->rndv_thresh = ctx->config->rndv_thresh;
+    }
+}
+
 void  ucg_builtin_set_phase_thresholds(ucg_builtin_group_ctx_t *ctx,
                                        ucg_builtin_plan_phase_t *phase)
 {
     ucg_builtin_set_phase_thresh_max_short(ctx, phase);
     ucg_builtin_set_phase_thresh_max_bcopy_zcopy(ctx, phase);
+    ucg_builtin_set_phase_thresh_rndv(ctx, phase);
 
     phase->send_thresh.md_attr_cap_max_reg = phase->md_attr->cap.max_reg;
     phase->send_thresh.initialized = 1;
@@ -1234,33 +1913,287 @@ void ucg_builtin_log_phase_info(ucg_builtin_plan_phase_t *phase, ucg_group_membe
                phase, idx, phase->send_thresh.max_short_one, phase->send_thresh.max_short_max, phase->send_thresh.max_bcopy_one, phase->send_thresh.max_bcopy_max, phase->send_thresh.max_zcopy_one, phase->md_attr->cap.max_reg);
 }
 
-ucs_status_t ucg_builtin_connect(ucg_builtin_group_ctx_t *ctx,
-                                 ucg_group_member_index_t idx, ucg_builtin_plan_phase_t *phase,
-                                 unsigned phase_ep_index)
+static ucs_status_t ucg_builtin_connect_add(ucg_builtin_group_ctx_t *ctx,
+                                            const ucg_builtin_plan_connect_t *connect,
+                                            ucp_ep_h ucp_ep)
+{
+    if (ctx->connect_cnt == ctx->connect_max) {
+        /* both arrays are replaced together, or not at all */
+        unsigned max = ucs_max(2 * ctx->connect_max, UCG_BUILTIN_CONNECT_MIN);
+        ucg_builtin_plan_connect_t *new_connect =
+                ucs_malloc(max * sizeof(*new_connect), "builtin_connect");
+        ucp_ep_h *new_eps = ucs_malloc(max * sizeof(*new_eps), "builtin_connect_eps");
+        if ((new_connect == NULL) || (new_eps == NULL)) {
+            ucs_free(new_connect);
+            ucs_free(new_eps);
+            return UCS_ERR_NO_MEMORY;
+        }
+
+        if (ctx->connect_cnt > 0) {
+            memcpy(new_connect, ctx->connect, ctx->connect_cnt * sizeof(*new_connect));
+            memcpy(new_eps, ctx->connect_eps, ctx->connect_cnt * sizeof(*new_eps));
+        }
+        ucs_free(ctx->connect);
+        ucs_free(ctx->connect_eps);
+        ctx->connect     = new_connect;
+        ctx->connect_eps = new_eps;
+        ctx->connect_max = max;
+    }
+
+    ctx->connect[ctx->connect_cnt]     = *connect;
+    ctx->connect_eps[ctx->connect_cnt] = ucp_ep;
+    ctx->connect_cnt++;
+    return UCS_OK;
+}
+
+ucs_status_t ucg_builtin_connect_cb(ucg_builtin_group_ctx_t *ctx,
+                                    ucg_group_member_index_t idx, ucg_builtin_plan_phase_t *phase,
+                                    unsigned phase_ep_index, ucg_builtin_connect_cb_t connected_cb)
 {
-    uct_ep_h ep;
     ucp_ep_h ucp_ep;
-    ucs_status_t status = ucg_plan_connect(ctx->group, idx, &ep,
-                                           &phase->ep_attr, &phase->md, &phase->md_attr, &ucp_ep);
+    ucs_status_t status = ucg_plan_connect_nb(ctx->group, idx, &ucp_ep);
     if (ucs_unlikely(status != UCS_OK)) {
         return status;
     }
-    if (phase->ucp_eps == NULL) {
-        phase->ucp_eps = UCS_ALLOC_CHECK(sizeof(ucp_ep_h) * phase->ep_cnt, "ucp_eps");
+    /* some phases (e.g. ring) have one more endpoint than ep_cnt */
+    unsigned ucp_ep_index = (phase_ep_index == UCG_BUILTIN_CONNECT_SINGLE_EP) ? 0 : phase_ep_index;
+    if (ucp_ep_index >= phase->ucp_ep_cnt) {
+        uint32_t ucp_ep_cnt = ucs_max(phase->ep_cnt, ucp_ep_index + 1);
+        ucp_ep_h *ucp_eps   = ucs_realloc(phase->ucp_eps, sizeof(ucp_ep_h) * ucp_ep_cnt, "ucp_eps");
+        if (ucp_eps == NULL) {
+            ucg_plan_disconnect(ctx->group, ucp_ep);
+            return UCS_ERR_NO_MEMORY;
+        }
+        memset(ucp_eps + phase->ucp_ep_cnt, 0,
+               sizeof(ucp_ep_h) * (ucp_ep_cnt - phase->ucp_ep_cnt));
+        phase->ucp_eps    = ucp_eps;
+        phase->ucp_ep_cnt = ucp_ep_cnt;
     }
-    phase->ucp_eps[(phase_ep_index == UCG_BUILTIN_CONNECT_SINGLE_EP) ? 0 : phase_ep_index] = ucp_ep;
+    phase->ucp_eps[ucp_ep_index] = ucp_ep;
 
 #if ENABLE_DEBUG_DATA
     phase->indexes[(phase_ep_index != UCG_BUILTIN_CONNECT_SINGLE_EP) ?
             phase_ep_index : 0] = idx;
 #endif
+
+    ucg_builtin_plan_connect_t connect = {
+        .phase          = phase,
+        .phase_ep_index = phase_ep_index,
+        .index          = idx,
+        .connected_cb   = connected_cb
+    };
+    status = ucg_builtin_connect_add(ctx, &connect, ucp_ep);
+    if (ucs_unlikely(status != UCS_OK)) {
+        /* the wireup list is what releases the endpoint if planning fails */
+        phase->ucp_eps[ucp_ep_index] = NULL;
+        ucg_plan_disconnect(ctx->group, ucp_ep);
+    }
+    return status;
+}
+
+const ucg_topo_t *ucg_builtin_group_topo(const ucg_builtin_group_ctx_t *ctx)
+{
+    return ctx->topo;
+}
+
+ucs_status_t ucg_builtin_connect(ucg_builtin_group_ctx_t *ctx,
+                                 ucg_group_member_index_t idx, ucg_builtin_plan_phase_t *phase,
+                                 unsigned phase_ep_index)
+{
+    return ucg_builtin_connect_cb(ctx, idx, phase, phase_ep_index, NULL);
+}
+
+/* A lane may only serve as a rail if it takes every fragment the first one does */
+static int ucg_builtin_rail_is_compatible(const ucg_plan_lane_t *lane,
+                                          const ucg_plan_lane_t *first)
+{
+    uint64_t am_flags = UCT_IFACE_FLAG_AM_BCOPY | UCT_IFACE_FLAG_AM_ZCOPY;
+
+    return ((lane->ep_attr->cap.flags & first->ep_attr->cap.flags & am_flags) ==
+            (first->ep_attr->cap.flags & am_flags)) &&
+           (lane->ep_attr->cap.am.max_bcopy >= first->ep_attr->cap.am.max_bcopy) &&
+           (lane->ep_attr->cap.am.max_zcopy >= first->ep_attr->cap.am.max_zcopy) &&
+           (lane->ep_attr->cap.am.max_hdr   >= first->ep_attr->cap.am.max_hdr) &&
+           (lane->md_attr->cap.max_reg      >= first->md_attr->cap.max_reg);
+}
+
+/* Which rail each fragment goes on - smooth weighted round-robin */
+static void ucg_builtin_set_phase_rail_map(ucg_builtin_group_ctx_t *ctx,
+                                           ucg_builtin_plan_phase_t *phase)
+{
+    double weight[UCG_BUILTIN_MAX_RAILS];
+    double credit[UCG_BUILTIN_MAX_RAILS] = {0};
+    const uct_iface_attr_t *attr;
+    double total = 0;
+    unsigned rail, slot, next;
+
+    for (rail = 0; rail < phase->rail_cnt; rail++) {
+        attr         = (rail == 0) ? phase->ep_attr : phase->rails[rail - 1].ep_attr;
+        weight[rail] = ctx->config->rail_bw_weighted ?
+                       attr->bandwidth.dedicated + attr->bandwidth.shared : 1.0;
+        total       += weight[rail];
+    }
+
+    for (slot = 0; slot < UCG_BUILTIN_RAIL_MAP_LEN; slot++) {
+        next = 0;
+        for (rail = 0; rail < phase->rail_cnt; rail++) {
+            credit[rail] += weight[rail];
+            if (credit[rail] > credit[next]) {
+                next = rail;
+            }
+        }
+
+        credit[next]        -= total;
+        phase->rail_map[slot] = next;
+    }
+}
+
+/*
+ * Multi-rail: look for other lanes to the same peer, to stripe fragments
+ * across. All the peers of a phase are reached on the same rails, so the phase
+ * only has as many as its "poorest" peer (and no more than configured).
+ */
+static ucs_status_t ucg_builtin_connect_rails(ucg_builtin_group_ctx_t *ctx,
+                                              ucg_builtin_plan_phase_t *phase,
+                                              unsigned phase_ep_index, ucp_ep_h ucp_ep)
+{
+    unsigned max_rails = ucs_min(ctx->config->max_rails, UCG_BUILTIN_MAX_RAILS);
+    unsigned ep_index  = (phase_ep_index == UCG_BUILTIN_CONNECT_SINGLE_EP) ?
+                         0 : phase_ep_index;
+    ucg_plan_lane_t lanes[UCG_BUILTIN_MAX_RAILS];
+    ucg_builtin_plan_rail_t *rail_info;
+    unsigned lane_cnt, rail;
+    ucs_status_t status;
+
+    if (max_rails <= 1) {
+        phase->rail_cnt = 1;
+        return UCS_OK;
+    }
+
+    status = ucg_plan_connect_lanes(ctx->group, ucp_ep, lanes, max_rails, &lane_cnt);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    for (rail = 1; rail < lane_cnt; rail++) {
+        if (!ucg_builtin_rail_is_compatible(&lanes[rail], &lanes[0])) {
+            break;
+        }
+    }
+    lane_cnt = rail;
+
+    if (phase->rail_cnt == 0) {
+        /* the first peer of the phase to be connected */
+        for (rail = 1; rail < lane_cnt; rail++) {
+            rail_info          = &phase->rails[rail - 1];
+            rail_info->md      = lanes[rail].md;
+            rail_info->md_attr = lanes[rail].md_attr;
+            rail_info->ep_attr = lanes[rail].ep_attr;
+            rail_info->rcache  = ctx->config->mem_reg_cache ?
+                                 ucg_builtin_rcache_get(&ctx->rcaches, lanes[rail].md,
+                                                        lanes[rail].md_attr) : NULL;
+        }
+        phase->rail_cnt = lane_cnt;
+    } else {
+        for (rail = 1; (rail < phase->rail_cnt) && (rail < lane_cnt); rail++) {
+            if ((lanes[rail].md      != phase->rails[rail - 1].md) ||
+                (lanes[rail].ep_attr != phase->rails[rail - 1].ep_attr)) {
+                break;
+            }
+        }
+        phase->rail_cnt = rail;
+    }
+
+    if (phase->rail_cnt > 1) {
+        if (phase->rail_eps == NULL) {
+            phase->rail_eps = ucs_calloc(phase->ucp_ep_cnt * (UCG_BUILTIN_MAX_RAILS - 1),
+                                         sizeof(uct_ep_h), "builtin_rail_eps");
+            if (phase->rail_eps == NULL) {
+                return UCS_ERR_NO_MEMORY;
+            }
+        }
+
+        ucs_assert(ep_index < phase->ucp_ep_cnt);
+        for (rail = 1; rail < phase->rail_cnt; rail++) {
+            phase->rail_eps[ep_index * (UCG_BUILTIN_MAX_RAILS - 1) + rail - 1] =
+                    lanes[rail].ep;
+        }
+    }
+
+    ucg_builtin_set_phase_rail_map(ctx, phase);
+    return UCS_OK;
+}
+
+/*
+ * A receiver expects to read the data of a step from the length it sets for
+ * the phase on, so the threshold of RDMA read only depends on the configuration
+ * - and every endpoint of such a phase has to support it, or fail to connect,
+ * rather than sending the data to a peer which does not expect it. The peers
+ * on the same node read using CMA instead, if it is supported.
+ */
+static ucs_status_t ucg_builtin_connect_check_rndv(ucg_builtin_group_ctx_t *ctx,
+                                                   ucg_builtin_plan_phase_t *phase,
+                                                   uct_component_h prev_component,
+                                                   ucg_group_member_index_t index)
+{
+    if (phase->rndv_thresh == UCS_CONFIG_MEMUNITS_INF) {
+        return UCS_OK;
+    }
+
+    if ((phase->rndv_host_id != UCG_BUILTIN_RNDV_NO_CMA) &&
+        (ucg_topo_my_distance(ctx->topo, index) <= UCG_GROUP_MEMBER_DISTANCE_HOST)) {
+        if (sizeof(ucg_builtin_rndv_header_t) <= phase->send_thresh.max_bcopy_one) {
+            return UCS_OK;
+        }
+    } else if ((phase->ep_attr->cap.flags & UCT_IFACE_FLAG_GET_ZCOPY) &&
+               (phase->md_attr->cap.flags & UCT_MD_FLAG_REG) &&
+               (phase->md_attr->cap.flags & UCT_MD_FLAG_NEED_RKEY) &&
+               (sizeof(ucg_builtin_rndv_header_t) + phase->md_attr->rkey_packed_size <=
+                phase->send_thresh.max_bcopy_one) &&
+               /* the remote keys of all the peers are unpacked with one component */
+               ((prev_component == NULL) || (prev_component == phase->component))) {
+        return UCS_OK;
+    }
+
+    ucs_error("rendezvous is enabled, but the transport to member #%" PRIu64 " does not "
+              "support reading its buffer", index);
+    return UCS_ERR_UNSUPPORTED;
+}
+
+static ucs_status_t ucg_builtin_connect_finish(ucg_builtin_group_ctx_t *ctx,
+                                               const ucg_builtin_plan_connect_t *connect,
+                                               ucp_ep_h ucp_ep)
+{
+    uct_ep_h ep;
+    uct_component_h prev_component;
+    ucg_builtin_plan_phase_t *phase = connect->phase;
+    unsigned phase_ep_index         = connect->phase_ep_index;
+    ucs_status_t status = ucg_plan_connect_finish(ctx->group, ucp_ep, &ep,
+                                                  &phase->ep_attr, &phase->md,
+                                                  &phase->md_attr);
+    if (ucs_unlikely(status != UCS_OK)) {
+        return status;
+    }
+
+    /* known once the last endpoint of the phase is connected (thresholds are set then) */
+    if (ucg_topo_my_distance(ctx->topo, connect->index) > UCG_GROUP_MEMBER_DISTANCE_HOST) {
+        phase->has_remote_peer = 1;
+    }
+
     if (!ep) {
         phase->send_thresh.max_short_one = UCS_CONFIG_MEMUNITS_INF;
         phase->md = NULL;
         phase->md_attr = NULL;
-        return UCS_OK;
+        phase->rcache = NULL;
+        goto out;
     }
 
+    prev_component   = phase->component;
+    phase->component = ucg_plan_connect_component(ucp_ep);
+    phase->rcache    = ctx->config->mem_reg_cache ?
+                       ucg_builtin_rcache_get(&ctx->rcaches, phase->md,
+                                              phase->md_attr) : NULL;
+
     if (phase_ep_index == UCG_BUILTIN_CONNECT_SINGLE_EP) {
         phase->single_ep = ep;
     } else {
@@ -1277,10 +2210,111 @@ ucs_status_t ucg_builtin_connect(ucg_builtin_group_ctx_t *ctx,
         phase->multi_eps[phase_ep_index] = ep;
     }
 
+    status = ucg_builtin_connect_rails(ctx, phase, phase_ep_index, ucp_ep);
+    if (ucs_unlikely(status != UCS_OK)) {
+        return status;
+    }
+
     /* Set the thresholds */
     ucg_builtin_set_phase_thresholds(ctx, phase);
-    ucg_builtin_log_phase_info(phase, idx);
+    ucg_builtin_log_phase_info(phase, connect->index);
+
+    status = ucg_builtin_connect_check_rndv(ctx, phase, prev_component, connect->index);
+    if (ucs_unlikely(status != UCS_OK)) {
+        return status;
+    }
+
+out:
+    if (connect->connected_cb != NULL) {
+        connect->connected_cb(phase);
+    }
+    return UCS_OK;
+}
 
+static ucs_status_t ucg_builtin_connect_progress(ucg_builtin_group_ctx_t *ctx,
+                                                 const ucg_builtin_plan_connect_t *connect,
+                                                 ucp_ep_h *connect_eps,
+                                                 unsigned connect_cnt)
+{
+    unsigned idx;
+    ucs_status_t status = ucg_plan_connect_all_nb(ctx->group, connect_eps, connect_cnt);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* in the order of connection, since later endpoints may override earlier ones */
+    for (idx = 0; idx < connect_cnt; idx++) {
+        status = ucg_builtin_connect_finish(ctx, &connect[idx], connect_eps[idx]);
+        if (status != UCS_OK) {
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
+void ucg_builtin_plan_clone_phase(ucg_builtin_plan_phase_t *phase,
+                                  ucg_builtin_plan_phase_t *original)
+{
+    ucs_assert(original->clone_of == NULL);
+    phase->clone_of = original;
+}
+
+/* Fill in the phases which share the endpoints of another, now connected */
+static void ucg_builtin_plan_clone_phases(ucg_builtin_plan_t *plan)
+{
+    ucg_builtin_plan_phase_t *phase, *original;
+    enum ucg_builtin_plan_method_type method;
+    ucg_step_idx_ext_t step_index;
+    unsigned phs_idx;
+
+    for (phs_idx = 0; phs_idx < plan->phs_cnt; phs_idx++) {
+        phase    = &plan->phss[phs_idx];
+        original = phase->clone_of;
+        if (original == NULL) {
+            continue;
+        }
+
+        method            = phase->method;
+        step_index        = phase->step_index;
+        *phase            = *original;
+        phase->method     = method;
+        phase->step_index = step_index;
+        phase->clone_of   = original;
+
+        /* the endpoints are released through the original phase */
+        phase->ucp_eps    = NULL;
+        phase->ucp_ep_cnt = 0;
+    }
+}
+
+ucs_status_t ucg_builtin_plan_connect_progress(ucg_builtin_plan_t *plan)
+{
+    if (ucs_likely(plan->connect_cnt == 0)) {
+        return UCS_OK;
+    }
+
+    ucs_status_t status = ucg_builtin_connect_progress(
+            UCG_GROUP_TO_COMPONENT_CTX(ucg_builtin_component, plan->super.group),
+            plan->connect, plan->connect_eps, plan->connect_cnt);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    ucg_builtin_plan_clone_phases(plan);
+
+    ucg_builtin_free((void **)&plan->connect);
+    ucg_builtin_free((void **)&plan->connect_eps);
+    plan->connect_cnt = 0;
+    return UCS_OK;
+}
+
+ucs_status_t ucg_builtin_plan_connect_wait(ucg_builtin_plan_t *plan)
+{
+    ucs_status_t status;
+    do {
+        status = ucg_builtin_plan_connect_progress(plan);
+    } while (status == UCS_INPROGRESS);
     return status;
 }
 
@@ -1288,6 +2322,7 @@ UCG_PLAN_COMPONENT_DEFINE(ucg_builtin_component, "builtin",
                           sizeof(ucg_builtin_group_ctx_t), ucg_builtin_query,
                           ucg_builtin_create, ucg_builtin_destroy,
                           ucg_builtin_progress, ucg_builtin_plan,
-                          ucg_builtin_op_create, ucg_builtin_op_trigger,
-                          ucg_builtin_op_discard, ucg_builtin_print, "BUILTIN_",
+                          ucg_builtin_plan_destroy, ucg_builtin_op_create,
+                          ucg_builtin_op_trigger, ucg_builtin_op_discard, ucg_builtin_op_rebind,
+                          ucg_builtin_print, "BUILTIN_",
                           ucg_builtin_config_table, ucg_builtin_config_t);
\ No newline at end of file
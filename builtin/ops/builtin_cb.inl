@@ -16,29 +16,54 @@
  * handled otherwise (using intermediate buffers).
  */
 
-mpi_reduce_f ucg_builtin_mpi_reduce_cb;
-static UCS_F_ALWAYS_INLINE void ucg_builtin_mpi_reduce(void *mpi_op,
-        void *src, void *dst, unsigned dcount, void* mpi_datatype)
+static void ucg_builtin_mpi_reduce_reversed(ucg_builtin_request_t *req,
+        void *src, void *dst, unsigned dcount)
 {
-    UCS_PROFILE_CALL_VOID(ucg_builtin_mpi_reduce_cb, mpi_op, (char*)src,
-            (char*)dst, dcount, mpi_datatype);
+    ucg_reduce_kernel_t *reduce = &req->op->reduce;
+    if (reduce->func_reversed != NULL) {
+        reduce->func_reversed(reduce->arg, dst, src, dcount);
+        return;
+    }
+
+    /* dst = dst (op) src - through a copy, allocated with the operation */
+    size_t length = dcount * reduce->dt_len;
+    ucs_assert(req->op->reduce_scratch != NULL);
+    ucs_assert(length <= req->op->super.params.recv.count * reduce->dt_len);
+
+    memcpy(req->op->reduce_scratch, dst, length);
+    memcpy(dst, src, length);
+    reduce->func(reduce->arg, dst, req->op->reduce_scratch, dcount);
+}
+
+static UCS_F_ALWAYS_INLINE void ucg_builtin_mpi_reduce(ucg_builtin_request_t *req,
+        void *src, void *dst, unsigned dcount)
+{
+    ucg_reduce_kernel_t *reduce = &req->op->reduce;
+
+    /* some phases (e.g. recursive doubling) apply the local operand first */
+    if (ucs_unlikely(req->step->phase->is_swap && !reduce->is_commutative)) {
+        UCS_PROFILE_CALL_VOID(ucg_builtin_mpi_reduce_reversed, req, src, dst, dcount);
+        return;
+    }
+
+    UCS_PROFILE_CALL_VOID(reduce->func, reduce->arg, dst, src, dcount);
 }
 
 #define ucg_builtin_mpi_reduce_full(_req, _offset, _data, _length, _params)    \
 {                                                                              \
     ucg_collective_params_t *params = _params;                                 \
     ucs_assert(length == (params->recv.count * params->recv.dt_len));          \
-    ucg_builtin_mpi_reduce(params->recv.op_ext,                                \
+    ucg_builtin_mpi_reduce(_req,                                               \
                            _data, (_req)->step->recv_buffer + offset,          \
-                           params->recv.count,  params->recv.dt_ext);          \
+                           params->recv.count);                                \
 }
 
 #define ucg_builtin_mpi_reduce_partial(_req, _offset, _data, _length, _params) \
 {                                                                              \
     ucg_collective_params_t *params = _params;                                 \
-    ucg_builtin_mpi_reduce(params->recv.op_ext,                                \
+    ucg_builtin_mpi_reduce(_req,                                               \
                            _data, (_req)->step->recv_buffer + offset,          \
-                           length / params->recv.dt_len, params->recv.dt_ext); \
+                           length / params->recv.dt_len);                      \
 }
 
 static UCS_F_ALWAYS_INLINE void ucg_builtin_comp_last_step_cb(ucg_builtin_request_t *req, ucs_status_t status)
@@ -51,6 +76,9 @@ static UCS_F_ALWAYS_INLINE void ucg_builtin_comp_last_step_cb(ucg_builtin_reques
     ucg_builtin_comp_slot_t *slot = ucs_container_of(req, ucg_builtin_comp_slot_t, req);
     slot->cb = NULL;
 
+    /* From now on the operation may be discarded from the cache */
+    req->op->super.flags &= ~UCG_OP_FLAG_IN_FLIGHT;
+
     /*
      * For some operations, like MPI_Allgather, MPI_Alltoall, the
      * local data should be re-arranged (e.g. Bruck algorithms).
@@ -156,6 +184,51 @@ static UCS_F_ALWAYS_INLINE void ucg_builtin_comp_zcopy_check_cb(ucg_builtin_requ
     }
 }
 
+/*
+ * Bruck alltoall steps transfer the runs of blocks in the receive buffer as if
+ * they were one contiguous buffer, so these copy a part of it (at "offset")
+ * directly - without packing all of it into a contiguous buffer first.
+ */
+static UCS_F_ALWAYS_INLINE void ucg_builtin_step_gather_runs(const ucg_builtin_op_step_t *step,
+                                                             int8_t *dst, size_t offset,
+                                                             size_t length)
+{
+    size_t run_length = step->buf_len_unit << step->am_header.step_idx;
+    size_t in_run     = offset % run_length;
+    size_t chunk      = run_length - in_run;
+    const int8_t *src = step->recv_buffer + run_length +
+                        (offset / run_length) * 2 * run_length + in_run;
+
+    while (length > 0) {
+        chunk = ucs_min(chunk, length);
+        memcpy(dst, src, chunk);
+        dst    += chunk;
+        src    += chunk + run_length; /* skip the blocks not in this step */
+        length -= chunk;
+        chunk   = run_length;
+    }
+}
+
+static UCS_F_ALWAYS_INLINE void ucg_builtin_step_scatter_runs(const ucg_builtin_op_step_t *step,
+                                                              const int8_t *src, size_t offset,
+                                                              size_t length)
+{
+    size_t run_length = step->buf_len_unit << step->am_header.step_idx;
+    size_t in_run     = offset % run_length;
+    size_t chunk      = run_length - in_run;
+    int8_t *dst       = step->recv_buffer + run_length +
+                        (offset / run_length) * 2 * run_length + in_run;
+
+    while (length > 0) {
+        chunk = ucs_min(chunk, length);
+        memcpy(dst, src, chunk);
+        src    += chunk;
+        dst    += chunk + run_length;
+        length -= chunk;
+        chunk   = run_length;
+    }
+}
+
 static int ucg_builtin_comp_recv_one_cb(ucg_builtin_request_t *req,
     uint64_t offset, void *data, size_t length)
 {
@@ -180,6 +253,69 @@ static int ucg_builtin_comp_recv_many_cb(ucg_builtin_request_t *req,
     return ucg_builtin_comp_step_check_cb(req);
 }
 
+/* Length of the next fragment a (partially sent) step is going to send */
+static UCS_F_ALWAYS_INLINE size_t ucg_builtin_step_next_frag_length(const ucg_builtin_op_step_t *step)
+{
+    size_t remaining = step->buffer_length - step->iter_offset;
+    return ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) &&
+            (remaining > step->fragment_length)) ? step->fragment_length : remaining;
+}
+
+static size_t ucg_builtin_comp_forward_packer(void *dest, void *arg)
+{
+    ucg_builtin_op_step_t *step      = (ucg_builtin_op_step_t*)arg;
+    ucg_builtin_header_t *header_ptr = (ucg_builtin_header_t*)dest;
+    size_t length                    = ucg_builtin_step_next_frag_length(step);
+    header_ptr->header               = step->am_header.header;
+
+    memcpy(header_ptr + 1, step->send_buffer + step->iter_offset, length);
+    return sizeof(*header_ptr) + length;
+}
+
+/*
+ * Pipelined ring: the fragment just received (and reduced) is also the next one
+ * the following step is going to send - so send it right away, rather than once
+ * this entire step is done. Whatever could not be passed on this way (e.g. no
+ * resources at the time) is sent by the next step itself, from that point on.
+ */
+static UCS_F_ALWAYS_INLINE void ucg_builtin_comp_ring_forward(ucg_builtin_request_t *req,
+                                                              uint64_t offset, size_t length)
+{
+    ucg_builtin_op_step_t *next = req->step + 1;
+    ssize_t len;
+
+    if (!(next->flags & UCG_BUILTIN_OP_STEP_FLAG_SENT_AHEAD) ||
+        !(next->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY) ||
+        (next->iter_offset >= next->buffer_length) ||
+        (offset != next->am_header.remote_offset) ||
+        (length != ucg_builtin_step_next_frag_length(next))) {
+        return;
+    }
+
+    next->am_header.coll_id = req->step->am_header.coll_id;
+    len = next->uct_iface->ops.ep_am_bcopy(next->phase->single_ep, next->am_id,
+                                            ucg_builtin_comp_forward_packer, next, 0);
+    if (ucs_likely(len >= 0)) {
+        next->iter_offset             += length;
+        next->am_header.remote_offset += length;
+    }
+}
+
+static int ucg_builtin_comp_recv_many_forward_cb(ucg_builtin_request_t *req,
+    uint64_t offset, void *data, size_t length)
+{
+    memcpy(req->step->recv_buffer + offset, data, length);
+    ucg_builtin_comp_ring_forward(req, offset, length);
+    return ucg_builtin_comp_step_check_cb(req);
+}
+
+static int ucg_builtin_comp_recv_runs_cb(ucg_builtin_request_t *req,
+    uint64_t offset, void *data, size_t length)
+{
+    ucg_builtin_step_scatter_runs(req->step, data, offset, length);
+    return ucg_builtin_comp_step_check_cb(req);
+}
+
 static int ucg_builtin_comp_recv_many_then_send_pipe_cb(ucg_builtin_request_t *req,
     uint64_t offset, void *data, size_t length)
 {
@@ -220,15 +356,22 @@ UCS_PROFILE_FUNC(int, ucg_builtin_comp_reduce_many_cb, (req, offset, data, lengt
     return ucg_builtin_comp_step_check_cb(req);
 }
 
+static int ucg_builtin_comp_reduce_many_forward_cb(ucg_builtin_request_t *req,
+    uint64_t offset, void *data, size_t length)
+{
+    ucg_builtin_mpi_reduce_partial(req, offset, data, length, &req->op->super.params);
+    ucg_builtin_comp_ring_forward(req, offset, length);
+    return ucg_builtin_comp_step_check_cb(req);
+}
+
 UCS_PROFILE_FUNC(int, ucg_builtin_comp_reduce_full_cb, (req, offset, data, length),
                  ucg_builtin_request_t *req, uint64_t offset, void *data, size_t length)
 {
     memcpy(req->step->phase->recv_cache_buffer + offset, data, length);
 
     if (req->pending == 1) {
-        ucg_builtin_mpi_reduce(req->op->super.params.recv.op_ext,
-                            req->step->phase->recv_cache_buffer, req->step->recv_buffer,
-                            req->op->super.params.recv.count,  req->op->super.params.recv.dt_ext);
+        ucg_builtin_mpi_reduce(req, req->step->phase->recv_cache_buffer,
+                               req->step->recv_buffer, req->op->super.params.recv.count);
     }
 
     return ucg_builtin_comp_step_check_cb(req);
@@ -254,9 +397,8 @@ static int ucg_builtin_comp_reduce_full_then_send_cb(ucg_builtin_request_t *req,
     memcpy(req->step->phase->recv_cache_buffer + offset, data, length);
 
     if (req->pending == 1) {
-        ucg_builtin_mpi_reduce(req->op->super.params.recv.op_ext,
-                            req->step->phase->recv_cache_buffer, req->step->recv_buffer,
-                            req->op->super.params.recv.count,  req->op->super.params.recv.dt_ext);
+        ucg_builtin_mpi_reduce(req, req->step->phase->recv_cache_buffer,
+                               req->step->recv_buffer, req->op->super.params.recv.count);
     }
     return ucg_builtin_comp_send_check_cb(req);
 }
@@ -306,6 +448,209 @@ static int ucg_builtin_comp_last_barrier_step_many_cb(ucg_builtin_request_t *req
     return 0;
 }
 
+/*
+ * Steps through node-local shared memory receive no messages: they poll the
+ * segment (from the progress function), and this callback only keeps their
+ * slot busy meanwhile.
+ */
+static int ucg_builtin_comp_shm_cb(ucg_builtin_request_t *req,
+    uint64_t offset, void *data, size_t length)
+{
+    ucs_error("unexpected message of %zu bytes for a shared-memory step #%u",
+              length, (unsigned)req->step->am_header.step_idx);
+    return 0;
+}
+
+/*
+ * Rendezvous: large broadcast steps only send the address (and remote key) of
+ * their buffer, and every receiver reads the data directly into its own buffer.
+ * Once done reading, the receiver acknowledges it with an empty message - so the
+ * sender may complete (or a waypoint may pass its own buffer on) only then.
+ * Between processes on the same node the address comes with the sender's PID
+ * instead of a key, and the data is read by the kernel (CMA) - in a single copy.
+ */
+static UCS_F_ALWAYS_INLINE int8_t *ucg_builtin_step_rndv_buffer(const ucg_builtin_op_step_t *step)
+{
+    return (step->phase->method == UCG_PLAN_METHOD_SEND_TERMINAL) ?
+           step->send_buffer : step->recv_buffer;
+}
+
+/* The sender, which the receiver reads from (a waypoint's parent comes first) */
+static UCS_F_ALWAYS_INLINE uct_ep_h ucg_builtin_step_rndv_peer(const ucg_builtin_op_step_t *step)
+{
+    return (step->phase->ep_cnt == 1) ? step->phase->single_ep :
+                                        step->phase->multi_eps[0];
+}
+
+static size_t ucg_builtin_step_rndv_ack_packer(void *dest, void *arg)
+{
+    ucg_builtin_op_step_t *step      = (ucg_builtin_op_step_t*)arg;
+    ucg_builtin_header_t *header_ptr = (ucg_builtin_header_t*)dest;
+    header_ptr->header               = step->am_header.header;
+    return sizeof(*header_ptr);
+}
+
+static int ucg_builtin_step_rndv_ack(ucg_builtin_request_t *req)
+{
+    ucg_builtin_op_step_t *step = req->step;
+    ssize_t len = step->uct_iface->ops.ep_am_bcopy(ucg_builtin_step_rndv_peer(step),
+                                                   step->am_id,
+                                                   ucg_builtin_step_rndv_ack_packer,
+                                                   step, 0);
+    if (ucs_unlikely(len < 0)) {
+        if (len == UCS_ERR_NO_RESOURCE) {
+            /* retried by @ref ucg_builtin_step_execute , upon progress */
+            step->rndv.state = UCG_BUILTIN_OP_STEP_RNDV_ACK;
+            ucs_list_add_tail(req->op->resend, &req->send_list);
+            return 0;
+        }
+
+        step->rndv.state = UCG_BUILTIN_OP_STEP_RNDV_IDLE;
+        ucg_builtin_comp_last_step_cb(req, (ucs_status_t)len);
+        return 1;
+    }
+
+    step->rndv.state = UCG_BUILTIN_OP_STEP_RNDV_IDLE;
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_RECV1_BEFORE_SEND) {
+        /* pass the buffer on, then wait for the children to acknowledge it */
+        req->pending = step->phase->ep_cnt - 1;
+        (void) ucg_builtin_step_execute(req, NULL);
+        return 1;
+    }
+
+    return ucg_builtin_comp_step_check_cb(req);
+}
+
+static int ucg_builtin_step_rndv_read_done(ucg_builtin_request_t *req)
+{
+    uct_rkey_release(req->step->phase->component, &req->step->rndv.rkey);
+    return ucg_builtin_step_rndv_ack(req);
+}
+
+static void ucg_builtin_step_rndv_read_comp_cb(uct_completion_t *self,
+                                               ucs_status_t status)
+{
+    ucg_builtin_zcomp_t *zcomp  = ucs_container_of(self, ucg_builtin_zcomp_t, comp);
+    ucg_builtin_request_t *req  = zcomp->req;
+    ucg_builtin_op_step_t *step = req->step;
+
+    if (ucs_unlikely(status != UCS_OK)) {
+        uct_rkey_release(step->phase->component, &step->rndv.rkey);
+        step->rndv.state = UCG_BUILTIN_OP_STEP_RNDV_IDLE;
+        ucg_builtin_comp_last_step_cb(req, status);
+        return;
+    }
+
+    (void) ucg_builtin_step_rndv_read_done(req);
+}
+
+static int ucg_builtin_step_rndv_read(ucg_builtin_request_t *req)
+{
+    ucg_builtin_op_step_t *step = req->step;
+    uct_ep_h ep                 = ucg_builtin_step_rndv_peer(step);
+    size_t max_read             = step->phase->ep_attr->cap.get.max_zcopy;
+    ucs_status_t status;
+    ucs_status_t (*ep_get_zcopy)(uct_ep_h, const uct_iov_t*, size_t, uint64_t,
+            uct_rkey_t, uct_completion_t*) = step->uct_iface->ops.ep_get_zcopy;
+
+    uct_iov_t iov = {
+        .memh   = step->rndv.memh,
+        .stride = 0,
+        .count  = 1
+    };
+
+    while (step->rndv.offset < step->buffer_length) {
+        iov.buffer = step->recv_buffer + step->rndv.offset;
+        iov.length = ucs_min(max_read, step->buffer_length - step->rndv.offset);
+        ucs_debug("rndv read step %u offset %zu length %zu", step->am_header.step_idx,
+                  step->rndv.offset, iov.length);
+        status     = ep_get_zcopy(ep, &iov, 1, step->rndv.remote_addr + step->rndv.offset,
+                                  step->rndv.rkey.rkey, &step->rndv.zcomp.comp);
+        if (status == UCS_INPROGRESS) {
+            step->rndv.zcomp.comp.count++;
+        } else if (ucs_unlikely(status != UCS_OK)) {
+            if (status == UCS_ERR_NO_RESOURCE) {
+                /* continued by @ref ucg_builtin_step_execute , upon progress */
+                ucs_list_add_tail(req->op->resend, &req->send_list);
+                return 0;
+            }
+
+            uct_rkey_release(step->phase->component, &step->rndv.rkey);
+            step->rndv.state = UCG_BUILTIN_OP_STEP_RNDV_IDLE;
+            ucg_builtin_comp_last_step_cb(req, status);
+            return 1;
+        }
+
+        step->rndv.offset += iov.length;
+    }
+
+    /* All the reads were issued - drop the count held meanwhile */
+    if (--step->rndv.zcomp.comp.count > 0) {
+        return 0;
+    }
+
+    return ucg_builtin_step_rndv_read_done(req);
+}
+
+static int ucg_builtin_step_rndv_cma_read(ucg_builtin_request_t *req)
+{
+    ucg_builtin_op_step_t *step = req->step;
+    ucs_status_t status;
+
+    status = ucg_builtin_shm_cma_read(step->rndv.remote_pid,
+                                      step->recv_buffer + step->rndv.offset,
+                                      step->rndv.remote_addr + step->rndv.offset,
+                                      step->buffer_length - step->rndv.offset);
+    if (ucs_unlikely(status != UCS_OK)) {
+        ucg_builtin_comp_last_step_cb(req, status);
+        return 1;
+    }
+
+    step->rndv.offset = step->buffer_length;
+    return ucg_builtin_step_rndv_ack(req);
+}
+
+static int ucg_builtin_comp_rndv_cb(ucg_builtin_request_t *req,
+    uint64_t offset, void *data, size_t length)
+{
+    ucg_builtin_op_step_t *step           = req->step;
+    const ucg_builtin_rndv_header_t *rndv = (const ucg_builtin_rndv_header_t*)data;
+    ucs_status_t status;
+
+    if (length == 0) {
+        /* one of my receivers is done reading */
+        return ucg_builtin_comp_step_check_cb(req);
+    }
+
+    /* the sender's address, see @ref ucg_builtin_step_rndv_packer */
+    ucs_assert(length >= sizeof(*rndv));
+    ucs_assert(step->rndv.state == UCG_BUILTIN_OP_STEP_RNDV_IDLE);
+    step->rndv.remote_addr = rndv->address;
+
+    /* a sender on my node is read using CMA */
+    if ((rndv->host_id != UCG_BUILTIN_RNDV_NO_CMA) &&
+        (rndv->host_id == step->phase->rndv_host_id)) {
+        step->rndv.remote_pid = (pid_t)rndv->pid;
+        step->rndv.offset     = 0;
+        return ucg_builtin_step_rndv_cma_read(req);
+    }
+
+    /* a sender on another node, which registered its buffer */
+    ucs_assert(length > sizeof(*rndv));
+    status = uct_rkey_unpack(step->phase->component, (const void*)(rndv + 1),
+                             &step->rndv.rkey);
+    if (ucs_unlikely(status != UCS_OK)) {
+        ucg_builtin_comp_last_step_cb(req, status);
+        return 1;
+    }
+
+    step->rndv.state            = UCG_BUILTIN_OP_STEP_RNDV_READ;
+    step->rndv.offset           = 0;
+    step->rndv.zcomp.req        = req;
+    step->rndv.zcomp.comp.count = 1; /* held until all the reads are issued */
+    return ucg_builtin_step_rndv_read(req);
+}
+
 static ucs_status_t ucg_builtin_step_select_callbacks(ucg_builtin_plan_phase_t *phase,
                                                ucg_builtin_comp_recv_cb_t *recv_cb, int nonzero_length, int flags)
 {
@@ -319,6 +664,12 @@ static ucs_status_t ucg_builtin_step_select_callbacks(ucg_builtin_plan_phase_t *
 
     int is_waypoint_fanout = 0;/* special flag for waypoint bcast/scatter, only receive once */
 
+    /* either the sender's address, or the receivers' acknowledgements */
+    if (flags & UCG_BUILTIN_OP_STEP_FLAG_RNDV) {
+        *recv_cb = ucg_builtin_comp_rndv_cb;
+        return UCS_OK;
+    }
+
     switch (phase->method) {
         case UCG_PLAN_METHOD_BCAST_WAYPOINT:
         case UCG_PLAN_METHOD_SCATTER_WAYPOINT:
@@ -378,17 +729,34 @@ static ucs_status_t ucg_builtin_step_select_callbacks(ucg_builtin_plan_phase_t *
                                         ucg_builtin_comp_wait_many_cb;
             break;
 
+        case UCG_PLAN_METHOD_ALLTOALL_BRUCK:
+            *recv_cb = nonzero_length ? ucg_builtin_comp_recv_runs_cb :
+                                        ucg_builtin_comp_wait_many_cb;
+            break;
+
         case UCG_PLAN_METHOD_REDUCE_SCATTER_RING:
             if (is_segmented && nonzero_length){
                 *recv_cb = ucg_builtin_comp_reduce_full_cb;
             } else {
-                *recv_cb = nonzero_length ? ucg_builtin_comp_reduce_many_cb :
+                *recv_cb = nonzero_length ? (is_pipelined ? ucg_builtin_comp_reduce_many_forward_cb :
+                                                            ucg_builtin_comp_reduce_many_cb) :
                                             ucg_builtin_comp_wait_many_cb;
             }
             break;
 
         case UCG_PLAN_METHOD_ALLGATHER_RING:
-            *recv_cb = ucg_builtin_comp_recv_many_cb;
+            *recv_cb = is_pipelined ? ucg_builtin_comp_recv_many_forward_cb :
+                                      ucg_builtin_comp_recv_many_cb;
+            break;
+
+        case UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING:
+            *recv_cb = nonzero_length ? ucg_builtin_comp_reduce_many_cb :
+                                        ucg_builtin_comp_wait_many_cb;
+            break;
+
+        case UCG_PLAN_METHOD_ALLGATHER_DOUBLING:
+            *recv_cb = nonzero_length ? ucg_builtin_comp_recv_many_cb :
+                                        ucg_builtin_comp_wait_many_cb;
             break;
 
         default:
@@ -409,22 +777,17 @@ static ucs_status_t ucg_builtin_step_select_callbacks(ucg_builtin_plan_phase_t *
  * Below is a list of possible callback functions for pretreatment before sending.
  */
 
-/* send_cb for alltoall to sned discrete elements */
+/*
+ * send_cb for alltoall to send discrete elements: BCOPY packs them straight
+ * into the transport's buffer, but the others need them in a (registered)
+ * staging buffer. Zero-copy can't send them in-place, since the same blocks
+ * are overwritten by incoming data before the send is known to complete.
+ */
 static void ucg_builtin_send_alltoall(ucg_builtin_request_t *req)
 {
-    unsigned i, k;
-    size_t len = req->step->buf_len_unit;
     ucg_builtin_op_step_t *step = req->step;
-    size_t buffer_length_discrete = 0;
-    if (step->displs_rule == UCG_BUILTIN_OP_STEP_DISPLS_RULE_BRUCK_ALLTOALL) {
-        k = (unsigned)step->am_header.step_idx;
-        for (i = 0; i < num_procs; i++) {
-            if ((i >> k) & 1) { //kth bit is 1
-                memcpy(step->send_buffer + buffer_length_discrete * len,
-                    step->recv_buffer + i * len, len);
-                buffer_length_discrete++;
-            }
-        }
+    if (!(step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY)) {
+        ucg_builtin_step_gather_runs(step, step->send_buffer, 0, step->buffer_length);
     }
 }
 
@@ -463,6 +826,36 @@ static void ucg_builtin_init_ring(ucg_builtin_op_t *op)
     memcpy(step->recv_buffer, step->send_buffer - step->am_header.remote_offset, len);
 }
 
+/* a ring between the node-local steps, reset like in @ref ucg_builtin_init_ring */
+static void ucg_builtin_init_node_ring(ucg_builtin_op_t *op)
+{
+    unsigned step_idx;
+    for (step_idx = 1; step_idx + 1 < ((ucg_builtin_plan_t *)op->super.plan)->phs_cnt; step_idx++) {
+        op->steps[step_idx].am_header.remote_offset = op->steps[step_idx].remote_offset;
+    }
+
+    ucg_builtin_init_reduce(op);
+}
+
+/* recursive halving and doubling, reset like in @ref ucg_builtin_init_ring */
+static void ucg_builtin_init_halving(ucg_builtin_op_t *op)
+{
+    ucg_builtin_op_step_t *step = &op->steps[0];
+    unsigned step_idx;
+    for (step_idx = 0; step_idx < ((ucg_builtin_plan_t *)op->super.plan)->phs_cnt; step_idx++, step++) {
+        if ((step->phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING) ||
+            (step->phase->method == UCG_PLAN_METHOD_ALLGATHER_DOUBLING)) {
+            step->am_header.remote_offset = step->remote_offset;
+        }
+    }
+
+    /* each step only sends (and reduces) some of the blocks, so all of them are copied */
+    if (op->super.params.send.buf != MPI_IN_PLACE) {
+        memcpy(op->super.params.recv.buf, op->super.params.send.buf,
+               op->super.params.send.count * op->super.params.send.dt_len);
+    }
+}
+
 /* for allgather, add initial step for first element storage*/
 static void ucg_builtin_init_allgather(ucg_builtin_op_t *op)
 {
@@ -496,11 +889,13 @@ static void ucg_builtin_init_alltoall(ucg_builtin_op_t *op)
     size_t my_index   = op->super.plan->my_index;
     ucg_builtin_op_step_t *step = &op->steps[0];
     size_t len = step->buf_len_unit;
+    /* the step itself sends from a staging buffer, see ucg_builtin_send_alltoall() */
+    const int8_t *send_buffer = (const int8_t*)op->super.params.send.buf;
 
-    memcpy(step->recv_buffer, step->send_buffer + my_index * len, (proc_count - my_index)*len);
+    memcpy(step->recv_buffer, send_buffer + my_index * len, (proc_count - my_index)*len);
 
     if (my_index != 0) {
-        memcpy(step->recv_buffer + (proc_count - my_index)*len, step->send_buffer, my_index*len);
+        memcpy(step->recv_buffer + (proc_count - my_index)*len, send_buffer, my_index*len);
     }
 }
 
@@ -514,15 +909,14 @@ static void ucg_builtin_final_allgather(ucg_builtin_request_t *req)
     size_t len = req->step->buf_len_unit;
     size_t my_index   = req->op->super.plan->my_index;
     size_t len_move = len * (num_procs_count - my_index);
-    void *temp_buffer = ucs_calloc(1, len * (num_procs_count - 1), "ucg_allgather_final_step_buffer");
-    ucs_assert(temp_buffer != NULL);
-    if (req->op->super.plan->my_index != 0) {
+    if (my_index != 0) {
+        void *temp_buffer = ucg_builtin_scratch_get(req->op->scratch, len_move);
+        ucs_assert(temp_buffer != NULL);
         memcpy(temp_buffer, req->step->recv_buffer, len_move);
         memmove(req->step->recv_buffer, req->step->recv_buffer + len_move, len*my_index);
         memcpy(req->step->recv_buffer + len * my_index, temp_buffer, len_move);
+        ucg_builtin_scratch_put(req->op->scratch, temp_buffer);
     }
-    free(temp_buffer);
-    temp_buffer = NULL;
 }
 
 /* local inverse rotation for alltoall at final step */
@@ -536,15 +930,14 @@ static void ucg_builtin_final_alltoall(ucg_builtin_request_t *req)
     size_t dst;
     unsigned i;
     size_t len_move = len * num_procs_count;
-    int8_t *temp_buffer = (int8_t*)ucs_calloc(1, len * num_procs_count, "ucg_alltoall_final_step_buffer");
+    int8_t *temp_buffer = (int8_t*)ucg_builtin_scratch_get(req->op->scratch, len_move);
     ucs_assert(temp_buffer != NULL);
     for (i = 0; i < num_procs_count; i++) {
         dst = (my_index - i + num_procs_count) % num_procs_count;
         memcpy(temp_buffer + dst * len, req->step->recv_buffer + i * len, len);
     }
     memcpy(req->step->recv_buffer, temp_buffer, len_move);
-    free(temp_buffer);
-    temp_buffer = NULL;
+    ucg_builtin_scratch_put(req->op->scratch, temp_buffer);
 }
 
 static ucs_status_t ucg_builtin_op_select_callback(ucg_builtin_plan_t *plan,
@@ -552,9 +945,18 @@ static ucs_status_t ucg_builtin_op_select_callback(ucg_builtin_plan_t *plan,
                                                    ucg_builtin_op_final_cb_t *final_cb)
 {
     switch (plan->phss[0].method) {
-        case UCG_PLAN_METHOD_REDUCE_WAYPOINT:
         case UCG_PLAN_METHOD_REDUCE_TERMINAL:
+            /* the extra members of a non-power-of-two group fold in before halving */
+            if ((plan->phs_cnt > 1) &&
+                (plan->phss[1].method == UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING)) {
+                *init_cb  = ucg_builtin_init_halving;
+                *final_cb = NULL;
+                break;
+            }
+            /* no break */
+        case UCG_PLAN_METHOD_REDUCE_WAYPOINT:
         case UCG_PLAN_METHOD_REDUCE_RECURSIVE:
+        case UCG_PLAN_METHOD_SHM_FANIN:
             *init_cb  = ucg_builtin_init_reduce;
             *final_cb = NULL;
             break;
@@ -583,6 +985,16 @@ static ucs_status_t ucg_builtin_op_select_callback(ucg_builtin_plan_t *plan,
             *final_cb = NULL;
             break;
 
+        case UCG_PLAN_METHOD_SHM_REDUCE_SCATTER:
+            *init_cb  = ucg_builtin_init_node_ring;
+            *final_cb = NULL;
+            break;
+
+        case UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING:
+            *init_cb  = ucg_builtin_init_halving;
+            *final_cb = NULL;
+            break;
+
         default:
             *init_cb  = ucg_builtin_init_dummy;
             *final_cb = NULL;
@@ -607,15 +1019,155 @@ static void ucg_builtin_step_am_zcopy_comp_step_check_cb(uct_completion_t *self,
     }
 }
 
-static inline ucs_status_t ucg_builtin_step_zcopy_prep(ucg_builtin_op_step_t *step)
+/*
+ * Registration of a user buffer of the step - taken from the registration
+ * cache of the phase (or rail) if it has one, so it's likely registered already.
+ */
+static inline ucs_status_t ucg_builtin_mem_reg(uct_md_h md, ucg_builtin_rcache_t *rcache,
+                                               void *buffer, size_t length, int prot,
+                                               uct_mem_h *memh_p,
+                                               ucg_builtin_rcache_region_t **region_p)
+{
+    if (rcache != NULL) {
+        return ucg_builtin_rcache_reg(rcache, buffer, length, prot, region_p, memh_p);
+    }
+
+    *region_p = NULL;
+    return uct_md_mem_reg(md, buffer, length, UCT_MD_MEM_ACCESS_ALL, memh_p);
+}
+
+static inline void ucg_builtin_mem_dereg(uct_md_h md, ucg_builtin_rcache_t *rcache,
+                                         uct_mem_h memh,
+                                         ucg_builtin_rcache_region_t *region)
+{
+    if (region != NULL) {
+        ucg_builtin_rcache_put(rcache, region);
+    } else {
+        uct_md_mem_dereg(md, memh);
+    }
+}
+
+static inline ucs_status_t ucg_builtin_step_mem_reg(ucg_builtin_op_step_t *step,
+                                                    void *buffer, int prot,
+                                                    uct_mem_h *memh_p,
+                                                    ucg_builtin_rcache_region_t **region_p)
+{
+    return ucg_builtin_mem_reg(step->uct_md, step->phase->rcache, buffer,
+                               step->buffer_length, prot, memh_p, region_p);
+}
+
+static inline void ucg_builtin_step_mem_dereg(ucg_builtin_op_step_t *step,
+                                              uct_mem_h memh,
+                                              ucg_builtin_rcache_region_t *region)
+{
+    ucg_builtin_mem_dereg(step->uct_md, step->phase->rcache, memh, region);
+}
+
+/*
+ * Multi-rail: a zero-copy step needs its send buffer registered with the MD of
+ * every rail as well - unless it's the same MD as of the first one (e.g. two
+ * ports of the same HCA), in which case the same memory handle is used.
+ */
+static UCS_F_ALWAYS_INLINE int ucg_builtin_step_rail_has_memh(const ucg_builtin_op_step_t *step,
+                                                              unsigned rail)
+{
+    return (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) &&
+           (step->phase->rails[rail - 1].md != step->uct_md);
+}
+
+static void ucg_builtin_step_rails_dereg(ucg_builtin_op_step_t *step, unsigned rail_cnt,
+                                         uct_mem_h *memhs,
+                                         ucg_builtin_rcache_region_t **regions)
+{
+    unsigned rail;
+    for (rail = 1; rail < rail_cnt; rail++) {
+        if (ucg_builtin_step_rail_has_memh(step, rail)) {
+            ucg_builtin_mem_dereg(step->phase->rails[rail - 1].md,
+                                  step->phase->rails[rail - 1].rcache,
+                                  memhs[rail - 1], regions[rail - 1]);
+        }
+    }
+}
+
+static ucs_status_t ucg_builtin_step_rails_reg(ucg_builtin_op_step_t *step, void *buffer,
+                                               uct_mem_h *memhs,
+                                               ucg_builtin_rcache_region_t **regions)
+{
+    ucs_status_t status;
+    unsigned rail;
+
+    for (rail = 1; rail < step->rail_cnt; rail++) {
+        if (ucg_builtin_step_rail_has_memh(step, rail)) {
+            status = ucg_builtin_mem_reg(step->phase->rails[rail - 1].md,
+                                         step->phase->rails[rail - 1].rcache,
+                                         buffer, step->buffer_length, PROT_READ,
+                                         &memhs[rail - 1], &regions[rail - 1]);
+            if (status != UCS_OK) {
+                ucg_builtin_step_rails_dereg(step, rail, memhs, regions);
+                return status;
+            }
+        }
+    }
+
+    return UCS_OK;
+}
+
+/*
+ * Stripe the fragments of a step across the rails of its phase, if it has
+ * several. Scratch buffers are registered with a single MD (at a time), so
+ * those are only striped if all the rails share it.
+ */
+static inline ucs_status_t ucg_builtin_step_rails_prep(ucg_builtin_op_step_t *step)
+{
+    const ucg_builtin_plan_phase_t *phase = step->phase;
+    unsigned rail;
+
+    step->rail_cnt = 1;
+    if ((phase->rail_cnt <= 1) ||
+        !(step->flags & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) ||
+        !(step->flags & (UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY |
+                         UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY))) {
+        return UCS_OK;
+    }
+
+    if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) &&
+        (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER)) {
+        for (rail = 1; rail < phase->rail_cnt; rail++) {
+            if (ucg_builtin_step_rail_has_memh(step, rail)) {
+                return UCS_OK;
+            }
+        }
+    }
+
+    step->rail_cnt = phase->rail_cnt;
+    if (!(step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) ||
+        (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER)) {
+        return UCS_OK;
+    }
+
+    ucs_status_t status = ucg_builtin_step_rails_reg(step, step->send_buffer,
+                                                     step->zcopy.rail_memh,
+                                                     step->zcopy.rail_region);
+    if (status != UCS_OK) {
+        step->rail_cnt = 1;
+    }
+    return status;
+}
+
+static inline ucs_status_t ucg_builtin_step_zcopy_prep(ucg_builtin_op_step_t *step,
+                                                       ucg_builtin_scratch_t *scratch)
 {
     /* Allocate callback context for zero-copy sends */
     uint32_t zcomp_cnt         = step->phase->ep_cnt * step->fragments;
     step->zcopy.memh           = NULL; /* - in case the allocation fails... */
+    step->zcopy.region         = NULL;
     step->zcopy.num_store      = 0;
     ucg_builtin_zcomp_t *zcomp =
-             step->zcopy.zcomp = (ucg_builtin_zcomp_t*)UCS_ALLOC_CHECK(zcomp_cnt *
-                     sizeof(*zcomp), "ucg_zcopy_completion");
+             step->zcopy.zcomp = (ucg_builtin_zcomp_t*)ucg_builtin_scratch_get(scratch,
+                     zcomp_cnt * sizeof(*zcomp));
+    if (zcomp == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
 
     /* Initialize all the zero-copy send completion structures */
     while (zcomp_cnt--) {
@@ -625,13 +1177,82 @@ static inline ucs_status_t ucg_builtin_step_zcopy_prep(ucg_builtin_op_step_t *st
     }
 
     /* Register the buffer, creating a memory handle used in zero-copy sends */
-    ucs_status_t status = uct_md_mem_reg(step->uct_md, step->send_buffer,
-            step->buffer_length, UCT_MD_MEM_ACCESS_ALL, &step->zcopy.memh);
+    ucs_status_t status;
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER) {
+        status = ucg_builtin_scratch_reg(step->send_buffer, step->uct_md,
+                                         &step->zcopy.memh);
+    } else {
+        status = ucg_builtin_step_mem_reg(step, step->send_buffer, PROT_READ,
+                                          &step->zcopy.memh, &step->zcopy.region);
+    }
+    if (status != UCS_OK) {
+        ucg_builtin_scratch_put(scratch, step->zcopy.zcomp);
+        step->zcopy.zcomp = NULL;
+        return status;
+    }
+    return UCS_OK;
+}
+
+static ucs_status_t ucg_builtin_step_rndv_reg(ucg_builtin_op_step_t *step, int8_t *buffer,
+                                              uct_mem_h *memh_p,
+                                              ucg_builtin_rcache_region_t **region_p)
+{
+    /* the root only has its buffer read, the others have the data read into theirs */
+    int prot            = (step->phase->method == UCG_PLAN_METHOD_SEND_TERMINAL) ?
+                          PROT_READ : (PROT_READ | PROT_WRITE);
+    ucs_status_t status = ucg_builtin_step_mem_reg(step, buffer, prot, memh_p, region_p);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* the key of the buffer is sent as is, so it's packed only once */
+    if (step->rndv.rkey_buffer != NULL) {
+        status = uct_md_mkey_pack(step->uct_md, *memh_p, step->rndv.rkey_buffer);
+        if (status != UCS_OK) {
+            ucg_builtin_step_mem_dereg(step, *memh_p, *region_p);
+            return status;
+        }
+    }
+
+    return UCS_OK;
+}
+
+static inline ucs_status_t ucg_builtin_step_rndv_prep(ucg_builtin_op_step_t *step,
+                                                      ucg_builtin_scratch_t *scratch)
+{
+    ucs_status_t status;
+
+    step->rndv.state            = UCG_BUILTIN_OP_STEP_RNDV_IDLE;
+    step->rndv.zcomp.comp.func  = ucg_builtin_step_rndv_read_comp_cb;
+    step->rndv.zcomp.comp.count = 1;
+    step->rndv.rkey_buffer      = NULL;
+    step->rndv.memh             = UCT_MEM_HANDLE_NULL;
+    step->rndv.region           = NULL;
+
+    /* CMA reads any memory of the sender, so there's nothing to register */
+    if (step->phase->rndv_cma) {
+        return UCS_OK;
+    }
+
+    /* Every step but the last in the tree advertises its buffer */
+    if (step->phase->method != UCG_PLAN_METHOD_RECV_TERMINAL) {
+        step->rndv.rkey_buffer = ucg_builtin_scratch_get(scratch,
+                step->phase->md_attr->rkey_packed_size);
+        if (step->rndv.rkey_buffer == NULL) {
+            return UCS_ERR_NO_MEMORY;
+        }
+    }
+
+    status = ucg_builtin_step_rndv_reg(step, ucg_builtin_step_rndv_buffer(step),
+                                       &step->rndv.memh, &step->rndv.region);
     if (status != UCS_OK) {
-        ucs_free(zcomp);
-        zcomp = NULL;
+        if (step->rndv.rkey_buffer != NULL) {
+            ucg_builtin_scratch_put(scratch, step->rndv.rkey_buffer);
+            step->rndv.rkey_buffer = NULL;
+        }
         return status;
     }
+
     return UCS_OK;
 }
 
@@ -645,9 +1266,12 @@ static ucs_status_t ucg_builtin_optimize_bcopy_to_zcopy(ucg_builtin_op_t *op)
     do {
         step = &op->steps[step_idx++];
         if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY) &&
+            !(step->flags & (UCG_BUILTIN_OP_STEP_FLAG_PIPELINED |
+                             UCG_BUILTIN_OP_STEP_FLAG_SENT_AHEAD |
+                             UCG_BUILTIN_OP_STEP_FLAG_RNDV)) &&
             (step->phase->md_attr->cap.max_reg > step->buffer_length) &&
             step->buffer_length != 0) {
-            status = ucg_builtin_step_zcopy_prep(step);
+            status = ucg_builtin_step_zcopy_prep(step, op->scratch);
             if (status != UCS_OK) {
                 goto bcopy_to_zcopy_cleanup;
             }
@@ -657,6 +1281,12 @@ static ucs_status_t ucg_builtin_optimize_bcopy_to_zcopy(ucg_builtin_op_t *op)
             if (step->recv_cb == ucg_builtin_comp_reduce_one_cb) {
                 step->recv_cb = ucg_builtin_comp_reduce_many_cb;
             }
+
+            /* a zero-copy step may need to register with the other rails too */
+            status = ucg_builtin_step_rails_prep(step);
+            if (status != UCS_OK) {
+                goto bcopy_to_zcopy_cleanup;
+            }
         }
     } while (!(step->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
 
@@ -666,7 +1296,7 @@ bcopy_to_zcopy_cleanup:
     while (step_idx--) {
         step = &op->steps[step_idx];
         if (step->zcopy.zcomp != NULL) {
-            ucs_free(step->zcopy.zcomp);
+            ucg_builtin_scratch_put(op->scratch, step->zcopy.zcomp);
             step->zcopy.zcomp = NULL;
         }
     }
@@ -693,6 +1323,9 @@ static ucs_status_t ucg_builtin_op_consider_optimization(ucg_builtin_op_t *op,
     do {
         step = &op->steps[step_idx++];
         if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY) &&
+            !(step->flags & (UCG_BUILTIN_OP_STEP_FLAG_PIPELINED |
+                             UCG_BUILTIN_OP_STEP_FLAG_SENT_AHEAD |
+                             UCG_BUILTIN_OP_STEP_FLAG_RNDV)) &&
             (step->phase->md_attr->cap.max_reg > step->buffer_length) && opt_flag) {
             op->optm_cb = ucg_builtin_optimize_bcopy_to_zcopy;
             op->opt_cnt = config->mem_reg_opt_cnt;
@@ -4,6 +4,8 @@
  */
 
 #include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
 
 #include <ucs/datastruct/queue.h>
 #include <ucs/datastruct/list.h>
@@ -11,6 +13,7 @@
 #include <ucs/debug/memtrack.h>
 #include <ucs/debug/assert.h>
 #include <ucp/dt/dt_contig.h>
+#include <ucg/api/ucg_mpi.h>
 
 #include "builtin_cb.inl"
 
@@ -35,6 +38,57 @@ void ucg_builtin_step_assert(ucg_builtin_op_step_t *step, enum ucg_builtin_op_st
     ucs_assert(step->iter_offset != UCG_BUILTIN_OFFSET_PIPELINE_PENDING);
 }
 
+#if ENABLE_DEBUG_DATA
+#define UCG_BUILTIN_FAULT_OFFSET_NONE ((ucg_offset_t)-1)
+
+/*
+ * Fault injection, for testing the resend path: every N-th fragment sent by
+ * a step (see BUILTIN_FAULT_NO_RESOURCE) fails with UCS_ERR_NO_RESOURCE before
+ * it reaches UCT. Each resend has to resume from that fragment, and each peer
+ * has to end up with exactly all the fragments of the step.
+ */
+static UCS_F_ALWAYS_INLINE int ucg_builtin_step_fault(ucg_builtin_request_t *req,
+                                                      ucg_builtin_op_step_t *step,
+                                                      size_t offset)
+{
+    unsigned fault_every = ((ucg_builtin_config_t*)
+            req->op->super.plan->planner->plan_config)->fault_no_resource;
+    if ((fault_every == 0) || ((++step->fault_cnt % fault_every) != 0)) {
+        return 0;
+    }
+
+    step->fault_offset = offset;
+    return 1;
+}
+
+static UCS_F_ALWAYS_INLINE void ucg_builtin_step_fault_resume(ucg_builtin_op_step_t *step,
+                                                              int is_single_send)
+{
+    /* pipelined steps resend their (possibly many) pending fragments in order */
+    if (!is_single_send && (step->fault_offset != UCG_BUILTIN_FAULT_OFFSET_NONE)) {
+        ucs_assertv(step->iter_offset == step->fault_offset,
+                    "resend from offset %u, rather than %u", step->iter_offset,
+                    step->fault_offset);
+    }
+    step->fault_offset = UCG_BUILTIN_FAULT_OFFSET_NONE;
+}
+
+static UCS_F_ALWAYS_INLINE void ucg_builtin_step_fault_sent(ucg_builtin_op_step_t *step,
+                                                            int is_last_fragment)
+{
+    step->fault_sent++;
+    if (is_last_fragment) {
+        ucs_assertv(step->fault_sent == step->fragments, "sent %u fragments out of %u",
+                    step->fault_sent, step->fragments);
+        step->fault_sent = 0;
+    }
+}
+#else
+#define ucg_builtin_step_fault(_req, _step, _offset) 0
+#define ucg_builtin_step_fault_resume(_step, _is_single_send)
+#define ucg_builtin_step_fault_sent(_step, _is_last_fragment)
+#endif
+
 static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_dummy_send(ucg_builtin_request_t *req,
                                                                     ucg_builtin_op_step_t *step,
                                                                     uct_ep_h ep, int is_single_send)
@@ -43,6 +97,15 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_dummy_send(ucg_builtin_
     return UCS_OK;
 }
 
+static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_sent_ahead(ucg_builtin_request_t *req,
+                                                                    ucg_builtin_op_step_t *step,
+                                                                    uct_ep_h ep, int is_single_send)
+{
+    /* all the data was already sent, see @ref ucg_builtin_comp_ring_forward */
+    ucs_assert(step->flags & UCG_BUILTIN_OP_STEP_FLAG_SENT_AHEAD);
+    return UCS_OK;
+}
+
 static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_short_one(ucg_builtin_request_t *req,
                                                                       ucg_builtin_op_step_t *step,
                                                                       uct_ep_h ep, int is_single_send)
@@ -70,15 +133,20 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_short_max(ucg_builti
     ucs_status_t (*ep_am_short)(uct_ep_h, uint8_t, uint64_t, const void*, unsigned) =
             step->uct_iface->ops.ep_am_short;
     ucg_builtin_step_assert(step, UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_SHORT);
+    ucg_builtin_step_fault_resume(step, is_single_send);
 
     /* send every fragment but the last */
     if (ucs_likely(buffer_iter < buffer_iter_limit)) {
         do {
             ucs_debug("am_short_max step %u offset %" PRIu32 " length %u", step->am_header.step_idx, am_iter.remote_offset, frag_size);
-            status = ep_am_short(ep, am_id, am_iter.header, buffer_iter, frag_size);
+            status = ucg_builtin_step_fault(req, step, buffer_iter - step->send_buffer) ?
+                     UCS_ERR_NO_RESOURCE :
+                     ep_am_short(ep, am_id, am_iter.header, buffer_iter, frag_size);
 
             if (is_single_send) {
                 return status;
+            } else if (status == UCS_OK) {
+                ucg_builtin_step_fault_sent(step, 0);
             }
 
             buffer_iter           += frag_size;
@@ -96,22 +164,67 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_short_max(ucg_builti
     }
 
     ucs_debug("am_short_max step: %u; offset: %" PRIu32 "", step->am_header.step_idx, am_iter.remote_offset);
-    status = ep_am_short(ep, am_id, am_iter.header, buffer_iter, step->send_buffer + step->buffer_length - buffer_iter);
+    status = ucg_builtin_step_fault(req, step, buffer_iter - step->send_buffer) ?
+             UCS_ERR_NO_RESOURCE :
+             ep_am_short(ep, am_id, am_iter.header, buffer_iter,
+                         step->send_buffer + step->buffer_length - buffer_iter);
     /* iter_offset can not set to be zero for pipelining */
     if (!is_single_send) {
         step->iter_offset = (status == UCS_OK) ? 0 : buffer_iter - step->send_buffer;
+        if (status == UCS_OK) {
+            ucg_builtin_step_fault_sent(step, 1);
+        }
     }
 
     return status;
 }
 
+/* The rail to send the fragment at this offset on, see @ref ucg_builtin_plan_rail_t */
+static UCS_F_ALWAYS_INLINE unsigned ucg_builtin_step_rail(const ucg_builtin_op_step_t *step,
+                                                          size_t offset)
+{
+    if (ucs_likely(step->rail_cnt <= 1)) {
+        return 0;
+    }
+
+    return step->phase->rail_map[(offset / step->fragment_length) %
+                                 UCG_BUILTIN_RAIL_MAP_LEN];
+}
+
+/* The endpoint of the current peer (the one given being the first rail) */
+static UCS_F_ALWAYS_INLINE uct_ep_h ucg_builtin_step_rail_ep(const ucg_builtin_op_step_t *step,
+                                                             uct_ep_h ep, unsigned rail)
+{
+    unsigned peer;
+    if (ucs_likely(rail == 0)) {
+        return ep;
+    }
+
+    peer = (step->phase->ep_cnt == 1) ? 0 : step->iter_ep;
+    return step->phase->rail_eps[peer * (UCG_BUILTIN_MAX_RAILS - 1) + rail - 1];
+}
+
+static UCS_F_ALWAYS_INLINE uct_mem_h ucg_builtin_step_rail_memh(const ucg_builtin_op_step_t *step,
+                                                                unsigned rail)
+{
+    if (ucs_likely(rail == 0) || !ucg_builtin_step_rail_has_memh(step, rail)) {
+        return step->zcopy.memh;
+    }
+
+    return step->zcopy.rail_memh[rail - 1];
+}
+
 static size_t ucg_builtin_step_am_bcopy_single_frag_packer(void *dest, void *arg)
 {
     ucg_builtin_op_step_t *step      = (ucg_builtin_op_step_t*)arg;
     ucg_builtin_header_t *header_ptr = (ucg_builtin_header_t*)dest;
     header_ptr->header               = step->am_header.header;
 
-    memcpy(header_ptr + 1, step->send_buffer, step->buffer_length);
+    if (ucs_unlikely(step->displs_rule == UCG_BUILTIN_OP_STEP_DISPLS_RULE_BRUCK_ALLTOALL)) {
+        ucg_builtin_step_gather_runs(step, (int8_t*)(header_ptr + 1), 0, step->buffer_length);
+    } else {
+        memcpy(header_ptr + 1, step->send_buffer, step->buffer_length);
+    }
     return sizeof(*header_ptr) + step->buffer_length;
 }
 
@@ -121,7 +234,12 @@ static size_t ucg_builtin_step_am_bcopy_full_frag_packer(void *dest, void *arg)
     ucg_builtin_header_t *header_ptr = (ucg_builtin_header_t*)dest;
     header_ptr->header               = step->am_header.header;
 
-    memcpy(header_ptr + 1, step->send_buffer + step->iter_offset, step->fragment_length);
+    if (ucs_unlikely(step->displs_rule == UCG_BUILTIN_OP_STEP_DISPLS_RULE_BRUCK_ALLTOALL)) {
+        ucg_builtin_step_gather_runs(step, (int8_t*)(header_ptr + 1),
+                                     step->iter_offset, step->fragment_length);
+    } else {
+        memcpy(header_ptr + 1, step->send_buffer + step->iter_offset, step->fragment_length);
+    }
     return sizeof(*header_ptr) + step->fragment_length;
 }
 
@@ -132,7 +250,12 @@ static size_t ucg_builtin_step_am_bcopy_partial_frag_packer(void *dest, void *ar
     ucg_builtin_header_t *header_ptr = (ucg_builtin_header_t*)dest;
     header_ptr->header               = step->am_header.header;
 
-    memcpy(header_ptr + 1, step->send_buffer + step->iter_offset, last_frag_length);
+    if (ucs_unlikely(step->displs_rule == UCG_BUILTIN_OP_STEP_DISPLS_RULE_BRUCK_ALLTOALL)) {
+        ucg_builtin_step_gather_runs(step, (int8_t*)(header_ptr + 1),
+                                     step->iter_offset, last_frag_length);
+    } else {
+        memcpy(header_ptr + 1, step->send_buffer + step->iter_offset, last_frag_length);
+    }
     return sizeof(*header_ptr) + last_frag_length;
 }
 
@@ -154,26 +277,33 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_bcopy_max(ucg_builti
                                                                       uct_ep_h ep, int is_single_send)
 {
     ssize_t len;
+    uct_ep_h frag_ep;
     unsigned am_id           = step->am_id;
     ucg_offset_t frag_size   = step->fragment_length;
     ucg_offset_t iter_limit  = step->buffer_length - frag_size;
     if (is_single_send) {
         step->am_header.remote_offset = step->iter_offset;
     }
-    ssize_t (*ep_am_bcopy)(uct_ep_h, uint8_t, uct_pack_callback_t, void*, unsigned) =
-            step->uct_iface->ops.ep_am_bcopy;
 
     ucg_builtin_step_assert(step, UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY);
+    ucg_builtin_step_fault_resume(step, is_single_send);
 
     /* check if this is not, by any chance, the last fragment */
     if (ucs_likely(step->iter_offset < iter_limit)) {
         /* send every fragment but the last */
         do {
             ucs_debug("am_bcopy_max step %u offset %" PRIu32 " length %u", step->am_header.step_idx, step->am_header.remote_offset, frag_size);
-            len = ep_am_bcopy(ep, am_id, ucg_builtin_step_am_bcopy_full_frag_packer, step, 0);
+            frag_ep = ucg_builtin_step_rail_ep(step, ep,
+                    ucg_builtin_step_rail(step, step->iter_offset));
+            len     = ucg_builtin_step_fault(req, step, step->iter_offset) ?
+                      UCS_ERR_NO_RESOURCE :
+                      frag_ep->iface->ops.ep_am_bcopy(frag_ep, am_id,
+                              ucg_builtin_step_am_bcopy_full_frag_packer, step, 0);
 
             if (is_single_send) {
                 return ucs_unlikely(len < 0) ? (ucs_status_t)len : UCS_OK;
+            } else if (len >= 0) {
+                ucg_builtin_step_fault_sent(step, 0);
             }
 
             step->am_header.remote_offset += frag_size;
@@ -189,11 +319,19 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_bcopy_max(ucg_builti
 
     /* Send last fragment of the message */
     ucs_debug("am_bcopy_max step: %u; offset: %" PRIu32 "", step->am_header.step_idx, step->am_header.remote_offset);
-    len = ep_am_bcopy(ep, am_id, ucg_builtin_step_am_bcopy_partial_frag_packer, step, 0);
+    frag_ep = ucg_builtin_step_rail_ep(step, ep, ucg_builtin_step_rail(step, step->iter_offset));
+    len     = ucg_builtin_step_fault(req, step, step->iter_offset) ?
+              UCS_ERR_NO_RESOURCE :
+              frag_ep->iface->ops.ep_am_bcopy(frag_ep, am_id,
+                      ucg_builtin_step_am_bcopy_partial_frag_packer, step, 0);
     if (ucs_unlikely(len < 0)) {
         return (ucs_status_t)len;
     }
 
+    if (!is_single_send) {
+        ucg_builtin_step_fault_sent(step, 1);
+    }
+
     step->am_header.remote_offset = 0;
     /* iter_offset can not set to be zero for pipelining */
     if (!is_single_send) {
@@ -240,9 +378,8 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
     unsigned zcomp_index       = step->iter_ep * step->fragments +
                                  step->iter_offset / step->fragment_length;
     ucg_builtin_zcomp_t *zcomp = &step->zcopy.zcomp[zcomp_index];
-    ucs_status_t (*ep_am_zcopy)(uct_ep_h, uint8_t, const void*, unsigned,
-            const uct_iov_t*, size_t, unsigned, uct_completion_t*) =
-                    step->uct_iface->ops.ep_am_zcopy;
+    uct_ep_h frag_ep;
+    unsigned rail;
 
     uct_iov_t iov = {
         .buffer = step->send_buffer + step->iter_offset,
@@ -253,19 +390,28 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
     };
 
     ucg_builtin_step_assert(step, UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY);
+    ucg_builtin_step_fault_resume(step, is_single_send);
 
     /* check if this is not, by any chance, the last fragment */
     if (ucs_likely(iov.buffer < iov_buffer_limit)) {
         /* send every fragment but the last */
         do {
             ucs_debug("am_zcopy_max step %u offset %" PRIu32 " length %u", step->am_header.step_idx, step->am_header.remote_offset, frag_size);
-            status = ep_am_zcopy(ep, am_id, &step->am_header,
-                                 sizeof(step->am_header), &iov,
-                                 1, 0, &zcomp->comp);
+            rail     = ucg_builtin_step_rail(step, (int8_t*)iov.buffer - step->send_buffer);
+            frag_ep  = ucg_builtin_step_rail_ep(step, ep, rail);
+            iov.memh = ucg_builtin_step_rail_memh(step, rail);
+            status   = ucg_builtin_step_fault(req, step,
+                                              (int8_t*)iov.buffer - step->send_buffer) ?
+                       UCS_ERR_NO_RESOURCE :
+                       frag_ep->iface->ops.ep_am_zcopy(frag_ep, am_id, &step->am_header,
+                                                       sizeof(step->am_header), &iov,
+                                                       1, 0, &zcomp->comp);
             (zcomp++)->req = req;
 
             if (is_single_send) {
                 return status;
+            } else if (status == UCS_INPROGRESS) {
+                ucg_builtin_step_fault_sent(step, 0);
             }
 
             step->am_header.remote_offset += frag_size;
@@ -285,9 +431,15 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
     zcomp->req = req;
     iov.length = step->send_buffer + step->buffer_length - (int8_t*)iov.buffer;
     ucs_debug("am_zcopy_max step %u offset %" PRIu32 " length %zu", step->am_header.step_idx, step->am_header.remote_offset, iov.length);
-    status     = ep_am_zcopy(ep, am_id, &step->am_header,
-                             sizeof(step->am_header),
-                             &iov, 1, 0, &zcomp->comp);
+    rail       = ucg_builtin_step_rail(step, (int8_t*)iov.buffer - step->send_buffer);
+    frag_ep    = ucg_builtin_step_rail_ep(step, ep, rail);
+    iov.memh   = ucg_builtin_step_rail_memh(step, rail);
+    status     = ucg_builtin_step_fault(req, step,
+                                        (int8_t*)iov.buffer - step->send_buffer) ?
+                 UCS_ERR_NO_RESOURCE :
+                 frag_ep->iface->ops.ep_am_zcopy(frag_ep, am_id, &step->am_header,
+                                                 sizeof(step->am_header),
+                                                 &iov, 1, 0, &zcomp->comp);
     if (ucs_unlikely(status != UCS_INPROGRESS)) {
         if (!is_single_send) {
             step->iter_offset = (int8_t*)iov.buffer - step->send_buffer;
@@ -296,6 +448,10 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
         return status;
     }
 
+    if (!is_single_send) {
+        ucg_builtin_step_fault_sent(step, 1);
+    }
+
     step->am_header.remote_offset = 0;
     /* iter_offset can not set to be zero for pipelining */
     if (!is_single_send) {
@@ -304,6 +460,40 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
     return UCS_OK;
 }
 
+static size_t ucg_builtin_step_rndv_packer(void *dest, void *arg)
+{
+    ucg_builtin_op_step_t *step      = (ucg_builtin_op_step_t*)arg;
+    ucg_builtin_header_t *header_ptr = (ucg_builtin_header_t*)dest;
+    ucg_builtin_rndv_header_t *rndv  = (ucg_builtin_rndv_header_t*)(header_ptr + 1);
+    size_t rkey_length;
+    header_ptr->header               = step->am_header.header;
+    rndv->address                    = (uintptr_t)ucg_builtin_step_rndv_buffer(step);
+    rndv->host_id                    = step->phase->rndv_host_id;
+    rndv->pid                        = (uint32_t)getpid();
+
+    /* only the receivers on other nodes need the key (if any) */
+    if (step->rndv.rkey_buffer == NULL) {
+        return sizeof(*header_ptr) + sizeof(*rndv);
+    }
+
+    rkey_length = step->phase->md_attr->rkey_packed_size;
+    memcpy(rndv + 1, step->rndv.rkey_buffer, rkey_length);
+    return sizeof(*header_ptr) + sizeof(*rndv) + rkey_length;
+}
+
+static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_rndv_send(ucg_builtin_request_t *req,
+                                                                   ucg_builtin_op_step_t *step,
+                                                                   uct_ep_h ep, int is_single_send)
+{
+    ucg_builtin_step_assert(step, UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY);
+
+    /* send only the address of the buffer, see @ref ucg_builtin_comp_rndv_cb */
+    ucs_debug("rndv_send step %u length %zu", step->am_header.step_idx, step->buffer_length);
+    ssize_t len = step->uct_iface->ops.ep_am_bcopy(ep, step->am_id,
+                                                   ucg_builtin_step_rndv_packer, step, 0);
+    return (ucs_unlikely(len < 0)) ? (ucs_status_t)len : UCS_OK;
+}
+
 /*
  * Below is a set of macros, generating most bit-field combinations of
  * step->flags inside @ref ucg_builtin_step_execute() .
@@ -358,6 +548,8 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
             ep_iter += (step)->iter_ep;                                          \
             ep_last += (phase)->ep_cnt;                                          \
             do {                                                                 \
+                /* the current peer, e.g. for its other rails */                 \
+                (step)->iter_ep = ep_iter - (phase)->multi_eps;                  \
                 status = _send_func (req, step, *ep_iter, is_pipelined);         \
                 if (ucs_unlikely(UCS_STATUS_IS_ERR(status))) {                   \
                     /* Store the pointer, e.g. for UCS_ERR_NO_RESOURCE */        \
@@ -417,7 +609,7 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
         }                                                                        \
                                                                                  \
         /* Potential completions (the operation may have finished by now) */     \
-        if ((!is_recv && !is_zcopy) || ((req)->pending == 0)) {                  \
+        if ((!is_recv && !is_zcopy && !is_rndv) || ((req)->pending == 0)) {      \
             /* Nothing else to do - complete this step */                        \
             if (is_last) {                                                       \
                 if (!(ureq)) {                                                   \
@@ -447,6 +639,266 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_am_zcopy_max(ucg_builti
         user_req = NULL;                                                         \
     }                                                                            \
 }
+
+/*
+ * Node-local steps go through the shared-memory segment of the group (see
+ * @ref ucg_builtin_shm_t): the slots of the collective's window slot are ready
+ * once their sequence number reaches "seq", i.e. the next one after the last
+ * collective which used that window slot. The leader of the node reduces the
+ * data of all the other members (in order), or posts the result for them.
+ */
+static ucs_status_t ucg_builtin_step_shm_fanin(ucg_builtin_request_t *req,
+                                               ucg_builtin_shm_t *shm,
+                                               unsigned coll_slot, uint64_t seq)
+{
+    ucg_builtin_op_step_t *step = req->step;
+    ucg_builtin_shm_slot_t *shm_slot;
+
+    if (shm->local_idx != 0) {
+        shm_slot = ucg_builtin_shm_slot(shm, coll_slot, shm->local_idx);
+        memcpy(shm_slot->data, step->recv_buffer, step->buffer_length);
+        ucs_memory_cpu_store_fence();
+        shm_slot->seq = seq;
+        return UCS_OK;
+    }
+
+    /* the iterator counts the members already reduced, across invocations */
+    while (step->iter_offset < shm->local_cnt - 1) {
+        shm_slot = ucg_builtin_shm_slot(shm, coll_slot, step->iter_offset + 1);
+        if (shm_slot->seq < seq) {
+            return UCS_INPROGRESS;
+        }
+
+        ucs_memory_cpu_load_fence();
+        if (step->buffer_length != 0) {
+            ucg_builtin_mpi_reduce(req, shm_slot->data, step->recv_buffer,
+                                   req->op->super.params.recv.count);
+        }
+        step->iter_offset++;
+    }
+
+    step->iter_offset = 0;
+    return UCS_OK;
+}
+
+static ucs_status_t ucg_builtin_step_shm_fanout(ucg_builtin_request_t *req,
+                                                ucg_builtin_shm_t *shm,
+                                                unsigned coll_slot, uint64_t seq)
+{
+    ucg_builtin_op_step_t *step      = req->step;
+    ucg_builtin_shm_slot_t *shm_slot = ucg_builtin_shm_slot(shm, coll_slot, 0);
+
+    if (shm->local_idx == 0) {
+        memcpy(shm_slot->data, step->recv_buffer, step->buffer_length);
+        ucs_memory_cpu_store_fence();
+        shm_slot->seq = seq;
+    } else if (shm_slot->seq >= seq) {
+        ucs_memory_cpu_load_fence();
+        memcpy(step->recv_buffer, shm_slot->data, step->buffer_length);
+    } else {
+        return UCS_INPROGRESS;
+    }
+
+    /* this is the last step using the slots, so the next collective may */
+    shm->seq[coll_slot] = seq;
+    return UCS_OK;
+}
+
+/*
+ * Larger vectors are reduce-scattered and allgathered by all the members of the
+ * node: each one reduces its own slice of the vector (see @ref ucg_builtin_slice),
+ * reading that slice from the buffers of the others, and later reads their slices
+ * once they are final. Every member posts the address of its buffer in its slot,
+ * and then the progress of the collective in its sequence number - each stage
+ * of it is a sequence number of its own, following the last collective's "seq".
+ */
+enum ucg_builtin_shm_stage {
+    UCG_BUILTIN_SHM_STAGE_POSTED  = 1, /* the buffer's address is in the slot */
+    UCG_BUILTIN_SHM_STAGE_REDUCED = 2, /* the member's slice of it is final */
+    UCG_BUILTIN_SHM_STAGE_READ    = 3  /* the member is done reading the others' */
+};
+
+#define UCG_BUILTIN_SHM_READ_CHUNK (64 * UCS_KBYTE) /* reduced at a time */
+
+static UCS_F_ALWAYS_INLINE void ucg_builtin_shm_post(ucg_builtin_shm_slot_t *shm_slot,
+                                                     uint64_t seq)
+{
+    if (shm_slot->seq < seq) {
+        ucs_memory_cpu_store_fence();
+        shm_slot->seq = seq;
+    }
+}
+
+static ucs_status_t ucg_builtin_step_shm_reduce_scatter(ucg_builtin_request_t *req,
+                                                        ucg_builtin_shm_t *shm,
+                                                        unsigned coll_slot, uint64_t seq)
+{
+    ucg_builtin_op_step_t *step      = req->step;
+    ucg_builtin_shm_slot_t *my_slot  = ucg_builtin_shm_slot(shm, coll_slot, shm->local_idx);
+    size_t dt_len                    = req->op->super.params.send.dt_len;
+    int chunk_count                  = ucs_max(UCG_BUILTIN_SHM_READ_CHUNK / dt_len, 1);
+    ucg_builtin_shm_slot_t *shm_slot;
+    int start, count, offset, length;
+    ucs_status_t status;
+    int8_t *temp;
+
+    my_slot->addr = (uintptr_t)step->recv_buffer;
+    my_slot->pid  = getpid();
+    ucg_builtin_shm_post(my_slot, seq + UCG_BUILTIN_SHM_STAGE_POSTED);
+
+    ucg_builtin_slice(req->op->super.params.send.count, shm->local_cnt,
+                      shm->local_idx, &start, &count);
+    if ((count == 0) || (shm->local_cnt == 1)) {
+        return UCS_OK;
+    }
+
+    temp = (int8_t*)ucg_builtin_scratch_get(req->op->scratch,
+                                            ucs_min(count, chunk_count) * dt_len);
+    if (temp == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    /* the iterator counts the members already reduced, each starting from the next one */
+    status = UCS_OK;
+    while (step->iter_offset < shm->local_cnt - 1) {
+        shm_slot = ucg_builtin_shm_slot(shm, coll_slot, (shm->local_idx + 1 +
+                                        step->iter_offset) % shm->local_cnt);
+        if (shm_slot->seq < seq + UCG_BUILTIN_SHM_STAGE_POSTED) {
+            status = UCS_INPROGRESS;
+            break;
+        }
+
+        ucs_memory_cpu_load_fence();
+        for (offset = start; offset < start + count; offset += length) {
+            length = ucs_min(chunk_count, start + count - offset);
+            status = ucg_builtin_shm_cma_read(shm_slot->pid, temp,
+                                              shm_slot->addr + (offset * dt_len),
+                                              length * dt_len);
+            if (ucs_unlikely(status != UCS_OK)) {
+                goto out;
+            }
+
+            ucg_builtin_mpi_reduce(req, temp, step->recv_buffer + (offset * dt_len), length);
+        }
+        step->iter_offset++;
+    }
+
+out:
+    ucg_builtin_scratch_put(req->op->scratch, temp);
+    if (status == UCS_OK) {
+        step->iter_offset = 0;
+    }
+    return status;
+}
+
+static ucs_status_t ucg_builtin_step_shm_allgather(ucg_builtin_request_t *req,
+                                                   ucg_builtin_shm_t *shm,
+                                                   unsigned coll_slot, uint64_t seq)
+{
+    ucg_builtin_op_step_t *step     = req->step;
+    ucg_builtin_shm_slot_t *my_slot = ucg_builtin_shm_slot(shm, coll_slot, shm->local_idx);
+    size_t dt_len                   = req->op->super.params.send.dt_len;
+    ucg_group_member_index_t peer;
+    ucg_builtin_shm_slot_t *shm_slot;
+    ucs_status_t status;
+    int start, count;
+
+    ucg_builtin_shm_post(my_slot, seq + UCG_BUILTIN_SHM_STAGE_REDUCED);
+
+    /* first read the slices of the others, then wait for them to read mine */
+    while (step->iter_offset < 2 * (shm->local_cnt - 1)) {
+        peer     = (shm->local_idx + 1 + (step->iter_offset % (shm->local_cnt - 1))) %
+                   shm->local_cnt;
+        shm_slot = ucg_builtin_shm_slot(shm, coll_slot, peer);
+        if (step->iter_offset >= shm->local_cnt - 1) {
+            ucg_builtin_shm_post(my_slot, seq + UCG_BUILTIN_SHM_STAGE_READ);
+            if (shm_slot->seq < seq + UCG_BUILTIN_SHM_STAGE_READ) {
+                return UCS_INPROGRESS;
+            }
+        } else if (shm_slot->seq < seq + UCG_BUILTIN_SHM_STAGE_REDUCED) {
+            return UCS_INPROGRESS;
+        } else {
+            ucs_memory_cpu_load_fence();
+            ucg_builtin_slice(req->op->super.params.send.count, shm->local_cnt,
+                              peer, &start, &count);
+            status = ucg_builtin_shm_cma_read(shm_slot->pid,
+                                              step->recv_buffer + (start * dt_len),
+                                              shm_slot->addr + (start * dt_len),
+                                              count * dt_len);
+            if (ucs_unlikely(status != UCS_OK)) {
+                return status;
+            }
+        }
+        step->iter_offset++;
+    }
+
+    /* also if alone on the node, the next collective is after all the stages */
+    step->iter_offset   = 0;
+    shm->seq[coll_slot] = seq + UCG_BUILTIN_SHM_STAGE_READ;
+    return UCS_OK;
+}
+
+static ucs_status_t ucg_builtin_step_shm_execute(ucg_builtin_request_t *req,
+                                                 ucg_request_t **user_req)
+{
+    ucg_builtin_op_step_t *step   = req->step;
+    ucg_builtin_shm_t *shm        = req->op->shm;
+    ucg_builtin_comp_slot_t *slot = ucs_container_of(req, ucg_builtin_comp_slot_t, req);
+    unsigned coll_slot            = slot->coll_id & req->op->slot_mask;
+    ucs_status_t status           = UCS_OK;
+    uint64_t seq;
+
+    /* the leader may not have created the segment by the time it was planned */
+    if (ucs_unlikely(shm->seg == NULL)) {
+        status = ucg_builtin_shm_attach(shm);
+    }
+
+    if (ucs_likely(status == UCS_OK)) {
+        seq = shm->seq[coll_slot];
+        switch (step->phase->method) {
+            case UCG_PLAN_METHOD_SHM_FANIN:
+                status = ucg_builtin_step_shm_fanin(req, shm, coll_slot, seq + 1);
+                break;
+
+            case UCG_PLAN_METHOD_SHM_FANOUT:
+                status = ucg_builtin_step_shm_fanout(req, shm, coll_slot, seq + 1);
+                break;
+
+            case UCG_PLAN_METHOD_SHM_REDUCE_SCATTER:
+                status = ucg_builtin_step_shm_reduce_scatter(req, shm, coll_slot, seq);
+                break;
+
+            default:
+                status = ucg_builtin_step_shm_allgather(req, shm, coll_slot, seq);
+                break;
+        }
+    }
+
+    if (status == UCS_INPROGRESS) {
+        /* no message will arrive, so the progress function polls it again */
+        INIT_USER_REQUEST_IF_GIVEN(user_req, req);
+        slot->cb = step->recv_cb;
+        ucs_list_add_tail(req->op->resend, &req->send_list);
+        return UCS_INPROGRESS;
+    } else if (ucs_unlikely(status != UCS_OK)) {
+        INIT_USER_REQUEST_IF_GIVEN(user_req, req);
+        ucg_builtin_comp_last_step_cb(req, status);
+        return status;
+    }
+
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP) {
+        if (user_req == NULL) {
+            ucg_builtin_comp_last_step_cb(req, UCS_OK);
+            if (step->buffer_length == 0) { /* barrier */
+                ucg_collective_release_barrier(req->op->super.plan->group);
+            }
+        }
+        return UCS_OK;
+    }
+
+    return ucg_builtin_comp_step_cb(req, user_req);
+}
+
 /*
  * Executing a single step is the heart of the Builtin planner.
  * This function advances to the next step (some invocations negate that...),
@@ -476,7 +928,7 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_step_execute, (req, user_req),
     /* Step-completion-related indicators */
     int is_last, is_one_ep, is_resend;
     /* Send-related  parameters */
-    int is_scatter, is_fragmented;
+    int is_scatter, is_fragmented, is_rndv;
 
     uint16_t local_id;
     ucs_status_t status;
@@ -508,10 +960,38 @@ UCS_PROFILE_FUNC(ucs_status_t, ucg_builtin_step_execute, (req, user_req),
     is_bcopy      = step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY;
     is_zcopy      = step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY;
     is_fragmented = step->flags & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED;
+    is_rndv       = step->flags & UCG_BUILTIN_OP_STEP_FLAG_RNDV;
+
+    /* for a step which only polls the node-local shared memory */
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SHM) {
+        return ucg_builtin_step_shm_execute(req, user_req);
+    }
+
+    /* a rendezvous read (or its acknowledgement) which was out of resources */
+    if (ucs_unlikely(is_rndv && (step->rndv.state != UCG_BUILTIN_OP_STEP_RNDV_IDLE))) {
+        (void) ((step->rndv.state == UCG_BUILTIN_OP_STEP_RNDV_READ) ?
+                ucg_builtin_step_rndv_read(req) : ucg_builtin_step_rndv_ack(req));
+        return UCS_INPROGRESS;
+    }
 
     /* for recv-only step */
     if (is_dummy) case_send(req, user_req, step, phase, ucg_builtin_step_dummy_send);
 
+    /* for a step which the previous one has already sent entirely */
+    if (ucs_unlikely((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SENT_AHEAD) &&
+                     (step->buffer_length != 0) &&
+                     (step->iter_offset == step->buffer_length))) {
+        step->iter_offset = 0;
+        case_send(req, user_req, step, phase, ucg_builtin_step_sent_ahead);
+        goto finish_send;
+    }
+
+    /* for a step which the receivers read from, once they get its address */
+    if (ucs_unlikely(is_rndv && is_bcopy)) {
+        case_send(req, user_req, step, phase, ucg_builtin_step_rndv_send);
+        goto finish_send;
+    }
+
     if (!is_fragmented) { /* Single-send operations (only one fragment passed to UCT) */
         if (is_short) {
             case_send(req, user_req, step, phase, ucg_builtin_step_am_short_one);
@@ -623,18 +1103,6 @@ ucs_status_t ucg_builtin_msg_process(ucg_builtin_comp_slot_t *slot, ucg_builtin_
             /* Remove the packet (next call may lead here recursively) */
             ucs_list_del(&desc->super.tag_list[0]);
 
-            char *header_tmp = &desc->data[0];
-            char *recv_buffer_tmp = (char *)slot->req.step->recv_buffer;
-            size_t real_length = desc->super.length;
-            if (req->step->phase->is_swap) {
-                char *temp_buffer = (char*)UCS_ALLOC_CHECK(real_length, "temp buffer");
-                memcpy(temp_buffer, header_tmp, real_length);
-                memcpy(header_tmp, recv_buffer_tmp + desc->header.remote_offset, real_length);
-                memcpy(recv_buffer_tmp + desc->header.remote_offset, temp_buffer, real_length);
-                free(temp_buffer);
-                temp_buffer = NULL;
-            }
-
             /* Handle this "waiting" packet, possibly completing the step */
             int is_step_done = step->recv_cb(&slot->req,
                                              desc->header.remote_offset, &desc->data[0],
@@ -660,40 +1128,241 @@ ucs_status_t ucg_builtin_msg_process(ucg_builtin_comp_slot_t *slot, ucg_builtin_
     return UCS_INPROGRESS;
 }
 
+static void ucg_builtin_step_release(ucg_builtin_op_t *builtin_op,
+                                     ucg_builtin_op_step_t *step)
+{
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) {
+        /* scratch buffers stay registered, for the next operation */
+        if (!(step->flags & UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER)) {
+            ucg_builtin_step_mem_dereg(step, step->zcopy.memh, step->zcopy.region);
+            ucg_builtin_step_rails_dereg(step, step->rail_cnt, step->zcopy.rail_memh,
+                                         step->zcopy.rail_region);
+        }
+        if (step->zcopy.zcomp != NULL) {
+            ucg_builtin_scratch_put(builtin_op->scratch, step->zcopy.zcomp);
+            step->zcopy.zcomp = NULL;
+        }
+    }
+
+    if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_RNDV) && !step->phase->rndv_cma) {
+        ucg_builtin_step_mem_dereg(step, step->rndv.memh, step->rndv.region);
+        if (step->rndv.rkey_buffer != NULL) {
+            ucg_builtin_scratch_put(builtin_op->scratch, step->rndv.rkey_buffer);
+            step->rndv.rkey_buffer = NULL;
+        }
+    }
+
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER) {
+        ucg_builtin_scratch_put(builtin_op->scratch, step->send_buffer);
+    }
+
+    if (step->fragment_pending != NULL) {
+        ucg_builtin_scratch_put(builtin_op->scratch, (void*)step->fragment_pending);
+        step->fragment_pending = NULL;
+    }
+}
+
 void ucg_builtin_op_discard(ucg_op_t *op)
 {
     ucg_builtin_op_t *builtin_op = (ucg_builtin_op_t*)op;
     ucg_builtin_op_step_t *step = &builtin_op->steps[0];
     do {
-        if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) {
-            uct_md_mem_dereg(step->uct_md, step->zcopy.memh);
-            if (step->zcopy.zcomp != NULL) {
-                ucs_free(step->zcopy.zcomp);
-                step->zcopy.zcomp = NULL;
-            }
+        ucg_builtin_step_release(builtin_op, step);
+    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+
+    if (builtin_op->reduce_scratch != NULL) {
+        ucg_builtin_scratch_put(builtin_op->scratch, builtin_op->reduce_scratch);
+        builtin_op->reduce_scratch = NULL;
+    }
+
+    ucs_mpool_put_inline(op);
+}
+
+static UCS_F_ALWAYS_INLINE int8_t *ucg_builtin_step_rebase(int8_t *buffer, uint8_t base,
+                                                           const void *old_sbuf, void *old_rbuf,
+                                                           const void *sbuf, void *rbuf)
+{
+    switch (base) {
+        case UCG_BUILTIN_OP_STEP_BUFFER_SEND:
+            return (int8_t*)sbuf + (buffer - (const int8_t*)old_sbuf);
+
+        case UCG_BUILTIN_OP_STEP_BUFFER_RECV:
+            return (int8_t*)rbuf + (buffer - (int8_t*)old_rbuf);
+
+        default:
+            return buffer;
+    }
+}
+
+/* New buffers (and registrations) of a step, until all the steps have them */
+typedef struct ucg_builtin_step_rebind {
+    int8_t                      *send_buffer;
+    int8_t                      *recv_buffer;
+    int                          is_zcopy_reg;
+    uct_mem_h                    zcopy_memh;
+    ucg_builtin_rcache_region_t *zcopy_region;
+    uct_mem_h                    rail_memh[UCG_BUILTIN_MAX_RAILS - 1];
+    ucg_builtin_rcache_region_t *rail_region[UCG_BUILTIN_MAX_RAILS - 1];
+    int                          is_rndv_reg;
+    uct_mem_h                    rndv_memh;
+    ucg_builtin_rcache_region_t *rndv_region;
+} ucg_builtin_step_rebind_t;
+
+static void ucg_builtin_step_rebind_abort(ucg_builtin_op_step_t *step,
+                                          ucg_builtin_step_rebind_t *rebind)
+{
+    if (rebind->is_rndv_reg) {
+        ucg_builtin_step_mem_dereg(step, rebind->rndv_memh, rebind->rndv_region);
+    }
+
+    if (rebind->is_zcopy_reg) {
+        ucg_builtin_step_mem_dereg(step, rebind->zcopy_memh, rebind->zcopy_region);
+        ucg_builtin_step_rails_dereg(step, step->rail_cnt, rebind->rail_memh,
+                                     rebind->rail_region);
+    }
+}
+
+/* Registers the new buffers of a step, leaving the step itself untouched */
+static ucs_status_t ucg_builtin_step_rebind_prepare(ucg_builtin_op_step_t *step,
+                                                    const void *old_sbuf, void *old_rbuf,
+                                                    const void *sbuf, void *rbuf,
+                                                    ucg_builtin_step_rebind_t *rebind)
+{
+    ucs_status_t status;
+
+    rebind->send_buffer  = ucg_builtin_step_rebase(step->send_buffer, step->send_base,
+                                                   old_sbuf, old_rbuf, sbuf, rbuf);
+    rebind->recv_buffer  = ucg_builtin_step_rebase(step->recv_buffer, step->recv_base,
+                                                   old_sbuf, old_rbuf, sbuf, rbuf);
+    rebind->is_zcopy_reg = 0;
+    rebind->is_rndv_reg  = 0;
+
+    /* only the registration of the send buffer depends on its address */
+    if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) &&
+        (rebind->send_buffer != step->send_buffer)) {
+        status = ucg_builtin_step_mem_reg(step, rebind->send_buffer, PROT_READ,
+                                          &rebind->zcopy_memh, &rebind->zcopy_region);
+        if (status != UCS_OK) {
+            return status;
         }
 
-        if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_PIPELINED) {
-            if (step->zcopy.zcomp != NULL) {
-                ucs_free((void*)step->fragment_pending);
-                step->fragment_pending = NULL;
+        status = ucg_builtin_step_rails_reg(step, rebind->send_buffer,
+                                            rebind->rail_memh, rebind->rail_region);
+        if (status != UCS_OK) {
+            ucg_builtin_step_mem_dereg(step, rebind->zcopy_memh, rebind->zcopy_region);
+            return status;
+        }
+
+        rebind->is_zcopy_reg = 1;
+    }
+
+    /* a rendezvous step has the buffer it's read from (or into) registered too */
+    if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_RNDV) && !step->phase->rndv_cma &&
+        ((rebind->send_buffer != step->send_buffer) ||
+         (rebind->recv_buffer != step->recv_buffer))) {
+        status = ucg_builtin_step_rndv_reg(step,
+                (step->phase->method == UCG_PLAN_METHOD_SEND_TERMINAL) ?
+                rebind->send_buffer : rebind->recv_buffer,
+                &rebind->rndv_memh, &rebind->rndv_region);
+        if (status != UCS_OK) {
+            ucg_builtin_step_rebind_abort(step, rebind);
+            return status;
+        }
+
+        rebind->is_rndv_reg = 1;
+    }
+
+    return UCS_OK;
+}
+
+/* Switches a step to its new buffers, releasing the old registrations */
+static void ucg_builtin_step_rebind_commit(ucg_builtin_op_step_t *step,
+                                           ucg_builtin_step_rebind_t *rebind)
+{
+    if (rebind->is_zcopy_reg) {
+        ucg_builtin_step_mem_dereg(step, step->zcopy.memh, step->zcopy.region);
+        ucg_builtin_step_rails_dereg(step, step->rail_cnt, step->zcopy.rail_memh,
+                                     step->zcopy.rail_region);
+        step->zcopy.memh   = rebind->zcopy_memh;
+        step->zcopy.region = rebind->zcopy_region;
+        memcpy(step->zcopy.rail_memh, rebind->rail_memh, sizeof(rebind->rail_memh));
+        memcpy(step->zcopy.rail_region, rebind->rail_region, sizeof(rebind->rail_region));
+    }
+
+    if (rebind->is_rndv_reg) {
+        ucg_builtin_step_mem_dereg(step, step->rndv.memh, step->rndv.region);
+        step->rndv.memh   = rebind->rndv_memh;
+        step->rndv.region = rebind->rndv_region;
+    }
+
+    step->send_buffer = rebind->send_buffer;
+    step->recv_buffer = rebind->recv_buffer;
+}
+
+ucs_status_t ucg_builtin_op_rebind(ucg_op_t *op, const void *sbuf, void *rbuf)
+{
+    ucg_builtin_op_t *builtin_op = (ucg_builtin_op_t*)op;
+    ucg_builtin_plan_t *plan     = ucs_derived_of(op->plan, ucg_builtin_plan_t);
+    const void *old_sbuf         = op->params.send.buf;
+    void *old_rbuf               = op->params.recv.buf;
+    ucg_builtin_step_rebind_t *rebind;
+    ucs_status_t status;
+    unsigned i, step_cnt;
+
+    /* in-place operations copy their data differently, so they are not interchangeable */
+    if ((old_sbuf == MPI_IN_PLACE) != (sbuf == MPI_IN_PLACE)) {
+        return UCS_ERR_UNSUPPORTED;
+    }
+
+    /* the buffers of an operation in progress must not be touched */
+    for (i = 0; i <= builtin_op->slot_mask; i++) {
+        if ((builtin_op->slots[i].cb != NULL) && (builtin_op->slots[i].req.op == builtin_op)) {
+            return UCS_ERR_BUSY;
+        }
+    }
+
+    rebind = ucg_builtin_scratch_get(builtin_op->scratch,
+                                     plan->phs_cnt * sizeof(*rebind));
+    if (rebind == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    /* register all the new buffers first, so a failure leaves the old ones */
+    step_cnt = 0;
+    do {
+        status = ucg_builtin_step_rebind_prepare(&builtin_op->steps[step_cnt],
+                                                 old_sbuf, old_rbuf, sbuf, rbuf,
+                                                 &rebind[step_cnt]);
+        if (ucs_unlikely(status != UCS_OK)) {
+            while (step_cnt-- > 0) {
+                ucg_builtin_step_rebind_abort(&builtin_op->steps[step_cnt],
+                                              &rebind[step_cnt]);
             }
+            goto out;
         }
-    } while (!((step++)->flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
+    } while (!(builtin_op->steps[step_cnt++].flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP));
 
-    ucs_mpool_put_inline(op);
+    for (i = 0; i < step_cnt; i++) {
+        ucg_builtin_step_rebind_commit(&builtin_op->steps[i], &rebind[i]);
+    }
+
+out:
+    ucg_builtin_scratch_put(builtin_op->scratch, rebind);
+    return status;
 }
 
 ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op, ucg_coll_id_t coll_id, ucg_request_t **request)
 {
     /* Allocate a "slot" for this operation, from a per-group array of slots */
     ucg_builtin_op_t *builtin_op  = (ucg_builtin_op_t*)op;
-    ucg_builtin_comp_slot_t *slot = &builtin_op->slots[coll_id % UCG_BUILTIN_MAX_CONCURRENT_OPS];
-    slot->coll_id                 = coll_id;
+    ucg_builtin_comp_slot_t *slot = &builtin_op->slots[coll_id & builtin_op->slot_mask];
     if (ucs_unlikely(slot->cb != NULL)) {
-        ucs_error("UCG Builtin planner exceeded the max concurrent collectives.");
+        /* the window is full - the caller queues this operation for later */
+        ucs_debug("no free slot for collective #%u (window of %u)",
+                  coll_id, builtin_op->slot_mask + 1);
         return UCS_ERR_NO_RESOURCE;
     }
+    slot->coll_id                 = coll_id;
 
     /* Initialize the request structure, located inside the selected slot s */
     ucg_builtin_request_t *builtin_req = &slot->req;
@@ -729,7 +1398,13 @@ ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op, ucg_coll_id_t coll_id, ucg_req
     }
 
     /* Start the first step, which may actually complete the entire operation */
-    return ucg_builtin_step_execute(builtin_req, request);
+    op->flags |= UCG_OP_FLAG_IN_FLIGHT;
+
+    ucs_status_t status = ucg_builtin_step_execute(builtin_req, request);
+    if (status != UCS_INPROGRESS) {
+        op->flags &= ~UCG_OP_FLAG_IN_FLIGHT;
+    }
+    return status;
 }
 
 /******************************************************************************
@@ -740,6 +1415,7 @@ ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op, ucg_coll_id_t coll_id, ucg_req
 static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_send_flags(ucg_builtin_op_step_t *step,
                                                                     ucg_builtin_plan_phase_t *phase,
                                                                     const ucg_collective_params_t *params,
+                                                                    ucg_builtin_scratch_t *scratch,
                                                                     enum ucg_builtin_op_step_flags *send_flag)
 {
     size_t length = step->buffer_length;
@@ -772,6 +1448,36 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_send_flags(ucg_builtin_
         partial_length = (length % step->fragment_length) > 0;
         step->fragments = length / step->fragment_length + partial_length;
 
+    /*
+     * Pipelined plans - every phase sends the same segments (regardless of the
+     * transport's zcopy threshold), so a waypoint may pass each one on as it arrives
+     */
+    } else if (ucs_unlikely((phase->segment_length != 0) &&
+                            (length > phase->segment_length) &&
+                            (dt_len <= phase->segment_length) &&
+                            (dt_len <= phase->send_thresh.max_bcopy_one))) {
+        /* BCopy send - one message per segment */
+        size_t segment        = ucs_min(phase->segment_length,
+                                        phase->send_thresh.max_bcopy_one);
+        step->fragment_length = segment - (segment % dt_len);
+        *send_flag = (enum ucg_builtin_op_step_flags)(UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY |
+                UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED);
+        partial_length = (length % step->fragment_length) > 0;
+        step->fragments = length / step->fragment_length + partial_length;
+
+    /*
+     * Rendezvous - only the address of the buffer is sent, and every receiver
+     * reads the data from it directly (e.g. RDMA "read"), by itself
+     */
+    } else if (ucs_unlikely((length >= phase->rndv_thresh) &&
+                            (params->type.modifiers ==
+                             ucg_predefined_modifiers[UCG_PRIMITIVE_BCAST]))) {
+        *send_flag = (enum ucg_builtin_op_step_flags)(UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY |
+                UCG_BUILTIN_OP_STEP_FLAG_RNDV);
+        step->fragment_length = step->buffer_length;
+        step->fragments       = 1;
+        return ucg_builtin_step_rndv_prep(step, scratch);
+
     /*
      * Large messages, if supported (e.g. RDMA "zero-copy")
      */
@@ -797,7 +1503,7 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_send_flags(ucg_builtin_
 
         if (phase->method != UCG_PLAN_METHOD_RECV_TERMINAL && phase->method != UCG_PLAN_METHOD_REDUCE_TERMINAL) {
             /* memory registration (using the memory registration cache) */
-            ucs_status_t status = ucg_builtin_step_zcopy_prep(step);
+            ucs_status_t status = ucg_builtin_step_zcopy_prep(step, scratch);
             if (ucs_unlikely(status != UCS_OK)) {
                 return status;
             }
@@ -832,6 +1538,17 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_send_flags(ucg_builtin_
 }
 
 
+/* Only segments (which all the phases agree on) may be passed on one at a time */
+static UCS_F_ALWAYS_INLINE int ucg_builtin_step_is_pipelined(const ucg_builtin_op_step_t *step,
+                                                             const ucg_builtin_plan_phase_t *phase,
+                                                             enum ucg_builtin_op_step_flags send_flag)
+{
+    return (phase->segment_length != 0) &&
+           (send_flag & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY) &&
+           (send_flag & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) &&
+           (step->fragment_length <= phase->segment_length);
+}
+
 static UCS_F_ALWAYS_INLINE void ucg_builtin_step_fragment_flags(size_t thresh_one,
                                                                 size_t dt_len,
                                                                 size_t length,
@@ -873,9 +1590,11 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_recv_flags(ucg_builtin_
     size_t fragment_length = 0;
     unsigned partial_length = 0;
 
-    /* for ring, the length of send_buffer and recv_buffer may be different */
+    /* for ring (or halving), the length of send_buffer and recv_buffer may be different */
     if (phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_RING ||
-        phase->method == UCG_PLAN_METHOD_ALLGATHER_RING) {
+        phase->method == UCG_PLAN_METHOD_ALLGATHER_RING ||
+        phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING ||
+        phase->method == UCG_PLAN_METHOD_ALLGATHER_DOUBLING) {
         length = step->buffer_length_recv;
     }
     /*
@@ -888,6 +1607,16 @@ static UCS_F_ALWAYS_INLINE ucs_status_t ucg_builtin_step_recv_flags(ucg_builtin_
         /* Short send - multiple messages */
         ucg_builtin_step_fragment_flags(phase->recv_thresh.max_short_one, dt_len, length,
                                         step, phase, recv_flag);
+    /*
+     * Pipelined plans - the same segments as in @ref ucg_builtin_step_send_flags
+     */
+    } else if (ucs_unlikely((phase->segment_length != 0) &&
+                            (length > phase->segment_length) &&
+                            (dt_len <= phase->segment_length) &&
+                            (dt_len <= phase->recv_thresh.max_bcopy_one))) {
+        ucg_builtin_step_fragment_flags(ucs_min(phase->segment_length,
+                                                phase->recv_thresh.max_bcopy_one),
+                                        dt_len, length, step, phase, recv_flag);
     /*
      * Large messages, if supported (e.g. RDMA "zero-copy")
      */
@@ -937,6 +1666,7 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
                                      ucg_group_id_t group_id,
                                      const ucg_collective_params_t *params,
                                      int8_t **current_data_buffer,
+                                     ucg_builtin_scratch_t *scratch,
                                      ucg_builtin_op_step_t *step)
 {
     ucs_status_t status;
@@ -949,17 +1679,32 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
     }
     /* Note: we assume all the UCT endpoints have the same interface */
     step->phase              = phase;
+    step->flags              = 0;
+    step->zcopy.zcomp        = NULL;
     step->am_id              = base_am_id;
     step->am_header.group_id = group_id;
     step->am_header.step_idx = (ucg_step_idx_t)phase->step_index;
     step->iter_ep            = 0;
     step->iter_offset        = 0;
+    step->rail_cnt           = 1;
     step->fragment_pending   = NULL;
+#if ENABLE_DEBUG_DATA
+    step->fault_offset       = UCG_BUILTIN_FAULT_OFFSET_NONE;
+    step->fault_sent         = 0;
+    step->fault_cnt          = 0;
+#endif
     step->recv_buffer        = (int8_t*)params->recv.buf;
-    step->send_buffer        = ((params->send.buf == MPI_IN_PLACE) ||
-            !(extra_flags & UCG_BUILTIN_OP_STEP_FLAG_FIRST_STEP)) ?
-                    (int8_t*)params->recv.buf : (int8_t*)params->send.buf;
+    step->recv_base          = UCG_BUILTIN_OP_STEP_BUFFER_RECV;
+    if ((params->send.buf == MPI_IN_PLACE) ||
+        !(extra_flags & UCG_BUILTIN_OP_STEP_FLAG_FIRST_STEP)) {
+        step->send_buffer    = (int8_t*)params->recv.buf;
+        step->send_base      = UCG_BUILTIN_OP_STEP_BUFFER_RECV;
+    } else {
+        step->send_buffer    = (int8_t*)params->send.buf;
+        step->send_base      = UCG_BUILTIN_OP_STEP_BUFFER_SEND;
+    }
     step->send_cb            = NULL;
+    step->displs_rule        = UCG_BUILTIN_OP_STEP_DISPLS_RULE_NONE;
 
     /* special parameter of buffer length should be set for allgather with bruck plan */
     if (phase->method == UCG_PLAN_METHOD_ALLGATHER_BRUCK) {
@@ -994,7 +1739,11 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
 
     if (phase->method != UCG_PLAN_METHOD_BCAST_WAYPOINT) {
         if (*current_data_buffer) {
+            /* either the receive buffer of a previous step, or a waypoint's */
             step->send_buffer = *current_data_buffer;
+            step->send_base   = (*current_data_buffer == (int8_t*)params->recv.buf) ?
+                                UCG_BUILTIN_OP_STEP_BUFFER_RECV :
+                                UCG_BUILTIN_OP_STEP_BUFFER_SCRATCH;
         } else {
             *current_data_buffer = step->recv_buffer;
         }
@@ -1002,32 +1751,53 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
 
     if (phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_RING ||
         phase->method == UCG_PLAN_METHOD_ALLGATHER_RING) {
-        int num_offset_blocks;
-        int send_position;
-        int recv_position;
-        int quotient = params->send.count / num_procs;
-        int remainder = params->send.count % num_procs;
-
-        step->buf_len_unit   = step->buffer_length; // for ring init
-        step->buffer_length = params->send.dt_len * quotient;
-        num_offset_blocks = (g_myidx - phase->step_index + UCG_BUILTIN_NUM_PROCS_DOUBLE * num_procs) % num_procs;
-        send_position = num_offset_blocks + 1;
-        recv_position = (num_offset_blocks - 1 + num_procs) % num_procs + 1;
-        if (recv_position <= remainder) {
-            step->buffer_length_recv = step->buffer_length + params->send.dt_len;
-        } else {
-            step->buffer_length_recv = step->buffer_length;
-        }
-        if (send_position <= remainder) {
-            step->buffer_length += params->send.dt_len;
-        }
-        step->am_header.remote_offset = params->send.dt_len * (num_offset_blocks * quotient +
-                               (num_offset_blocks <= remainder ? num_offset_blocks : remainder));
+        /* the whole group on the whole vector, unless the ring is part of a larger plan */
+        unsigned ring_cnt  = phase->ring_cnt ? phase->ring_cnt : num_procs;
+        unsigned ring_idx  = phase->ring_cnt ? phase->ring_index : (unsigned)g_myidx;
+        unsigned ring_step = phase->step_index - phase->ring_base;
+        unsigned send_block, recv_block;
+        int slice_start, slice_count, send_start, send_count, recv_start, recv_count;
+
+        ucg_builtin_slice(params->send.count, phase->slice_cnt, phase->slice_idx,
+                          &slice_start, &slice_count);
+        send_block = (ring_idx - ring_step + UCG_BUILTIN_NUM_PROCS_DOUBLE * ring_cnt) % ring_cnt;
+        recv_block = (send_block - 1 + ring_cnt) % ring_cnt;
+        ucg_builtin_slice(slice_count, ring_cnt, send_block, &send_start, &send_count);
+        ucg_builtin_slice(slice_count, ring_cnt, recv_block, &recv_start, &recv_count);
+
+        step->buf_len_unit       = step->buffer_length; // for ring init
+        step->buffer_length      = params->send.dt_len * send_count;
+        step->buffer_length_recv = params->send.dt_len * recv_count;
+        step->am_header.remote_offset = params->send.dt_len * (slice_start + send_start);
 
         step->remote_offset = step->am_header.remote_offset;
         step->send_buffer +=  step->am_header.remote_offset;
     }
 
+    if (phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING ||
+        phase->method == UCG_PLAN_METHOD_ALLGATHER_DOUBLING) {
+        /* the blocks I (or my peer) have, are those sharing my index above the distance */
+        unsigned distance   = phase->block_distance;
+        unsigned my_block   = (phase->block_idx / distance) * distance;
+        unsigned peer_block = ((phase->block_idx ^ distance) / distance) * distance;
+        int is_halving      = (phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING);
+        int send_start, send_count, recv_start, recv_count;
+
+        /* halving sends the blocks the peer keeps, doubling sends the ones I have */
+        ucg_builtin_slice_span(params->send.count, phase->block_cnt, is_halving ? peer_block : my_block,
+                               distance, &send_start, &send_count);
+        ucg_builtin_slice_span(params->send.count, phase->block_cnt, is_halving ? my_block : peer_block,
+                               distance, &recv_start, &recv_count);
+
+        step->buf_len_unit       = step->buffer_length;
+        step->buffer_length      = params->send.dt_len * send_count;
+        step->buffer_length_recv = params->send.dt_len * recv_count;
+        step->am_header.remote_offset = params->send.dt_len * send_start;
+
+        step->remote_offset = step->am_header.remote_offset;
+        step->send_buffer  += step->am_header.remote_offset;
+    }
+
     if (phase->method == UCG_PLAN_METHOD_ALLGATHER_RECURSIVE) {
         size_t power = 1UL << (phase->step_index - 1);
         size_t base_index = 0;
@@ -1042,13 +1812,40 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
     }
     ucs_assert(base_am_id < UCP_AM_ID_MAX);
 
+    /* The blocks of Bruck alltoall are packed into a staging buffer, if at all */
+    if (phase->method == UCG_PLAN_METHOD_ALLTOALL_BRUCK) {
+        step->send_buffer = (int8_t*)ucg_builtin_scratch_get(scratch, step->buffer_length);
+        if (step->send_buffer == NULL) {
+            return UCS_ERR_NO_MEMORY;
+        }
+        step->send_base   = UCG_BUILTIN_OP_STEP_BUFFER_SCRATCH;
+        step->flags       = UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER;
+    }
+
+    /* Node-local steps send nothing, but access the shared-memory segment */
+    if ((phase->method == UCG_PLAN_METHOD_SHM_FANIN) ||
+        (phase->method == UCG_PLAN_METHOD_SHM_FANOUT) ||
+        (phase->method == UCG_PLAN_METHOD_SHM_REDUCE_SCATTER) ||
+        (phase->method == UCG_PLAN_METHOD_SHM_ALLGATHER)) {
+        ucs_assert((step->buffer_length <= UCG_BUILTIN_SHM_MAX_DATA) ||
+                   (phase->method == UCG_PLAN_METHOD_SHM_REDUCE_SCATTER) ||
+                   (phase->method == UCG_PLAN_METHOD_SHM_ALLGATHER));
+        step->flags          = extra_flags | UCG_BUILTIN_OP_STEP_FLAG_SHM;
+        step->fragments      = 1;
+        step->fragments_recv = 0;
+        step->resend_flag    = UCG_BUILTIN_OP_STEP_FIRST_SEND;
+        step->recv_cb        = ucg_builtin_comp_shm_cb;
+        return UCS_OK;
+    }
+
     /* Decide how the messages are sent (regardless of my role) */
     enum ucg_builtin_op_step_flags send_flag, recv_flag;
     recv_flag = (enum ucg_builtin_op_step_flags) 0;
     send_flag = (enum ucg_builtin_op_step_flags) 0;
     /* Note: in principle, step->send_buffer should not be changed after this function */
-    status = ucg_builtin_step_send_flags(step, phase, params, &send_flag);
-    extra_flags |= (send_flag & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED);
+    status = ucg_builtin_step_send_flags(step, phase, params, scratch, &send_flag);
+    extra_flags |= (send_flag & (UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED |
+                                 UCG_BUILTIN_OP_STEP_FLAG_RNDV));
     if (ucs_unlikely(status != UCS_OK)) {
         return status;
     }
@@ -1075,17 +1872,21 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
             extra_flags      |= UCG_BUILTIN_OP_STEP_FLAG_LENGTH_PER_REQUEST;
             /* no break */
         case UCG_PLAN_METHOD_REDUCE_WAYPOINT:
-            if ((send_flag & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) && ucg_algo.pipeline) {
+            if (ucg_builtin_step_is_pipelined(step, phase, send_flag)) {
                 extra_flags  |= UCG_BUILTIN_OP_STEP_FLAG_PIPELINED;
             }
             extra_flags      |= UCG_BUILTIN_OP_STEP_FLAG_RECV_BEFORE_SEND1;
-            step->flags       = send_flag | extra_flags;
-            *current_data_buffer = (int8_t*)ucs_calloc(1, step->buffer_length, "ucg_fanin_waypoint_buffer");
+            step->flags       = send_flag | extra_flags; /* released if this fails */
+            *current_data_buffer = (int8_t*)ucg_builtin_scratch_get(scratch, step->buffer_length);
             if (*current_data_buffer == NULL) {
                 return UCS_ERR_NO_MEMORY;
             }
+            extra_flags      |= UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER;
+            step->flags       = send_flag | extra_flags;
             step->send_buffer = *current_data_buffer;
             step->recv_buffer = step->send_buffer;
+            step->send_base   = UCG_BUILTIN_OP_STEP_BUFFER_SCRATCH;
+            step->recv_base   = UCG_BUILTIN_OP_STEP_BUFFER_SCRATCH;
 
             if (params->send.buf == MPI_IN_PLACE) {
                 memcpy(step->send_buffer, params->recv.buf, step->buffer_length);
@@ -1094,23 +1895,20 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
             }
 
             if (send_flag & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) {
-                /* The send buffer changed, reregister it */
-                uct_md_mem_dereg(step->uct_md, step->zcopy.memh);
-                status = uct_md_mem_reg(step->uct_md, step->send_buffer,
-                                        step->buffer_length, UCT_MD_MEM_ACCESS_ALL, &step->zcopy.memh);
+                /* The send buffer changed, use the (cached) registration of the scratch */
+                ucg_builtin_step_mem_dereg(step, step->zcopy.memh, step->zcopy.region);
+                step->zcopy.region = NULL;
+                status = ucg_builtin_scratch_reg(step->send_buffer, step->uct_md,
+                                                 &step->zcopy.memh);
                 if (status != UCS_OK) {
                     return status;
                 }
             }
-
-            if (!step->recv_buffer) {
-                return UCS_ERR_NO_MEMORY;
-            }
             break;
 
         /* Recv-one, Send-all */
         case UCG_PLAN_METHOD_BCAST_WAYPOINT:
-            if ((send_flag & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) && ucg_algo.pipeline) {
+            if (ucg_builtin_step_is_pipelined(step, phase, send_flag)) {
                 extra_flags  |= UCG_BUILTIN_OP_STEP_FLAG_PIPELINED;
             }
             extra_flags      |= UCG_BUILTIN_OP_STEP_FLAG_RECV1_BEFORE_SEND;
@@ -1118,20 +1916,32 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
             break;
 
         case UCG_PLAN_METHOD_SCATTER_WAYPOINT:
-            if ((send_flag & UCG_BUILTIN_OP_STEP_FLAG_FRAGMENTED) && ucg_algo.pipeline) {
+            if (ucg_builtin_step_is_pipelined(step, phase, send_flag)) {
                 extra_flags  |= UCG_BUILTIN_OP_STEP_FLAG_PIPELINED;
             }
             extra_flags      |= UCG_BUILTIN_OP_STEP_FLAG_RECV1_BEFORE_SEND;
             extra_flags      |= UCG_BUILTIN_OP_STEP_FLAG_LENGTH_PER_REQUEST;
-            step->flags       = send_flag | extra_flags;
-            *current_data_buffer = (int8_t*)ucs_calloc(1, step->buffer_length, "ucg_fanout_waypoint_buffer");
+            step->flags       = send_flag | extra_flags; /* released if this fails */
+            *current_data_buffer = (int8_t*)ucg_builtin_scratch_get(scratch, step->buffer_length);
             if (*current_data_buffer == NULL) {
                 return UCS_ERR_NO_MEMORY;
             }
+            extra_flags      |= UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER;
+            step->flags       = send_flag | extra_flags;
             step->send_buffer = *current_data_buffer;
             step->recv_buffer = step->send_buffer;
-            if (!step->recv_buffer) {
-                return UCS_ERR_NO_MEMORY;
+            step->send_base   = UCG_BUILTIN_OP_STEP_BUFFER_SCRATCH;
+            step->recv_base   = UCG_BUILTIN_OP_STEP_BUFFER_SCRATCH;
+            memset(step->recv_buffer, 0, step->buffer_length);
+
+            if (send_flag & UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY) {
+                ucg_builtin_step_mem_dereg(step, step->zcopy.memh, step->zcopy.region);
+                step->zcopy.region = NULL;
+                status = ucg_builtin_scratch_reg(step->send_buffer, step->uct_md,
+                                                 &step->zcopy.memh);
+                if (status != UCS_OK) {
+                    return status;
+                }
             }
             break;
 
@@ -1151,21 +1961,21 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
         /* Bruck patterns for alltoall */
         case UCG_PLAN_METHOD_ALLTOALL_BRUCK:
             extra_flags |= UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND;
+            extra_flags |= UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER;
             step->flags = send_flag | extra_flags;
-            // should malloc a new buffer to handle ucg_alltoall_step_buffer_discrete
-            step->send_buffer = (int8_t*)params->send.buf;
-            // bellow does not work
-            /* max buffer size for alltoall at every step is num_procs/2 !!!! */
             break;
 
         case UCG_PLAN_METHOD_REDUCE_SCATTER_RING:
         case UCG_PLAN_METHOD_ALLGATHER_RING:
+        case UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING:
+        case UCG_PLAN_METHOD_ALLGATHER_DOUBLING:
             extra_flags |= UCG_BUILTIN_OP_STEP_FLAG_RECV_AFTER_SEND;
             step->flags = send_flag | extra_flags;
             break;
 
         default:
             ucs_error("Invalid method for a collective operation.");
+            step->flags = send_flag | extra_flags; /* released by the caller */
             return UCS_ERR_INVALID_PARAM;
     }
     status = ucg_builtin_step_recv_flags(step, phase, params, &recv_flag);
@@ -1173,6 +1983,19 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
         return status;
     }
 
+    /* Pipelined ring - each step passes its data on to the next as it arrives */
+    if ((phase->segment_length != 0) &&
+        ((phase->method == UCG_PLAN_METHOD_REDUCE_SCATTER_RING) ||
+         (phase->method == UCG_PLAN_METHOD_ALLGATHER_RING))) {
+        if (!(extra_flags & UCG_BUILTIN_OP_STEP_FLAG_FIRST_STEP)) {
+            step->flags |= UCG_BUILTIN_OP_STEP_FLAG_SENT_AHEAD;
+        }
+        if (!(extra_flags & UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP)) {
+            recv_flag = (enum ucg_builtin_op_step_flags)(recv_flag |
+                    UCG_BUILTIN_OP_STEP_FLAG_PIPELINED);
+        }
+    }
+
     /* fill in additional data before finishing this step */
     if (phase->ep_cnt == 1) {
         step->flags |= UCG_BUILTIN_OP_STEP_FLAG_SINGLE_ENDPOINT;
@@ -1181,30 +2004,52 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
     if (step->flags & send_flag) {
         if (phase->method != UCG_PLAN_METHOD_ALLGATHER_RECURSIVE &&
             phase->method != UCG_PLAN_METHOD_REDUCE_SCATTER_RING &&
-            phase->method != UCG_PLAN_METHOD_ALLGATHER_RING) {
+            phase->method != UCG_PLAN_METHOD_ALLGATHER_RING &&
+            phase->method != UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING &&
+            phase->method != UCG_PLAN_METHOD_ALLGATHER_DOUBLING) {
             step->am_header.remote_offset = 0;
         }
     }
 
     /* Pipelining preparation */
-    if ((step->flags & UCG_BUILTIN_OP_STEP_FLAG_PIPELINED) && ucg_algo.pipeline) {
-        step->fragment_pending = (uint8_t*)UCS_ALLOC_CHECK(step->fragments *
-                sizeof(uint8_t*), "ucg_builtin_step_pipelining");
+    if (step->flags & UCG_BUILTIN_OP_STEP_FLAG_PIPELINED) {
+        step->fragment_pending = (uint8_t*)ucg_builtin_scratch_get(scratch,
+                                                                   step->fragments);
+        if (step->fragment_pending == NULL) {
+            return UCS_ERR_NO_MEMORY;
+        }
     }
 
     if (phase->method != UCG_PLAN_METHOD_ALLGATHER_BRUCK &&
         phase->method != UCG_PLAN_METHOD_ALLTOALL_BRUCK &&
         phase->method != UCG_PLAN_METHOD_REDUCE_SCATTER_RING &&
-        phase->method != UCG_PLAN_METHOD_ALLGATHER_RING) {
+        phase->method != UCG_PLAN_METHOD_ALLGATHER_RING &&
+        phase->method != UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING &&
+        phase->method != UCG_PLAN_METHOD_ALLGATHER_DOUBLING) {
         recv_flag = (enum ucg_builtin_op_step_flags)step->flags;
         step->fragments_recv = step->fragments;
     }
 
+    /* The cache buffer is shared by the operations of this phase, so only grows */
     if (phase->segmented) {
-        phase->recv_cache_buffer = (int8_t *)UCS_ALLOC_CHECK(params->send.count * params->send.dt_len, "recv_cache_buffer");
+        size_t cache_len = params->send.count * params->send.dt_len;
+        if (phase->recv_cache_len < cache_len) {
+            if (phase->recv_cache_buffer != NULL) {
+                ucg_builtin_scratch_put(scratch, phase->recv_cache_buffer);
+            }
+            phase->recv_cache_buffer = (int8_t*)ucg_builtin_scratch_get(scratch, cache_len);
+            phase->recv_cache_len    = (phase->recv_cache_buffer != NULL) ? cache_len : 0;
+            if (phase->recv_cache_buffer == NULL) {
+                return UCS_ERR_NO_MEMORY;
+            }
+        }
         ucs_debug("segmented phase %p fragments %" PRIu32 "", phase, step->fragments_recv);
-    } else {
-        phase->recv_cache_buffer = NULL;
+    }
+
+    /* Multi-rail striping, now that the buffers of the step are final */
+    status = ucg_builtin_step_rails_prep(step);
+    if (status != UCS_OK) {
+        return status;
     }
 
     /* Select the right completion callback */
@@ -1212,6 +2057,74 @@ ucs_status_t ucg_builtin_step_create(ucg_builtin_plan_phase_t *phase,
                                              params->send.count > 0, recv_flag);
 }
 
+static void ucg_builtin_op_reduce_mpi(void *arg, void *dst, const void *src,
+                                      size_t count)
+{
+    ucg_builtin_op_t *op = (ucg_builtin_op_t*)arg;
+    ucg_group_get_params(op->super.plan->group)->mpi_reduce_f(
+            op->super.params.recv.op_ext, (char*)src, (char*)dst, count,
+            op->super.params.recv.dt_ext);
+}
+
+static void ucg_builtin_op_reduce_init(ucg_builtin_op_t *op,
+                                       const ucg_group_params_t *group_params,
+                                       const ucg_collective_params_t *params)
+{
+    ucg_reduce_kernel_t *reduce = &op->reduce;
+    void *mpi_op                = params->recv.op_ext;
+
+    memset(reduce, 0, sizeof(*reduce));
+    if (mpi_op == NULL) {
+        return; /* no reduction in this collective */
+    }
+
+    /* Predefined reductions have native kernels, others may be resolved by MPI */
+    if (ucg_builtin_reduce_find(group_params, params, reduce) ||
+        ((group_params->reduce_resolve_f != NULL) &&
+         (group_params->reduce_resolve_f(mpi_op, params->recv.dt_ext,
+                                         reduce) == UCS_OK))) {
+        ucs_assert(reduce->func != NULL);
+        ucs_assert(reduce->dt_len == params->recv.dt_len);
+        return;
+    }
+
+    /* Fall back to the generic MPI callback of this group */
+    reduce->func           = ucg_builtin_op_reduce_mpi;
+    reduce->func_reversed  = NULL;
+    reduce->arg            = op;
+    reduce->dt_len         = params->recv.dt_len;
+    reduce->is_commutative = group_params->op_is_commute_f(mpi_op);
+    reduce->identity       = NULL;
+}
+
+/*
+ * Non-commutative reductions applied in reverse (see ucg_builtin_mpi_reduce)
+ * need a copy of an operand - allocated here, rather than in the data-path.
+ */
+static ucs_status_t ucg_builtin_op_reduce_scratch_init(ucg_builtin_op_t *op,
+                                                       const ucg_builtin_plan_t *plan,
+                                                       const ucg_collective_params_t *params)
+{
+    ucg_reduce_kernel_t *reduce = &op->reduce;
+    unsigned phs_idx;
+
+    if ((reduce->func == NULL) || (reduce->func_reversed != NULL) ||
+        reduce->is_commutative || (params->recv.count == 0)) {
+        return UCS_OK;
+    }
+
+    for (phs_idx = 0; phs_idx < plan->phs_cnt; phs_idx++) {
+        if (plan->phss[phs_idx].is_swap) {
+            op->reduce_scratch = ucg_builtin_scratch_get(op->scratch,
+                                                         params->recv.count *
+                                                         reduce->dt_len);
+            return (op->reduce_scratch != NULL) ? UCS_OK : UCS_ERR_NO_MEMORY;
+        }
+    }
+
+    return UCS_OK;
+}
+
 ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
                                    const ucg_collective_params_t *params,
                                    ucg_op_t **new_op)
@@ -1221,6 +2134,12 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
     ucg_builtin_plan_phase_t *next_phase = &builtin_plan->phss[0];
     unsigned phase_count                 = builtin_plan->phs_cnt;
 
+    /* the steps depend on the endpoints (e.g. thresholds) of the phases */
+    status = ucg_builtin_plan_connect_wait(builtin_plan);
+    if (status != UCS_OK) {
+        return status;
+    }
+
     ucg_builtin_op_t *op                 = (ucg_builtin_op_t*)
             ucs_mpool_get_inline(&builtin_plan->op_mp);
     if (op == NULL) {
@@ -1230,6 +2149,9 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
     ucg_builtin_op_step_t *next_step     = &op->steps[0];
     unsigned am_id                       = builtin_plan->am_id;
     int8_t *current_data_buffer          = NULL;
+    op->scratch                          = builtin_plan->scratch;
+    op->shm                              = builtin_plan->shm;
+    op->reduce_scratch                   = NULL;
 
     /* get number of processes */
     num_procs = (unsigned)(ucg_group_get_params(plan->group))->member_count;
@@ -1238,7 +2160,8 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
     /* Select the right initialization callback */
     status = ucg_builtin_op_select_callback(builtin_plan, &op->init_cb, &op->final_cb);
     if (status != UCS_OK) {
-        goto op_cleanup;
+        ucs_mpool_put_inline(op);
+        return status;
     }
 
     /* Create a step in the op for each phase in the topology */
@@ -1247,12 +2170,13 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
         status = ucg_builtin_step_create(next_phase,
                                          UCG_BUILTIN_OP_STEP_FLAG_FIRST_STEP | UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP,
                                          am_id, plan->group_id, params,
-                                         &current_data_buffer, next_step);
+                                         &current_data_buffer, builtin_plan->scratch, next_step);
     } else {
         /* First step of many */
         status = ucg_builtin_step_create(next_phase,
                                          UCG_BUILTIN_OP_STEP_FLAG_FIRST_STEP, am_id, plan->group_id,
-                                         params, &current_data_buffer, next_step);
+                                         params, &current_data_buffer, builtin_plan->scratch,
+                                         next_step);
         if (ucs_unlikely(status != UCS_OK)) {
             goto op_cleanup;
         }
@@ -1260,7 +2184,8 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
         ucg_step_idx_ext_t step_cnt;
         for (step_cnt = 1; step_cnt < phase_count - 1; step_cnt++) {
             status = ucg_builtin_step_create(++next_phase, 0, am_id,
-                                             plan->group_id, params, &current_data_buffer, ++next_step);
+                                             plan->group_id, params, &current_data_buffer,
+                                             builtin_plan->scratch, ++next_step);
             if (ucs_unlikely(status != UCS_OK)) {
                 goto op_cleanup;
             }
@@ -1269,7 +2194,8 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
         /* Last step gets a special flag */
         status = ucg_builtin_step_create(++next_phase,
                                          UCG_BUILTIN_OP_STEP_FLAG_LAST_STEP, am_id, plan->group_id,
-                                         params, &current_data_buffer, ++next_step);
+                                         params, &current_data_buffer, builtin_plan->scratch,
+                                         ++next_step);
     }
     if (ucs_unlikely(status != UCS_OK)) {
         goto op_cleanup;
@@ -1278,18 +2204,31 @@ ucs_status_t ucg_builtin_op_create(ucg_plan_t *plan,
     /* Select the right optimization callback */
     status = ucg_builtin_op_consider_optimization(op, (ucg_builtin_config_t*)plan->planner->plan_config);
     if (status != UCS_OK) {
-        goto op_cleanup;
+        ucg_builtin_op_discard(&op->super);
+        return status;
     }
 
     UCS_STATIC_ASSERT(sizeof(ucg_builtin_header_t) <= UCP_WORKER_HEADROOM_PRIV_SIZE);
     UCS_STATIC_ASSERT(sizeof(ucg_builtin_header_t) == sizeof(uint64_t));
 
-    op->slots  = (ucg_builtin_comp_slot_t*)builtin_plan->slots;
-    op->resend = builtin_plan->resend;
-    *new_op    = &op->super;
+    ucg_builtin_op_reduce_init(op, ucg_group_get_params(plan->group), params);
+    status = ucg_builtin_op_reduce_scratch_init(op, builtin_plan, params);
+    if (status != UCS_OK) {
+        ucg_builtin_op_discard(&op->super);
+        return status;
+    }
+
+    op->slots     = (ucg_builtin_comp_slot_t*)builtin_plan->slots;
+    op->slot_mask = builtin_plan->slot_mask;
+    op->resend    = builtin_plan->resend;
+    *new_op       = &op->super;
     return UCS_OK;
 
 op_cleanup:
+    /* release the steps created so far, including whatever the failing one holds */
+    do {
+        ucg_builtin_step_release(op, next_step);
+    } while (next_step-- != &op->steps[0]);
     ucs_mpool_put_inline(op);
     return status;
 }
\ No newline at end of file
@@ -9,6 +9,10 @@
 BEGIN_C_DECLS
 
 #include "../plan/builtin_plan.h"
+#include "builtin_reduce.h"
+#include "builtin_scratch.h"
+#include "builtin_rcache.h"
+#include "builtin_shm.h"
 #include <ucp/core/ucp_request.h>
 
 /*
@@ -27,13 +31,9 @@ BEGIN_C_DECLS
  * step templates are used to generate an instance
  * (or it is fetched from cache) and that instance is executed.
  */
-typedef void (*mpi_reduce_f)(void *mpi_op, char *src_buffer,
-                             char *dst_buffer, unsigned dcount,
-                             void* mpi_datatype);
 typedef void(*ucg_builtin_op_complete_cb_f)(void *complete_cb_arg);
 
 extern ucg_plan_component_t ucg_builtin_component;
-extern mpi_reduce_f ucg_builtin_mpi_reduce_cb;
 extern unsigned builtin_base_am_id;
 extern ucg_group_member_index_t g_myidx;
 extern unsigned num_procs;
@@ -77,10 +77,26 @@ enum ucg_builtin_op_step_flags {
     UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_SHORT      = UCS_BIT(9),
     UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_BCOPY      = UCS_BIT(10),
     UCG_BUILTIN_OP_STEP_FLAG_SEND_AM_ZCOPY      = UCS_BIT(11),
+
+    /* The step owns a buffer from the scratch arena (and its registration) */
+    UCG_BUILTIN_OP_STEP_FLAG_SCRATCH_BUFFER     = UCS_BIT(12),
+
+    /* The previous step may send (a prefix of) it, as its data arrives */
+    UCG_BUILTIN_OP_STEP_FLAG_SENT_AHEAD         = UCS_BIT(13),
+
+    /* Only the address is sent, and the receivers read the data by themselves */
+    UCG_BUILTIN_OP_STEP_FLAG_RNDV               = UCS_BIT(14),
+
+    /* Nothing is sent, the data is exchanged through node-local shared memory */
+    UCG_BUILTIN_OP_STEP_FLAG_SHM                = UCS_BIT(15),
 };
 
 enum ucg_builtin_op_step_displs_rule {
-    /* rule of displacement for bruck plan with alltoall  */
+    /* the data is contiguous in the buffers */
+    UCG_BUILTIN_OP_STEP_DISPLS_RULE_NONE,
+    /* rule of displacement for bruck plan with alltoall: step k sends (and
+     * receives) the blocks whose k-th index bit is set, i.e. runs of 2^k
+     * blocks which are 2^(k+1) blocks apart, starting from block 2^k */
     UCG_BUILTIN_OP_STEP_DISPLS_RULE_BRUCK_ALLTOALL
 };
 
@@ -90,6 +106,32 @@ enum ucg_builtin_op_step_resend_flag {
     UCG_BUILTIN_OP_STEP_RESEND,
 };
 
+enum ucg_builtin_op_step_rndv_state {
+    UCG_BUILTIN_OP_STEP_RNDV_IDLE, /* not reading (or a sender of the data) */
+    UCG_BUILTIN_OP_STEP_RNDV_READ, /* reading from the sender's buffer */
+    UCG_BUILTIN_OP_STEP_RNDV_ACK   /* done reading, telling the sender so */
+};
+
+/*
+ * What a rendezvous sender sends, followed by the packed key of its buffer if
+ * it has one registered. Each receiver reads the buffer using CMA if it is on
+ * the same node as the sender (both ends know it), or with the key otherwise.
+ */
+typedef struct ucg_builtin_rndv_header {
+    uint64_t address;      /* of the sender's buffer */
+    uint32_t host_id;      /* of the sender, or UCG_BUILTIN_RNDV_NO_CMA */
+    uint32_t pid;          /* of the sender, read by the receivers on its node */
+} ucg_builtin_rndv_header_t;
+
+#define UCG_BUILTIN_RNDV_NO_CMA ((uint32_t)-1)
+
+enum ucg_builtin_op_step_buffer_base {
+    /* which buffer the step's send/recv buffer points into, for re-binding */
+    UCG_BUILTIN_OP_STEP_BUFFER_SCRATCH, /* allocated by the operation itself */
+    UCG_BUILTIN_OP_STEP_BUFFER_SEND,    /* the user's send buffer */
+    UCG_BUILTIN_OP_STEP_BUFFER_RECV     /* the user's receive buffer */
+};
+
 /* Definitions of several callback functions, used during an operation */
 typedef struct ucg_builtin_op ucg_builtin_op_t;
 typedef struct ucg_builtin_request ucg_builtin_request_t;
@@ -110,6 +152,7 @@ typedef struct ucg_builtin_zcomp {
 typedef struct ucg_builtin_op_step {
     uint16_t                   flags;            /* @ref enum ucg_builtin_op_step_flags */
     uint8_t                    iter_ep;          /* iterator, somewhat volatile */
+    uint8_t                    rail_cnt;         /* fragments are striped across */
     ucg_offset_t               iter_offset;      /* iterator, somewhat volatile */
     ucg_offset_t               remote_offset;    /*  for algorithm like ring    */
 #define UCG_BUILTIN_OFFSET_PIPELINE_READY   ((ucg_offset_t)-1)
@@ -121,6 +164,8 @@ typedef struct ucg_builtin_op_step {
 
     int8_t                    *send_buffer;
     int8_t                    *recv_buffer;
+    uint8_t                    send_base;   /* @ref enum ucg_builtin_op_step_buffer_base */
+    uint8_t                    recv_base;   /* @ref enum ucg_builtin_op_step_buffer_base */
     size_t                     buffer_length;
     size_t                     buffer_length_recv;
     ucg_builtin_header_t       am_header;
@@ -142,6 +187,11 @@ typedef struct ucg_builtin_op_step {
     unsigned                   displs_rule; /* @ref enum ucg_builtin_op_step_displs_rule */
 
     unsigned                   resend_flag; /* @ref enum ucg_builtin_op_step_resend_flag */
+#if ENABLE_DEBUG_DATA
+    ucg_offset_t               fault_offset; /* of an injected send failure, see below */
+    uint32_t                   fault_sent;   /* fragments sent to the current peer */
+    uint32_t                   fault_cnt;    /* fragments attempted, to pick the next fault */
+#endif
 
     ucg_builtin_comp_send_cb_t send_cb;
     ucg_builtin_comp_recv_cb_t recv_cb;
@@ -149,9 +199,27 @@ typedef struct ucg_builtin_op_step {
     /* Fields intended for zero-copy */
     struct {
         uct_mem_h              memh;
+        ucg_builtin_rcache_region_t *region; /* cached registration, or NULL */
         ucg_builtin_zcomp_t   *zcomp;
         uint32_t               num_store; /* < number of step's store zcopy messages */
+
+        /* registration with the other rails, unless the same MD as above */
+        uct_mem_h              rail_memh[UCG_BUILTIN_MAX_RAILS - 1];
+        ucg_builtin_rcache_region_t *rail_region[UCG_BUILTIN_MAX_RAILS - 1];
     } zcopy;
+
+    /* Fields intended for rendezvous */
+    struct {
+        uct_mem_h              memh;        /* of the buffer read from (or into) */
+        ucg_builtin_rcache_region_t *region; /* cached registration, or NULL */
+        void                  *rkey_buffer; /* packed key of the buffer, if sent */
+        uct_rkey_bundle_t      rkey;        /* of the remote buffer being read */
+        uint64_t               remote_addr;
+        pid_t                  remote_pid;  /* of the sender, if read using CMA */
+        size_t                 offset;      /* how much of it was read so far */
+        ucg_builtin_zcomp_t    zcomp;       /* completion of those reads */
+        uint8_t                state;       /* @ref enum ucg_builtin_op_step_rndv_state */
+    } rndv;
 } ucg_builtin_op_step_t;
 
 typedef struct ucg_builtin_comp_slot ucg_builtin_comp_slot_t;
@@ -161,8 +229,13 @@ struct ucg_builtin_op {
     ucg_builtin_op_optm_cb_t  optm_cb;  /**< optimization function for the operation */
     ucg_builtin_op_init_cb_t  init_cb;  /**< Initialization function for the operation */
     ucg_builtin_op_final_cb_t final_cb; /**< Finalization function for the operation */
+    ucg_reduce_kernel_t       reduce;   /**< reduction, resolved once per operation */
+    void                     *reduce_scratch; /**< copy of an operand, for reversed reductions */
     ucg_builtin_comp_slot_t  *slots;    /**< slots pointer, for faster initialization */
+    unsigned                  slot_mask; /**< number of slots, minus one */
     ucs_list_link_t          *resend;   /**< resend pointer, for faster resend */
+    ucg_builtin_scratch_t    *scratch;  /**< arena for the temporary buffers */
+    ucg_builtin_shm_t        *shm;      /**< node-local segment, for SHM steps */
     ucg_builtin_op_step_t     steps[];  /**< steps required to complete the operation */
 };
 
@@ -186,6 +259,7 @@ ucs_status_t ucg_builtin_step_create (ucg_builtin_plan_phase_t *phase,
                                       ucg_group_id_t group_id,
                                       const ucg_collective_params_t *params,
                                       int8_t **current_data_buffer,
+                                      ucg_builtin_scratch_t *scratch,
                                       ucg_builtin_op_step_t *step);
 ucs_status_t ucg_builtin_step_execute(ucg_builtin_request_t *req,
                                       ucg_request_t **user_req);
@@ -194,6 +268,9 @@ ucs_status_t ucg_builtin_op_create (ucg_plan_t *plan,
                                     const ucg_collective_params_t *params,
                                     ucg_op_t **op);
 void         ucg_builtin_op_discard(ucg_op_t *op);
+ucs_status_t ucg_builtin_op_rebind (ucg_op_t *op,
+                                    const void *sbuf,
+                                    void *rbuf);
 ucs_status_t ucg_builtin_op_trigger(ucg_op_t *op,
                                     ucg_coll_id_t coll_id,
                                     ucg_request_t **request);
@@ -231,17 +308,51 @@ struct ucg_builtin_comp_slot {
 
 
 /*
- * This number sets the number of slots available for collective operations.
+ * These numbers bound the number of slots available for collective operations.
  * Each operation occupies a slot, so no more than this number of collectives
- * can take place at the same time. The slot is determined by the collective
- * operation id (ucg_coll_id_t) - modulo this constant. Translating "coll_id"
- * to slot# happens on every incoming packet, so this constant is best kept
- * determinable at compile time, and set to a power of 2.
+ * can take place at the same time (later ones wait in the group's queue). The
+ * slot is determined by the collective operation id (ucg_coll_id_t) - masked
+ * by the window size. Translating "coll_id" to slot# happens on every incoming
+ * packet, so the window is always a power of 2. It may not exceed half of the
+ * (cyclic) id space, or a late packet could be mistaken for a newer collective.
  */
-#define UCG_BUILTIN_MAX_CONCURRENT_OPS 16
+#define UCG_BUILTIN_MAX_CONCURRENT_OPS_DEFAULT 16
+#define UCG_BUILTIN_MAX_CONCURRENT_OPS_LIMIT   (UCS_BIT(sizeof(ucg_coll_id_t) * 8) / 2)
 
 #define UCG_BUILTIN_NUM_PROCS_DOUBLE 2
 
+/*
+ * Slice #idx of a vector of "count" elements, divided into "parts" (or the whole
+ * vector, if not divided): the first (count % parts) slices have an extra one.
+ */
+static UCS_F_ALWAYS_INLINE void ucg_builtin_slice(int count, unsigned parts, unsigned idx,
+                                                  int *start, int *slice_count)
+{
+    int quotient, remainder;
+
+    if (parts == 0) {
+        *start       = 0;
+        *slice_count = count;
+        return;
+    }
+
+    quotient     = count / (int)parts;
+    remainder    = count % (int)parts;
+    *start       = ((int)idx * quotient) + ucs_min((int)idx, remainder);
+    *slice_count = quotient + ((int)idx < remainder);
+}
+
+/* Slices #idx to #(idx + span - 1) of the above, together */
+static UCS_F_ALWAYS_INLINE void ucg_builtin_slice_span(int count, unsigned parts, unsigned idx,
+                                                       unsigned span, int *start, int *span_count)
+{
+    int end, unused;
+
+    ucg_builtin_slice(count, parts, idx, start, &unused);
+    ucg_builtin_slice(count, parts, idx + span, &end, &unused);
+    *span_count = end - *start;
+}
+
 END_C_DECLS
 
 #endif
\ No newline at end of file
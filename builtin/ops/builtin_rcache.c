@@ -0,0 +1,157 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include "builtin_rcache.h"
+
+#include <sys/mman.h>
+#include <ucm/api/ucm.h>
+#include <ucs/sys/sys.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+#include <ucs/memory/rcache.h>
+#include <ucs/stats/stats.h>
+
+/* Let the cache be notified of unmaps before other (e.g. UCT) caches are */
+#define UCG_BUILTIN_RCACHE_EVENT_PRIORITY 1000
+
+struct ucg_builtin_rcache {
+    ucs_list_link_t  list;   /* in the per-group list of caches */
+    uct_md_h         md;     /* registering all the regions of this cache */
+    ucs_rcache_t    *rcache;
+};
+
+struct ucg_builtin_rcache_region {
+    ucs_rcache_region_t super;
+    uct_mem_h           memh;
+};
+
+static ucs_status_t ucg_builtin_rcache_mem_reg_cb(void *context, ucs_rcache_t *rcache,
+                                                  void *arg, ucs_rcache_region_t *rregion,
+                                                  uint16_t flags)
+{
+    ucg_builtin_rcache_region_t *region = ucs_derived_of(rregion,
+                                                         ucg_builtin_rcache_region_t);
+    ucs_status_t status;
+
+    status = uct_md_mem_reg((uct_md_h)context, (void*)region->super.super.start,
+                            region->super.super.end - region->super.super.start,
+                            UCT_MD_MEM_ACCESS_ALL, &region->memh);
+    if (status != UCS_OK) {
+        ucs_debug("failed to register %p..%p: %s", (void*)region->super.super.start,
+                  (void*)region->super.super.end, ucs_status_string(status));
+    }
+    return status;
+}
+
+static void ucg_builtin_rcache_mem_dereg_cb(void *context, ucs_rcache_t *rcache,
+                                            ucs_rcache_region_t *rregion)
+{
+    ucg_builtin_rcache_region_t *region = ucs_derived_of(rregion,
+                                                         ucg_builtin_rcache_region_t);
+
+    uct_md_mem_dereg((uct_md_h)context, region->memh);
+}
+
+static void ucg_builtin_rcache_dump_region_cb(void *context, ucs_rcache_t *rcache,
+                                              ucs_rcache_region_t *rregion,
+                                              char *buf, size_t max)
+{
+    ucg_builtin_rcache_region_t *region = ucs_derived_of(rregion,
+                                                         ucg_builtin_rcache_region_t);
+
+    snprintf(buf, max, "memh %p", region->memh);
+}
+
+static ucs_rcache_ops_t ucg_builtin_rcache_ops = {
+    .mem_reg     = ucg_builtin_rcache_mem_reg_cb,
+    .mem_dereg   = ucg_builtin_rcache_mem_dereg_cb,
+    .dump_region = ucg_builtin_rcache_dump_region_cb
+};
+
+void ucg_builtin_rcache_init(ucs_list_link_t *rcaches)
+{
+    ucs_list_head_init(rcaches);
+}
+
+void ucg_builtin_rcache_cleanup(ucs_list_link_t *rcaches)
+{
+    ucg_builtin_rcache_t *cache;
+
+    while (!ucs_list_is_empty(rcaches)) {
+        cache = ucs_list_extract_head(rcaches, ucg_builtin_rcache_t, list);
+        ucs_rcache_destroy(cache->rcache);
+        ucs_free(cache);
+    }
+}
+
+ucg_builtin_rcache_t *ucg_builtin_rcache_get(ucs_list_link_t *rcaches, uct_md_h md,
+                                             const uct_md_attr_t *md_attr)
+{
+    ucg_builtin_rcache_t *cache;
+    ucs_status_t status;
+
+    if (!(md_attr->cap.flags & UCT_MD_FLAG_REG)) {
+        return NULL;
+    }
+
+    ucs_list_for_each(cache, rcaches, list) {
+        if (cache->md == md) {
+            return cache;
+        }
+    }
+
+    cache = ucs_malloc(sizeof(*cache), "ucg_builtin_rcache");
+    if (cache == NULL) {
+        return NULL;
+    }
+
+    ucs_rcache_params_t params = {
+        .region_struct_size = sizeof(ucg_builtin_rcache_region_t),
+        .alignment          = UCS_PGT_ADDR_ALIGN,
+        .max_alignment      = ucs_get_page_size(),
+        .ucm_events         = UCM_EVENT_VM_UNMAPPED,
+        .ucm_event_priority = UCG_BUILTIN_RCACHE_EVENT_PRIORITY,
+        .ops                = &ucg_builtin_rcache_ops,
+        .context            = md
+    };
+
+    status = ucs_rcache_create(&params, "ucg_builtin", ucs_stats_get_root(),
+                               &cache->rcache);
+    if (status != UCS_OK) {
+        /* e.g. no memory events - operations register buffers on their own */
+        ucs_debug("failed to create a registration cache: %s",
+                  ucs_status_string(status));
+        ucs_free(cache);
+        return NULL;
+    }
+
+    cache->md = md;
+    ucs_list_add_tail(rcaches, &cache->list);
+    return cache;
+}
+
+ucs_status_t ucg_builtin_rcache_reg(ucg_builtin_rcache_t *cache, void *buffer,
+                                    size_t length, int prot,
+                                    ucg_builtin_rcache_region_t **region_p,
+                                    uct_mem_h *memh_p)
+{
+    ucs_rcache_region_t *rregion;
+    ucs_status_t status;
+
+    status = ucs_rcache_get(cache->rcache, buffer, length, prot, NULL, &rregion);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    *region_p = ucs_derived_of(rregion, ucg_builtin_rcache_region_t);
+    *memh_p   = (*region_p)->memh;
+    return UCS_OK;
+}
+
+void ucg_builtin_rcache_put(ucg_builtin_rcache_t *cache,
+                            ucg_builtin_rcache_region_t *region)
+{
+    ucs_rcache_region_put(cache->rcache, &region->super);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_BUILTIN_RCACHE_H_
+#define UCG_BUILTIN_RCACHE_H_
+
+#include <uct/api/uct.h>
+#include <ucs/datastruct/list.h>
+
+BEGIN_C_DECLS
+
+/*
+ * Per-group registration cache of user buffers, one for each memory domain.
+ * Registered regions are kept (in an interval tree) after the operation using
+ * them is discarded, so that any later operation on a buffer inside the same
+ * region reuses its handle. A region is only deregistered once it's unused
+ * and its memory was unmapped (or the group is destroyed).
+ */
+typedef struct ucg_builtin_rcache        ucg_builtin_rcache_t;
+typedef struct ucg_builtin_rcache_region ucg_builtin_rcache_region_t;
+
+void ucg_builtin_rcache_init(ucs_list_link_t *rcaches);
+
+/* Destroy all the caches, whose regions must have been released by now */
+void ucg_builtin_rcache_cleanup(ucs_list_link_t *rcaches);
+
+/* Get (or create) the cache of this memory domain, or NULL if it can't have one */
+ucg_builtin_rcache_t *ucg_builtin_rcache_get(ucs_list_link_t *rcaches, uct_md_h md,
+                                             const uct_md_attr_t *md_attr);
+
+/*
+ * Registration of a buffer, valid until released by @ref ucg_builtin_rcache_put.
+ * The protection (PROT_READ, and PROT_WRITE if it is written) is what the buffer
+ * needs to be mapped with - so that read-only send buffers can be registered too.
+ */
+ucs_status_t ucg_builtin_rcache_reg(ucg_builtin_rcache_t *cache, void *buffer,
+                                    size_t length, int prot,
+                                    ucg_builtin_rcache_region_t **region_p,
+                                    uct_mem_h *memh_p);
+
+void ucg_builtin_rcache_put(ucg_builtin_rcache_t *cache,
+                            ucg_builtin_rcache_region_t *region);
+
+END_C_DECLS
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include "builtin_reduce.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <ucs/debug/log.h>
+
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#endif
+
+/*
+ * The kernels are plain loops, which the compiler vectorizes once per
+ * instruction set - the best set the CPU supports is chosen at runtime.
+ * On Arm, NEON is always available, so the "generic" kernels use it.
+ */
+#if defined(__GNUC__) && !defined(__clang__)
+#define UCG_BUILTIN_REDUCE_VECTORIZE __attribute__((optimize("tree-vectorize")))
+#else
+#define UCG_BUILTIN_REDUCE_VECTORIZE
+#endif
+
+#if defined(__aarch64__) && defined(HWCAP_SVE) && \
+    defined(__GNUC__) && !defined(__clang__) && (__GNUC__ >= 10)
+#define UCG_BUILTIN_REDUCE_HAVE_SVE 1
+#endif
+
+#define UCG_BUILTIN_REDUCE_ATTR_generic UCG_BUILTIN_REDUCE_VECTORIZE
+#define UCG_BUILTIN_REDUCE_ATTR_avx2    UCG_BUILTIN_REDUCE_VECTORIZE __attribute__((target("avx2")))
+#define UCG_BUILTIN_REDUCE_ATTR_avx512  UCG_BUILTIN_REDUCE_VECTORIZE __attribute__((target("avx512f")))
+#define UCG_BUILTIN_REDUCE_ATTR_sve     UCG_BUILTIN_REDUCE_VECTORIZE __attribute__((target("+sve")))
+
+#define ucg_builtin_reduce_op_sum(_a, _b)  ((_a) + (_b))
+#define ucg_builtin_reduce_op_prod(_a, _b) ((_a) * (_b))
+#define ucg_builtin_reduce_op_min(_a, _b)  (((_b) < (_a)) ? (_b) : (_a))
+#define ucg_builtin_reduce_op_max(_a, _b)  (((_b) > (_a)) ? (_b) : (_a))
+#define ucg_builtin_reduce_op_band(_a, _b) ((_a) & (_b))
+#define ucg_builtin_reduce_op_bor(_a, _b)  ((_a) | (_b))
+#define ucg_builtin_reduce_op_bxor(_a, _b) ((_a) ^ (_b))
+
+#define UCG_BUILTIN_REDUCE_INT_TYPES(_m, ...)                          \
+    _m(__VA_ARGS__, INT8,   int8,   int8_t,   INT8_MIN,  INT8_MAX)     \
+    _m(__VA_ARGS__, INT16,  int16,  int16_t,  INT16_MIN, INT16_MAX)    \
+    _m(__VA_ARGS__, INT32,  int32,  int32_t,  INT32_MIN, INT32_MAX)    \
+    _m(__VA_ARGS__, INT64,  int64,  int64_t,  INT64_MIN, INT64_MAX)    \
+    _m(__VA_ARGS__, UINT8,  uint8,  uint8_t,  0,         UINT8_MAX)    \
+    _m(__VA_ARGS__, UINT16, uint16, uint16_t, 0,         UINT16_MAX)   \
+    _m(__VA_ARGS__, UINT32, uint32, uint32_t, 0,         UINT32_MAX)   \
+    _m(__VA_ARGS__, UINT64, uint64, uint64_t, 0,         UINT64_MAX)
+
+#define UCG_BUILTIN_REDUCE_FP_TYPES(_m, ...)                           \
+    _m(__VA_ARGS__, FLOAT,  float,  float,    -INFINITY, INFINITY)     \
+    _m(__VA_ARGS__, DOUBLE, double, double,   -INFINITY, INFINITY)
+
+/* Arithmetic operators apply to all the types, bitwise ones only to integers */
+#define UCG_BUILTIN_REDUCE_ARITH(_m, ...)        \
+    UCG_BUILTIN_REDUCE_INT_TYPES(_m, __VA_ARGS__) \
+    UCG_BUILTIN_REDUCE_FP_TYPES(_m, __VA_ARGS__)
+
+#define UCG_BUILTIN_REDUCE_BITWISE(_m, ...)      \
+    UCG_BUILTIN_REDUCE_INT_TYPES(_m, __VA_ARGS__)
+
+#define UCG_BUILTIN_REDUCE_KERNEL(_isa, _op, _DT, _dt, _type, _lo, _hi)       \
+static UCG_BUILTIN_REDUCE_ATTR_##_isa void                                      \
+ucg_builtin_reduce_##_op##_##_dt##_##_isa(void *arg, void *dst, const void *src, \
+                                          size_t count)                         \
+{                                                                               \
+    _type *d       = (_type*)dst;                                               \
+    const _type *s = (const _type*)src;                                         \
+    size_t i;                                                                   \
+    for (i = 0; i < count; i++) {                                               \
+        d[i] = ucg_builtin_reduce_op_##_op(d[i], s[i]);                         \
+    }                                                                           \
+}
+
+#define UCG_BUILTIN_REDUCE_ENTRY(_isa, _op, _DT, _dt, _type, _lo, _hi)        \
+    [UCG_REDUCE_DT_##_DT] = ucg_builtin_reduce_##_op##_##_dt##_##_isa,
+
+#define UCG_BUILTIN_REDUCE_DEFINE(_isa)                                         \
+UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_KERNEL, _isa, sum)                  \
+UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_KERNEL, _isa, prod)                 \
+UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_KERNEL, _isa, min)                  \
+UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_KERNEL, _isa, max)                  \
+UCG_BUILTIN_REDUCE_BITWISE(UCG_BUILTIN_REDUCE_KERNEL, _isa, band)               \
+UCG_BUILTIN_REDUCE_BITWISE(UCG_BUILTIN_REDUCE_KERNEL, _isa, bor)                \
+UCG_BUILTIN_REDUCE_BITWISE(UCG_BUILTIN_REDUCE_KERNEL, _isa, bxor)               \
+                                                                                \
+static const ucg_reduce_kernel_f                                                \
+ucg_builtin_reduce_table_##_isa[UCG_REDUCE_OP_LAST][UCG_REDUCE_DT_LAST] = {     \
+    [UCG_REDUCE_OP_SUM]  = { UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_ENTRY, _isa, sum) },    \
+    [UCG_REDUCE_OP_PROD] = { UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_ENTRY, _isa, prod) },   \
+    [UCG_REDUCE_OP_MIN]  = { UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_ENTRY, _isa, min) },    \
+    [UCG_REDUCE_OP_MAX]  = { UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_ENTRY, _isa, max) },    \
+    [UCG_REDUCE_OP_BAND] = { UCG_BUILTIN_REDUCE_BITWISE(UCG_BUILTIN_REDUCE_ENTRY, _isa, band) }, \
+    [UCG_REDUCE_OP_BOR]  = { UCG_BUILTIN_REDUCE_BITWISE(UCG_BUILTIN_REDUCE_ENTRY, _isa, bor) },  \
+    [UCG_REDUCE_OP_BXOR] = { UCG_BUILTIN_REDUCE_BITWISE(UCG_BUILTIN_REDUCE_ENTRY, _isa, bxor) }, \
+};
+
+UCG_BUILTIN_REDUCE_DEFINE(generic)
+#if defined(__x86_64__)
+UCG_BUILTIN_REDUCE_DEFINE(avx2)
+UCG_BUILTIN_REDUCE_DEFINE(avx512)
+#elif defined(UCG_BUILTIN_REDUCE_HAVE_SVE)
+UCG_BUILTIN_REDUCE_DEFINE(sve)
+#endif
+
+/* The identity element of each operator, per data-type */
+#define UCG_BUILTIN_REDUCE_IDENTITY(_unused, _DT, _dt, _type, _lo, _hi)       \
+static const _type ucg_builtin_reduce_identity_##_dt[UCG_REDUCE_OP_LAST] = {   \
+    [UCG_REDUCE_OP_SUM]  = 0,                                                   \
+    [UCG_REDUCE_OP_PROD] = 1,                                                   \
+    [UCG_REDUCE_OP_MIN]  = _hi,                                                 \
+    [UCG_REDUCE_OP_MAX]  = _lo,                                                 \
+    [UCG_REDUCE_OP_BAND] = (_type)~0ull,                                        \
+    [UCG_REDUCE_OP_BOR]  = 0,                                                   \
+    [UCG_REDUCE_OP_BXOR] = 0                                                    \
+};
+
+#define UCG_BUILTIN_REDUCE_IDENTITY_ENTRY(_unused, _DT, _dt, _type, _lo, _hi) \
+    [UCG_REDUCE_DT_##_DT] = ucg_builtin_reduce_identity_##_dt,
+
+#define UCG_BUILTIN_REDUCE_SIZE_ENTRY(_unused, _DT, _dt, _type, _lo, _hi)     \
+    [UCG_REDUCE_DT_##_DT] = sizeof(_type),
+
+UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_IDENTITY, _)
+
+static const void *ucg_builtin_reduce_identity[UCG_REDUCE_DT_LAST] = {
+    UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_IDENTITY_ENTRY, _)
+};
+
+static const size_t ucg_builtin_reduce_dt_size[UCG_REDUCE_DT_LAST] = {
+    UCG_BUILTIN_REDUCE_ARITH(UCG_BUILTIN_REDUCE_SIZE_ENTRY, _)
+};
+
+static const ucg_reduce_kernel_f (*ucg_builtin_reduce_table)[UCG_REDUCE_DT_LAST] = NULL;
+
+void ucg_builtin_reduce_select(void)
+{
+    const char *isa = "generic";
+
+    if (ucg_builtin_reduce_table != NULL) {
+        return;
+    }
+
+    ucg_builtin_reduce_table = ucg_builtin_reduce_table_generic;
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f")) {
+        ucg_builtin_reduce_table = ucg_builtin_reduce_table_avx512;
+        isa                      = "avx512";
+    } else if (__builtin_cpu_supports("avx2")) {
+        ucg_builtin_reduce_table = ucg_builtin_reduce_table_avx2;
+        isa                      = "avx2";
+    }
+#elif defined(UCG_BUILTIN_REDUCE_HAVE_SVE)
+    if (getauxval(AT_HWCAP) & HWCAP_SVE) {
+        ucg_builtin_reduce_table = ucg_builtin_reduce_table_sve;
+        isa                      = "sve";
+    }
+#endif
+
+    ucs_debug("using %s reduction kernels", isa);
+}
+
+int ucg_builtin_reduce_find(const ucg_group_params_t *group_params,
+                            const ucg_collective_params_t *coll_params,
+                            ucg_reduce_kernel_t *kernel)
+{
+    ucg_reduce_op_t op;
+    ucg_reduce_dt_t dt;
+
+    if ((group_params->reduce_type_f == NULL) ||
+        !group_params->reduce_type_f(coll_params->recv.op_ext,
+                                     coll_params->recv.dt_ext, &op, &dt)) {
+        return 0; /* user-defined, or not identified */
+    }
+
+    if ((op >= UCG_REDUCE_OP_LAST) || (dt >= UCG_REDUCE_DT_LAST) ||
+        (ucg_builtin_reduce_dt_size[dt] != coll_params->recv.dt_len)) {
+        ucs_debug("reduction %d on datatype %d (length %zu) has no kernel",
+                  (int)op, (int)dt, coll_params->recv.dt_len);
+        return 0;
+    }
+
+    ucs_assert(ucg_builtin_reduce_table != NULL);
+    kernel->func = ucg_builtin_reduce_table[op][dt];
+    if (kernel->func == NULL) {
+        return 0; /* e.g. bitwise operators on floating-point types */
+    }
+
+    kernel->func_reversed  = kernel->func;
+    kernel->arg            = NULL;
+    kernel->dt_len         = ucg_builtin_reduce_dt_size[dt];
+    kernel->is_commutative = 1;
+    kernel->identity       = (const char*)ucg_builtin_reduce_identity[dt] +
+                             (op * kernel->dt_len);
+    return 1;
+}
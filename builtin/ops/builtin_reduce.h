@@ -0,0 +1,30 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_BUILTIN_REDUCE_H_
+#define UCG_BUILTIN_REDUCE_H_
+
+#include <ucg/api/ucg.h>
+
+BEGIN_C_DECLS
+
+/*
+ * Native reduction kernels, for the predefined (operator, data-type) pairs.
+ * Each computes dst[i] = src[i] (op) dst[i] for "count" elements, same as
+ * the MPI callback does, only without going through the MPI layer. These
+ * operators are commutative, so the same kernel serves the reversed order.
+ */
+
+/* Pick the best kernels this CPU supports (called once per group creation) */
+void ucg_builtin_reduce_select(void);
+
+/* Fill the native kernel for this collective, returns 0 if there's none */
+int ucg_builtin_reduce_find(const ucg_group_params_t *group_params,
+                            const ucg_collective_params_t *coll_params,
+                            ucg_reduce_kernel_t *kernel);
+
+END_C_DECLS
+
+#endif
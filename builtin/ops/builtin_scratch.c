@@ -0,0 +1,261 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include "builtin_scratch.h"
+
+#include <string.h>
+#include <sys/mman.h>
+#include <ucs/arch/cpu.h>
+#include <ucs/sys/sys.h>
+#include <ucs/sys/math.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/assert.h>
+#include <ucs/debug/memtrack.h>
+
+struct ucg_builtin_scratch_chunk {
+    ucg_builtin_scratch_chunk_t *next;       /* next in the free-list */
+    size_t                       length;     /* of the chunk, header included */
+    uint8_t                      size_class; /* or UCG_BUILTIN_SCRATCH_LARGE */
+    uint8_t                      is_huge;    /* mapped from huge pages */
+    uct_md_h                     md;         /* registered with, if not NULL */
+    uct_mem_h                    memh;
+};
+
+/* The buffer itself starts on the cache-line after the chunk header */
+#define UCG_BUILTIN_SCRATCH_HDR_LEN UCS_SYS_CACHE_LINE_SIZE
+UCS_STATIC_ASSERT(sizeof(ucg_builtin_scratch_chunk_t) <= UCG_BUILTIN_SCRATCH_HDR_LEN);
+
+#define UCG_BUILTIN_SCRATCH_CHUNK(_buffer) \
+    ((ucg_builtin_scratch_chunk_t*)UCS_PTR_BYTE_OFFSET(_buffer, \
+            -(ptrdiff_t)UCG_BUILTIN_SCRATCH_HDR_LEN))
+
+#define UCG_BUILTIN_SCRATCH_BUFFER(_chunk) \
+    UCS_PTR_BYTE_OFFSET(_chunk, UCG_BUILTIN_SCRATCH_HDR_LEN)
+
+#define UCG_BUILTIN_SCRATCH_CAPACITY(_chunk) \
+    ((_chunk)->length - UCG_BUILTIN_SCRATCH_HDR_LEN)
+
+/* Size class of the buffers beyond the power-of-2 ones */
+#define UCG_BUILTIN_SCRATCH_LARGE   ((uint8_t)-1)
+
+static inline size_t ucg_builtin_scratch_class_len(unsigned size_class)
+{
+    return UCS_BIT(size_class + UCG_BUILTIN_SCRATCH_MIN_SHIFT);
+}
+
+void ucg_builtin_scratch_init(ucg_builtin_scratch_t *scratch, int use_hugetlb,
+                              size_t max_cached)
+{
+    memset(scratch->free, 0, sizeof(scratch->free));
+    scratch->free_large  = NULL;
+    scratch->cached      = 0;
+    scratch->max_cached  = max_cached;
+    scratch->outstanding = 0;
+    scratch->use_hugetlb = use_hugetlb;
+}
+
+static void ucg_builtin_scratch_release(ucg_builtin_scratch_chunk_t *chunk)
+{
+    if (chunk->md != NULL) {
+        uct_md_mem_dereg(chunk->md, chunk->memh);
+    }
+
+    if (chunk->is_huge) {
+        ucs_munmap(chunk, chunk->length);
+    } else {
+        ucs_free(chunk);
+    }
+}
+
+static void ucg_builtin_scratch_release_list(ucg_builtin_scratch_chunk_t **list)
+{
+    ucg_builtin_scratch_chunk_t *chunk;
+    while ((chunk = *list) != NULL) {
+        *list = chunk->next;
+        ucg_builtin_scratch_release(chunk);
+    }
+}
+
+void ucg_builtin_scratch_cleanup(ucg_builtin_scratch_t *scratch)
+{
+    unsigned size_class;
+
+    if (scratch->outstanding) {
+        ucs_warn("%u scratch buffers were not returned", scratch->outstanding);
+    }
+
+    for (size_class = 0; size_class < UCG_BUILTIN_SCRATCH_CLASSES; size_class++) {
+        ucg_builtin_scratch_release_list(&scratch->free[size_class]);
+    }
+    ucg_builtin_scratch_release_list(&scratch->free_large);
+    scratch->cached = 0;
+}
+
+static ucg_builtin_scratch_chunk_t*
+ucg_builtin_scratch_alloc(ucg_builtin_scratch_t *scratch, uint8_t size_class,
+                          size_t capacity)
+{
+    size_t length = UCG_BUILTIN_SCRATCH_HDR_LEN + capacity;
+    ucg_builtin_scratch_chunk_t *chunk = NULL;
+    ssize_t huge_page_size;
+    size_t huge_length;
+    void *ptr;
+
+    /* Huge pages are only worth it for buffers of at least one such page */
+    if (scratch->use_hugetlb) {
+        huge_page_size = ucs_get_huge_page_size();
+        if ((huge_page_size > 0) && (length >= (size_t)huge_page_size)) {
+            huge_length = ucs_align_up(length, huge_page_size);
+            ptr         = ucs_mmap(NULL, huge_length, PROT_READ | PROT_WRITE,
+                                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0,
+                                   "ucg_scratch_huge");
+            if (ptr != MAP_FAILED) {
+                chunk          = ptr;
+                chunk->is_huge = 1;
+                chunk->length  = huge_length;
+            } else {
+                ucs_debug("failed to map %zu bytes of huge pages: %m", huge_length);
+            }
+        }
+    }
+
+    if (chunk == NULL) {
+        if (ucs_posix_memalign(&ptr, UCS_SYS_CACHE_LINE_SIZE, length,
+                               "ucg_scratch") != 0) {
+            return NULL;
+        }
+
+        chunk          = ptr;
+        chunk->is_huge = 0;
+        chunk->length  = length;
+    }
+
+    chunk->size_class = size_class;
+    chunk->md         = NULL;
+    return chunk;
+}
+
+/*
+ * The best fitting large buffer, unless it's over a quarter larger than needed
+ * (not counting the rounding up to a huge page, if those are used).
+ */
+static ucg_builtin_scratch_chunk_t*
+ucg_builtin_scratch_get_large(ucg_builtin_scratch_t *scratch, size_t length)
+{
+    ucg_builtin_scratch_chunk_t **iter, **best = NULL;
+    ucg_builtin_scratch_chunk_t *chunk;
+    size_t capacity, max_capacity;
+    ssize_t huge_page_size;
+
+    max_capacity = length + (length / 4);
+    if (scratch->use_hugetlb) {
+        huge_page_size = ucs_get_huge_page_size();
+        if (huge_page_size > 0) {
+            max_capacity += huge_page_size;
+        }
+    }
+
+    for (iter = &scratch->free_large; *iter != NULL; iter = &(*iter)->next) {
+        capacity = UCG_BUILTIN_SCRATCH_CAPACITY(*iter);
+        if ((capacity >= length) && (capacity <= max_capacity) &&
+            ((best == NULL) || (capacity < UCG_BUILTIN_SCRATCH_CAPACITY(*best)))) {
+            best = iter;
+        }
+    }
+
+    if (best != NULL) {
+        chunk            = *best;
+        *best            = chunk->next;
+        scratch->cached -= chunk->length;
+        return chunk;
+    }
+
+    return ucg_builtin_scratch_alloc(scratch, UCG_BUILTIN_SCRATCH_LARGE,
+                                     ucs_align_up(length, ucs_get_page_size()));
+}
+
+void *ucg_builtin_scratch_get(ucg_builtin_scratch_t *scratch, size_t length)
+{
+    ucg_builtin_scratch_chunk_t *chunk;
+    unsigned size_class = 0;
+
+    if (length > ucg_builtin_scratch_class_len(UCG_BUILTIN_SCRATCH_CLASSES - 1)) {
+        chunk = ucg_builtin_scratch_get_large(scratch, length);
+        if (chunk == NULL) {
+            return NULL;
+        }
+        goto out;
+    }
+
+    if (length > ucg_builtin_scratch_class_len(0)) {
+        size_class = ucs_ilog2(length - 1) + 1 - UCG_BUILTIN_SCRATCH_MIN_SHIFT;
+    }
+
+    chunk = scratch->free[size_class];
+    if (ucs_likely(chunk != NULL)) {
+        scratch->free[size_class] = chunk->next;
+        scratch->cached          -= chunk->length;
+    } else {
+        chunk = ucg_builtin_scratch_alloc(scratch, size_class,
+                                          ucg_builtin_scratch_class_len(size_class));
+        if (chunk == NULL) {
+            return NULL;
+        }
+    }
+
+out:
+    scratch->outstanding++;
+    return UCG_BUILTIN_SCRATCH_BUFFER(chunk);
+}
+
+void ucg_builtin_scratch_put(ucg_builtin_scratch_t *scratch, void *buffer)
+{
+    ucg_builtin_scratch_chunk_t *chunk = UCG_BUILTIN_SCRATCH_CHUNK(buffer);
+    ucg_builtin_scratch_chunk_t **list;
+
+    ucs_assert(scratch->outstanding > 0);
+    scratch->outstanding--;
+
+    /* above the high-water mark - give the memory back rather than keep it */
+    if (scratch->cached + chunk->length > scratch->max_cached) {
+        ucg_builtin_scratch_release(chunk);
+        return;
+    }
+
+    list             = (chunk->size_class == UCG_BUILTIN_SCRATCH_LARGE) ?
+                       &scratch->free_large : &scratch->free[chunk->size_class];
+    chunk->next      = *list;
+    *list            = chunk;
+    scratch->cached += chunk->length;
+}
+
+size_t ucg_builtin_scratch_footprint(const void *buffer)
+{
+    return UCG_BUILTIN_SCRATCH_CHUNK(buffer)->length;
+}
+
+ucs_status_t ucg_builtin_scratch_reg(void *buffer, uct_md_h md, uct_mem_h *memh_p)
+{
+    ucg_builtin_scratch_chunk_t *chunk = UCG_BUILTIN_SCRATCH_CHUNK(buffer);
+    ucs_status_t status;
+
+    if (ucs_unlikely(chunk->md != md)) {
+        if (chunk->md != NULL) {
+            uct_md_mem_dereg(chunk->md, chunk->memh);
+            chunk->md = NULL;
+        }
+
+        status = uct_md_mem_reg(md, buffer, UCG_BUILTIN_SCRATCH_CAPACITY(chunk),
+                                UCT_MD_MEM_ACCESS_ALL, &chunk->memh);
+        if (status != UCS_OK) {
+            return status;
+        }
+
+        chunk->md = md;
+    }
+
+    *memh_p = chunk->memh;
+    return UCS_OK;
+}
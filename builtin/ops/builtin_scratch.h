@@ -0,0 +1,56 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_BUILTIN_SCRATCH_H_
+#define UCG_BUILTIN_SCRATCH_H_
+
+#include <uct/api/uct.h>
+
+BEGIN_C_DECLS
+
+/*
+ * Per-group arena of temporary buffers (e.g. for waypoint steps or the final
+ * rotation of Bruck algorithms). Small buffers are kept in power-of-2 size
+ * classes, and large ones are rounded up to whole pages instead - so once a
+ * collective was created, the same ones are simply reused. Each buffer keeps
+ * its memory registration, so reusing it costs none either. Returned buffers
+ * beyond the given amount are released, rather than kept for later.
+ */
+#define UCG_BUILTIN_SCRATCH_MIN_SHIFT 6  /* smallest buffer is 64 bytes */
+#define UCG_BUILTIN_SCRATCH_MAX_SHIFT 16 /* larger ones are page-rounded */
+#define UCG_BUILTIN_SCRATCH_CLASSES   (UCG_BUILTIN_SCRATCH_MAX_SHIFT - \
+                                       UCG_BUILTIN_SCRATCH_MIN_SHIFT + 1)
+
+typedef struct ucg_builtin_scratch_chunk ucg_builtin_scratch_chunk_t;
+
+typedef struct ucg_builtin_scratch {
+    ucg_builtin_scratch_chunk_t *free[UCG_BUILTIN_SCRATCH_CLASSES];
+    ucg_builtin_scratch_chunk_t *free_large;  /* page-rounded, of any length */
+    size_t                       cached;      /* bytes on the free-lists */
+    size_t                       max_cached;  /* beyond which buffers are released */
+    unsigned                     outstanding; /* buffers currently in use */
+    int                          use_hugetlb; /* map large buffers from huge pages */
+} ucg_builtin_scratch_t;
+
+void ucg_builtin_scratch_init(ucg_builtin_scratch_t *scratch, int use_hugetlb,
+                              size_t max_cached);
+
+/* Release all the buffers, which must have been returned by now */
+void ucg_builtin_scratch_cleanup(ucg_builtin_scratch_t *scratch);
+
+/* Get a buffer of at least this length (not zeroed), or NULL if out of memory */
+void *ucg_builtin_scratch_get(ucg_builtin_scratch_t *scratch, size_t length);
+
+void ucg_builtin_scratch_put(ucg_builtin_scratch_t *scratch, void *buffer);
+
+/* Memory actually taken by a buffer (i.e. including rounding and header) */
+size_t ucg_builtin_scratch_footprint(const void *buffer);
+
+/* Registration of an entire buffer, valid (and owned by the arena) until cleanup */
+ucs_status_t ucg_builtin_scratch_reg(void *buffer, uct_md_h md, uct_mem_h *memh_p);
+
+END_C_DECLS
+
+#endif
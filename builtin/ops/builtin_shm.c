@@ -0,0 +1,361 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include "builtin_shm.h"
+
+#include <stdio.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <ucg/base/ucg_topo.h>
+#include <ucs/arch/atomic.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/assert.h>
+#include <ucs/debug/memtrack.h>
+
+/* The first cache-line of the segment, followed by the slots */
+typedef struct ucg_builtin_shm_hdr {
+    volatile uint32_t attached; /* number of members which mapped the segment */
+    volatile uint32_t owner;    /* PID of the leader, set once it's ready */
+} ucg_builtin_shm_hdr_t;
+UCS_STATIC_ASSERT(sizeof(ucg_builtin_shm_hdr_t) <= UCS_SYS_CACHE_LINE_SIZE);
+UCS_STATIC_ASSERT(sizeof(ucg_builtin_shm_slot_t) % UCS_SYS_CACHE_LINE_SIZE == 0);
+
+void ucg_builtin_shm_init(ucg_builtin_shm_t *shm, unsigned slot_cnt)
+{
+    shm->seg       = NULL;
+    shm->seg_size  = 0;
+    shm->local_cnt = 0;
+    shm->local_idx = 0;
+    shm->slot_cnt  = slot_cnt;
+    shm->seq       = NULL;
+    shm->status    = UCS_OK;
+    shm->name[0]   = '\0';
+}
+
+/*
+ * A leader which failed to create the segment leaves a marker of it instead,
+ * so that the other members stop waiting for it (see @ref ucg_builtin_shm_attach).
+ */
+static void ucg_builtin_shm_marker_name(const ucg_builtin_shm_t *shm, char *name,
+                                        size_t max)
+{
+    snprintf(name, max, "%s_failed", shm->name);
+}
+
+static int ucg_builtin_shm_pid_is_alive(pid_t pid)
+{
+    return (kill(pid, 0) == 0) || (errno == EPERM);
+}
+
+void ucg_builtin_shm_cleanup(ucg_builtin_shm_t *shm)
+{
+    ucg_builtin_shm_hdr_t *hdr = shm->seg;
+    char marker[sizeof(shm->name) + 8];
+
+    if ((shm->local_idx == 0) && (shm->status != UCS_OK) && (shm->name[0] != '\0')) {
+        ucg_builtin_shm_marker_name(shm, marker, sizeof(marker));
+        shm_unlink(marker);
+    }
+
+    if (hdr != NULL) {
+        /* the name is removed once all the members attached, if ever */
+        if ((shm->local_idx == 0) && (hdr->attached < shm->local_cnt)) {
+            shm_unlink(shm->name);
+        }
+        munmap(shm->seg, shm->seg_size);
+        shm->seg = NULL;
+    }
+
+    ucs_free(shm->seq);
+    shm->seq     = NULL;
+    shm->status  = UCS_OK;
+    shm->name[0] = '\0';
+}
+
+static void ucg_builtin_shm_mapped(ucg_builtin_shm_t *shm, void *seg)
+{
+    ucg_builtin_shm_hdr_t *hdr = seg;
+
+    /* the last member to attach removes the name, so nothing is left behind */
+    shm->seg = seg;
+    if (ucs_atomic_fadd32(&hdr->attached, 1) + 1 == shm->local_cnt) {
+        shm_unlink(shm->name);
+    }
+}
+
+/* Not attached yet - unless the leader failed to create the segment */
+static ucs_status_t ucg_builtin_shm_attach_pending(ucg_builtin_shm_t *shm)
+{
+    char marker[sizeof(shm->name) + 8];
+    int fd;
+
+    ucg_builtin_shm_marker_name(shm, marker, sizeof(marker));
+    fd = shm_open(marker, O_RDONLY, 0);
+    if (fd < 0) {
+        return UCS_INPROGRESS;
+    }
+
+    close(fd);
+    ucs_error("the leader failed to create the shared-memory segment %s", shm->name);
+    shm->status = UCS_ERR_IO_ERROR;
+    return shm->status;
+}
+
+ucs_status_t ucg_builtin_shm_attach(ucg_builtin_shm_t *shm)
+{
+    ucg_builtin_shm_hdr_t *hdr;
+    struct stat st;
+    void *seg;
+    int fd;
+
+    if (shm->seg != NULL) {
+        return UCS_OK;
+    } else if (shm->status != UCS_OK) {
+        return shm->status;
+    }
+
+    fd = shm_open(shm->name, O_RDWR, 0);
+    if (fd < 0) {
+        if (errno == ENOENT) {
+            return ucg_builtin_shm_attach_pending(shm);
+        }
+        ucs_error("shm_open(%s) failed: %m", shm->name);
+        shm->status = UCS_ERR_IO_ERROR;
+        return shm->status;
+    }
+
+    /* the leader may not have set the size yet */
+    if (fstat(fd, &st) < 0) {
+        ucs_error("fstat(%s) failed: %m", shm->name);
+        close(fd);
+        shm->status = UCS_ERR_IO_ERROR;
+        return shm->status;
+    } else if ((size_t)st.st_size != shm->seg_size) {
+        close(fd);
+        return ucg_builtin_shm_attach_pending(shm);
+    }
+
+    seg = mmap(NULL, shm->seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (seg == MAP_FAILED) {
+        ucs_error("mmap(%s, %zu) failed: %m", shm->name, shm->seg_size);
+        shm->status = UCS_ERR_NO_MEMORY;
+        return shm->status;
+    }
+
+    /* not ready yet, or left behind by a leader which is gone (to be replaced) */
+    hdr = seg;
+    if ((hdr->owner == 0) || !ucg_builtin_shm_pid_is_alive((pid_t)hdr->owner)) {
+        munmap(seg, shm->seg_size);
+        return ucg_builtin_shm_attach_pending(shm);
+    }
+
+    ucg_builtin_shm_mapped(shm, seg);
+    return UCS_OK;
+}
+
+/*
+ * Whether the segment of that name was left behind by a leader which is gone,
+ * rather than used by another (live) group which happens to have the same name.
+ */
+static int ucg_builtin_shm_is_stale(ucg_builtin_shm_t *shm)
+{
+    ucg_builtin_shm_hdr_t *hdr;
+    struct stat st;
+    int is_stale;
+    int fd;
+
+    fd = shm_open(shm->name, O_RDONLY, 0);
+    if (fd < 0) {
+        return errno == ENOENT;
+    }
+
+    if ((fstat(fd, &st) < 0) || ((size_t)st.st_size < sizeof(*hdr))) {
+        close(fd);
+        return 0;
+    }
+
+    hdr = mmap(NULL, sizeof(*hdr), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (hdr == MAP_FAILED) {
+        return 0;
+    }
+
+    is_stale = (hdr->owner != 0) && !ucg_builtin_shm_pid_is_alive((pid_t)hdr->owner);
+    munmap(hdr, sizeof(*hdr));
+    return is_stale;
+}
+
+static ucs_status_t ucg_builtin_shm_create(ucg_builtin_shm_t *shm)
+{
+    ucg_builtin_shm_hdr_t *hdr;
+    void *seg;
+    int fd;
+
+    fd = shm_open(shm->name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    if ((fd < 0) && (errno == EEXIST) && ucg_builtin_shm_is_stale(shm)) {
+        ucs_debug("taking over the stale shared-memory segment %s", shm->name);
+        shm_unlink(shm->name);
+        fd = shm_open(shm->name, O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+    }
+
+    if (fd < 0) {
+        ucs_error("shm_open(%s) failed: %m", shm->name);
+        return UCS_ERR_IO_ERROR;
+    }
+
+    if (ftruncate(fd, shm->seg_size) < 0) {
+        ucs_error("ftruncate(%s, %zu) failed: %m", shm->name, shm->seg_size);
+        goto err_unlink;
+    }
+
+    seg = mmap(NULL, shm->seg_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (seg == MAP_FAILED) {
+        ucs_error("mmap(%s, %zu) failed: %m", shm->name, shm->seg_size);
+        goto err_unlink;
+    }
+
+    close(fd);
+
+    /* the others attach it from now on */
+    hdr = seg;
+    ucs_memory_cpu_store_fence();
+    hdr->owner = (uint32_t)getpid();
+    ucg_builtin_shm_mapped(shm, seg);
+    return UCS_OK;
+
+err_unlink:
+    close(fd);
+    shm_unlink(shm->name);
+    return UCS_ERR_IO_ERROR;
+}
+
+/*
+ * The segment is named after the leader's worker address, which is unique
+ * (unlike the group ID, which other jobs on the same node may use as well).
+ */
+static ucs_status_t ucg_builtin_shm_set_name(ucg_builtin_shm_t *shm,
+                                             const ucg_group_params_t *group_params,
+                                             ucg_group_member_index_t leader)
+{
+    uint64_t hash = 14695981039346656037ull; /* FNV-1a */
+    ucg_address_t *addr;
+    size_t addr_len, i;
+
+    ucs_status_t status = group_params->resolve_address_f(group_params->cb_group_obj,
+                                                          leader, &addr, &addr_len);
+    if (status != UCS_OK) {
+        ucs_error("failed to obtain the address of member #%lu", (unsigned long)leader);
+        return status;
+    }
+
+    for (i = 0; i < addr_len; i++) {
+        hash = (hash ^ ((const uint8_t*)addr)[i]) * 1099511628211ull;
+    }
+    group_params->release_address_f(addr);
+
+    snprintf(shm->name, sizeof(shm->name), "/ucg_shm_%016llx_%x",
+             (unsigned long long)hash, group_params->cid);
+    return UCS_OK;
+}
+
+ucs_status_t ucg_builtin_shm_connect(ucg_builtin_shm_t *shm,
+                                     const ucg_group_params_t *group_params,
+                                     const ucg_topo_t *topo)
+{
+    uint32_t host_id = topo->members[topo->my_index].host_id;
+    ucg_group_member_index_t idx;
+    char marker[sizeof(shm->name) + 8];
+    ucs_status_t status;
+    int fd;
+
+    if (shm->status != UCS_OK) {
+        return shm->status;
+    } else if (shm->name[0] != '\0') {
+        return UCS_OK;
+    }
+
+    shm->local_cnt = 0;
+    for (idx = 0; idx < topo->member_count; idx++) {
+        if (topo->members[idx].host_id == host_id) {
+            if (idx == topo->my_index) {
+                shm->local_idx = shm->local_cnt;
+            }
+            shm->local_cnt++;
+        }
+    }
+
+    shm->seg_size = UCS_SYS_CACHE_LINE_SIZE + (shm->slot_cnt * shm->local_cnt *
+                                               sizeof(ucg_builtin_shm_slot_t));
+    shm->seq      = ucs_calloc(shm->slot_cnt, sizeof(*shm->seq), "shm sequence");
+    if (shm->seq == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    status = ucg_builtin_shm_set_name(shm, group_params, host_id);
+    if (status != UCS_OK) {
+        goto err_free;
+    }
+
+    ucs_debug("shared-memory segment %s: member %lu of %lu, %zu bytes", shm->name,
+              (unsigned long)shm->local_idx, (unsigned long)shm->local_cnt, shm->seg_size);
+
+    if (shm->local_idx != 0) {
+        status = ucg_builtin_shm_attach(shm);
+        return UCS_STATUS_IS_ERR(status) ? status : UCS_OK;
+    }
+
+    /* a marker of an earlier failure with this name is no longer relevant */
+    ucg_builtin_shm_marker_name(shm, marker, sizeof(marker));
+    shm_unlink(marker);
+
+    status = ucg_builtin_shm_create(shm);
+    if (status != UCS_OK) {
+        /* let the others know, rather than have them wait for the segment */
+        fd = shm_open(marker, O_CREAT | O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd >= 0) {
+            close(fd);
+        }
+        shm->status = status;
+    }
+    return status;
+
+err_free:
+    ucs_free(shm->seq);
+    shm->seq     = NULL;
+    shm->name[0] = '\0';
+    return status;
+}
+
+ucs_status_t ucg_builtin_shm_cma_read(pid_t pid, void *buffer, uint64_t remote_addr,
+                                      size_t length)
+{
+    struct iovec local_iov, remote_iov;
+    ssize_t len;
+
+    /* the kernel may copy less than asked, e.g. upon crossing a page it lacks */
+    while (length > 0) {
+        local_iov.iov_base  = buffer;
+        local_iov.iov_len   = length;
+        remote_iov.iov_base = (void*)(uintptr_t)remote_addr;
+        remote_iov.iov_len  = length;
+        len = process_vm_readv(pid, &local_iov, 1, &remote_iov, 1, 0);
+        if (ucs_unlikely(len <= 0)) {
+            ucs_error("process_vm_readv(pid %d, length %zu) failed: %m", (int)pid, length);
+            return UCS_ERR_IO_ERROR;
+        }
+
+        buffer       = UCS_PTR_BYTE_OFFSET(buffer, len);
+        remote_addr += len;
+        length      -= len;
+    }
+
+    return UCS_OK;
+}
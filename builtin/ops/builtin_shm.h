@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifndef UCG_BUILTIN_SHM_H_
+#define UCG_BUILTIN_SHM_H_
+
+#include <ucg/api/ucg_plan_component.h>
+#include <ucg/base/ucg_topo.h>
+#include <ucs/sys/compiler_def.h>
+#include <ucs/arch/cpu.h>
+#include <sys/types.h>
+
+BEGIN_C_DECLS
+
+/*
+ * Per-group shared-memory segment of the members on the same node, used by
+ * barriers and small allreduce operations instead of the transport. For each
+ * collective slot (of the window of outstanding collectives) every member has
+ * a slot of its own: the members post their data in theirs, and the leader of
+ * the node (the member with the lowest index there) posts the result in its
+ * own. A slot holds the data of a collective once its sequence number reaches
+ * that collective's, so no slot is ever reset. Larger vectors are not copied
+ * into the slots: each member posts the address of its buffer instead, and the
+ * others read it directly (see @ref ucg_builtin_shm_cma_read).
+ */
+#define UCG_BUILTIN_SHM_MAX_DATA 256 /* largest message in a slot */
+
+typedef struct ucg_builtin_shm_slot {
+    volatile uint64_t seq;  /* last collective (or stage of it) whose data is here */
+    uint64_t          addr; /* of the buffer the others may read, if posted */
+    uint64_t          pid;  /* of the process owning that buffer */
+    uint8_t           pad[UCS_SYS_CACHE_LINE_SIZE - (3 * sizeof(uint64_t))];
+    uint8_t           data[UCG_BUILTIN_SHM_MAX_DATA];
+} ucg_builtin_shm_slot_t;
+
+typedef struct ucg_builtin_shm {
+    void                     *seg;       /* mapped segment, or NULL if not yet */
+    size_t                    seg_size;
+    ucg_group_member_index_t  local_cnt; /* number of members on this node */
+    ucg_group_member_index_t  local_idx; /* my position among them, 0 for the leader */
+    unsigned                  slot_cnt;  /* collective slots of the group */
+    uint64_t                 *seq;       /* last collective done, per collective slot */
+    ucs_status_t              status;    /* why the segment can not be used, once failed */
+    char                      name[64];  /* of the segment, empty if not connected */
+} ucg_builtin_shm_t;
+
+void ucg_builtin_shm_init(ucg_builtin_shm_t *shm, unsigned slot_cnt);
+
+/* Release the segment, unmapping (and removing) it if it was mapped */
+void ucg_builtin_shm_cleanup(ucg_builtin_shm_t *shm);
+
+/*
+ * Prepare the segment for the first collective using it: the leader creates
+ * it, and the others try to attach it (see @ref ucg_builtin_shm_attach). Once
+ * it failed (on any member of the node), the group does without it.
+ */
+ucs_status_t ucg_builtin_shm_connect(ucg_builtin_shm_t *shm,
+                                     const ucg_group_params_t *group_params,
+                                     const ucg_topo_t *topo);
+
+/*
+ * Attach the segment created by the leader: UCS_INPROGRESS if it's not there
+ * yet, or the error the leader failed to create it with.
+ */
+ucs_status_t ucg_builtin_shm_attach(ucg_builtin_shm_t *shm);
+
+/* Copy the memory of another process on this node (CMA), all of it or fail */
+ucs_status_t ucg_builtin_shm_cma_read(pid_t pid, void *buffer, uint64_t remote_addr,
+                                      size_t length);
+
+static UCS_F_ALWAYS_INLINE ucg_builtin_shm_slot_t*
+ucg_builtin_shm_slot(const ucg_builtin_shm_t *shm, unsigned coll_slot,
+                     ucg_group_member_index_t local_idx)
+{
+    ucg_builtin_shm_slot_t *slots = (ucg_builtin_shm_slot_t*)
+            UCS_PTR_BYTE_OFFSET(shm->seg, UCS_SYS_CACHE_LINE_SIZE);
+    return &slots[(coll_slot * shm->local_cnt) + local_idx];
+}
+
+END_C_DECLS
+
+#endif
@@ -27,6 +27,7 @@
 typedef struct ucg_builtin_binomial_tree_params {
     ucg_builtin_group_ctx_t *ctx;
     const ucg_group_params_t *group_params;
+    const ucg_topo_t *topo;
     const ucg_collective_type_t *coll_type;
     enum ucg_builtin_plan_topology_type topo_type;
     ucg_group_member_index_t root;
@@ -51,13 +52,13 @@ ucs_config_field_t ucg_builtin_binomial_tree_config_table[] = {
     {NULL}
 };
 
-unsigned ucg_builtin_calculate_ppx(const ucg_group_params_t *group_params,
+unsigned ucg_builtin_calculate_ppx(const ucg_topo_t *topo,
                                    enum ucg_group_member_distance domain_distance)
 {
     unsigned member_idx;
     unsigned ppx = 0;
-    for (member_idx = 0; member_idx < group_params->member_count; member_idx++) {
-        enum ucg_group_member_distance next_distance = group_params->distance[member_idx];
+    for (member_idx = 0; member_idx < topo->member_count; member_idx++) {
+        enum ucg_group_member_distance next_distance = ucg_topo_my_distance(topo, member_idx);
         ucs_assert(next_distance < UCG_GROUP_MEMBER_DISTANCE_LAST);
         if (ucs_likely(next_distance <= domain_distance)) {
             ppx++;
@@ -481,7 +482,7 @@ static ucs_status_t ucg_builtin_binomial_tree_connect_phase(ucg_builtin_plan_pha
     return status;
 }
 
-static void ucg_builtin_get_node_leaders_node_level(const uint16_t *node_index,
+static void ucg_builtin_get_node_leaders_node_level(const ucg_topo_t *topo,
                                                     ucg_group_member_index_t member_count,
                                                     unsigned ppx,
                                                     ucg_group_member_index_t *leaders)
@@ -490,7 +491,7 @@ static void ucg_builtin_get_node_leaders_node_level(const uint16_t *node_index,
     int node_idx;
     leaders[0] = 0;
     for (member_idx = 1, node_idx = 0; member_idx < member_count; member_idx++) {
-        if (node_index[member_idx] > node_idx) {
+        if (ucg_topo_node_index(topo, member_idx) > node_idx) {
             node_idx++;
             leaders[node_idx] = member_idx;
         }
@@ -508,12 +509,12 @@ static void ucg_builtin_get_node_leaders_normal_level(ucg_group_member_index_t m
     }
 }
 
-static ucs_status_t ucg_builtin_get_node_leaders(const uint16_t *node_index, ucg_group_member_index_t member_count,
+static ucs_status_t ucg_builtin_get_node_leaders(const ucg_topo_t *topo, ucg_group_member_index_t member_count,
                                                  enum ucg_group_hierarchy_level level, unsigned ppx,
                                                  ucg_group_member_index_t *leaders)
 {
     if (level == UCG_GROUP_HIERARCHY_LEVEL_NODE) {
-        ucg_builtin_get_node_leaders_node_level(node_index, member_count, ppx, leaders);
+        ucg_builtin_get_node_leaders_node_level(topo, member_count, ppx, leaders);
     } else {
         ucg_builtin_get_node_leaders_normal_level(member_count, ppx, leaders);
     }
@@ -852,7 +853,7 @@ static ucs_status_t ucg_builtin_binomial_tree_inter_create(enum ucg_builtin_plan
                 unsigned phs_cnt = tree->phs_cnt;
                 ucg_group_member_index_t *node_leaders = UCS_ALLOC_CHECK(node_count * sizeof(ucg_group_member_index_t),
                                                                          "recursive ranks");
-                (void)ucg_builtin_get_node_leaders(params->group_params->node_index,
+                (void)ucg_builtin_get_node_leaders(params->topo,
                                                    params->group_params->member_count,
                                                    ucg_algo.topo_level, ppx, node_leaders);
                 ucg_builtin_recursive_connect(params->ctx, my_index, node_leaders, node_count, factor, 0, tree);
@@ -1432,7 +1433,7 @@ static void ucg_builtin_prepare_member_idx(const ucg_builtin_binomial_tree_param
         k = 0;
         ucg_group_member_index_t member_idx;
         for (member_idx = 0; member_idx < params->group_params->member_count; member_idx++) {
-            if (ucs_likely(params->group_params->distance[member_idx] <= domain_distance)) {
+            if (ucs_likely(ucg_topo_my_distance(params->topo, member_idx) <= domain_distance)) {
                 member_list[k++] = member_idx;
             }
         }
@@ -1579,9 +1580,9 @@ static ucs_status_t ucg_builtin_tree_build(const ucg_builtin_binomial_tree_param
         /* L3cache-aware: ppx = ppl (processes per L3cache) */
         enum ucg_group_member_distance domain_distance = UCG_GROUP_MEMBER_DISTANCE_HOST;
         status = choose_distance_from_topo_aware_level(&domain_distance);
-        *ppx = ucg_builtin_calculate_ppx(params->group_params, domain_distance);
-        *ppn = ucg_builtin_calculate_ppx(params->group_params, UCG_GROUP_MEMBER_DISTANCE_HOST);
-        *pps = ucg_builtin_calculate_ppx(params->group_params, UCG_GROUP_MEMBER_DISTANCE_SOCKET);
+        *ppx = ucg_builtin_calculate_ppx(params->topo, domain_distance);
+        *ppn = ucg_builtin_calculate_ppx(params->topo, UCG_GROUP_MEMBER_DISTANCE_HOST);
+        *pps = ucg_builtin_calculate_ppx(params->topo, UCG_GROUP_MEMBER_DISTANCE_SOCKET);
         status = ucg_builtin_topo_tree_build(params, topo_params, domain_distance, root, rank, up, up_cnt, down,
                                              down_cnt, up_fanin, up_fanin_cnt,
                                              down_fanin, down_fanin_cnt,
@@ -1662,7 +1663,7 @@ static ucs_status_t ucg_builtin_binomial_tree_build(const ucg_builtin_binomial_t
     size = params->group_params->member_count;
 
     /* find my own rank */
-    status = ucg_builtin_find_myself(params->group_params, &rank);
+    status = ucg_builtin_find_myself(params->topo, &rank);
     if (status != UCS_OK) {
         return status;
     }
@@ -1670,7 +1671,7 @@ static ucs_status_t ucg_builtin_binomial_tree_build(const ucg_builtin_binomial_t
 
     /* topology information obtain from ompi layer */
     ucg_builtin_topology_info_params_t *topo_params = (ucg_builtin_topology_info_params_t *)UCS_ALLOC_CHECK(sizeof(ucg_builtin_topology_info_params_t), "topo params");
-    status = ucg_builtin_topology_info_create(topo_params, params->group_params, params->root);
+    status = ucg_builtin_topology_info_create(topo_params, params->topo, params->root);
     if (status != UCS_OK) {
         ucg_builtin_binomial_tree_free_topo_info(&topo_params);
         ucs_error("Invalid paramters in topological info create");
@@ -1718,6 +1719,7 @@ ucs_status_t ucg_builtin_binomial_tree_create(ucg_builtin_group_ctx_t *ctx,
         .coll_type = coll_type,
         .topo_type = plan_topo_type,
         .group_params = group_params,
+        .topo = ucg_builtin_group_topo(ctx),
         .root = coll_type->root,
         .tree_degree_inter_fanout = config->bmtree.degree_inter_fanout,
         .tree_degree_inter_fanin  = config->bmtree.degree_inter_fanin,
@@ -0,0 +1,193 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include <string.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+
+#include "builtin_plan.h"
+
+#define NUM_TWO 2
+
+/*
+ * Find the peers of my ring: the members at my position (among the members of
+ * their node) on the previous and the next nodes, in the order of the nodes'
+ * leaders. The ring is given as "ring_cnt" - the number of nodes - and my node's
+ * position among them. All nodes must have the same number of members.
+ */
+static ucs_status_t ucg_builtin_node_ring_peers(const ucg_topo_t *topo,
+                                                ucg_group_member_index_t local_idx,
+                                                ucg_group_member_index_t local_cnt,
+                                                unsigned *ring_cnt, unsigned *ring_index,
+                                                ucg_group_member_index_t *src,
+                                                ucg_group_member_index_t *dst)
+{
+    uint32_t host_id = topo->members[topo->my_index].host_id;
+    ucg_group_member_index_t idx, leader, node_cnt = 0;
+    ucg_group_member_index_t *position, *members;
+    ucs_status_t status = UCS_OK;
+
+    /* indexed by the leaders: the position of their node, and its member count */
+    position = ucs_calloc(NUM_TWO * topo->member_count, sizeof(*position), "node positions");
+    if (position == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+    members = position + topo->member_count;
+
+    for (idx = 0; idx < topo->member_count; idx++) {
+        leader = topo->members[idx].host_id;
+        if (leader == idx) {
+            position[leader] = node_cnt++;
+        }
+        members[leader]++;
+    }
+
+    for (idx = 0; idx < topo->member_count; idx++) {
+        if ((topo->members[idx].host_id == idx) && (members[idx] != local_cnt)) {
+            ucs_error("node of member #%lu has %lu members, instead of %lu",
+                      (unsigned long)idx, (unsigned long)members[idx],
+                      (unsigned long)local_cnt);
+            status = UCS_ERR_UNSUPPORTED;
+            goto out;
+        }
+    }
+
+    *ring_cnt   = node_cnt;
+    *ring_index = position[host_id];
+
+    /* count the members of each node again, to find those at my position */
+    memset(members, 0, topo->member_count * sizeof(*members));
+    for (idx = 0; idx < topo->member_count; idx++) {
+        leader = topo->members[idx].host_id;
+        if (members[leader]++ != local_idx) {
+            continue;
+        }
+
+        if (position[leader] == (*ring_index + node_cnt - 1) % node_cnt) {
+            *src = idx;
+        }
+        if (position[leader] == (*ring_index + 1) % node_cnt) {
+            *dst = idx;
+        }
+    }
+
+out:
+    ucs_free(position);
+    return status;
+}
+
+/*
+ * Node-aware ring: the members on each node reduce-scatter their vectors through
+ * shared memory, so that each one holds the sum of its own slice over the node.
+ * Each member then runs a ring (reduce-scatter followed by allgather) on its slice
+ * with the members at the same position on the other nodes - so all the members,
+ * and the rails they use, carry a share of the traffic between nodes. Finally,
+ * the members on each node gather the slices of the others, again through shared
+ * memory. Every node must have the same number of members.
+ */
+ucs_status_t ucg_builtin_node_ring_create(ucg_builtin_group_ctx_t *ctx,
+                                          enum ucg_builtin_plan_topology_type plan_topo_type,
+                                          const ucg_builtin_config_t *config,
+                                          const ucg_group_params_t *group_params,
+                                          const ucg_collective_type_t *coll_type,
+                                          ucg_builtin_plan_t **plan_p)
+{
+    const ucg_topo_t *topo            = ucg_builtin_group_topo(ctx);
+    ucg_group_member_index_t my_index = topo->my_index;
+    uint32_t host_id                  = topo->members[my_index].host_id;
+    ucg_group_member_index_t local_cnt, local_idx, idx;
+    ucg_group_member_index_t peer_index_src = my_index;
+    ucg_group_member_index_t peer_index_dst = my_index;
+    ucg_builtin_plan_phase_t *phase, *phase_zero;
+    unsigned ring_cnt, ring_index, ring_steps;
+    ucg_step_idx_ext_t step_idx;
+    ucs_status_t status;
+
+    local_cnt = 0;
+    local_idx = 0;
+    for (idx = 0; idx < topo->member_count; idx++) {
+        if (topo->members[idx].host_id == host_id) {
+            if (idx == my_index) {
+                local_idx = local_cnt;
+            }
+            local_cnt++;
+        }
+    }
+
+    status = ucg_builtin_node_ring_peers(topo, local_idx, local_cnt, &ring_cnt,
+                                         &ring_index, &peer_index_src, &peer_index_dst);
+    if (status != UCS_OK) {
+        return status;
+    }
+
+    /* the ring's phases, between the node-local reduce-scatter and allgather */
+    ring_steps = NUM_TWO * (ring_cnt - 1);
+    size_t alloc_size = sizeof(ucg_builtin_plan_t) +
+            ((ring_steps + NUM_TWO) * sizeof(ucg_builtin_plan_phase_t)) +
+            (NUM_TWO * sizeof(uct_ep_h));
+    ucg_builtin_plan_t *node_ring = (ucg_builtin_plan_t*)ucs_malloc(alloc_size, "node ring topology");
+    if (node_ring == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+    memset(node_ring, 0, alloc_size);
+    node_ring->phs_cnt  = ring_steps + NUM_TWO;
+    node_ring->step_cnt = node_ring->phs_cnt;
+
+    phase             = &node_ring->phss[0];
+    phase->method     = UCG_PLAN_METHOD_SHM_REDUCE_SCATTER;
+    phase->step_index = 0;
+
+    if (ring_steps > 0) {
+        phase             = &node_ring->phss[1];
+        phase->method     = UCG_PLAN_METHOD_REDUCE_SCATTER_RING;
+        phase->step_index = 1;
+        phase->ring_cnt   = ring_cnt;
+        phase->ring_index = ring_index;
+        phase->ring_base  = 1;
+        phase->slice_cnt  = local_cnt;
+        phase->slice_idx  = local_idx;
+
+#if ENABLE_DEBUG_DATA
+        phase->indexes = UCS_ALLOC_CHECK(((peer_index_src == peer_index_dst) ? 1 : NUM_TWO) *
+                                         sizeof(my_index), "node ring indexes");
+#endif
+
+        /* the endpoints are located after all the phases, hence the "step_idx" */
+        node_ring->ep_cnt = NUM_TWO;
+        status = ucg_builtin_ring_connect(ctx, phase, ring_steps + 1, peer_index_src,
+                                          peer_index_dst, node_ring);
+        if (status != UCS_OK) {
+            ucs_error("Error in node ring create: %d", (int)status);
+            ucs_free(node_ring);
+            return status;
+        }
+
+        /* the other ring phases are filled in from the first, once connected */
+        phase_zero = phase;
+        for (step_idx = 1; step_idx < ring_steps; step_idx++) {
+            phase             = &node_ring->phss[step_idx + 1];
+            ucg_builtin_plan_clone_phase(phase, phase_zero);
+            phase->method     = (step_idx < ring_cnt - 1) ?
+                                UCG_PLAN_METHOD_REDUCE_SCATTER_RING :
+                                UCG_PLAN_METHOD_ALLGATHER_RING;
+            phase->step_index = step_idx + 1;
+        }
+    }
+
+    phase             = &node_ring->phss[node_ring->phs_cnt - 1];
+    phase->method     = UCG_PLAN_METHOD_SHM_ALLGATHER;
+    phase->step_index = node_ring->phs_cnt - 1;
+
+    ucs_debug("node ring plan: member %lu of %lu on its node, node %u of %u, "
+              "peers #%lu(source) and #%lu(destination)", (unsigned long)local_idx,
+              (unsigned long)local_cnt, ring_index, ring_cnt,
+              (unsigned long)peer_index_src, (unsigned long)peer_index_dst);
+
+    node_ring->super.my_index                = my_index;
+    node_ring->super.support_non_commutative = 0;
+    node_ring->super.support_large_datatype  = 1;
+    *plan_p = node_ring;
+    return UCS_OK;
+}
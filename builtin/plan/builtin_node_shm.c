@@ -0,0 +1,104 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2019-2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#include <string.h>
+#include <ucs/debug/log.h>
+#include <ucs/debug/memtrack.h>
+
+#include "builtin_plan.h"
+
+/* the layout expected by @ref ucg_builtin_recursive_connect */
+#define MAX_PEERS 100
+#define MAX_PHASES 16
+#define NUM_TWO 2
+
+/*
+ * Node-local plan: the members on each node pass their data to the leader of
+ * the node through shared memory, the leaders run recursive doubling among
+ * themselves (if there are several nodes), and then the members on each node
+ * read the result of their leader - again through shared memory. Either phase
+ * is omitted on a node where the leader is the only member.
+ */
+ucs_status_t ucg_builtin_node_shm_create(ucg_builtin_group_ctx_t *ctx,
+                                         enum ucg_builtin_plan_topology_type plan_topo_type,
+                                         const ucg_builtin_config_t *config,
+                                         const ucg_group_params_t *group_params,
+                                         const ucg_collective_type_t *coll_type,
+                                         ucg_builtin_plan_t **plan_p)
+{
+    const ucg_topo_t *topo            = ucg_builtin_group_topo(ctx);
+    ucg_group_member_index_t my_index = topo->my_index;
+    uint32_t host_id                  = topo->members[my_index].host_id;
+    ucg_group_member_index_t local_cnt, leader_cnt, idx;
+    ucg_builtin_plan_phase_t *phase;
+    ucs_status_t status = UCS_OK;
+
+    ucg_group_member_index_t *leaders = ucs_malloc(topo->member_count * sizeof(*leaders),
+                                                   "node leaders");
+    if (leaders == NULL) {
+        return UCS_ERR_NO_MEMORY;
+    }
+
+    local_cnt  = 0;
+    leader_cnt = 0;
+    for (idx = 0; idx < topo->member_count; idx++) {
+        if (topo->members[idx].host_id == host_id) {
+            local_cnt++;
+        }
+        if (topo->members[idx].host_id == idx) {
+            leaders[leader_cnt++] = idx;
+        }
+    }
+
+    size_t alloc_size = sizeof(ucg_builtin_plan_t) +
+            (MAX_PHASES * sizeof(ucg_builtin_plan_phase_t)) + MAX_PEERS * sizeof(uct_ep_h);
+    ucg_builtin_plan_t *node_shm = (ucg_builtin_plan_t*)ucs_malloc(alloc_size, "node shm topology");
+    if (node_shm == NULL) {
+        ucs_free(leaders);
+        return UCS_ERR_NO_MEMORY;
+    }
+    memset(node_shm, 0, alloc_size);
+
+    if (local_cnt > 1) {
+        phase             = &node_shm->phss[node_shm->phs_cnt++];
+        phase->method     = UCG_PLAN_METHOD_SHM_FANIN;
+        phase->step_index = node_shm->step_cnt++;
+    }
+
+    if ((my_index == host_id) && (leader_cnt > 1)) {
+        status = ucg_builtin_recursive_connect(ctx, my_index, leaders, leader_cnt,
+                                               NUM_TWO, 0, node_shm);
+        if (status != UCS_OK) {
+            goto out;
+        }
+
+        for (idx = 0; idx < node_shm->phs_cnt; idx++) {
+            node_shm->step_cnt = ucs_max(node_shm->step_cnt,
+                                         node_shm->phss[idx].step_index + 1);
+        }
+    }
+
+    if (local_cnt > 1) {
+        phase             = &node_shm->phss[node_shm->phs_cnt++];
+        phase->method     = UCG_PLAN_METHOD_SHM_FANOUT;
+        phase->step_index = node_shm->step_cnt++;
+    }
+
+    ucs_debug("node shm plan: member %lu of %lu on its node, %lu nodes, %u phases",
+              (unsigned long)my_index, (unsigned long)local_cnt,
+              (unsigned long)leader_cnt, (unsigned)node_shm->phs_cnt);
+
+    node_shm->super.my_index                = my_index;
+    node_shm->super.support_non_commutative = 0;
+    node_shm->super.support_large_datatype  = 1;
+    *plan_p = node_shm;
+
+out:
+    if (status != UCS_OK) {
+        ucs_free(node_shm);
+    }
+    ucs_free(leaders);
+    return status;
+}
@@ -7,6 +7,7 @@
 #define UCG_BUILTIN_PLAN_H
 
 #include <ucg/api/ucg_plan_component.h>
+#include <ucg/base/ucg_topo.h>
 #include <ucs/datastruct/mpool.inl>
 #include <uct/api/uct.h>
 
@@ -36,6 +37,8 @@ struct ucg_builtin_algorithm {
     /* UCG_GROUP_HIERARCHY_LEVEL_L3CACHE:  L3cache-aware */
     unsigned ring;       /* ring       0: recursive       1: ring */
     unsigned pipeline;   /* pipeline   0: normal send     1: pipelining send for waypoint */
+    unsigned halving;    /* halving    0: recursive doubling  1: recursive halving/doubling */
+    unsigned kary;       /* kary       0: recursive doubling  1: recursive k-ing, see @ref ucg_builtin_recursive_factor */
     uint8_t  feature_flag; /* @ref enum ucg_builtin_algorithm_feature */
 };
 
@@ -45,7 +48,8 @@ enum choose_ops_mask {
     OPS_AUTO_DECISION,
     OPS_BCAST,
     OPS_ALLREDUCE,
-    OPS_BARRIER
+    OPS_BARRIER,
+    OPS_REDUCE
 };
 
 enum ucg_change_algo {
@@ -65,6 +69,9 @@ enum ucg_builtin_plan_topology_type {
     UCG_PLAN_BRUCK,
     UCG_PLAN_LAST,
     UCG_PLAN_RING,
+    UCG_PLAN_NODE_SHM,
+    UCG_PLAN_NODE_RING,
+    UCG_PLAN_RECURSIVE_HALVING,
 };
 
 enum UCS_S_PACKED ucg_builtin_plan_method_type {
@@ -84,6 +91,12 @@ enum UCS_S_PACKED ucg_builtin_plan_method_type {
     UCG_PLAN_METHOD_ALLTOALL_BRUCK,    /* send+receive for alltoall   (BRUCK) */
     UCG_PLAN_METHOD_REDUCE_SCATTER_RING,
     UCG_PLAN_METHOD_ALLGATHER_RING,
+    UCG_PLAN_METHOD_SHM_FANIN,         /* pass to the node leader, via shared memory */
+    UCG_PLAN_METHOD_SHM_FANOUT,        /* take from the node leader, via shared memory */
+    UCG_PLAN_METHOD_SHM_REDUCE_SCATTER, /* reduce my slice of the node's vectors */
+    UCG_PLAN_METHOD_SHM_ALLGATHER,     /* read the others' slices on this node */
+    UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING, /* send half my blocks, reduce the other half */
+    UCG_PLAN_METHOD_ALLGATHER_DOUBLING, /* send my blocks, receive as many */
 };
 
 enum ucg_builtin_bcast_algorithm {
@@ -92,6 +105,8 @@ enum ucg_builtin_bcast_algorithm {
     UCG_ALGORITHM_BCAST_NODE_AWARE_BMTREE            = 2, /* Topo-aware tree (Binomial tree + Binomial tree) */
     UCG_ALGORITHM_BCAST_NODE_AWARE_KMTREE_AND_BMTREE = 3, /* Topo-aware tree (K-nomial tree + Binomial tree) */
     UCG_ALGORITHM_BCAST_NODE_AWARE_KMTREE            = 4, /* Topo-aware tree (K-nomial tree + K-nomial tree) */
+    UCG_ALGORITHM_BCAST_PIPELINED_BMTREE             = 5, /* Binomial tree, forwarding each segment as it arrives */
+    UCG_ALGORITHM_BCAST_PIPELINED_NODE_AWARE_KMTREE  = 6, /* Topo-aware tree (K-nomial tree + K-nomial tree), pipelined */
     UCG_ALGORITHM_BCAST_LAST,
 };
 
@@ -105,6 +120,9 @@ enum ucg_builtin_allreduce_algorithm {
     UCG_ALGORITHM_ALLREDUCE_SOCKET_AWARE_RECURSIVE_AND_KMTREE  = 6, /* Topo-aware Recursive (with K-nomial tree for intra node, ppn inside socket) */
     UCG_ALGORITHM_ALLREDUCE_NODE_AWARE_KMTREE                  = 7, /* Topo-aware FANIN-FANOUT (with K-nomial tree for intra node, ppn inside node) */
     UCG_ALGORITHM_ALLREDUCE_SOCKET_AWARE_KMTREE                = 8, /* Topo-aware FANIN-FANOUT (with K-nomial tree for intra node, ppn inside socket) */
+    UCG_ALGORITHM_ALLREDUCE_PIPELINED_RING                     = 9, /* Ring, passing each segment on to the next step as it arrives */
+    UCG_ALGORITHM_ALLREDUCE_NODE_AWARE_RING                    = 10, /* Topo-aware Ring (reduce-scatter inside node, a ring per slice between nodes) */
+    UCG_ALGORITHM_ALLREDUCE_RABENSEIFNER                       = 11, /* Recursive halving (reduce-scatter) + Recursive doubling (allgather) */
     UCG_ALGORITHM_ALLREDUCE_LAST,
 };
 
@@ -120,6 +138,33 @@ enum ucg_builtin_barrier_algorithm {
     UCG_ALGORITHM_BARRIER_LAST,
 };
 
+enum ucg_builtin_reduce_algorithm {
+    UCG_ALGORITHM_REDUCE_AUTO_DECISION                       = 0,
+    UCG_ALGORITHM_REDUCE_BMTREE                              = 1, /* Binomial tree */
+    UCG_ALGORITHM_REDUCE_PIPELINED_BMTREE                    = 2, /* Binomial tree, forwarding each segment once reduced */
+    UCG_ALGORITHM_REDUCE_LAST,
+};
+
+/*
+ * Message size classes - each class of a collective is planned and cached
+ * separately, so that it may use a different algorithm.
+ */
+enum ucg_builtin_msg_size_class {
+    UCG_BUILTIN_MSG_SIZE_TINY   = 0, /* allreduce through shared memory, if enabled */
+    UCG_BUILTIN_MSG_SIZE_SMALL  = 1,
+    UCG_BUILTIN_MSG_SIZE_MEDIUM = 2,
+    UCG_BUILTIN_MSG_SIZE_LARGE  = 3,
+    UCG_BUILTIN_MSG_SIZE_HUGE   = 4,
+    UCG_BUILTIN_MSG_SIZE_LAST
+};
+
+typedef struct ucg_builtin_msg_size_config {
+    size_t medium; /* smallest message of the medium class */
+    size_t large;  /* smallest message of the large class */
+    size_t huge;   /* smallest message of the huge class */
+} ucg_builtin_msg_size_config_t;
+extern ucs_config_field_t ucg_builtin_msg_size_config_table[];
+
 typedef struct ucg_builtin_tl_threshold {
     int                               initialized;
     size_t                            max_short_one; /* max single short message */
@@ -130,6 +175,21 @@ typedef struct ucg_builtin_tl_threshold {
     size_t                            md_attr_cap_max_reg;
 } ucg_builtin_tl_threshold_t;
 
+/*
+ * Multi-rail: the fragments of large messages may be striped across several
+ * lanes to the same peer (e.g. one per HCA). The rails of a phase are the same
+ * for all its peers, and fragment #i is sent on rail rail_map[i % MAP_LEN].
+ */
+#define UCG_BUILTIN_MAX_RAILS     4
+#define UCG_BUILTIN_RAIL_MAP_LEN 16
+
+typedef struct ucg_builtin_plan_rail {
+    uct_md_h                          md;
+    const uct_md_attr_t              *md_attr;
+    const uct_iface_attr_t           *ep_attr;
+    struct ucg_builtin_rcache        *rcache;
+} ucg_builtin_plan_rail_t;
+
 typedef struct ucg_builtin_plan_phase {
     /* Parameters for buffer send/recv action */
     union {
@@ -151,19 +211,60 @@ typedef struct ucg_builtin_plan_phase {
     unsigned                          is_swap;
     int                               segmented;     /* 1: message to receive is segmented;0: message to receive is not segmented. */
     int8_t                           *recv_cache_buffer; /* temp buffer to receive segmented messages. */
+    size_t                            recv_cache_len; /* length of the above, kept for re-use */
+    size_t                            segment_length; /* fragment length of pipelined plans, or 0 */
+    size_t                            rndv_thresh;   /* length from which receivers read the data */
+    uct_component_h                   component;     /* to unpack the remote keys of the above */
+    uint8_t                           rndv_cma;      /* 1: all my peers read (or are read) using CMA */
+    uint32_t                          rndv_host_id;  /* mine if CMA is supported, see below */
+    uint8_t                           has_remote_peer; /* 1: some peer is on another node */
+    struct ucg_builtin_rcache        *rcache;        /* of user buffers registered with md, or NULL */
+
+    /* Ring phases of a part of the group, working on a slice of the vector */
+    unsigned                          ring_cnt;      /* members in the ring, or 0 for the whole group */
+    unsigned                          ring_index;    /* my position in that ring */
+    ucg_step_idx_ext_t                ring_base;     /* step index of the first ring phase */
+    unsigned                          slice_cnt;     /* slices of the vector, or 0 if not divided */
+    unsigned                          slice_idx;     /* the slice the ring works on */
+
+    /* Recursive halving/doubling phases, exchanging blocks of the vector */
+    unsigned                          block_cnt;     /* blocks of the vector, one per member */
+    unsigned                          block_idx;     /* my block, which I end up reducing */
+    unsigned                          block_distance; /* to the peer, also the blocks exchanged */
+
+    /* Rails other than the one above, see @ref ucg_builtin_plan_rail_t */
+    uint8_t                           rail_cnt;      /* including the one above, 0 if not connected */
+    uint8_t                           rail_map[UCG_BUILTIN_RAIL_MAP_LEN];
+    ucg_builtin_plan_rail_t           rails[UCG_BUILTIN_MAX_RAILS - 1];
+    uct_ep_h                         *rail_eps;      /* [ucp_ep_cnt][UCG_BUILTIN_MAX_RAILS - 1] */
 
     ucp_ep_h                         *ucp_eps;       /* ucp_ep related with this phase(used for release) */
+    uint32_t                          ucp_ep_cnt;    /* size of ucp_eps, may exceed ep_cnt (e.g. ring) */
+    struct ucg_builtin_plan_phase    *clone_of;      /* phase whose endpoints this one shares, or NULL */
 
 #if ENABLE_DEBUG_DATA
     ucg_group_member_index_t         *indexes;       /* array corresponding to EPs */
 #endif
 } ucg_builtin_plan_phase_t;
 
+typedef void (*ucg_builtin_connect_cb_t)(ucg_builtin_plan_phase_t *phase);
+
+/* An endpoint of a plan, which is still being wired up */
+typedef struct ucg_builtin_plan_connect {
+    ucg_builtin_plan_phase_t *phase;          /* phase using this endpoint */
+    unsigned                  phase_ep_index; /* or UCG_BUILTIN_CONNECT_SINGLE_EP */
+    ucg_group_member_index_t  index;          /* remote group member */
+    ucg_builtin_connect_cb_t  connected_cb;   /* called once connected, or NULL */
+} ucg_builtin_plan_connect_t;
+
 typedef struct ucg_builtin_group_ctx ucg_builtin_group_ctx_t;
 typedef struct ucg_builtin_plan {
     ucg_plan_t               super;
     void                    *slots;   /* slots for builtin operations */
+    unsigned                 slot_mask; /* number of slots, minus one */
     ucs_list_link_t         *resend;  /* per-group list of requests to resend */
+    struct ucg_builtin_scratch *scratch; /* per-group arena of temporary buffers */
+    struct ucg_builtin_shm  *shm;     /* per-group node-local shared memory */
     ucs_list_link_t          list;    /* member of a per-group list of plans */
     ucs_list_link_t          by_root; /* extra phases for non-zero root */
     ucs_mpool_t              op_mp;   /* memory pool for (builtin_)operations */
@@ -172,14 +273,41 @@ typedef struct ucg_builtin_plan {
     ucg_step_idx_ext_t       ep_cnt;  /* total endpoint count */
     uint16_t                 am_id;   /* active message ID */
     size_t                   non_power_of_two; /* number of processes is power of two or not */
+    ucg_builtin_plan_connect_t *connect; /* endpoints still being wired up */
+    ucp_ep_h                *connect_eps; /* UCP endpoints of the above */
+    unsigned                 connect_cnt; /* number of endpoints being wired up */
     ucg_builtin_plan_phase_t phss[];  /* topology's phases */
 /*  uct_ep_h                 eps[];    * logically located here */
 } ucg_builtin_plan_t;
 
+/*
+ * Connecting only starts the wireup: the endpoints of a plan are connected
+ * together, once all its phases are created, and the phase details (e.g.
+ * thresholds) are filled in only then - followed by the optional callback.
+ */
 #define UCG_BUILTIN_CONNECT_SINGLE_EP ((unsigned)-1)
+/* Placement of the members of the group, as passed by UCG to the planner */
+const ucg_topo_t *ucg_builtin_group_topo(const ucg_builtin_group_ctx_t *ctx);
+
 ucs_status_t ucg_builtin_connect(ucg_builtin_group_ctx_t *ctx,
                                  ucg_group_member_index_t idx, ucg_builtin_plan_phase_t *phase,
                                  unsigned phase_ep_index);
+ucs_status_t ucg_builtin_connect_cb(ucg_builtin_group_ctx_t *ctx,
+                                    ucg_group_member_index_t idx, ucg_builtin_plan_phase_t *phase,
+                                    unsigned phase_ep_index, ucg_builtin_connect_cb_t connected_cb);
+
+/*
+ * Have a phase use the same endpoints as another phase of the plan - it's filled
+ * in from that phase once the plan is wired up, keeping its own method and step.
+ */
+void ucg_builtin_plan_clone_phase(ucg_builtin_plan_phase_t *phase,
+                                  ucg_builtin_plan_phase_t *original);
+
+/* Progress the wireup of a plan: UCS_OK once it's complete, or UCS_INPROGRESS */
+ucs_status_t ucg_builtin_plan_connect_progress(ucg_builtin_plan_t *plan);
+
+/* Wait for the wireup of a plan to complete */
+ucs_status_t ucg_builtin_plan_connect_wait(ucg_builtin_plan_t *plan);
 
 typedef struct ucg_builtin_config ucg_builtin_config_t;
 
@@ -200,6 +328,7 @@ ucs_status_t ucg_builtin_binomial_tree_create(ucg_builtin_group_ctx_t *ctx,
 typedef struct ucg_builtin_recursive_config {
     unsigned factor;
 } ucg_builtin_recursive_config_t;
+extern ucs_config_field_t ucg_builtin_recursive_config_table[];
 
 ucs_status_t ucg_builtin_recursive_create(ucg_builtin_group_ctx_t *ctx,
                                           enum ucg_builtin_plan_topology_type plan_topo_type,
@@ -216,9 +345,19 @@ ucs_status_t ucg_builtin_recursive_connect(ucg_builtin_group_ctx_t *ctx,
                                            unsigned check_swap,
                                            ucg_builtin_plan_t *recursive);
 
+ucs_status_t ucg_builtin_recursive_halving_create(ucg_builtin_group_ctx_t *ctx,
+                                                  enum ucg_builtin_plan_topology_type plan_topo_type,
+                                                  const ucg_builtin_config_t *config,
+                                                  const ucg_group_params_t *group_params,
+                                                  const ucg_collective_type_t *coll_type,
+                                                  ucg_builtin_plan_t **plan_p);
+
 ucs_status_t ucg_builtin_recursive_compute_steps(ucg_group_member_index_t my_index_local,
                                                  unsigned rank_count, unsigned factor, unsigned *steps);
 
+unsigned ucg_builtin_recursive_factor(const ucg_builtin_config_t *config,
+                                      ucg_group_member_index_t member_cnt);
+
 
 typedef struct ucg_builtin_bruck_config {
     unsigned factor;
@@ -235,6 +374,27 @@ ucs_status_t ucg_builtin_ring_create(ucg_builtin_group_ctx_t *ctx,
                                      const ucg_collective_type_t *coll_type,
                                      ucg_builtin_plan_t **plan_p);
 
+ucs_status_t ucg_builtin_ring_connect(ucg_builtin_group_ctx_t *ctx,
+                                      ucg_builtin_plan_phase_t *phase,
+                                      ucg_step_idx_ext_t step_idx,
+                                      ucg_group_member_index_t peer_index_src,
+                                      ucg_group_member_index_t peer_index_dst,
+                                      ucg_builtin_plan_t *ring);
+
+ucs_status_t ucg_builtin_node_shm_create(ucg_builtin_group_ctx_t *ctx,
+                                         enum ucg_builtin_plan_topology_type plan_topo_type,
+                                         const ucg_builtin_config_t *config,
+                                         const ucg_group_params_t *group_params,
+                                         const ucg_collective_type_t *coll_type,
+                                         ucg_builtin_plan_t **plan_p);
+
+ucs_status_t ucg_builtin_node_ring_create(ucg_builtin_group_ctx_t *ctx,
+                                          enum ucg_builtin_plan_topology_type plan_topo_type,
+                                          const ucg_builtin_config_t *config,
+                                          const ucg_group_params_t *group_params,
+                                          const ucg_collective_type_t *coll_type,
+                                          ucg_builtin_plan_t **plan_p);
+
 ucs_status_t ucg_topo_neighbor_create(ucg_builtin_group_ctx_t *ctx,
                                       enum ucg_builtin_plan_topology_type plan_topo_type,
                                       const ucg_builtin_config_t *config,
@@ -248,7 +408,10 @@ struct ucg_builtin_config {
     ucg_builtin_binomial_tree_config_t bmtree;
     ucg_builtin_recursive_config_t     recursive;
 
-    unsigned                       cache_size;
+    ucg_builtin_msg_size_config_t      allreduce_size;
+    ucg_builtin_msg_size_config_t      bcast_size;
+    ucg_builtin_msg_size_config_t      coll_size; /* other collectives */
+
     size_t                         short_max_tx;
     size_t                         bcopy_max_tx;
     unsigned                       mem_reg_opt_cnt;
@@ -258,10 +421,26 @@ struct ucg_builtin_config {
     double                         bcast_algorithm;
     double                         allreduce_algorithm;
     double                         barrier_algorithm;
+    double                         reduce_algorithm;
 
-    unsigned                       pipelining;
+    size_t                         pipeline_segment;
+    size_t                         rndv_thresh;
+    size_t                         cma_thresh;
+    int                            cma_ptracer_any;
+    int                            shm_coll;
+    int                            node_ring;
 
     unsigned                       max_msg_list_size;
+
+    unsigned                       max_concurrent_colls;
+    int                            scratch_hugetlb;
+    size_t                         scratch_max_cached;
+    int                            mem_reg_cache;
+    unsigned                       max_rails;
+    int                            rail_bw_weighted;
+#if ENABLE_DEBUG_DATA
+    unsigned                       fault_no_resource;
+#endif
 };
 
 ucs_status_t choose_distance_from_topo_aware_level(enum ucg_group_member_distance *domain_distance);
@@ -275,7 +454,7 @@ typedef struct ucg_builtin_topology_info_params {
 } ucg_builtin_topology_info_params_t;
 
 ucs_status_t ucg_builtin_topology_info_create(ucg_builtin_topology_info_params_t *topo_params,
-                                              const ucg_group_params_t *group_params,
+                                              const ucg_topo_t *topo,
                                               ucg_group_member_index_t root);
 
 ucs_status_t ucg_builtin_am_handler(void *arg, void *data, size_t length, unsigned am_flags);
@@ -290,13 +469,18 @@ ucs_status_t ucg_builtin_barrier_algo_switch(const enum ucg_builtin_barrier_algo
 
 ucs_status_t ucg_builtin_allreduce_algo_switch(const enum ucg_builtin_allreduce_algorithm allreduce_algo_decision, struct ucg_builtin_algorithm *algo);
 
-ucs_status_t ucg_builtin_check_ppn(const ucg_group_params_t *group_params,
+ucs_status_t ucg_builtin_reduce_algo_switch(const enum ucg_builtin_reduce_algorithm reduce_algo_decision, struct ucg_builtin_algorithm *algo);
+
+enum ucg_builtin_msg_size_class ucg_builtin_msg_size_class(enum ucg_collective_modifiers modifiers,
+                                                           size_t msg_size);
+
+ucs_status_t ucg_builtin_check_ppn(const ucg_topo_t *topo,
                                    unsigned *unequal_ppn);
 
-ucs_status_t ucg_builtin_find_myself(const ucg_group_params_t *group_params,
+ucs_status_t ucg_builtin_find_myself(const ucg_topo_t *topo,
                                      ucg_group_member_index_t *myrank);
 
-ucs_status_t ucg_builtin_check_continuous_number(const ucg_group_params_t *group_params,
+ucs_status_t ucg_builtin_check_continuous_number(const ucg_topo_t *topo,
                                                  enum ucg_group_member_distance domain_distance,
                                                  unsigned *discont_flag);
 
@@ -322,14 +506,21 @@ enum choose_ops_mask ucg_builtin_plan_choose_ops(ucg_plan_component_t *plan_comp
 ucs_status_t ucg_builtin_algorithm_decision(const ucg_collective_type_t *coll_type,
                                             const size_t msg_size,
                                             const ucg_group_params_t *group_params,
+                                            const ucg_topo_t *topo,
                                             const ucg_collective_params_t *coll_params,
                                             ucg_plan_component_t *plan_component);
 
-unsigned ucg_builtin_calculate_ppx(const ucg_group_params_t *group_params,
+unsigned ucg_builtin_calculate_ppx(const ucg_topo_t *topo,
                                    enum ucg_group_member_distance domain_distance);
 
 
 ucs_status_t ucg_builtin_destroy_plan(ucg_builtin_plan_t *plan, ucg_group_h group);
 
+/* Whether a plan may still be used: not if it needs a shared-memory segment which failed */
+int ucg_builtin_plan_is_usable(const ucg_builtin_plan_t *plan);
+
+size_t ucg_builtin_plan_footprint(const ucg_builtin_plan_t *plan);
+size_t ucg_builtin_op_footprint(const ucg_op_t *op);
+
 
 #endif
\ No newline at end of file
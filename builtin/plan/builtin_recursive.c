@@ -13,79 +13,97 @@
 #define MAX_PEERS 100
 #define MAX_PHASES 16
 #define NUM_TWO 2
+#define MAX_AUTO_FACTOR 8
 
-static ucs_status_t ucg_builtin_recursive_non_pow_two_pre(ucg_builtin_group_ctx_t *ctx,
-                                                          uct_ep_h *next_ep,
-                                                          ucg_builtin_plan_phase_t *phase,
-                                                          ucg_group_member_index_t my_index,
-                                                          ucg_group_member_index_t *member_list,
-                                                          ucg_step_idx_ext_t step_idx,
-                                                          unsigned extra_indexs,
-                                                          unsigned factor,
-                                                          ucg_builtin_plan_t *recursive)
+ucs_config_field_t ucg_builtin_recursive_config_table[] = {
+    {"FACTOR", "0", "Radix of the recursive exchange of barriers and small allreduce operations\n"
+     "(2 is recursive doubling), or 0 to choose it from the group size.\n"
+     "Must be the same on all the processes.\n",
+     ucs_offsetof(ucg_builtin_recursive_config_t, factor), UCS_CONFIG_TYPE_UINT},
+    {NULL}
+};
+
+/*
+ * Groups of a non-power-of-k size are divided into as many parts as the largest
+ * power of k below their size - the first ones with an extra member, like the
+ * slices of a vector - and the last member of every part (its "proxy") takes
+ * part in recursive k-ing on behalf of the others. For k = 2, a part is either
+ * an even member followed by an odd one, or a single member.
+ */
+static void ucg_builtin_recursive_proxy_part(ucg_group_member_index_t member_cnt,
+                                             ucg_group_member_index_t proxy_cnt,
+                                             ucg_group_member_index_t proxy_idx,
+                                             ucg_group_member_index_t *first,
+                                             ucg_group_member_index_t *size)
 {
-    ucs_status_t status;
-    if (my_index % NUM_TWO != 0) {       // add  pre- and after- processing steps;
-        phase->method = UCG_PLAN_METHOD_REDUCE_TERMINAL;
-        phase->ep_cnt = factor - 1;
-        phase->step_index = step_idx;
-#if ENABLE_DEBUG_DATA
-        phase->indexes = UCS_ALLOC_CHECK((factor - 1) * sizeof(my_index), "recursive topology indexes");
-#endif
-        ucg_group_member_index_t peer_index = my_index - 1;
-        phase->multi_eps = next_ep;
-        phase->is_swap = 0;
-        status = ucg_builtin_connect(ctx, member_list[peer_index], phase, UCG_BUILTIN_CONNECT_SINGLE_EP);
-    } else { // only pre- and after- processing steps;
-        phase->method = UCG_PLAN_METHOD_SEND_TERMINAL;
-        phase->ep_cnt = factor - 1;
-        phase->step_index = step_idx;
-#if ENABLE_DEBUG_DATA
-        phase->indexes = UCS_ALLOC_CHECK((factor - 1) * sizeof(my_index), "recursive topology indexes");
-#endif
-        ucg_group_member_index_t peer_index = my_index + 1;
-        phase->multi_eps = next_ep;
-        phase->is_swap = 0;
-        status = ucg_builtin_connect(ctx, member_list[peer_index], phase, UCG_BUILTIN_CONNECT_SINGLE_EP);
+    ucg_group_member_index_t quotient  = member_cnt / proxy_cnt;
+    ucg_group_member_index_t remainder = member_cnt % proxy_cnt;
+
+    *first = (proxy_idx * quotient) + ucs_min(proxy_idx, remainder);
+    *size  = quotient + (proxy_idx < remainder);
+}
+
+/* The part, see @ref ucg_builtin_recursive_proxy_part, which a member is in */
+static ucg_group_member_index_t ucg_builtin_recursive_proxy_idx(ucg_group_member_index_t member_cnt,
+                                                                ucg_group_member_index_t proxy_cnt,
+                                                                ucg_group_member_index_t my_index)
+{
+    ucg_group_member_index_t quotient  = member_cnt / proxy_cnt;
+    ucg_group_member_index_t remainder = member_cnt % proxy_cnt;
+
+    if (my_index < remainder * (quotient + 1)) {
+        return my_index / (quotient + 1);
     }
+    return remainder + ((my_index - (remainder * (quotient + 1))) / quotient);
+}
 
-    return status;
+/* The proxy of a part, who exchanges the data of that part with the others */
+static ucg_group_member_index_t ucg_builtin_recursive_proxy(ucg_group_member_index_t member_cnt,
+                                                            ucg_group_member_index_t proxy_cnt,
+                                                            ucg_group_member_index_t proxy_idx)
+{
+    ucg_group_member_index_t first, size;
+
+    ucg_builtin_recursive_proxy_part(member_cnt, proxy_cnt, proxy_idx, &first, &size);
+    return first + size - 1;
 }
 
-static ucs_status_t ucg_builtin_recursive_non_pow_two_post(ucg_builtin_group_ctx_t *ctx,
+/*
+ * Pre- and after- processing steps: the members of a part pass their data to
+ * its proxy (using "member_method"), and the proxy takes it from all of them
+ * (using "proxy_method") - or the other way round.
+ */
+static ucs_status_t ucg_builtin_recursive_non_pow_two_fold(ucg_builtin_group_ctx_t *ctx,
                                                            uct_ep_h *next_ep,
                                                            ucg_builtin_plan_phase_t *phase,
                                                            ucg_group_member_index_t my_index,
                                                            ucg_group_member_index_t *member_list,
                                                            ucg_step_idx_ext_t step_idx,
-                                                           unsigned extra_indexs,
-                                                           unsigned factor,
-                                                           unsigned near_power_of_two_step,
-                                                           ucg_builtin_plan_t *recursive)
+                                                           ucg_group_member_index_t first,
+                                                           ucg_group_member_index_t size,
+                                                           enum ucg_builtin_plan_method_type proxy_method,
+                                                           enum ucg_builtin_plan_method_type member_method)
 {
-    ucs_status_t status;
-    if (my_index % NUM_TWO != 0) {       /* add pre- and after- processing steps */
-        phase->method = UCG_PLAN_METHOD_SEND_TERMINAL;
-        phase->ep_cnt = factor - 1;
-        phase->step_index = step_idx;
-#if ENABLE_DEBUG_DATA
-        phase->indexes = UCS_ALLOC_CHECK((factor - 1) * sizeof(my_index), "recursive topology indexes");
-#endif
-        ucg_group_member_index_t peer_index = my_index - 1;
-        phase->multi_eps = next_ep;
-        phase->is_swap = 0;
-        status = ucg_builtin_connect(ctx, member_list[peer_index], phase, UCG_BUILTIN_CONNECT_SINGLE_EP);
-    } else { // only pre- and after- processing steps;
-        phase->method = UCG_PLAN_METHOD_RECV_TERMINAL;
-        phase->ep_cnt = factor - 1;
-        phase->step_index = step_idx;
+    ucg_group_member_index_t proxy = first + size - 1;
+    ucg_group_member_index_t peer_idx;
+    ucs_status_t status = UCS_OK;
+
+    phase->method     = (my_index == proxy) ? proxy_method : member_method;
+    phase->ep_cnt     = (my_index == proxy) ? (size - 1) : 1;
+    phase->step_index = step_idx;
+    phase->multi_eps  = next_ep;
+    phase->is_swap    = 0;
 #if ENABLE_DEBUG_DATA
-        phase->indexes = UCS_ALLOC_CHECK((factor - 1) * sizeof(my_index), "recursive topology indexes");
+    phase->indexes = UCS_ALLOC_CHECK(phase->ep_cnt * sizeof(my_index), "recursive topology indexes");
 #endif
-        ucg_group_member_index_t peer_index = my_index + 1;
-        phase->multi_eps = next_ep;
-        phase->is_swap = 0;
-        status = ucg_builtin_connect(ctx, member_list[peer_index], phase, UCG_BUILTIN_CONNECT_SINGLE_EP);
+
+    if (my_index != proxy) {
+        return ucg_builtin_connect(ctx, member_list[proxy], phase, UCG_BUILTIN_CONNECT_SINGLE_EP);
+    }
+
+    for (peer_idx = 0; ((peer_idx < size - 1) && (status == UCS_OK)); peer_idx++) {
+        status = ucg_builtin_connect(ctx, member_list[first + peer_idx], phase,
+                                     (size != NUM_TWO) ? peer_idx : UCG_BUILTIN_CONNECT_SINGLE_EP);
     }
     return status;
 }
@@ -111,10 +129,10 @@ static ucs_status_t ucg_builtin_check_swap(unsigned factor, ucg_step_idx_t step_
 static ucs_status_t ucg_builtin_recursive_non_pow_two_inter(ucg_builtin_group_ctx_t *ctx,
                                                             ucg_group_member_index_t new_my_index,
                                                             ucg_group_member_index_t *member_list,
-                                                            unsigned step_size,
+                                                            ucg_group_member_index_t member_cnt,
+                                                            unsigned proxy_cnt,
                                                             unsigned near_power_of_two_step,
                                                             unsigned factor,
-                                                            unsigned extra_indexs,
                                                             unsigned check_swap,
                                                             ucg_step_idx_ext_t step_idx,
                                                             ucg_builtin_plan_phase_t **phase,
@@ -122,6 +140,7 @@ static ucs_status_t ucg_builtin_recursive_non_pow_two_inter(ucg_builtin_group_ct
                                                             ucg_builtin_plan_t *recursive)
 {
     ucs_status_t status = UCS_OK;
+    unsigned step_size;
     ucg_step_idx_t idx;
     if (new_my_index != ((ucg_group_member_index_t)-1)) {
         for (idx = 0, step_size = 1; ((idx < near_power_of_two_step) && (status == UCS_OK));
@@ -139,17 +158,15 @@ static ucs_status_t ucg_builtin_recursive_non_pow_two_inter(ucg_builtin_group_ct
             }
             /* In each step, there are one or more peers */
             unsigned step_peer_idx;
+            (*phase)->multi_eps = *next_ep;
             for (step_peer_idx = 1; ((step_peer_idx < factor) && (status == UCS_OK)); step_peer_idx++) {
                 ucg_group_member_index_t peer_index =
                     step_base + ((new_my_index - step_base + step_size * step_peer_idx) % (step_size * factor));
-                if (peer_index < extra_indexs) {
-                    peer_index = NUM_TWO * peer_index + 1;
-                } else {
-                    peer_index += extra_indexs;
-                }
+                peer_index = ucg_builtin_recursive_proxy(member_cnt, proxy_cnt, peer_index);
                 ucs_info("%lu's peer #%u/%u (step #%u/%u): %lu ", new_my_index, step_peer_idx, factor - 1, idx + 1,
                     recursive->phs_cnt, peer_index);
-                (*phase)->multi_eps = (*next_ep)++;
+                (*next_ep)++;
+                recursive->ep_cnt++;
                 status = ucg_builtin_connect(ctx, member_list[peer_index], (*phase),
                     (factor != NUM_TWO) ? (step_peer_idx - 1) : UCG_BUILTIN_CONNECT_SINGLE_EP);
             }
@@ -171,25 +188,19 @@ static ucs_status_t ucg_builtin_recursive_non_pow_two(ucg_builtin_group_ctx_t *c
                                                       ucg_builtin_plan_t *recursive)
 {
     ucg_builtin_plan_phase_t *phase = &recursive->phss[recursive->phs_cnt];
-    ucg_group_member_index_t new_my_index = (ucg_group_member_index_t) - 1;
-    unsigned extra_indexs;
-    unsigned near_power_of_two_step = (step_size != member_cnt) ? (step_cnt - 1) : step_cnt;
-    step_size >>= 1;
-    extra_indexs = member_cnt - step_size;
-    if (my_index < NUM_TWO * extra_indexs && my_index % NUM_TWO == 0) {
-        step_cnt = NUM_TWO;  // only pre- and after- processing steps
-    } else if (my_index < NUM_TWO * extra_indexs && my_index % NUM_TWO != 0) {
-        step_cnt++;  // add  pre- and after- processing steps
-        new_my_index = my_index / NUM_TWO;
-    } else {
-        step_cnt--;  // no   pre- and after- processing steps
-        new_my_index = my_index - extra_indexs;
+    ucg_group_member_index_t new_my_index, first, size;
+    unsigned near_power_of_two_step = step_cnt - 1;
+    step_size /= factor;
+    new_my_index = ucg_builtin_recursive_proxy_idx(member_cnt, step_size, my_index);
+    ucg_builtin_recursive_proxy_part(member_cnt, step_size, new_my_index, &first, &size);
+    if (my_index != first + size - 1) {
+        new_my_index = (ucg_group_member_index_t)-1; // only pre- and after- processing steps
     }
     /*
-     * for     power of two processes case:
-     * - near_power_of_two = log2(proc_count)
-     * for non power of two processes case:
-     * - near_power_of_two = log2(nearest power of two number less than proc_count)
+     * for     power of k processes case:
+     * - near_power_of_two = log_k(proc_count)
+     * for non power of k processes case:
+     * - near_power_of_two = log_k(nearest power of k number less than proc_count)
      */
     /*
        TO support non-commutative operation, like matrix multiplication, modified recursive doubling change a little
@@ -205,46 +216,51 @@ static ucs_status_t ucg_builtin_recursive_non_pow_two(ucg_builtin_group_ctx_t *c
                          1  <->  4    3  <->  5
 
        after-         0 <- 1    2 <- 3    4    5
+
+       For a factor k above 2, every part of (up to k) consecutive ranks passes its
+       data to its last rank - the proxy - which is not order-preserving.
     */
     ucs_status_t status;
     ucg_step_idx_ext_t step_idx = recursive->step_cnt;
     uct_ep_h *next_ep               = (uct_ep_h*)(&recursive->phss[MAX_PHASES]) + recursive->ep_cnt;
-    if (my_index < (NUM_TWO * extra_indexs)) {
-        /* pre - processing steps for non power of two processes case */
-        status = ucg_builtin_recursive_non_pow_two_pre(ctx, next_ep, phase, my_index, member_list,
-                                                       step_idx, extra_indexs, factor,
-                                                       recursive);
+    if (size > 1) {
+        /* pre - processing steps for non power of k processes case */
+        status = ucg_builtin_recursive_non_pow_two_fold(ctx, next_ep, phase, my_index, member_list,
+                                                        step_idx, first, size,
+                                                        UCG_PLAN_METHOD_REDUCE_TERMINAL,
+                                                        UCG_PLAN_METHOD_SEND_TERMINAL);
         if (status != UCS_OK) {
             return status;
         }
+        next_ep += phase->ep_cnt;
+        recursive->ep_cnt += phase->ep_cnt;
         phase++;
-        next_ep++;
         recursive->phs_cnt++;
-        recursive->ep_cnt++;
     }
     ++step_idx;
 
     /* Calculate the peers for each step */
-    status = ucg_builtin_recursive_non_pow_two_inter(ctx, new_my_index, member_list, step_size, near_power_of_two_step,
-                                                     factor, extra_indexs, check_swap, step_idx, &phase, &next_ep,
-                                                     recursive);
+    status = ucg_builtin_recursive_non_pow_two_inter(ctx, new_my_index, member_list, member_cnt, step_size,
+                                                     near_power_of_two_step, factor, check_swap, step_idx,
+                                                     &phase, &next_ep, recursive);
     if (status != UCS_OK) {
         return status;
     }
     step_idx += near_power_of_two_step;
 
-    if (my_index < (NUM_TWO * extra_indexs)) {
-        /* after - processing steps for non power of two processes case */
-        status = ucg_builtin_recursive_non_pow_two_post(ctx, next_ep, phase, my_index, member_list,
-                                                        step_idx, extra_indexs, factor, near_power_of_two_step,
-                                                        recursive);
+    if (size > 1) {
+        /* after - processing steps for non power of k processes case */
+        status = ucg_builtin_recursive_non_pow_two_fold(ctx, next_ep, phase, my_index, member_list,
+                                                        step_idx, first, size,
+                                                        UCG_PLAN_METHOD_SEND_TERMINAL,
+                                                        UCG_PLAN_METHOD_RECV_TERMINAL);
         if (status != UCS_OK) {
             return status;
         }
+        next_ep += phase->ep_cnt;
+        recursive->ep_cnt += phase->ep_cnt;
         phase++;
-        next_ep++;
         recursive->phs_cnt++;
-        recursive->ep_cnt++;
     }
     ++step_idx;
 
@@ -281,12 +297,13 @@ static ucs_status_t ucg_builtin_recursive_pow_two(ucg_builtin_group_ctx_t *ctx,
         }
         /* In each step, there are one or more peers */
         unsigned step_peer_idx;
+        phase->multi_eps = next_ep;
         for (step_peer_idx = 1; ((step_peer_idx < factor) && (status == UCS_OK)); step_peer_idx++) {
             ucg_group_member_index_t peer_index =
                 step_base + ((my_index - step_base + step_size * step_peer_idx) % (step_size * factor));
             ucs_info("%lu's peer #%u/%u (step #%u/%u): %lu ", my_index, step_peer_idx, factor - 1, step_idx + 1,
                 recursive->phs_cnt, peer_index);
-            phase->multi_eps = next_ep++;
+            next_ep++;
             recursive->ep_cnt++;
 
             status = ucg_builtin_connect(ctx, member_list[peer_index], phase,
@@ -355,41 +372,52 @@ ucs_status_t ucg_builtin_recursive_connect(ucg_builtin_group_ctx_t *ctx,
     return status;
 }
 
+/*
+ * A radix of k takes log_k(n) steps of k-1 messages each, which are sent at once -
+ * so as long as the messages are small, a larger radix means less latency. The
+ * configured factor is used if there is one, otherwise the one of 2, 4 and 8 which
+ * takes the fewest steps (the smallest one, upon a tie), counting the pre- and
+ * after- processing steps of non-power-of-k groups.
+ */
+unsigned ucg_builtin_recursive_factor(const ucg_builtin_config_t *config,
+                                      ucg_group_member_index_t member_cnt)
+{
+    unsigned factor, steps, best_steps;
+    unsigned best_factor = NUM_TWO;
+
+    if (config->recursive.factor >= NUM_TWO) {
+        return config->recursive.factor;
+    }
+
+    (void)ucg_builtin_recursive_compute_steps(0, member_cnt, NUM_TWO, &best_steps);
+    for (factor = NUM_TWO * NUM_TWO; factor <= MAX_AUTO_FACTOR; factor *= NUM_TWO) {
+        (void)ucg_builtin_recursive_compute_steps(0, member_cnt, factor, &steps);
+        if (steps < best_steps) {
+            best_steps  = steps;
+            best_factor = factor;
+        }
+    }
+    return best_factor;
+}
+
 ucs_status_t ucg_builtin_recursive_compute_steps(ucg_group_member_index_t my_index_local, unsigned rank_count,
                                                  unsigned factor, unsigned *steps)
 {
     unsigned step_size = 1;
     ucg_step_idx_t step_idx = 0;
     while (step_size < rank_count) {
-            step_size *= factor;
-            step_idx++;
-        }
-
-    unsigned extra_indexs;
-    unsigned near_power_of_two_step;
+        step_size *= factor;
+        step_idx++;
+    }
 
     /*
-     * for   power of two processes case:
-     * - near_power_of_two = log2(proc_count)
-     * for non power of two processes case:
-     * - near_power_of_two = log2(nearest power of two number less than proc_count)
+     * for     power of k processes case:
+     * - the steps of recursive k-ing, log_k(proc_count)
+     * for non power of k processes case:
+     * - log_k(nearest power of k number less than proc_count), plus the pre- and
+     *   after- processing steps - which all the members count, to stay in step
      */
-    near_power_of_two_step = (step_size != rank_count) ? (step_idx - 1) : step_idx;
-
-    /* non-power of two case */
-    if (step_size != rank_count) {
-        step_size >>= 1;
-        extra_indexs = rank_count - step_size;
-        if (my_index_local < (rank_count - NUM_TWO * extra_indexs)) {
-            step_idx--; // no   pre- and after- processing steps;
-        } else if (my_index_local < rank_count - extra_indexs) {
-            step_idx++; // add  pre- and after- processing steps;
-        } else {
-            step_idx = NUM_TWO; // only pre- and after- processing steps;
-        }
-    }
-
-    *steps = (step_size != rank_count) ? (near_power_of_two_step + NUM_TWO) : step_idx;
+    *steps = (step_size != rank_count) ? (step_idx - 1 + NUM_TWO) : step_idx;
 
     return UCS_OK;
 }
@@ -407,18 +435,14 @@ ucs_status_t ucg_builtin_recursive_create(ucg_builtin_group_ctx_t *ctx,
     const ucg_group_params_t *group_params, const ucg_collective_type_t *coll_type, ucg_builtin_plan_t **plan_p)
 {
     /* Find my own index */
-    ucg_group_member_index_t my_rank = 0;
-    while ((my_rank < group_params->member_count) &&
-           (group_params->distance[my_rank] !=
-           UCG_GROUP_MEMBER_DISTANCE_SELF)) {
-        my_rank++;
-    }
+    ucg_group_member_index_t my_rank = ucg_builtin_group_topo(ctx)->my_index;
 
     ucg_group_member_index_t member_cnt = group_params->member_count;
     ucg_group_member_index_t *member_list = UCS_ALLOC_CHECK(member_cnt * sizeof(ucg_group_member_index_t), "member list");
     ucg_builtin_recursive_init_member_list(member_cnt, member_list);
 
-    unsigned factor = config->recursive.factor;
+    /* the other collectives depend on the order of recursive doubling */
+    unsigned factor = ucg_algo.kary ? ucg_builtin_recursive_factor(config, member_cnt) : NUM_TWO;
     ucg_step_idx_t step_cnt = 0;
     unsigned step_size = 1;
     while (step_size < member_cnt) {
@@ -429,8 +453,8 @@ ucs_status_t ucg_builtin_recursive_create(ucg_builtin_group_ctx_t *ctx,
     size_t alloc_size = sizeof(ucg_builtin_plan_t) +
             (MAX_PHASES * sizeof(ucg_builtin_plan_phase_t)) + MAX_PEERS * sizeof(uct_ep_h);
     if (factor != NUM_TWO) {
-        /* Allocate extra space for the map's multiple endpoints */
-        alloc_size += step_cnt * (factor - 1) * sizeof(uct_ep_h);
+        /* Allocate extra space for the map's multiple endpoints, incl. pre- and after- processing */
+        alloc_size += (step_cnt + NUM_TWO) * (factor - 1) * sizeof(uct_ep_h);
     }
     ucg_builtin_plan_t *recursive = (ucg_builtin_plan_t*)ucs_malloc(alloc_size, "recursive topology");
     if (recursive == NULL) {
@@ -445,11 +469,162 @@ ucs_status_t ucg_builtin_recursive_create(ucg_builtin_group_ctx_t *ctx,
     }
 
     recursive->super.my_index = my_rank;
-    recursive->super.support_non_commutative = 1;
+    recursive->super.support_non_commutative = (factor == NUM_TWO);
     recursive->super.support_large_datatype = 1;
     *plan_p = recursive;
 out:
     ucs_free(member_list);
     member_list = NULL;
     return status;
-}
\ No newline at end of file
+}
+
+static ucs_status_t ucg_builtin_recursive_halving_inter(ucg_builtin_group_ctx_t *ctx,
+                                                        ucg_group_member_index_t new_my_index,
+                                                        ucg_group_member_index_t *member_list,
+                                                        ucg_group_member_index_t member_cnt,
+                                                        unsigned block_cnt,
+                                                        unsigned near_power_of_two_step,
+                                                        ucg_step_idx_ext_t step_idx,
+                                                        ucg_builtin_plan_phase_t **phase,
+                                                        uct_ep_h **next_ep,
+                                                        ucg_builtin_plan_t *recursive)
+{
+    ucs_status_t status = UCS_OK;
+    unsigned idx, distance;
+
+    if (new_my_index == ((ucg_group_member_index_t)-1)) {
+        return UCS_OK;
+    }
+
+    /* halving with the farthest peer first, then doubling with the nearest first */
+    for (idx = 0; ((idx < NUM_TWO * near_power_of_two_step) && (status == UCS_OK)); idx++, (*phase)++) {
+        if (idx < near_power_of_two_step) {
+            distance           = block_cnt >> (idx + 1);
+            (*phase)->method   = UCG_PLAN_METHOD_REDUCE_SCATTER_HALVING;
+        } else {
+            distance           = 1U << (idx - near_power_of_two_step);
+            (*phase)->method   = UCG_PLAN_METHOD_ALLGATHER_DOUBLING;
+        }
+        (*phase)->ep_cnt         = 1;
+        (*phase)->step_index     = step_idx + idx;
+        (*phase)->is_swap        = 0;
+        (*phase)->block_cnt      = block_cnt;
+        (*phase)->block_idx      = new_my_index;
+        (*phase)->block_distance = distance;
+#if ENABLE_DEBUG_DATA
+        (*phase)->indexes = UCS_ALLOC_CHECK(sizeof(new_my_index), "recursive topology indexes");
+#endif
+
+        ucg_group_member_index_t peer_index =
+            ucg_builtin_recursive_proxy(member_cnt, block_cnt, new_my_index ^ distance);
+        ucs_info("%lu's peer (step #%u/%u): %lu ", new_my_index, idx + 1,
+                 NUM_TWO * near_power_of_two_step, peer_index);
+        (*phase)->multi_eps = (*next_ep)++;
+        status = ucg_builtin_connect(ctx, member_list[peer_index], (*phase),
+                                     UCG_BUILTIN_CONNECT_SINGLE_EP);
+        recursive->phs_cnt++;
+        recursive->step_cnt++;
+        recursive->ep_cnt++;
+    }
+    return status;
+}
+
+/*
+ * Recursive halving/doubling (Rabenseifner): the vector is divided into a block
+ * per member, and every step of recursive halving exchanges half the blocks a
+ * member still has, reducing the half it keeps - until it reduced its own block.
+ * Recursive doubling then gathers the blocks, in the reverse order. Each member
+ * sends about twice the vector in total, instead of once per step. Groups of a
+ * non-power-of-two size fold the extra members in and out as in
+ * @ref ucg_builtin_recursive_non_pow_two.
+ */
+ucs_status_t ucg_builtin_recursive_halving_create(ucg_builtin_group_ctx_t *ctx,
+    enum ucg_builtin_plan_topology_type plan_topo_type, const ucg_builtin_config_t *config,
+    const ucg_group_params_t *group_params, const ucg_collective_type_t *coll_type, ucg_builtin_plan_t **plan_p)
+{
+    ucg_group_member_index_t my_index     = ucg_builtin_group_topo(ctx)->my_index;
+    ucg_group_member_index_t member_cnt   = group_params->member_count;
+    ucg_group_member_index_t new_my_index, first, size;
+    ucg_builtin_plan_phase_t *phase;
+    unsigned step_size, step_cnt, phs_max;
+    ucg_step_idx_ext_t step_idx;
+    ucs_status_t status;
+    uct_ep_h *next_ep;
+
+    ucg_group_member_index_t *member_list = UCS_ALLOC_CHECK(member_cnt * sizeof(ucg_group_member_index_t), "member list");
+    ucg_builtin_recursive_init_member_list(member_cnt, member_list);
+
+    /* the largest power of two not above the group size */
+    for (step_size = 1, step_cnt = 0; step_size * NUM_TWO <= member_cnt; step_size *= NUM_TWO) {
+        step_cnt++;
+    }
+    new_my_index = ucg_builtin_recursive_proxy_idx(member_cnt, step_size, my_index);
+    ucg_builtin_recursive_proxy_part(member_cnt, step_size, new_my_index, &first, &size);
+    if (my_index != first + size - 1) {
+        new_my_index = (ucg_group_member_index_t)-1;
+    }
+
+    /* Allocate memory resources: a phase and an endpoint per step */
+    phs_max = NUM_TWO * step_cnt + NUM_TWO;
+    size_t alloc_size = sizeof(ucg_builtin_plan_t) +
+            (phs_max * sizeof(ucg_builtin_plan_phase_t)) + (phs_max * sizeof(uct_ep_h));
+    ucg_builtin_plan_t *recursive = (ucg_builtin_plan_t*)ucs_malloc(alloc_size, "recursive halving topology");
+    if (recursive == NULL) {
+        ucs_free(member_list);
+        return UCS_ERR_NO_MEMORY;
+    }
+    memset(recursive, 0, alloc_size);
+    phase    = &recursive->phss[0];
+    next_ep  = (uct_ep_h*)(&recursive->phss[phs_max]);
+    step_idx = 0;
+
+    if (size > 1) {
+        /* pre - processing steps for non power of two processes case */
+        status = ucg_builtin_recursive_non_pow_two_fold(ctx, next_ep, phase, my_index, member_list,
+                                                        step_idx, first, size,
+                                                        UCG_PLAN_METHOD_REDUCE_TERMINAL,
+                                                        UCG_PLAN_METHOD_SEND_TERMINAL);
+        if (status != UCS_OK) {
+            goto out;
+        }
+        next_ep += phase->ep_cnt;
+        recursive->ep_cnt += phase->ep_cnt;
+        phase++;
+        recursive->phs_cnt++;
+    }
+    ++step_idx;
+
+    status = ucg_builtin_recursive_halving_inter(ctx, new_my_index, member_list, member_cnt,
+                                                 step_size, step_cnt, step_idx, &phase,
+                                                 &next_ep, recursive);
+    if (status != UCS_OK) {
+        goto out;
+    }
+    step_idx += NUM_TWO * step_cnt;
+
+    if (size > 1) {
+        /* after - processing steps for non power of two processes case */
+        status = ucg_builtin_recursive_non_pow_two_fold(ctx, next_ep, phase, my_index, member_list,
+                                                        step_idx, first, size,
+                                                        UCG_PLAN_METHOD_SEND_TERMINAL,
+                                                        UCG_PLAN_METHOD_RECV_TERMINAL);
+        if (status != UCS_OK) {
+            goto out;
+        }
+        recursive->ep_cnt += phase->ep_cnt;
+        recursive->phs_cnt++;
+    }
+    ucg_builtin_recursive_log(recursive);
+
+    recursive->super.my_index = my_index;
+    recursive->super.support_non_commutative = 0;
+    recursive->super.support_large_datatype = 0;
+    *plan_p = recursive;
+out:
+    if (status != UCS_OK) {
+        ucs_free(recursive);
+    }
+    ucs_free(member_list);
+    member_list = NULL;
+    return status;
+}
@@ -24,6 +24,15 @@ void ucg_builtin_ring_assign_recv_thresh(ucg_builtin_plan_phase_t *phase)
     }
 }
 
+static void ucg_builtin_ring_assign_single_ep(ucg_builtin_plan_phase_t *phase)
+{
+    /*
+    * while phase->ep_cnt is set to be 1. So phase->single_ep should
+    * point to multi_eps[0].
+    */
+    phase->single_ep = phase->multi_eps[0];
+}
+
 ucs_status_t ucg_builtin_ring_connect(ucg_builtin_group_ctx_t *ctx,
                                       ucg_builtin_plan_phase_t *phase,
                                       ucg_step_idx_ext_t step_idx,
@@ -38,55 +47,45 @@ ucs_status_t ucg_builtin_ring_connect(ucg_builtin_group_ctx_t *ctx,
         unsigned phase_ep_index = 1; /* index: 0 for sender and 1 for receiver */
         phase->multi_eps = next_ep++;
 
-        /* connected to src process for second EP, recv */
-        status = ucg_builtin_connect(ctx, peer_index_src, phase, phase_ep_index);
+        /* connected to src process for second EP, recv - and once connected,
+        * set threshold for receiver
+        * for ring threshold for receiver and sender maybe not same!!!
+        */
+        status = ucg_builtin_connect_cb(ctx, peer_index_src, phase, phase_ep_index,
+                                        ucg_builtin_ring_assign_recv_thresh);
         if (status != UCS_OK) {
             return status;
         }
         phase_ep_index--;
         next_ep++;
 
-        /* set threshold for receiver
-        * for ring threshold for receiver and sender maybe not same!!!
-        */
-        ucg_builtin_ring_assign_recv_thresh(phase);
-
         /* connected to dst process for first EP, send */
-        status = ucg_builtin_connect(ctx, peer_index_dst, phase, phase_ep_index);
+        status = ucg_builtin_connect_cb(ctx, peer_index_dst, phase, phase_ep_index,
+                                        ucg_builtin_ring_assign_single_ep);
         if (status != UCS_OK) {
             return status;
         }
-
-        /*
-        * while phase->ep_cnt is set to be 1. So phase->single_ep should
-        * point to multi_eps[0].
-        */
-        phase->single_ep = phase->multi_eps[0];
     } else {
         phase->ep_cnt  = 1;
         ring->ep_cnt -= 1;
         phase->multi_eps = next_ep++;
-        status = ucg_builtin_connect(ctx, peer_index_src, phase, UCG_BUILTIN_CONNECT_SINGLE_EP);
+        /* set threshold for receiver (once connected)
+            * for ring threshold for receiver and sender maybe not same!!!
+            */
+        status = ucg_builtin_connect_cb(ctx, peer_index_src, phase, UCG_BUILTIN_CONNECT_SINGLE_EP,
+                                        ucg_builtin_ring_assign_recv_thresh);
         if (status != UCS_OK) {
             return status;
         }
-        /* set threshold for receiver
-            * for ring threshold for receiver and sender maybe not same!!!
-            */
-        ucg_builtin_ring_assign_recv_thresh(phase);
     }
 
     return status;
 }
 
-void ucg_builtin_ring_find_my_index(const ucg_group_params_t *group_params, unsigned proc_count, ucg_group_member_index_t *my_index)
+void ucg_builtin_ring_find_my_index(const ucg_topo_t *topo, unsigned proc_count, ucg_group_member_index_t *my_index)
 {
-    while ((*my_index < proc_count) &&
-           (group_params->distance[*my_index] !=
-           UCG_GROUP_MEMBER_DISTANCE_SELF)) {
-        (*my_index)++;
-    }
-    ucs_assert(*my_index != proc_count);
+    *my_index = topo->my_index;
+    ucs_assert(*my_index < proc_count);
 }
 ucs_status_t ucg_builtin_ring_create(ucg_builtin_group_ctx_t *ctx,
                                      enum ucg_builtin_plan_topology_type plan_topo_type,
@@ -96,7 +95,7 @@ ucs_status_t ucg_builtin_ring_create(ucg_builtin_group_ctx_t *ctx,
                                      ucg_builtin_plan_t **plan_p)
 {
     /* only phase0  need to call builtin_connect */
-    ucg_builtin_plan_phase_t  phase_zero;
+    ucg_builtin_plan_phase_t *phase_zero;
 
     /* the number of ring steps is proc_count-1,and the step_size is always 1 */
     unsigned proc_count = group_params->member_count;
@@ -117,7 +116,7 @@ ucs_status_t ucg_builtin_ring_create(ucg_builtin_group_ctx_t *ctx,
 
     /* Find my own index */
     ucg_group_member_index_t my_index = 0;
-    ucg_builtin_ring_find_my_index(group_params, proc_count, &my_index);
+    ucg_builtin_ring_find_my_index(ucg_builtin_group_topo(ctx), proc_count, &my_index);
 
     ucs_status_t status;
     /* builtin phase 0 */
@@ -146,13 +145,12 @@ ucs_status_t ucg_builtin_ring_create(ucg_builtin_group_ctx_t *ctx,
         ucs_error("Error in ring create: %d", (int)status);
         return status;
     }
-    phase_zero = *phase;
+    phase_zero = phase;
     phase++;
 
     for (step_idx = 1; step_idx < ring->phs_cnt; step_idx++, phase++) {
-        /* the following endpoint is as same as phase(0) */
-        *phase = phase_zero;
-        phase->ucp_eps = NULL;
+        /* the following endpoint is as same as phase(0), once connected */
+        ucg_builtin_plan_clone_phase(phase, phase_zero);
 
         /* modify method and step_index in phase */
         if (step_idx < proc_count - 1) {
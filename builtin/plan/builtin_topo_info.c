@@ -13,25 +13,11 @@
 
 
 /* find my own rank */
-ucs_status_t ucg_builtin_find_myself(const ucg_group_params_t *group_params,
+ucs_status_t ucg_builtin_find_myself(const ucg_topo_t *topo,
                                      ucg_group_member_index_t *myrank)
 {
-    /* find my own rank */
-    unsigned member_idx;
-    ucg_group_member_index_t init_myrank = (ucg_group_member_index_t) - 1;
-    *myrank = init_myrank;
-    for (member_idx = 0; member_idx < group_params->member_count; member_idx++) {
-        ucs_assert(group_params->distance[member_idx] < UCG_GROUP_MEMBER_DISTANCE_LAST);
-        if (group_params->distance[member_idx] == UCG_GROUP_MEMBER_DISTANCE_SELF) {
-            *myrank = member_idx;
-            break;
-        }
-    }
-
-    if (*myrank == init_myrank) {
-        ucs_error("No member with distance==UCP_GROUP_MEMBER_DISTANCE_SELF found");
-        return UCS_ERR_INVALID_PARAM;
-    }
+    /* validated when the group's topology was created */
+    *myrank = topo->my_index;
     return UCS_OK;
 }
 
@@ -59,7 +45,7 @@ static ucs_status_t ucg_builtin_check_topology_info(ucg_builtin_topology_info_pa
     return UCS_OK;
 }
 
-static ucs_status_t ucg_builtin_prepare_topology_info(const ucg_group_params_t *group_params,
+static ucs_status_t ucg_builtin_prepare_topology_info(const ucg_topo_t *topo,
                                                       ucg_builtin_topology_info_params_t *topo_params,
                                                       ucg_group_member_index_t myrank)
 {
@@ -85,15 +71,15 @@ static ucs_status_t ucg_builtin_prepare_topology_info(const ucg_group_params_t *
     }
 
     /* rank_same_node */
-    for (member_idx = 0, ppn_idx = 0; member_idx < group_params->member_count; member_idx++) {
-        if (group_params->node_index[member_idx] == group_params->node_index[myrank]) {
+    for (member_idx = 0, ppn_idx = 0; member_idx < topo->member_count; member_idx++) {
+        if (ucg_topo_node_index(topo, member_idx) == ucg_topo_node_index(topo, myrank)) {
             topo_params->rank_same_node[ppn_idx++] = member_idx;
         }
     }
 
     /* subroot_array: Pick mininum rank number as subroot in same node */
-    for (member_idx = 0; member_idx < group_params->member_count; member_idx++)  {
-        node_idx = group_params->node_index[member_idx];
+    for (member_idx = 0; member_idx < topo->member_count; member_idx++)  {
+        node_idx = ucg_topo_node_index(topo, member_idx);
         if (member_idx < topo_params->subroot_array[node_idx]) {
             topo_params->subroot_array[node_idx] = member_idx;
         }
@@ -103,45 +89,36 @@ static ucs_status_t ucg_builtin_prepare_topology_info(const ucg_group_params_t *
 }
 
 ucs_status_t ucg_builtin_topology_info_create(ucg_builtin_topology_info_params_t *topo_params,
-                                              const ucg_group_params_t *group_params,
+                                              const ucg_topo_t *topo,
                                               ucg_group_member_index_t root)
 {
     ucs_status_t status;
     ucg_group_member_index_t member_idx;
     unsigned node_idx;
     unsigned ppn_idx = 0;
-    ucg_group_member_index_t myrank = 0;
+    ucg_group_member_index_t myrank = topo->my_index;
     /* initalization */
-    topo_params->node_cnt = 0;
+    topo_params->node_cnt = topo->node_cnt;
     topo_params->ppn_cnt = 0;
 
-    status = ucg_builtin_find_myself(group_params, &myrank);
-    if (status != UCS_OK) {
-        return status;
-    }
-
-    /* obtain node count, ppn_cnt */
-    for (member_idx = 0; member_idx < group_params->member_count; member_idx++) {
-        if (topo_params->node_cnt < group_params->node_index[member_idx]) {
-            topo_params->node_cnt = group_params->node_index[member_idx];
-        }
-        if (group_params->node_index[member_idx] == group_params->node_index[myrank]) {
+    /* obtain ppn_cnt */
+    for (member_idx = 0; member_idx < topo->member_count; member_idx++) {
+        if (ucg_topo_node_index(topo, member_idx) == ucg_topo_node_index(topo, myrank)) {
             (topo_params->ppn_cnt)++;
         }
     }
 
-    (topo_params->node_cnt)++;
-    status = ucg_builtin_prepare_topology_info(group_params, topo_params, myrank);
+    status = ucg_builtin_prepare_topology_info(topo, topo_params, myrank);
     if (status != UCS_OK) {
         return status;
     }
 
     /* Special case: root is not minumum */
     /* root must be sub-root no matter its value */
-    node_idx = group_params->node_index[root];
+    node_idx = ucg_topo_node_index(topo, root);
     topo_params->subroot_array[node_idx] = root;
 
-    if (group_params->node_index[myrank] == group_params->node_index[root]) {
+    if (ucg_topo_node_index(topo, myrank) == ucg_topo_node_index(topo, root)) {
         /* find ppn_idx corresponding to root rank */
         for (ppn_idx = 0; ppn_idx < topo_params->ppn_cnt; ppn_idx++) {
             if (topo_params->rank_same_node[ppn_idx] == root) {
@@ -160,28 +137,20 @@ ucs_status_t ucg_builtin_topology_info_create(ucg_builtin_topology_info_params_t
 }
 
 /* check ppn balance or not */
-ucs_status_t ucg_builtin_check_ppn(const ucg_group_params_t *group_params,
+ucs_status_t ucg_builtin_check_ppn(const ucg_topo_t *topo,
                                    unsigned *unequal_ppn)
 {
     ucg_group_member_index_t member_idx;
-    volatile unsigned node_cnt = 0;
+    unsigned node_cnt = topo->node_cnt;
     unsigned node_idx;
     *unequal_ppn = 0;
-    /* node count */
-    for (member_idx = 0; member_idx < group_params->member_count; member_idx++) {
-        node_idx = group_params->node_index[member_idx];
-        if (node_cnt < node_idx) {
-            node_cnt = node_idx;
-        }
-    }
-    node_cnt++;
 
     /* ppn array: record ppn vaule in every single node */
     size_t alloc_size = sizeof(unsigned) * node_cnt;
     unsigned *ppn_array = (unsigned *)UCS_ALLOC_CHECK(alloc_size, "ppn array");
     memset(ppn_array, 0, alloc_size);
-    for (member_idx = 0; member_idx < group_params->member_count; member_idx++) {
-        node_idx = group_params->node_index[member_idx];
+    for (member_idx = 0; member_idx < topo->member_count; member_idx++) {
+        node_idx = ucg_topo_node_index(topo, member_idx);
         ppn_array[node_idx]++;
     }
 
@@ -0,0 +1,287 @@
+/*
+ * Copyright (C) Huawei Technologies Co., Ltd. 2020.  ALL RIGHTS RESERVED.
+ * See file LICENSE for terms.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include "config.h"
+#endif
+
+#include <common/test.h>
+
+extern "C" {
+#include <ucg/api/ucg_mpi.h>
+}
+
+#include <vector>
+
+/*
+ * Pipelined collectives, with every few fragments failing with
+ * UCS_ERR_NO_RESOURCE (BUILTIN_FAULT_NO_RESOURCE) - the resends have to
+ * deliver exactly the same data as the first attempt would have.
+ */
+class test_ucg_fault : public ucs::test {
+protected:
+    static const unsigned NUM_MEMBERS = 4;
+    static const int      COUNT       = 16 * 1024; /* of int32_t, 64 fragments */
+
+    struct member {
+        ucp_context_h  context;
+        ucp_worker_h   worker;
+        ucp_address_t *address;
+        size_t         address_len;
+        ucg_group_h    group;
+    };
+
+    virtual void init() {
+        ucs::test::init();
+
+#if !ENABLE_DEBUG_DATA
+        UCS_TEST_SKIP_R("fault injection requires --enable-debug-data");
+#endif
+
+        /* every member is on a node of its own, so all the data is sent */
+        set_env("UCX_BUILTIN_FAULT_NO_RESOURCE", "3");
+        set_env("UCX_BUILTIN_PIPELINE_SEGMENT",  "1k");
+        set_env("UCX_BUILTIN_SHM_COLL",          "n");
+        set_env("UCX_BUILTIN_BCAST_ALGORITHM",   "5"); /* pipelined binomial tree */
+        set_env("UCX_BUILTIN_REDUCE_ALGORITHM",  "2"); /* pipelined binomial tree */
+        set_env("UCX_BUILTIN_ALLREDUCE_ALGORITHM", "9"); /* pipelined ring */
+
+        m_members.resize(NUM_MEMBERS);
+        for (unsigned i = 0; i < NUM_MEMBERS; ++i) {
+            create_member(m_members[i]);
+        }
+        for (unsigned i = 0; i < NUM_MEMBERS; ++i) {
+            create_group(i);
+        }
+    }
+
+    virtual void cleanup() {
+        for (std::vector<member>::iterator it = m_members.begin();
+             it != m_members.end(); ++it) {
+            if (it->group != NULL) {
+                ucg_group_destroy(it->group);
+            }
+            if (it->address != NULL) {
+                ucg_worker_release_address(it->worker, it->address);
+            }
+            if (it->worker != NULL) {
+                ucg_worker_destroy(it->worker);
+            }
+            if (it->context != NULL) {
+                ucg_cleanup(it->context);
+            }
+        }
+        m_members.clear();
+
+        for (std::vector<ucs::scoped_setenv*>::iterator it = m_env.begin();
+             it != m_env.end(); ++it) {
+            delete *it;
+        }
+        m_env.clear();
+
+        ucs::test::cleanup();
+    }
+
+    void set_env(const char *name, const char *value) {
+        m_env.push_back(new ucs::scoped_setenv(name, value));
+    }
+
+    void create_member(member &m) {
+        memset(&m, 0, sizeof(m));
+
+        ucp_params_t params;
+        params.field_mask = UCP_PARAM_FIELD_FEATURES;
+        params.features   = UCP_FEATURE_GROUPS;
+
+        ucp_config_t *config;
+        ASSERT_UCS_OK(ucg_config_read(NULL, NULL, &config));
+        ucs_status_t status = ucg_init(&params, config, &m.context);
+        ucg_config_release(config);
+        ASSERT_UCS_OK(status);
+
+        ucp_worker_params_t worker_params;
+        worker_params.field_mask  = UCP_WORKER_PARAM_FIELD_THREAD_MODE;
+        worker_params.thread_mode = UCS_THREAD_MODE_SINGLE;
+        ASSERT_UCS_OK(ucg_worker_create(m.context, &worker_params, &m.worker));
+        ASSERT_UCS_OK(ucg_worker_get_address(m.worker, &m.address,
+                                             &m.address_len));
+    }
+
+    void create_group(unsigned index) {
+        std::vector<enum ucg_group_member_distance> &distance = m_distance[index];
+        distance.assign(NUM_MEMBERS, UCG_GROUP_MEMBER_DISTANCE_NET);
+        distance[index] = UCG_GROUP_MEMBER_DISTANCE_SELF;
+
+        m_node_index.resize(NUM_MEMBERS);
+        for (unsigned i = 0; i < NUM_MEMBERS; ++i) {
+            m_node_index[i] = i;
+        }
+
+        ucg_group_params_t params;
+        memset(&params, 0, sizeof(params));
+        params.member_count      = NUM_MEMBERS;
+        params.cid               = 1;
+        params.distance          = &distance[0];
+        params.node_index        = &m_node_index[0];
+        params.mpi_reduce_f      = reduce_sum;
+        params.resolve_address_f = resolve_address;
+        params.release_address_f = release_address;
+        params.cb_group_obj      = this;
+        params.op_is_commute_f   = op_is_commute;
+        params.reduce_type_f     = reduce_type;
+        ASSERT_UCS_OK(ucg_group_create(m_members[index].worker, &params,
+                                       &m_members[index].group));
+    }
+
+    static ucs_status_t resolve_address(void *cb_group_obj,
+                                        ucg_group_member_index_t index,
+                                        ucg_address_t **addr, size_t *addr_len) {
+        test_ucg_fault *self = reinterpret_cast<test_ucg_fault*>(cb_group_obj);
+        *addr                = self->m_members[index].address;
+        *addr_len            = self->m_members[index].address_len;
+        return UCS_OK;
+    }
+
+    static void release_address(ucg_address_t *addr) {
+        /* the addresses are released along with the workers */
+    }
+
+    static int op_is_commute(void *mpi_op) {
+        return 1;
+    }
+
+    static int reduce_type(void *mpi_op, void *mpi_dtype, ucg_reduce_op_t *op_p,
+                           ucg_reduce_dt_t *dt_p) {
+        *op_p = UCG_REDUCE_OP_SUM;
+        *dt_p = UCG_REDUCE_DT_INT32;
+        return 1;
+    }
+
+    static void reduce_sum(void *mpi_op, char *src, char *dst, unsigned count,
+                           void *mpi_dtype) {
+        for (unsigned i = 0; i < count; ++i) {
+            reinterpret_cast<int32_t*>(dst)[i] +=
+                    reinterpret_cast<const int32_t*>(src)[i];
+        }
+    }
+
+    /* start the collective on every member, and progress them all until done */
+    void run(std::vector<ucg_coll_h> &colls) {
+        std::vector<void*> reqs(NUM_MEMBERS);
+        for (unsigned i = 0; i < NUM_MEMBERS; ++i) {
+            ucs_status_ptr_t req = ucg_collective_start_nb(colls[i]);
+            ASSERT_UCS_PTR_OK(req);
+            reqs[i] = req;
+        }
+
+        unsigned done;
+        do {
+            done = 0;
+            for (unsigned i = 0; i < NUM_MEMBERS; ++i) {
+                ucg_worker_progress(m_members[i].worker);
+                if (reqs[i] == NULL) {
+                    ++done;
+                } else if (ucg_request_check_status(reqs[i]) != UCS_INPROGRESS) {
+                    ASSERT_UCS_OK(ucg_request_check_status(reqs[i]));
+                    ucg_request_free(reqs[i]);
+                    reqs[i] = NULL;
+                }
+            }
+        } while (done < NUM_MEMBERS);
+    }
+
+    static int32_t value(unsigned member, int i) {
+        return (int32_t)((member + 1) * 1000 + i);
+    }
+
+    std::vector<member>                          m_members;
+    std::vector<enum ucg_group_member_distance>  m_distance[NUM_MEMBERS];
+    std::vector<uint16_t>                        m_node_index;
+    std::vector<ucs::scoped_setenv*>             m_env;
+    int                                          m_mpi_op;
+    int                                          m_mpi_dtype;
+};
+
+UCS_TEST_F(test_ucg_fault, bcast) {
+    std::vector<std::vector<int32_t> > bufs(NUM_MEMBERS,
+                                            std::vector<int32_t>(COUNT, 0));
+    std::vector<ucg_coll_h> colls(NUM_MEMBERS);
+
+    for (int i = 0; i < COUNT; ++i) {
+        bufs[0][i] = value(0, i);
+    }
+
+    for (unsigned m = 0; m < NUM_MEMBERS; ++m) {
+        ASSERT_UCS_OK(ucg_coll_bcast_init(&bufs[m][0], &bufs[m][0], COUNT,
+                                          sizeof(int32_t), &m_mpi_dtype,
+                                          m_members[m].group, NULL, NULL, 0, 0,
+                                          &colls[m]));
+    }
+
+    run(colls);
+
+    for (unsigned m = 1; m < NUM_MEMBERS; ++m) {
+        for (int i = 0; i < COUNT; ++i) {
+            ASSERT_EQ(value(0, i), bufs[m][i]) << "member " << m << " index " << i;
+        }
+    }
+}
+
+UCS_TEST_F(test_ucg_fault, reduce) {
+    std::vector<std::vector<int32_t> > sbufs(NUM_MEMBERS,
+                                             std::vector<int32_t>(COUNT));
+    std::vector<int32_t> rbuf(COUNT, 0);
+    std::vector<ucg_coll_h> colls(NUM_MEMBERS);
+
+    for (unsigned m = 0; m < NUM_MEMBERS; ++m) {
+        for (int i = 0; i < COUNT; ++i) {
+            sbufs[m][i] = value(m, i);
+        }
+        ASSERT_UCS_OK(ucg_coll_reduce_init(&sbufs[m][0], &rbuf[0], COUNT,
+                                           sizeof(int32_t), &m_mpi_dtype,
+                                           m_members[m].group, NULL, &m_mpi_op,
+                                           0, 0, &colls[m]));
+    }
+
+    run(colls);
+
+    for (int i = 0; i < COUNT; ++i) {
+        int32_t expected = 0;
+        for (unsigned m = 0; m < NUM_MEMBERS; ++m) {
+            expected += value(m, i);
+        }
+        ASSERT_EQ(expected, rbuf[i]) << "index " << i;
+    }
+}
+
+UCS_TEST_F(test_ucg_fault, allreduce) {
+    std::vector<std::vector<int32_t> > sbufs(NUM_MEMBERS,
+                                             std::vector<int32_t>(COUNT));
+    std::vector<std::vector<int32_t> > rbufs(NUM_MEMBERS,
+                                             std::vector<int32_t>(COUNT, 0));
+    std::vector<ucg_coll_h> colls(NUM_MEMBERS);
+
+    for (unsigned m = 0; m < NUM_MEMBERS; ++m) {
+        for (int i = 0; i < COUNT; ++i) {
+            sbufs[m][i] = value(m, i);
+        }
+        ASSERT_UCS_OK(ucg_coll_allreduce_init(&sbufs[m][0], &rbufs[m][0], COUNT,
+                                              sizeof(int32_t), &m_mpi_dtype,
+                                              m_members[m].group, NULL,
+                                              &m_mpi_op, 0, 0, &colls[m]));
+    }
+
+    run(colls);
+
+    for (int i = 0; i < COUNT; ++i) {
+        int32_t expected = 0;
+        for (unsigned m = 0; m < NUM_MEMBERS; ++m) {
+            expected += value(m, i);
+        }
+        for (unsigned m = 0; m < NUM_MEMBERS; ++m) {
+            ASSERT_EQ(expected, rbufs[m][i]) << "member " << m << " index " << i;
+        }
+    }
+}